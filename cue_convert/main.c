@@ -20,6 +20,7 @@ int main(int argc, char const *argv[]) {
 
   env.out = stdout;
   env.err = stderr;
+  env.watch_passes = 0;
 
   return cue_convert_with_args(argc, argv, &env, 0);
 }
@@ -0,0 +1,640 @@
+#include "cue_catalog.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "err_helpers.h"
+#include "mem_helpers.h"
+#include "cue_parser.h"
+#include "cue_sheet_cache.h"
+#include "cue_traverse_record.h"
+#include "filesystem.h"
+#include "path.h"
+#include "line_writer.h"
+#include "format_helpers.h"
+
+// a section of the catalog as it is built
+typedef struct catalog_buffer {
+  char* bytes;
+  size_t length;
+  size_t capacity;
+} catalog_buffer_t;
+
+// a cue of the report, with what the run did with it
+typedef struct gathered_cue {
+  cue_traverse_record_t const* record;  // weak ref
+  char const* path;  // points into the record, relative to the source root
+  cue_traverse_report_type_t status;
+} gathered_cue_t;
+
+typedef struct catalog_builder {
+  catalog_buffer_t cues;
+  catalog_buffer_t files;
+  catalog_buffer_t tracks;
+  catalog_buffer_t indexes;
+  catalog_buffer_t strings;
+} catalog_builder_t;
+
+static int compare_cues(void const* lhs, void const* rhs);
+static void gather_cues(
+  struct cue_traverse_record_vector const* list,
+  cue_traverse_report_type_t status,
+  char const* source_root,
+  gathered_cue_t* cues,
+  size_t* num_cues);
+static errno_t add_cue(catalog_builder_t* builder, gathered_cue_t const* cue, struct cue_sheet_cache* sheet_cache);
+static errno_t add_file(catalog_builder_t* builder, char const* dir, cue_file_t const* file);
+static errno_t add_tracks(catalog_builder_t* builder, cue_file_t const* file, unsigned long long file_frames);
+static unsigned int track_start(cue_track_t const* track);
+static unsigned long long file_frames(cue_file_t const* file, unsigned long long size);
+static errno_t add_string(catalog_builder_t* builder, char const* str, unsigned int* offset);
+static errno_t buffer_append(catalog_buffer_t* self, void const* bytes, size_t length);
+static void buffer_uninit(catalog_buffer_t* self);
+static errno_t write_section(FILE* file, catalog_buffer_t const* section);
+static short check_range(unsigned long long offset, unsigned long long count, size_t item_size, size_t total);
+static short check_span(unsigned int first, unsigned int count, unsigned int total);
+static errno_t validate(struct cue_catalog* self);
+static short is_under(char const* path, char const* dir);
+static short has_type(struct cue_catalog const* self, cue_catalog_cue_t const* cue, cue_file_type_t type);
+static short name_matches(char const* name, char const* arg);
+static char* format_frames(unsigned long long frames);
+
+#define CATALOG_ALIGNMENT 8
+
+// indexed by cue_traverse_report_type_t
+static char const* const s_status_names[] = {
+  "transformed",
+  "failed",
+  "skipped",
+};
+
+// indexed by cue_file_type_t, as the cue sheets name them
+static char const* const s_type_names[] = {
+  "BINARY",
+  "WAV",
+  "MP3",
+  "OGG",
+};
+
+static const char s_type_term[] = "type=";
+static const char s_status_term[] = "status=";
+static const char s_under_term[] = "under=";
+
+// raw cd audio, and the 2048 byte sectors of data tracks stored without
+// their error correction
+#define SECTOR_SIZE 2352
+#define DATA_SECTOR_SIZE 2048
+
+// the usual header of a wav file ahead of its samples
+#define WAV_HEADER_SIZE 44
+
+errno_t cue_catalog_write(
+  char const* path,
+  struct cue_traverse_report const* report,
+  char const* source_root,
+  struct cue_sheet_cache* sheet_cache_opt) {
+
+  errno_t err = 0;
+  catalog_builder_t builder;
+  gathered_cue_t* cues = 0;
+  size_t num_cues = 0;
+  size_t capacity = 0;
+  cue_catalog_header_t header;
+  unsigned long long offset = 0;
+  FILE* file = 0;
+  char const* part_path = 0;
+
+  memset(&builder, 0, sizeof(builder));
+  memset(&header, 0, sizeof(header));
+
+  ERR_REGION_BEGIN() {
+    capacity = report->transformed_list->get_length(report->transformed_list)
+      + report->failed_list->get_length(report->failed_list)
+      + report->skipped_list->get_length(report->skipped_list);
+    ERR_REGION_NULL_CHECK(cues = calloc(capacity ? capacity : 1, sizeof(*cues)), err);
+
+    gather_cues(report->transformed_list, EWC_CTR_TRANSFORMED, source_root, cues, &num_cues);
+    gather_cues(report->failed_list, EWC_CTR_FAILED, source_root, cues, &num_cues);
+    gather_cues(report->skipped_list, EWC_CTR_SKIPPED, source_root, cues, &num_cues);
+
+    // in path order, so that a subtree is listed together
+    qsort(cues, num_cues, sizeof(*cues), compare_cues);
+
+    // offset 0 is the empty string
+    ERR_REGION_ERROR_CHECK(buffer_append(&builder.strings, "", 1), err);
+    ERR_REGION_ERROR_CHECK(add_string(&builder, source_root, &header.source_root), err);
+
+    for (size_t i = 0; i < num_cues; ++i) {
+      ERR_REGION_ERROR_CHECK(add_cue(&builder, &cues[i], sheet_cache_opt), err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    // every section starts aligned for its largest member
+    memcpy(header.magic, CUE_CATALOG_MAGIC, sizeof(header.magic));
+    header.version = CUE_CATALOG_VERSION;
+    header.num_cues = (unsigned int)(builder.cues.length / sizeof(cue_catalog_cue_t));
+    header.num_files = (unsigned int)(builder.files.length / sizeof(cue_catalog_file_t));
+    header.num_tracks = (unsigned int)(builder.tracks.length / sizeof(cue_catalog_track_t));
+    header.num_indexes = (unsigned int)(builder.indexes.length / sizeof(cue_catalog_time_t));
+
+    offset = sizeof(header);
+    header.cues_offset = offset;
+    offset += builder.cues.length;
+    header.files_offset = offset;
+    offset += builder.files.length;
+    header.tracks_offset = offset;
+    offset += builder.tracks.length;
+    header.indexes_offset = offset;
+    offset += builder.indexes.length;
+    header.strings_offset = offset;
+    header.strings_size = builder.strings.length;
+
+    // written aside, so a catalog being mapped is never changed under it
+    ERR_REGION_NULL_CHECK(part_path = path_part_file(path), err);
+    fopen_s(&file, part_path, "wb");
+    ERR_REGION_NULL_CHECK(file, err);
+
+    ERR_REGION_CMP_CHECK(fwrite(&header, sizeof(header), 1, file) != 1, err);
+    ERR_REGION_ERROR_CHECK(write_section(file, &builder.cues), err);
+    ERR_REGION_ERROR_CHECK(write_section(file, &builder.files), err);
+    ERR_REGION_ERROR_CHECK(write_section(file, &builder.tracks), err);
+    ERR_REGION_ERROR_CHECK(write_section(file, &builder.indexes), err);
+    ERR_REGION_ERROR_CHECK(write_section(file, &builder.strings), err);
+
+    ERR_REGION_CMP_CHECK(fclose(file), err);
+    file = 0;
+    ERR_REGION_ERROR_CHECK(replace_file(part_path, path), err);
+
+  } ERR_REGION_END()
+
+  if (file) fclose(file);
+  if (err && part_path) delete_file(part_path);
+  SAFE_FREE(part_path);
+
+  buffer_uninit(&builder.strings);
+  buffer_uninit(&builder.indexes);
+  buffer_uninit(&builder.tracks);
+  buffer_uninit(&builder.files);
+  buffer_uninit(&builder.cues);
+  SAFE_FREE(cues);
+
+  return err;
+}
+
+static int compare_cues(void const* lhs, void const* rhs) {
+  gathered_cue_t const* a = (gathered_cue_t const*)lhs;
+  gathered_cue_t const* b = (gathered_cue_t const*)rhs;
+
+  return strcmp(a->path, b->path);
+}
+
+static void gather_cues(
+  struct cue_traverse_record_vector const* list,
+  cue_traverse_report_type_t status,
+  char const* source_root,
+  gathered_cue_t* cues,
+  size_t* num_cues) {
+
+  for (size_t i = 0; i < list->get_length(list); ++i) {
+    gathered_cue_t* cue = &cues[(*num_cues)++];
+
+    cue->record = list->get(list, i);
+    cue->path = path_relative_part(source_root, cue->record->source_path);
+    cue->status = status;
+  }
+}
+
+static errno_t add_cue(catalog_builder_t* builder, gathered_cue_t const* cue, struct cue_sheet_cache* sheet_cache) {
+  errno_t err = 0;
+  cue_catalog_cue_t entry;
+  cue_sheet_t const* sheet = cue->record->source_sheet;
+  cue_sheet_t* parsed = 0;
+  char const* dir = 0;
+
+  memset(&entry, 0, sizeof(entry));
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_ERROR_CHECK(add_string(builder, cue->path, &entry.path), err);
+    entry.status = cue->status;
+    entry.first_file = (unsigned int)(builder->files.length / sizeof(cue_catalog_file_t));
+
+    // skipped cues were never read, and a cue that won't parse is listed
+    // without its files
+    if (!sheet) {
+      if (sheet_cache) {
+        parsed = cue_sheet_cache_parse_filename(sheet_cache, cue->record->source_path, NULL);
+      }
+      else {
+        parsed = cue_sheet_parse_filename(cue->record->source_path, NULL);
+      }
+
+      sheet = parsed;
+    }
+
+    if (sheet) {
+      entry.flags |= CUE_CATALOG_CUE_PARSED;
+      entry.num_files = sheet->num_files;
+
+      ERR_REGION_NULL_CHECK(dir = path_dir_part(cue->record->source_path), err);
+      for (short i = 0; i < sheet->num_files; ++i) {
+        ERR_REGION_ERROR_CHECK(add_file(builder, dir, sheet->file[i]), err);
+      } ERR_REGION_ERROR_BUBBLE(err);
+    }
+
+    ERR_REGION_ERROR_CHECK(buffer_append(&builder->cues, &entry, sizeof(entry)), err);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE(dir);
+  SAFE_FREE_HANDLER(parsed, cue_sheet_free);
+
+  return err;
+}
+
+static errno_t add_file(catalog_builder_t* builder, char const* dir, cue_file_t const* file) {
+  errno_t err = 0;
+  cue_catalog_file_t entry;
+  char const* path = 0;
+
+  memset(&entry, 0, sizeof(entry));
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_ERROR_CHECK(add_string(builder, file->filename, &entry.name), err);
+    entry.type = file->type;
+    entry.first_track = (unsigned int)(builder->tracks.length / sizeof(cue_catalog_track_t));
+    entry.num_tracks = file->num_tracks;
+
+    ERR_REGION_NULL_CHECK(path = join_dir_file_path(dir, file->filename), err);
+    if (!file_size(path, &entry.size)) entry.flags |= CUE_CATALOG_FILE_FOUND;
+
+    ERR_REGION_ERROR_CHECK(add_tracks(builder, file,
+      (entry.flags & CUE_CATALOG_FILE_FOUND) ? file_frames(file, entry.size) : 0), err);
+
+    ERR_REGION_ERROR_CHECK(buffer_append(&builder->files, &entry, sizeof(entry)), err);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE(path);
+
+  return err;
+}
+
+static errno_t add_tracks(catalog_builder_t* builder, cue_file_t const* file, unsigned long long frames) {
+  errno_t err = 0;
+
+  ERR_REGION_BEGIN() {
+    for (short i = 0; i < file->num_tracks; ++i) {
+      cue_track_t const* track = file->track[i];
+      cue_catalog_track_t entry;
+      unsigned int start = track_start(track);
+      unsigned long long end = i + 1 < file->num_tracks ? track_start(file->track[i + 1]) : frames;
+
+      memset(&entry, 0, sizeof(entry));
+      entry.number = track->track;
+      entry.mode = track->mode;
+      entry.pregap = track->pregap.frames
+        + CUE_CATALOG_FRAMES_PER_SECOND * (track->pregap.seconds + 60 * track->pregap.minutes);
+      entry.length = end > start ? (unsigned int)(end - start) : 0;
+      entry.first_index = (unsigned int)(builder->indexes.length / sizeof(cue_catalog_time_t));
+      entry.num_indexes = track->num_indexes;
+
+      for (short j = 0; j < track->num_indexes; ++j) {
+        cue_index_t const* index = &track->index[j];
+        cue_catalog_time_t time;
+
+        time.number = index->index;
+        time.time = index->timestamp.frames
+          + CUE_CATALOG_FRAMES_PER_SECOND * (index->timestamp.seconds + 60 * index->timestamp.minutes);
+
+        ERR_REGION_ERROR_CHECK(buffer_append(&builder->indexes, &time, sizeof(time)), err);
+      } ERR_REGION_ERROR_BUBBLE(err);
+
+      ERR_REGION_ERROR_CHECK(buffer_append(&builder->tracks, &entry, sizeof(entry)), err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+  } ERR_REGION_END()
+
+  return err;
+}
+
+// a track starts at its index 1, the ones before it being its pregap
+static unsigned int track_start(cue_track_t const* track) {
+  cue_time_t const* time = 0;
+
+  for (short i = 0; i < track->num_indexes; ++i) {
+    if (!time || track->index[i].index == 1) time = &track->index[i].timestamp;
+    if (track->index[i].index == 1) break;
+  }
+
+  if (!time) return 0;
+
+  return time->frames + CUE_CATALOG_FRAMES_PER_SECOND * (time->seconds + 60 * time->minutes);
+}
+
+// how long a file plays, where that follows from its size alone
+static unsigned long long file_frames(cue_file_t const* file, unsigned long long size) {
+  switch (file->type) {
+    case EWC_CFT_BINARY:
+      // a file of data tracks alone holds only their user data
+      if (file->num_tracks && file->track[0]->mode == EWC_CTM_MODE1_2048) return size / DATA_SECTOR_SIZE;
+      return size / SECTOR_SIZE;
+
+    case EWC_CFT_WAV:
+      return size > WAV_HEADER_SIZE ? (size - WAV_HEADER_SIZE) / SECTOR_SIZE : 0;
+
+    default:
+      // compressed, so only decoding would tell
+      return 0;
+  }
+}
+
+static errno_t add_string(catalog_builder_t* builder, char const* str, unsigned int* offset) {
+  size_t length = builder->strings.length;
+
+  // offsets are 32 bits, which no real collection comes near
+  if (length > 0xFFFFFFFFu) return -1;
+
+  *offset = (unsigned int)length;
+  return buffer_append(&builder->strings, str, strlen(str) + 1);
+}
+
+static errno_t buffer_append(catalog_buffer_t* self, void const* bytes, size_t length) {
+  if (self->capacity - self->length < length) {
+    size_t capacity = self->capacity ? self->capacity : 4096;
+    char* grown = 0;
+
+    while (capacity - self->length < length) capacity *= 2;
+
+    grown = realloc(self->bytes, capacity);
+    if (!grown) return -1;
+
+    self->bytes = grown;
+    self->capacity = capacity;
+  }
+
+  memcpy(self->bytes + self->length, bytes, length);
+  self->length += length;
+
+  return 0;
+}
+
+static void buffer_uninit(catalog_buffer_t* self) {
+  SAFE_FREE(self->bytes);
+  self->length = 0;
+  self->capacity = 0;
+}
+
+static errno_t write_section(FILE* file, catalog_buffer_t const* section) {
+  if (!section->length) return 0;
+
+  return fwrite(section->bytes, 1, section->length, file) == section->length ? 0 : -1;
+}
+
+struct cue_catalog* cue_catalog_alloc(char const* path) {
+  cue_catalog_t* self = malloc(sizeof(*self));
+  if (!self) return NULL;
+
+  errno_t err = cue_catalog_init(self, path);
+  if (!err) return self;
+
+  SAFE_FREE(self);
+  return NULL;
+}
+
+errno_t cue_catalog_init(struct cue_catalog* self, char const* path) {
+  errno_t err = 0;
+
+  memset(self, 0, sizeof(*self));
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_ERROR_CHECK(map_file(path, &self->view, &self->size), err);
+    ERR_REGION_ERROR_CHECK(validate(self), err);
+
+    return err;
+
+  } ERR_REGION_END()
+
+  cue_catalog_uninit(self);
+
+  return err;
+}
+
+void cue_catalog_uninit(struct cue_catalog* self) {
+  if (self->view) unmap_file(self->view, self->size);
+
+  memset(self, 0, sizeof(*self));
+}
+
+void cue_catalog_free(struct cue_catalog* self) {
+  cue_catalog_uninit(self);
+  SAFE_FREE(self);
+}
+
+char const* cue_catalog_string(struct cue_catalog const* self, unsigned int offset) {
+  return self->strings + offset;
+}
+
+// whether count items of item_size at offset, aligned, fit in total bytes
+static short check_range(unsigned long long offset, unsigned long long count, size_t item_size, size_t total) {
+  if (offset % CATALOG_ALIGNMENT || offset > total) return 0;
+  return count <= (total - offset) / item_size;
+}
+
+// whether elements first to first + count are all among total
+static short check_span(unsigned int first, unsigned int count, unsigned int total) {
+  return first <= total && count <= total - first;
+}
+
+// everything the catalog refers to is checked once here, so that reading it
+// later needs no checks at all
+static errno_t validate(struct cue_catalog* self) {
+  errno_t err = 0;
+  char const* base = (char const*)self->view;
+  cue_catalog_header_t const* header = (cue_catalog_header_t const*)base;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_CMP_CHECK(self->size < sizeof(*header), err);
+    ERR_REGION_CMP_CHECK(memcmp(header->magic, CUE_CATALOG_MAGIC, sizeof(header->magic)), err);
+    ERR_REGION_CMP_CHECK(header->version != CUE_CATALOG_VERSION, err);
+
+    ERR_REGION_CMP_CHECK(!check_range(header->cues_offset, header->num_cues, sizeof(cue_catalog_cue_t), self->size), err);
+    ERR_REGION_CMP_CHECK(!check_range(header->files_offset, header->num_files, sizeof(cue_catalog_file_t), self->size), err);
+    ERR_REGION_CMP_CHECK(!check_range(header->tracks_offset, header->num_tracks, sizeof(cue_catalog_track_t), self->size), err);
+    ERR_REGION_CMP_CHECK(!check_range(header->indexes_offset, header->num_indexes, sizeof(cue_catalog_time_t), self->size), err);
+
+    // strings need no alignment, but must end in a terminator
+    ERR_REGION_CMP_CHECK(!header->strings_size, err);
+    ERR_REGION_CMP_CHECK(header->strings_offset > self->size, err);
+    ERR_REGION_CMP_CHECK(header->strings_size > self->size - header->strings_offset, err);
+    ERR_REGION_CMP_CHECK(base[header->strings_offset + header->strings_size - 1], err);
+    ERR_REGION_CMP_CHECK(header->source_root >= header->strings_size, err);
+
+    self->header = header;
+    self->cues = (cue_catalog_cue_t const*)(base + header->cues_offset);
+    self->files = (cue_catalog_file_t const*)(base + header->files_offset);
+    self->tracks = (cue_catalog_track_t const*)(base + header->tracks_offset);
+    self->indexes = (cue_catalog_time_t const*)(base + header->indexes_offset);
+    self->strings = base + header->strings_offset;
+
+    for (unsigned int i = 0; i < header->num_cues; ++i) {
+      cue_catalog_cue_t const* cue = &self->cues[i];
+      ERR_REGION_CMP_CHECK(cue->path >= header->strings_size, err);
+      ERR_REGION_CMP_CHECK(cue->status >= EWC_CTR_LAST, err);
+      ERR_REGION_CMP_CHECK(!check_span(cue->first_file, cue->num_files, header->num_files), err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    for (unsigned int i = 0; i < header->num_files; ++i) {
+      cue_catalog_file_t const* file = &self->files[i];
+      ERR_REGION_CMP_CHECK(file->name >= header->strings_size, err);
+      ERR_REGION_CMP_CHECK(file->type >= EWC_CFT_LAST, err);
+      ERR_REGION_CMP_CHECK(!check_span(file->first_track, file->num_tracks, header->num_tracks), err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    for (unsigned int i = 0; i < header->num_tracks; ++i) {
+      cue_catalog_track_t const* track = &self->tracks[i];
+      ERR_REGION_CMP_CHECK(track->mode >= EWC_CTM_LAST, err);
+      ERR_REGION_CMP_CHECK(!check_span(track->first_index, track->num_indexes, header->num_indexes), err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+  } ERR_REGION_END()
+
+  return err;
+}
+
+errno_t cue_catalog_query_parse(cue_catalog_query_t* self, char const* const* terms, size_t num_terms) {
+  memset(self, 0, sizeof(*self));
+
+  for (size_t i = 0; i < num_terms; ++i) {
+    char const* term = terms[i];
+    short found = 0;
+
+    if (strncmp(term, s_type_term, sizeof(s_type_term) - 1) == 0) {
+      term += sizeof(s_type_term) - 1;
+
+      for (int j = 0; !found && j < EWC_CFT_LAST; ++j) {
+        found = name_matches(s_type_names[j], term);
+        if (found) self->type = (cue_file_type_t)j;
+      }
+
+      self->match_type = 1;
+    }
+    else if (strncmp(term, s_status_term, sizeof(s_status_term) - 1) == 0) {
+      term += sizeof(s_status_term) - 1;
+
+      for (int j = 0; !found && j < EWC_CTR_LAST; ++j) {
+        found = name_matches(s_status_names[j], term);
+        if (found) self->status = (cue_traverse_report_type_t)j;
+      }
+
+      self->match_status = 1;
+    }
+    else if (strncmp(term, s_under_term, sizeof(s_under_term) - 1) == 0) {
+      self->under = term + sizeof(s_under_term) - 1;
+      found = 1;
+    }
+
+    if (!found) return -1;
+  }
+
+  return 0;
+}
+
+errno_t cue_catalog_query_write(
+  struct cue_catalog const* self,
+  cue_catalog_query_t const* query,
+  struct line_writer* writer) {
+
+  errno_t err = 0;
+  unsigned int num_cues = self->header->num_cues;
+  size_t matched = 0;
+  size_t num_files = 0;
+  unsigned long long bytes = 0;
+  unsigned long long audio = 0;
+  size_t unknown = 0;
+  char* audio_str = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_CMP_CHECK(!line_writer_write_fmt(writer, "%s", "CATALOG QUERY"), err);
+    ERR_REGION_CMP_CHECK(!line_writer_write_fmt(writer, "%s%s", "Source directory: ",
+      cue_catalog_string(self, self->header->source_root)), err);
+    ERR_REGION_CMP_CHECK(!line_writer_write_fmt(writer, "%s", "Matching cues:"), err);
+
+    for (unsigned int i = 0; i < num_cues; ++i) {
+      cue_catalog_cue_t const* cue = &self->cues[i];
+      char const* path = cue_catalog_string(self, cue->path);
+
+      if (query->under && !is_under(path, query->under)) continue;
+      if (query->match_status && cue->status != (unsigned int)query->status) continue;
+      if (query->match_type && !has_type(self, cue, query->type)) continue;
+
+      ++matched;
+      ERR_REGION_CMP_CHECK(!line_writer_write_fmt(writer, "%s%s (%s)", "  ", path, s_status_names[cue->status]), err);
+
+      for (unsigned int j = 0; j < cue->num_files; ++j) {
+        cue_catalog_file_t const* file = &self->files[cue->first_file + j];
+
+        ++num_files;
+        bytes += file->size;
+
+        for (unsigned int k = 0; k < file->num_tracks; ++k) {
+          cue_catalog_track_t const* track = &self->tracks[file->first_track + k];
+          if (track->mode != EWC_CTM_AUDIO) continue;
+
+          if (track->length) audio += track->length;
+          else ++unknown;
+        }
+      }
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    ERR_REGION_NULL_CHECK(audio_str = format_frames(audio), err);
+
+    ERR_REGION_CMP_CHECK(!line_writer_write_fmt(writer, "%s%zu", "Matched total: ", matched), err);
+    ERR_REGION_CMP_CHECK(!line_writer_write_fmt(writer, "%s%zu", "Files: ", num_files), err);
+    ERR_REGION_CMP_CHECK(!line_writer_write_fmt(writer, "%s%llu", "Bytes: ", bytes), err);
+    ERR_REGION_CMP_CHECK(!line_writer_write_fmt(writer, "%s%s", "Audio: ", audio_str), err);
+    ERR_REGION_CMP_CHECK(!line_writer_write_fmt(writer, "%s%zu", "Audio tracks of unknown length: ", unknown), err);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE(audio_str);
+
+  return err;
+}
+
+// the path itself, or anything in the directory it names
+static short is_under(char const* path, char const* dir) {
+  size_t len = strlen(dir);
+
+  // a trailing separator names the same directory
+  while (len && dir[len - 1] == k_path_separator_char) --len;
+  if (!len) return 1;
+
+  if (strncmp(path, dir, len) != 0) return 0;
+
+  return path[len] == 0 || path[len] == k_path_separator_char;
+}
+
+static short has_type(struct cue_catalog const* self, cue_catalog_cue_t const* cue, cue_file_type_t type) {
+  for (unsigned int i = 0; i < cue->num_files; ++i) {
+    if (self->files[cue->first_file + i].type == (unsigned int)type) return 1;
+  }
+
+  return 0;
+}
+
+// names are matched without regard to case
+static short name_matches(char const* name, char const* arg) {
+  for (; *name && *arg; ++name, ++arg) {
+    if (tolower((unsigned char)*name) != tolower((unsigned char)*arg)) return 0;
+  }
+
+  return !*name && !*arg;
+}
+
+// h:mm:ss, which the caller frees
+static char* format_frames(unsigned long long frames) {
+  unsigned long long seconds = frames / CUE_CATALOG_FRAMES_PER_SECOND;
+
+  return msnprintf("%llu:%02llu:%02llu", seconds / 3600, seconds / 60 % 60, seconds % 60);
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "cue_file.h"
+#include "cue_traverse_report.h"
+
+struct cue_traverse_report;
+struct cue_sheet_cache;
+struct line_writer;
+
+// a catalog indexes every cue a run found, with its files, tracks and
+// index times, in a flat file that is used straight from memory once
+// mapped.  there are no pointers, only element numbers and offsets into a
+// table of strings, and every value is little endian with its natural
+// alignment, so a mapped catalog needs no parsing at all
+
+#define CUE_CATALOG_MAGIC "CUECATLG"
+#define CUE_CATALOG_VERSION 1
+
+// times and lengths are counted in cue frames, 75 to the second
+#define CUE_CATALOG_FRAMES_PER_SECOND 75
+
+// the cue sheet was read, so its files are listed
+#define CUE_CATALOG_CUE_PARSED 1
+
+// the file was found next to its cue, so its size is known
+#define CUE_CATALOG_FILE_FOUND 1
+
+typedef struct cue_catalog_header {
+  char magic[8];
+  unsigned int version;
+  unsigned int source_root;  // string, where the run started
+  unsigned int num_cues;
+  unsigned int num_files;
+  unsigned int num_tracks;
+  unsigned int num_indexes;
+  unsigned long long cues_offset;  // each offset is from the start of the file
+  unsigned long long files_offset;
+  unsigned long long tracks_offset;
+  unsigned long long indexes_offset;
+  unsigned long long strings_offset;
+  unsigned long long strings_size;  // the table ends in a terminator
+} cue_catalog_header_t;
+
+typedef struct cue_catalog_cue {
+  unsigned int path;  // string, relative to the source root
+  unsigned int status;  // what the run did with it, as a cue_traverse_report_type_t
+  unsigned int flags;
+  unsigned int first_file;
+  unsigned int num_files;
+  unsigned int reserved;
+} cue_catalog_cue_t;
+
+typedef struct cue_catalog_file {
+  unsigned long long size;  // bytes
+  unsigned int name;  // string, as the cue names it
+  unsigned int type;  // cue_file_type_t
+  unsigned int flags;
+  unsigned int first_track;
+  unsigned int num_tracks;
+  unsigned int reserved;
+} cue_catalog_file_t;
+
+typedef struct cue_catalog_track {
+  int number;
+  unsigned int mode;  // cue_track_mode_t
+  unsigned int pregap;  // frames
+  unsigned int length;  // frames from this track to the next, 0 when not known
+  unsigned int first_index;
+  unsigned int num_indexes;
+} cue_catalog_track_t;
+
+typedef struct cue_catalog_time {
+  int number;
+  unsigned int time;  // frames into the file
+} cue_catalog_time_t;
+
+// builds a catalog of every cue in the report.  cues the run didn't parse
+// are parsed now, from the cache if one is given
+errno_t cue_catalog_write(
+  char const* path,
+  struct cue_traverse_report const* report,
+  char const* source_root,
+  struct cue_sheet_cache* sheet_cache_opt);
+
+// a catalog, mapped for reading
+typedef struct cue_catalog {
+  void const* view;  // owned, the whole file
+  size_t size;
+  cue_catalog_header_t const* header;  // everything from here on points into the view
+  cue_catalog_cue_t const* cues;
+  cue_catalog_file_t const* files;
+  cue_catalog_track_t const* tracks;
+  cue_catalog_time_t const* indexes;
+  char const* strings;
+} cue_catalog_t;
+
+// fails on a catalog that is damaged, or from another version
+struct cue_catalog* cue_catalog_alloc(char const* path);
+errno_t cue_catalog_init(struct cue_catalog* self, char const* path);
+void cue_catalog_uninit(struct cue_catalog* self);
+void cue_catalog_free(struct cue_catalog* self);
+
+char const* cue_catalog_string(struct cue_catalog const* self, unsigned int offset);
+
+// which cues a query picks.  every condition given has to hold
+typedef struct cue_catalog_query {
+  char const* under;  // weak ref, a directory under the source root, NULL for all
+  short match_type;
+  cue_file_type_t type;  // some file of the cue has this type
+  short match_status;
+  cue_traverse_report_type_t status;
+} cue_catalog_query_t;
+
+// terms are type=<cue file type>, status=<transformed|failed|skipped> and
+// under=<directory>.  the query refers to the terms, so they must outlive it
+errno_t cue_catalog_query_parse(cue_catalog_query_t* self, char const* const* terms, size_t num_terms);
+
+// lists the cues a query picks, then totals their files, bytes and audio
+errno_t cue_catalog_query_write(
+  struct cue_catalog const* self,
+  cue_catalog_query_t const* query,
+  struct line_writer* writer);
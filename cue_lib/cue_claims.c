@@ -0,0 +1,319 @@
+#include "cue_claims.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "err_helpers.h"
+#include "mem_helpers.h"
+#include "filesystem.h"
+#include "path.h"
+#include "format_helpers.h"
+#include "hash_helpers.h"
+#include "string_vector.h"
+#include "thread_helpers.h"
+
+static char const* claim_path(cue_claims_t const* self, char const* key);
+static errno_t start_locked(cue_claims_t* self);
+static short find_held(cue_claims_t const* self, char const* path, size_t* index);
+static short is_owned(cue_claims_t const* self, char const* path);
+static errno_t drop_claim(cue_claims_t const* self, char const* path);
+static errno_t is_stale(cue_claims_t* self, char const* path, short* stale);
+static errno_t take_over(cue_claims_t* self, char const* path, short* acquired);
+static void run_heartbeat(void* arg);
+
+static const char s_claims_dir[] = "cue_claims";
+
+// held claims are touched this many times for each stale period, so that
+// one slow or missed touch doesn't let a claim go stale
+#define HEARTBEATS_PER_STALE 4
+
+// nor are they touched more often than this, however short the period
+#define MIN_HEARTBEAT_MS 1000
+
+char const* cue_claims_path(char const* target_root) {
+  return join_dir_file_path(target_root, s_claims_dir);
+}
+
+struct cue_claims* cue_claims_alloc(char const* dir, char const* owner, unsigned long stale_seconds) {
+  cue_claims_t* self = malloc(sizeof(*self));
+  if (!self) return NULL;
+
+  errno_t err = cue_claims_init(self, dir, owner, stale_seconds);
+  if (!err) return self;
+
+  SAFE_FREE(self);
+  return NULL;
+}
+
+errno_t cue_claims_init(struct cue_claims* self, char const* dir, char const* owner, unsigned long stale_seconds) {
+  errno_t err = 0;
+
+  memset(self, 0, sizeof(*self));
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(self->dir = _strdup(dir), err);
+    ERR_REGION_NULL_CHECK(self->owner = _strdup(owner), err);
+    ERR_REGION_NULL_CHECK(self->owner_path = msnprintf("%s%s%s.owner", dir, k_path_separator, owner), err);
+    ERR_REGION_NULL_CHECK(self->held = string_vector_alloc(), err);
+    ERR_REGION_NULL_CHECK(self->lock = th_mutex_alloc(), err);
+    ERR_REGION_NULL_CHECK(self->wake = th_cond_alloc(), err);
+
+    self->stale_ticks = stale_seconds * k_file_mtime_ticks_per_second;
+    self->heartbeat_ms = stale_seconds * 1000 / HEARTBEATS_PER_STALE;
+    if (self->heartbeat_ms < MIN_HEARTBEAT_MS) self->heartbeat_ms = MIN_HEARTBEAT_MS;
+
+    return err;
+
+  } ERR_REGION_END()
+
+  cue_claims_uninit(self);
+
+  return err;
+}
+
+void cue_claims_uninit(struct cue_claims* self) {
+  if (self->heartbeat) {
+    th_mutex_lock(self->lock);
+    self->stopping = 1;
+    th_cond_broadcast(self->wake);
+    th_mutex_unlock(self->lock);
+
+    th_thread_join(self->heartbeat);
+    self->heartbeat = 0;
+
+    delete_file(self->owner_path);
+  }
+
+  // work left unfinished is left for whoever claims it next
+  while (self->held && self->held->get_length(self->held)) {
+    drop_claim(self, self->held->get(self->held, 0));
+    self->held->shift(self->held);
+  }
+
+  SAFE_FREE_HANDLER(self->wake, th_cond_free);
+  SAFE_FREE_HANDLER(self->lock, th_mutex_free);
+  SAFE_FREE_HANDLER(self->held, string_vector_free);
+  SAFE_FREE(self->owner_path);
+  SAFE_FREE(self->owner);
+  SAFE_FREE(self->dir);
+}
+
+void cue_claims_free(struct cue_claims* self) {
+  cue_claims_uninit(self);
+  SAFE_FREE(self);
+}
+
+errno_t cue_claims_acquire(struct cue_claims* self, char const* key, short* acquired) {
+  errno_t err = 0;
+  char const* path = 0;
+  short created = 0;
+  short locked = 0;
+
+  *acquired = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(path = claim_path(self, key), err);
+
+    th_mutex_lock(self->lock);
+    locked = 1;
+
+    ERR_REGION_ERROR_CHECK(start_locked(self), err);
+
+    // another thread of this process got there first
+    ERR_REGION_CMP_EXIT(find_held(self, path, 0));
+
+    ERR_REGION_ERROR_CHECK(create_file_exclusive(path, self->owner, strlen(self->owner), &created), err);
+
+    if (!created && is_owned(self, path)) {
+      // left by an earlier run under this name, which can't still be running
+      ERR_REGION_ERROR_CHECK(touch_file(path), err);
+      created = 1;
+    }
+
+    if (!created) {
+      ERR_REGION_ERROR_CHECK(take_over(self, path, &created), err);
+    }
+
+    if (created) {
+      ERR_REGION_NULL_CHECK(self->held->push(self->held, path), err);
+      *acquired = 1;
+    }
+
+  } ERR_REGION_END()
+
+  if (locked) th_mutex_unlock(self->lock);
+
+  // a claim that can't be kept fresh is given up straight away
+  if (err && created && !*acquired) delete_file(path);
+
+  SAFE_FREE(path);
+
+  return err;
+}
+
+errno_t cue_claims_release(struct cue_claims* self, char const* key) {
+  errno_t err = 0;
+  char const* path = 0;
+  size_t index = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(path = claim_path(self, key), err);
+
+    th_mutex_lock(self->lock);
+    if (find_held(self, path, &index)) {
+      err = self->held->delete_at(self->held, index);
+    }
+    else {
+      err = -1;
+    }
+    th_mutex_unlock(self->lock);
+
+    ERR_REGION_ERROR_CHECK(err, err);
+    ERR_REGION_ERROR_CHECK(drop_claim(self, path), err);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE(path);
+
+  return err;
+}
+
+// keys may be long, and hold separators, so claims are named by their hash
+static char const* claim_path(cue_claims_t const* self, char const* key) {
+  return msnprintf("%s%s%016llx.claim", self->dir, k_path_separator, hash_cstr(0, key));
+}
+
+static errno_t start_locked(cue_claims_t* self) {
+  errno_t err = 0;
+  short created = 0;
+
+  if (self->heartbeat) return err;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_ERROR_CHECK(ensure_dir(self->dir), err);
+
+    // the owner file is touched along with the claims, and its time is
+    // what the age of other claims is measured against
+    ERR_REGION_ERROR_CHECK(create_file_exclusive(self->owner_path,
+      self->owner, strlen(self->owner), &created), err);
+    ERR_REGION_ERROR_CHECK(touch_file(self->owner_path), err);
+
+    ERR_REGION_NULL_CHECK(self->heartbeat = th_thread_start(run_heartbeat, self), err);
+
+  } ERR_REGION_END()
+
+  return err;
+}
+
+static short find_held(cue_claims_t const* self, char const* path, size_t* index) {
+  for (size_t i = 0; i < self->held->get_length(self->held); ++i) {
+    if (strcmp(self->held->get(self->held, i), path) == 0) {
+      if (index) *index = i;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+static short is_owned(cue_claims_t const* self, char const* path) {
+  FILE* file = 0;
+  char buf[256];
+  size_t length = 0;
+
+  fopen_s(&file, path, "rb");
+  if (!file) return 0;
+
+  length = fread(buf, 1, sizeof(buf) - 1, file);
+  fclose(file);
+  buf[length] = 0;
+
+  return strcmp(buf, self->owner) == 0;
+}
+
+// a claim taken over while this process held it now belongs to another,
+// and is left to them
+static errno_t drop_claim(cue_claims_t const* self, char const* path) {
+  return is_owned(self, path) ? delete_file(path) : 0;
+}
+
+// a claim's age is measured by the filesystem's times rather than the
+// local clock, so hosts only need to agree with each other
+static errno_t is_stale(cue_claims_t* self, char const* path, short* stale) {
+  errno_t err = 0;
+  unsigned long long now = 0;
+  unsigned long long touched = 0;
+
+  *stale = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_ERROR_CHECK(touch_file(self->owner_path), err);
+    ERR_REGION_ERROR_CHECK(file_mtime(self->owner_path, &now), err);
+    ERR_REGION_ERROR_CHECK(file_mtime(path, &touched), err);
+
+    *stale = now >= touched && now - touched >= self->stale_ticks;
+
+  } ERR_REGION_END()
+
+  return err;
+}
+
+// moves a stale claim aside, which only one process can do, then claims
+// the key afresh.  a claim that was touched just before it was moved was
+// still live after all, so it is put back
+static errno_t take_over(cue_claims_t* self, char const* path, short* acquired) {
+  errno_t err = 0;
+  char const* aside = 0;
+  short stale = 0;
+
+  *acquired = 0;
+
+  ERR_REGION_BEGIN() {
+    // a claim that went away as it was looked at was released, and the
+    // work it guarded is done
+    if (is_stale(self, path, &stale) && !file_exists(path)) {
+      return create_file_exclusive(path, self->owner, strlen(self->owner), acquired);
+    }
+    ERR_REGION_CMP_EXIT(!stale);
+
+    ERR_REGION_NULL_CHECK(aside = msnprintf("%s.%s.stale", path, self->owner), err);
+    delete_file(aside);
+
+    // another process took it over first
+    ERR_REGION_CMP_EXIT(rename_file(path, aside));
+
+    if (!is_stale(self, aside, &stale) && !stale) {
+      if (rename_file(aside, path)) delete_file(aside);
+      ERR_REGION_EXIT();
+    }
+
+    delete_file(aside);
+    ERR_REGION_ERROR_CHECK(create_file_exclusive(path, self->owner, strlen(self->owner), acquired), err);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE(aside);
+
+  return err;
+}
+
+static void run_heartbeat(void* arg) {
+  cue_claims_t* self = (cue_claims_t*)arg;
+
+  th_mutex_lock(self->lock);
+
+  while (!self->stopping) {
+    // a claim that can't be touched may go stale, and be converted twice,
+    // which costs time but does no harm
+    if (!th_cond_timed_wait(self->wake, self->lock, self->heartbeat_ms) && !self->stopping) {
+      touch_file(self->owner_path);
+
+      for (size_t i = 0; i < self->held->get_length(self->held); ++i) {
+        touch_file(self->held->get(self->held, i));
+      }
+    }
+  }
+
+  th_mutex_unlock(self->lock);
+}
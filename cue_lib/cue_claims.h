@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stddef.h>
+
+struct th_mutex;
+struct th_cond;
+struct th_thread;
+struct string_vector;
+
+// claims let any number of conversions, on this host or on others sharing
+// the target, split its cues between them as they go.  a cue is converted
+// by whichever process first creates its claim file, which is kept fresh
+// while the conversion runs and removed once it is done.  a claim left
+// behind by a process that stopped goes stale, and may then be taken over
+typedef struct cue_claims {
+  char const* dir;  // owned, where the claim files are kept
+  char const* owner;  // owned, names this process in each of its claims
+  char const* owner_path;  // owned, touched with every heartbeat, to tell the time by
+  unsigned long long stale_ticks;  // a claim not touched for this long is stale
+  unsigned long heartbeat_ms;  // how often held claims are touched
+  struct string_vector* held;  // owned, paths of the claims held
+  struct th_mutex* lock;  // owned, guards held and stopping
+  struct th_cond* wake;  // owned, signaled to stop the heartbeat
+  struct th_thread* heartbeat;  // owned, NULL until the first claim
+  short stopping;
+} cue_claims_t;
+
+// where the claims of a target root are kept, the caller frees the path
+char const* cue_claims_path(char const* target_root);
+
+// owner must be usable as a file name, and should differ between processes
+// working at once.  a claim is stale once it hasn't been touched for
+// stale_seconds, so that should be well over the heartbeat, and over any
+// difference between the clocks of the hosts involved
+struct cue_claims* cue_claims_alloc(char const* dir, char const* owner, unsigned long stale_seconds);
+errno_t cue_claims_init(struct cue_claims* self, char const* dir, char const* owner, unsigned long stale_seconds);
+// releases every claim still held
+void cue_claims_uninit(struct cue_claims* self);
+void cue_claims_free(struct cue_claims* self);
+
+// claims key, a path the processes agree on, such as a cue relative to
+// the source.  acquired tells whether this process now holds the claim,
+// either as the first to ask, because a claim of the same owner was left
+// by an earlier run, or by taking over a stale one.  safe to call from
+// several threads at once
+errno_t cue_claims_acquire(struct cue_claims* self, char const* key, short* acquired);
+
+// gives up a claim once the work it guarded is done
+errno_t cue_claims_release(struct cue_claims* self, char const* key);
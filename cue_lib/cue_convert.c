@@ -14,8 +14,43 @@
 #include "array_line_writer.h"
 #include "cue_traverse_report.h"
 #include "cue_traverse_report_writer.h"
+#include "cue_traverse_report_collector.h"
+#include "cue_traverse_partial_report.h"
+#include "cue_manifest.h"
+#include "cue_store.h"
+#include "cue_journal.h"
+#include "cue_claims.h"
+#include "cue_sheet_cache.h"
+#include "cue_catalog.h"
+#include "cue_watch.h"
+#include "string_vector.h"
 #include "path.h"
 #include "read_write.h"
+#include "thread_helpers.h"
+
+static errno_t merge_partial_reports(string_vector_t* paths, cue_traverse_report_t** merged);
+static errno_t query_catalog(struct cue_options* opts, cue_convert_env_t* env);
+static errno_t watch_source(
+  struct cue_options* opts,
+  cue_convert_env_t* env,
+  cue_watch_t* watch,
+  cue_traverse_visitor_t* visitor,
+  int scan_threads,
+  cue_traverse_report_writer_t* report_writer);
+static errno_t convert_changed(
+  struct cue_options* opts,
+  cue_traverse_visitor_t* visitor,
+  int scan_threads,
+  char const* dir,
+  short descend,
+  cue_traverse_report_writer_t* report_writer,
+  short* converted);
+
+// a claim not kept fresh for this long was left by a conversion that stopped
+#define CLAIM_STALE_SECONDS 120
+
+// how often a watch looks for directories that have settled
+#define WATCH_POLL_MS 1000
 
 errno_t cue_convert(
   struct cue_options* opts, 
@@ -30,12 +65,32 @@ errno_t cue_convert(
   line_writer_i *selected_writer = 0;
   cue_traverse_report_writer_t report_file_writer = { 0 };
   cue_traverse_report_writer_t report_out_writer = { 0 };
-  cue_traverse_report_t *report = 0;
+  cue_traverse_report_t *report = 0;  // weak ref
+  cue_traverse_report_t *merged = 0;
+  cue_manifest_t* manifest = 0;
+  char const* manifest_path = 0;
+  cue_store_t* store = 0;
+  cue_journal_t* journal = 0;
+  char const* journal_path = 0;
+  cue_claims_t* claims = 0;
+  char const* claims_path = 0;
+  cue_sheet_cache_t* sheet_cache = 0;
+  cue_watch_t* watch = 0;
   cue_traverse_visitor_opts_t visitor_opts = { 0 };
+  directory_traversal_options_t traversal_opts = { 0 };
   file_line_reader_t filter_reader = { 0 };
   array_line_writer_t filter_data = { 0 };
 
+  // a query answers from the catalog alone, so has no report
+  if (opts->query) return query_catalog(opts, env);
+
   ERR_REGION_BEGIN() {
+    // read every partial report before the report file is replaced, in case
+    // one of them turns out to be bad
+    if (opts->merge) {
+      ERR_REGION_ERROR_CHECK(merge_partial_reports(opts->partial_paths, &merged), err);
+    }
+
     if (opts->generate_report) {
       ERR_REGION_ERROR_CHECK(file_line_writer_init_path(&file_writer, opts->report_path), err);
       ERR_REGION_ERROR_CHECK(cue_traverse_report_writer_init_params(
@@ -61,40 +116,141 @@ errno_t cue_convert(
       &report_out_writer,
       selected_writer), err);
 
-    memset(&visitor_opts, 0, sizeof(visitor_opts));
-    visitor_opts.target_path = opts->target_dir;
-    visitor_opts.source_path = opts->source_dir;
-    visitor_opts.report_only = opts->test_only;
-    visitor_opts.writer = selected_writer;
-    visitor_opts.overwrite = opts->overwrite;
-    visitor_opts.quality = opts->quality;
-
-    if (opts->filter_path) {
-      ERR_REGION_ERROR_CHECK(file_line_reader_init_path(&filter_reader, opts->filter_path), err);
-      array_line_writer_init(&filter_data);
-      ERR_REGION_ERROR_CHECK(read_write_all_lines(&filter_reader.line_reader, &filter_data.line_writer), err);
-      file_line_reader_uninit(&filter_reader);
-      visitor_opts.filters = filter_data.lines;
-      visitor_opts.num_filters = filter_data.num_lines;
+    if (opts->merge) {
+      report = merged;
     }
+    else {
+      memset(&visitor_opts, 0, sizeof(visitor_opts));
+      visitor_opts.target_path = opts->target_dir;
+      visitor_opts.source_path = opts->source_dir;
+      visitor_opts.report_only = opts->test_only;
+      visitor_opts.writer = selected_writer;
+      visitor_opts.overwrite = opts->overwrite;
+      visitor_opts.quality = opts->quality;
+      visitor_opts.jobs = opts->jobs ? opts->jobs : (int)th_cpu_count();
+      visitor_opts.copy_jobs = opts->copy_jobs ? opts->copy_jobs : visitor_opts.jobs;
+      visitor_opts.encode_jobs = opts->encode_jobs ? opts->encode_jobs : visitor_opts.jobs;
+      visitor_opts.copy_strategy = opts->copy_strategy;
+      visitor_opts.scan_threads = opts->scan_threads ? opts->scan_threads : (int)th_cpu_count();
+      visitor_opts.shard = opts->shard;
+      visitor_opts.num_shards = opts->num_shards;
+
+      if (opts->filter_path) {
+        ERR_REGION_ERROR_CHECK(file_line_reader_init_path(&filter_reader, opts->filter_path), err);
+        array_line_writer_init(&filter_data);
+        ERR_REGION_ERROR_CHECK(read_write_all_lines(&filter_reader.line_reader, &filter_data.line_writer), err);
+        file_line_reader_uninit(&filter_reader);
+        visitor_opts.filters = filter_data.lines;
+        visitor_opts.num_filters = filter_data.num_lines;
+      }
+
+      // what earlier runs converted into this target, so that only what
+      // changed since is converted again
+      manifest_path = cue_manifest_path(opts->target_dir, opts->shard, opts->num_shards, opts->claim_owner);
+      ERR_REGION_NULL_CHECK(manifest_path, err);
+      manifest = cue_manifest_alloc(manifest_path, opts->source_dir, opts->target_dir);
+      ERR_REGION_NULL_CHECK(manifest, err);
+      ERR_REGION_ERROR_CHECK(cue_manifest_load(manifest), err);
+      visitor_opts.manifest = manifest;
+
+      // files made before, by this or any other conversion using the store
+      if (opts->store_path && !opts->test_only) {
+        ERR_REGION_NULL_CHECK(store = cue_store_alloc(opts->store_path), err);
+        visitor_opts.store = store;
+      }
+
+      // what a run that stopped part way finished, before the manifest
+      // could learn of it
+      if (!opts->test_only) {
+        journal_path = cue_journal_path(opts->target_dir, opts->shard, opts->num_shards, opts->claim_owner);
+        ERR_REGION_NULL_CHECK(journal_path, err);
+        ERR_REGION_NULL_CHECK(journal = cue_journal_alloc(journal_path, opts->target_dir), err);
+        ERR_REGION_ERROR_CHECK(cue_journal_load(journal), err);
+        visitor_opts.journal = journal;
+      }
+
+      // cues other conversions of the target are working on, or that a
+      // stopped one left behind
+      if (opts->claim_owner) {
+        ERR_REGION_NULL_CHECK(claims_path = cue_claims_path(opts->target_dir), err);
+        ERR_REGION_NULL_CHECK(claims = cue_claims_alloc(claims_path, opts->claim_owner, CLAIM_STALE_SECONDS), err);
+        visitor_opts.claims = claims;
+      }
 
-    ERR_REGION_ERROR_CHECK(cue_traverse_visitor_init(
-      &visitor,
-      &visitor_opts), err);
+      // cues parsed before, which even a test run can use and add to
+      if (opts->cue_cache_path) {
+        ERR_REGION_NULL_CHECK(sheet_cache = cue_sheet_cache_alloc(opts->cue_cache_path), err);
+        ERR_REGION_ERROR_CHECK(cue_sheet_cache_load(sheet_cache), err);
+        visitor_opts.sheet_cache = sheet_cache;
+      }
 
-    traverse_dir_path(opts->source_dir, &visitor.pv_t.handler_i);
+      // watched from before the first pass, so that nothing changed while
+      // it runs is missed
+      if (opts->watch) {
+        ERR_REGION_NULL_CHECK(watch = cue_watch_alloc(opts->source_dir, opts->settle_seconds), err);
+      }
 
-    cue_traverse_report_t* report = visitor.report;
+      ERR_REGION_ERROR_CHECK(cue_traverse_visitor_init(
+        &visitor,
+        &visitor_opts), err);
+
+      traversal_opts.should_descend = 1;
+      traversal_opts.threads = visitor_opts.scan_threads;
+      cue_traverse_visitor_filter(&traversal_opts);
+      traverse_dir_path_opts(opts->source_dir, &traversal_opts, &visitor.pv_t.handler_i);
+      ERR_REGION_ERROR_CHECK(cue_traverse_visitor_finish(&visitor), err);
+
+      // a test run changed nothing, so there is nothing new to record
+      if (!opts->test_only) {
+        ERR_REGION_ERROR_CHECK(cue_journal_flush(journal), err);
+        ERR_REGION_ERROR_CHECK(cue_manifest_save(manifest), err);
+
+        // once every cue is in the manifest, the journal holds nothing it
+        // doesn't.  files of failed cues are kept for the next run
+        if (!visitor.report->failed_cue_count) {
+          ERR_REGION_ERROR_CHECK(cue_journal_discard(journal), err);
+        }
+      }
+
+      // before the cache is saved, as cues the run skipped are read here
+      if (opts->catalog_path) {
+        ERR_REGION_ERROR_CHECK(cue_catalog_write(opts->catalog_path, visitor.report,
+          opts->source_dir, sheet_cache), err);
+      }
+
+      if (sheet_cache) {
+        ERR_REGION_ERROR_CHECK(cue_sheet_cache_save(sheet_cache), err);
+      }
+
+      report = visitor.report;
+    }
 
     if (opts->generate_report) {
-      ERR_REGION_ERROR_CHECK(cue_traverse_report_writer_write(&report_file_writer, report), err);
+      if (opts->num_shards) {
+        ERR_REGION_ERROR_CHECK(cue_traverse_partial_report_write(
+          &file_writer.line_writer, report, opts->shard, opts->num_shards), err);
+      }
+      else {
+        ERR_REGION_ERROR_CHECK(cue_traverse_report_writer_write(&report_file_writer, report), err);
+      }
     }
 
     selected_writer->write_line(selected_writer, "");
     ERR_REGION_ERROR_CHECK(cue_traverse_report_writer_write(&report_out_writer, report), err);
 
     if (report_nullable) {
-      *report_nullable = cue_traverse_visitor_detach_report(&visitor);
+      if (merged) {
+        *report_nullable = merged;
+        merged = 0;
+      }
+      else {
+        *report_nullable = cue_traverse_visitor_detach_report(&visitor);
+      }
+    }
+
+    if (watch) {
+      ERR_REGION_ERROR_CHECK(watch_source(opts, env, watch, &visitor,
+        visitor_opts.scan_threads, &report_out_writer), err);
     }
 
   } ERR_REGION_END()
@@ -104,9 +260,213 @@ errno_t cue_convert(
   cue_traverse_report_writer_uninit(&report_file_writer);
   cue_traverse_report_writer_uninit(&report_out_writer);
   cue_traverse_visitor_uninit(&visitor);
+  SAFE_FREE_HANDLER(watch, cue_watch_free);
+  SAFE_FREE_HANDLER(claims, cue_claims_free);
+  SAFE_FREE_HANDLER(manifest, cue_manifest_free);
+  SAFE_FREE_HANDLER(store, cue_store_free);
+  // whatever finished is kept, even when the run as a whole failed
+  if (journal) cue_journal_flush(journal);
+  SAFE_FREE_HANDLER(journal, cue_journal_free);
+  SAFE_FREE_HANDLER(sheet_cache, cue_sheet_cache_free);
+  SAFE_FREE(manifest_path);
+  SAFE_FREE(journal_path);
+  SAFE_FREE(claims_path);
   file_line_writer_uninit(&file_writer);
   file_line_writer_uninit(&out_writer);
   null_line_writer_uninit(&null_writer);
+  SAFE_FREE_HANDLER(merged, cue_traverse_report_free);
+
+  return err;
+}
+
+static errno_t merge_partial_reports(string_vector_t* paths, cue_traverse_report_t** merged) {
+  errno_t err = 0;
+  size_t num_paths = paths->get_length(paths);
+  cue_traverse_report_collector_t* collector = 0;
+  cue_traverse_report_t* report = 0;
+  file_line_reader_t reader = { 0 };
+  short* seen = 0;
+  size_t expected_shards = 0;
+
+  ERR_REGION_BEGIN() {
+    // one collector shard per partial report
+    ERR_REGION_NULL_CHECK(collector = cue_traverse_report_collector_alloc(num_paths), err);
+
+    for (size_t i = 0; i < num_paths; ++i) {
+      size_t shard = 0, num_shards = 0;
+
+      ERR_REGION_ERROR_CHECK(file_line_reader_init_path(&reader, paths->get(paths, i)), err);
+      ERR_REGION_ERROR_CHECK(cue_traverse_partial_report_read(
+        &reader.line_reader, collector, i, &shard, &num_shards), err);
+      file_line_reader_uninit(&reader);
+
+      // every report must come from the same split
+      if (!seen) {
+        expected_shards = num_shards;
+        ERR_REGION_NULL_CHECK(seen = calloc(expected_shards, sizeof(*seen)), err);
+      }
+
+      ERR_REGION_CMP_CHECK(num_shards != expected_shards, err);
+      ERR_REGION_CMP_CHECK(seen[shard - 1], err);
+      seen[shard - 1] = 1;
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    // and a missing shard would quietly leave its cues out
+    ERR_REGION_CMP_CHECK(num_paths != expected_shards, err);
+
+    ERR_REGION_NULL_CHECK(report = cue_traverse_report_alloc(), err);
+    ERR_REGION_ERROR_CHECK(cue_traverse_report_collector_merge(collector, report), err);
+
+    *merged = report;
+    report = 0;
+
+  } ERR_REGION_END()
+
+  file_line_reader_uninit(&reader);
+  SAFE_FREE(seen);
+  SAFE_FREE_HANDLER(report, cue_traverse_report_free);
+  SAFE_FREE_HANDLER(collector, cue_traverse_report_collector_free);
+
+  return err;
+}
+
+// converts the cues of each directory in which anything changed, once it
+// settles, for as long as the process runs.  the visitor of the first pass
+// carries on, with its pools, manifest and journal, and the last two are
+// saved after every directory.  its report is replaced by each pass
+static errno_t watch_source(
+  struct cue_options* opts,
+  cue_convert_env_t* env,
+  cue_watch_t* watch,
+  cue_traverse_visitor_t* visitor,
+  int scan_threads,
+  cue_traverse_report_writer_t* report_writer) {
+
+  errno_t err = 0;
+  string_vector_t* dirs = 0;
+  string_vector_t* trees = 0;
+  int passes = 0;
+
+  // a watch only reads the cues that changed, which the cache can't help
+  // with, and the cache would only grow
+  visitor->sheet_cache = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(dirs = string_vector_alloc(), err);
+    ERR_REGION_NULL_CHECK(trees = string_vector_alloc(), err);
+
+    while (!env->watch_passes || passes < env->watch_passes) {
+      short converted = 0;
+
+      ERR_REGION_ERROR_CHECK(cue_watch_wait(watch, WATCH_POLL_MS, dirs, trees), err);
+
+      // just the cues beside the changes, or everything under a directory
+      // that is new
+      while (dirs->get_length(dirs) || trees->get_length(trees)) {
+        short descend = !dirs->get_length(dirs);
+        string_vector_t* changed = descend ? trees : dirs;
+
+        ERR_REGION_ERROR_CHECK(convert_changed(opts, visitor, scan_threads,
+          changed->get(changed, 0), descend, report_writer, &converted), err);
+        changed->shift(changed);
+      } ERR_REGION_ERROR_BUBBLE(err);
+
+      if (converted) ++passes;
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE_HANDLER(trees, string_vector_free);
+  SAFE_FREE_HANDLER(dirs, string_vector_free);
+
+  return err;
+}
+
+// converts a directory of the source into the same place under the target
+// as a whole run would, reporting only when it held any cues
+static errno_t convert_changed(
+  struct cue_options* opts,
+  cue_traverse_visitor_t* visitor,
+  int scan_threads,
+  char const* dir,
+  short descend,
+  cue_traverse_report_writer_t* report_writer,
+  short* converted) {
+
+  errno_t err = 0;
+  directory_traversal_options_t traversal_opts = { 0 };
+  char const* relative = path_relative_part(opts->source_dir, dir);
+  char const* target_path = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(target_path = *relative
+      ? join_dir_file_path(opts->target_dir, relative)
+      : _strdup(opts->target_dir), err);
+
+    // the source root still names the cues, so that claims and shards are
+    // keyed just as in a whole run
+    ERR_REGION_ERROR_CHECK(cue_traverse_visitor_restart(visitor, target_path), err);
+
+    traversal_opts.should_descend = descend;
+    traversal_opts.threads = scan_threads;
+    cue_traverse_visitor_filter(&traversal_opts);
+    traverse_dir_path_opts(dir, &traversal_opts, &visitor->pv_t.handler_i);
+    ERR_REGION_ERROR_CHECK(cue_traverse_visitor_finish(visitor), err);
+
+    if (!opts->test_only) {
+      ERR_REGION_ERROR_CHECK(cue_journal_flush(visitor->journal), err);
+      ERR_REGION_ERROR_CHECK(cue_manifest_save(visitor->manifest), err);
+      ERR_REGION_ERROR_CHECK(cue_manifest_settle(visitor->manifest), err);
+
+      if (!visitor->report->failed_cue_count) {
+        ERR_REGION_ERROR_CHECK(cue_journal_discard(visitor->journal), err);
+      }
+    }
+
+    // a directory with no cues in it has nothing to report
+    ERR_REGION_CMP_EXIT(!visitor->report->found_cue_count);
+    *converted = 1;
+
+    visitor->writer->write_line(visitor->writer, "");
+    ERR_REGION_ERROR_CHECK(cue_traverse_report_writer_write(report_writer, visitor->report), err);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE(target_path);
+
+  return err;
+}
+
+static errno_t query_catalog(struct cue_options* opts, cue_convert_env_t* env) {
+  errno_t err = 0;
+  cue_catalog_t* catalog = 0;
+  cue_catalog_query_t query;
+  file_line_writer_t out_writer = { 0 };
+  null_line_writer_t null_writer = { 0 };
+  line_writer_i* selected_writer = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_ERROR_CHECK(cue_catalog_query_parse(&query,
+      opts->query_terms->get_buffer(opts->query_terms),
+      opts->query_terms->get_length(opts->query_terms)), err);
+
+    ERR_REGION_NULL_CHECK(catalog = cue_catalog_alloc(opts->catalog_path), err);
+
+    ERR_REGION_ERROR_CHECK(null_line_writer_init(&null_writer), err);
+    selected_writer = &null_writer.line_writer;
+
+    if (env->out && !opts->quiet) {
+      file_line_writer_init_fid(&out_writer, env->out);
+      selected_writer = &out_writer.line_writer;
+    }
+
+    ERR_REGION_ERROR_CHECK(cue_catalog_query_write(catalog, &query, selected_writer), err);
+
+  } ERR_REGION_END()
+
+  file_line_writer_uninit(&out_writer);
+  null_line_writer_uninit(&null_writer);
+  SAFE_FREE_HANDLER(catalog, cue_catalog_free);
 
   return err;
 }
@@ -9,6 +9,7 @@ struct cue_traverse_report;
 typedef struct {
   FILE* out;
   FILE* err;
+  int watch_passes;  // in watch mode, the conversions to stop after, 0 watches until stopped
 } cue_convert_env_t;
 
 errno_t cue_convert(
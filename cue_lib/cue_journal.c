@@ -0,0 +1,456 @@
+#include "cue_journal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "err_helpers.h"
+#include "mem_helpers.h"
+#include "filesystem.h"
+#include "path.h"
+#include "file_line_reader.h"
+#include "file_line_writer.h"
+#include "thread_helpers.h"
+#include "format_helpers.h"
+
+static void* acquire(void const* instance);
+static void entry_release(void* instance);
+static int compare_entries(void const* lhs, void const* rhs);
+static errno_t read_entries(struct cue_journal* self, line_reader_i* reader);
+static errno_t parse_entry(cue_journal_entry_vector_t* entries, char const* arg, size_t sequence);
+static errno_t write_entries(line_writer_i* writer, cue_journal_entry_vector_t const* entries);
+static errno_t rewrite(struct cue_journal* self);
+static errno_t append(struct cue_journal* self);
+static errno_t flush_locked(struct cue_journal* self);
+static void clear_entries(cue_journal_entry_vector_t* entries);
+static char const* skip_prefix(char const* line, char const* prefix);
+
+static const char s_header[] = "CUE JOURNAL";
+static const char s_output[] = "Output: ";
+
+// outputs are recorded once this many are waiting, or once the oldest has
+// waited this many seconds, whichever comes first
+#define JOURNAL_BATCH 64
+#define JOURNAL_INTERVAL 5
+
+struct object_vector_params cue_journal_entry_vector_ops = {
+  acquire,
+  entry_release,
+};
+
+static void* acquire(void const* instance) {
+  return (void*)instance;
+}
+
+static void entry_release(void* instance) {
+  cue_journal_entry_t* entry = (cue_journal_entry_t*)instance;
+  SAFE_FREE(entry->path);
+  SAFE_FREE(entry);
+}
+
+IMPLEMENT_OBJECT_VECTOR(cue_journal_entry_vector, cue_journal_entry_t)
+
+char const* cue_journal_path(char const* target_root, size_t shard, size_t num_shards,
+  char const* worker_opt) {
+
+  char const* name = 0;
+  char const* path = 0;
+
+  if (worker_opt) {
+    name = msnprintf("cue_journal_%s.txt", worker_opt);
+  }
+  else if (num_shards) {
+    name = msnprintf("cue_journal_%zu_of_%zu.txt", shard, num_shards);
+  }
+  else {
+    name = _strdup("cue_journal.txt");
+  }
+
+  if (!name) return NULL;
+
+  path = join_dir_file_path(target_root, name);
+  SAFE_FREE(name);
+
+  return path;
+}
+
+struct cue_journal* cue_journal_alloc(char const* path, char const* target_root) {
+  cue_journal_t* self = malloc(sizeof(*self));
+  if (!self) return NULL;
+
+  errno_t err = cue_journal_init(self, path, target_root);
+  if (!err) return self;
+
+  SAFE_FREE(self);
+  return NULL;
+}
+
+errno_t cue_journal_init(struct cue_journal* self, char const* path, char const* target_root) {
+  errno_t err = 0;
+
+  memset(self, 0, sizeof(*self));
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(self->path = _strdup(path), err);
+    ERR_REGION_NULL_CHECK(self->target_root = _strdup(target_root), err);
+    ERR_REGION_NULL_CHECK(self->entries = cue_journal_entry_vector_alloc(), err);
+    ERR_REGION_NULL_CHECK(self->pending = cue_journal_entry_vector_alloc(), err);
+    ERR_REGION_NULL_CHECK(self->lock = th_mutex_alloc(), err);
+    self->last_flush = time(NULL);
+
+    return err;
+
+  } ERR_REGION_END()
+
+  cue_journal_uninit(self);
+
+  return err;
+}
+
+void cue_journal_uninit(struct cue_journal* self) {
+  SAFE_FREE_HANDLER(self->lock, th_mutex_free);
+  SAFE_FREE_HANDLER(self->pending, cue_journal_entry_vector_free);
+  SAFE_FREE_HANDLER(self->entries, cue_journal_entry_vector_free);
+  SAFE_FREE(self->target_root);
+  SAFE_FREE(self->path);
+}
+
+void cue_journal_free(struct cue_journal* self) {
+  cue_journal_uninit(self);
+  SAFE_FREE(self);
+}
+
+errno_t cue_journal_load(struct cue_journal* self) {
+  errno_t err = 0;
+  file_line_reader_t reader = { 0 };
+  cue_journal_entry_vector_t* entries = self->entries;
+  size_t length = 0;
+
+  ERR_REGION_BEGIN() {
+    if (!file_exists(self->path)) return err;
+
+    ERR_REGION_ERROR_CHECK(file_line_reader_init_path(&reader, self->path), err);
+    err = read_entries(self, &reader.line_reader);
+
+  } ERR_REGION_END()
+
+  file_line_reader_uninit(&reader);
+
+  // a journal that isn't one is dropped rather than trusted
+  if (err) {
+    clear_entries(entries);
+    return 0;
+  }
+
+  length = entries->get_length(entries);
+  if (length > 1) {
+    qsort((void*)entries->get_buffer(entries), length, sizeof(cue_journal_entry_t*), compare_entries);
+  }
+
+  return err;
+}
+
+struct cue_journal_entry const* cue_journal_find(struct cue_journal const* self, char const* path) {
+  cue_journal_entry_vector_t const* entries = self->entries;
+  cue_journal_entry_t const* const* buffer = (cue_journal_entry_t const* const*)entries->get_buffer(entries);
+  cue_journal_entry_t key = { 0 };
+  cue_journal_entry_t const* key_ptr = &key;
+  size_t low = 0;
+  size_t high = entries->get_length(entries);
+
+  // sorts after every record of the path
+  key.path = path_relative_part(self->target_root, path);
+  key.sequence = (size_t)-1;
+
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+
+    if (compare_entries(&buffer[mid], &key_ptr) < 0) {
+      low = mid + 1;
+    }
+    else {
+      high = mid;
+    }
+  }
+
+  // so the latest record, if there is one, is just before where it would go
+  if (!low || strcmp(buffer[low - 1]->path, key.path) != 0) return NULL;
+
+  return buffer[low - 1];
+}
+
+errno_t cue_journal_add(struct cue_journal* self, char const* path, char const* source_path, float quality) {
+  errno_t err = 0;
+  cue_journal_entry_t* entry = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(entry = calloc(1, sizeof(*entry)), err);
+    ERR_REGION_NULL_CHECK(entry->path = _strdup(path_relative_part(self->target_root, path)), err);
+    entry->quality = quality;
+
+    ERR_REGION_ERROR_CHECK(file_size(path, &entry->size), err);
+    ERR_REGION_ERROR_CHECK(file_mtime(path, &entry->mtime), err);
+    ERR_REGION_ERROR_CHECK(file_size(source_path, &entry->source_size), err);
+    ERR_REGION_ERROR_CHECK(file_mtime(source_path, &entry->source_mtime), err);
+
+    th_mutex_lock(self->lock);
+
+    if (!self->pending->push(self->pending, entry)) {
+      err = -1;
+    }
+    else {
+      entry = 0;
+
+      if (self->pending->get_length(self->pending) >= JOURNAL_BATCH
+        || time(NULL) - self->last_flush >= JOURNAL_INTERVAL) {
+        err = flush_locked(self);
+      }
+    }
+
+    th_mutex_unlock(self->lock);
+
+  } ERR_REGION_END()
+
+  if (entry) entry_release(entry);
+
+  return err;
+}
+
+errno_t cue_journal_flush(struct cue_journal* self) {
+  errno_t err = 0;
+
+  th_mutex_lock(self->lock);
+  err = flush_locked(self);
+  th_mutex_unlock(self->lock);
+
+  return err;
+}
+
+errno_t cue_journal_discard(struct cue_journal* self) {
+  errno_t err = 0;
+
+  th_mutex_lock(self->lock);
+
+  clear_entries(self->pending);
+  clear_entries(self->entries);
+  self->rewritten = 0;
+
+  if (file_exists(self->path)) err = delete_file(self->path);
+
+  th_mutex_unlock(self->lock);
+
+  return err;
+}
+
+static errno_t flush_locked(struct cue_journal* self) {
+  errno_t err = 0;
+  cue_journal_entry_vector_t* pending = self->pending;
+  char const* path = 0;
+
+  if (!pending->get_length(pending)) return err;
+
+  ERR_REGION_BEGIN() {
+    // the outputs reach the disk before the records naming them do, so a
+    // record is never left pointing at a file that was lost.  an output
+    // that can't be synced is left out, to be made again if it is needed
+    for (size_t i = 0; i < pending->get_length(pending);) {
+      cue_journal_entry_t const* entry = pending->get(pending, i);
+
+      ERR_REGION_NULL_CHECK(path = join_dir_file_path(self->target_root, entry->path), err);
+      if (sync_file(path)) {
+        ERR_REGION_ERROR_CHECK(pending->delete_at(pending, i), err);
+      }
+      else {
+        ++i;
+      }
+      SAFE_FREE(path);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    // the first batch replaces whatever an earlier run may have cut short,
+    // and the rest are appended to it
+    if (!self->rewritten) {
+      ERR_REGION_ERROR_CHECK(rewrite(self), err);
+      self->rewritten = 1;
+    }
+    else {
+      ERR_REGION_ERROR_CHECK(append(self), err);
+    }
+
+    clear_entries(pending);
+    self->last_flush = time(NULL);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE(path);
+
+  return err;
+}
+
+static errno_t rewrite(struct cue_journal* self) {
+  errno_t err = 0;
+  file_line_writer_t writer = { 0 };
+  char const* part_path = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(part_path = path_part_file(self->path), err);
+
+    ERR_REGION_ERROR_CHECK(file_line_writer_init_path(&writer, part_path), err);
+    ERR_REGION_CMP_CHECK(!line_writer_write_fmt(&writer.line_writer, "%s", s_header), err);
+    ERR_REGION_ERROR_CHECK(write_entries(&writer.line_writer, self->entries), err);
+    ERR_REGION_ERROR_CHECK(write_entries(&writer.line_writer, self->pending), err);
+    ERR_REGION_CMP_CHECK(fflush(writer.fid), err);
+    file_line_writer_uninit(&writer);
+
+    ERR_REGION_ERROR_CHECK(sync_file(part_path), err);
+    ERR_REGION_ERROR_CHECK(replace_file(part_path, self->path), err);
+
+  } ERR_REGION_END()
+
+  file_line_writer_uninit(&writer);
+  SAFE_FREE(part_path);
+
+  return err;
+}
+
+static errno_t append(struct cue_journal* self) {
+  errno_t err = 0;
+  file_line_writer_t writer = { 0 };
+  FILE* file = 0;
+
+  ERR_REGION_BEGIN() {
+    fopen_s(&file, self->path, "ab");
+    ERR_REGION_NULL_CHECK(file, err);
+    file_line_writer_init_fid(&writer, file);
+    writer.close_file_on_uninit = 1;
+
+    ERR_REGION_ERROR_CHECK(write_entries(&writer.line_writer, self->pending), err);
+    ERR_REGION_CMP_CHECK(fflush(writer.fid), err);
+    file_line_writer_uninit(&writer);
+
+    ERR_REGION_ERROR_CHECK(sync_file(self->path), err);
+
+  } ERR_REGION_END()
+
+  file_line_writer_uninit(&writer);
+
+  return err;
+}
+
+static int compare_entries(void const* lhs, void const* rhs) {
+  cue_journal_entry_t const* a = *(cue_journal_entry_t const* const*)lhs;
+  cue_journal_entry_t const* b = *(cue_journal_entry_t const* const*)rhs;
+  int result = strcmp(a->path, b->path);
+
+  if (result) return result;
+  if (a->sequence != b->sequence) return a->sequence < b->sequence ? -1 : 1;
+  return 0;
+}
+
+static errno_t read_entries(struct cue_journal* self, line_reader_i* reader) {
+  errno_t err = 0;
+  char const* line = 0;
+  size_t bytes = 0;
+  char const* arg = 0;
+  short has_header = 0;
+  short damaged = 0;
+  size_t sequence = 0;
+
+  ERR_REGION_BEGIN() {
+    while (reader->read_line(reader, &line, &bytes) != (size_t)EOF) {
+      ERR_REGION_NULL_CHECK(line, err);
+
+      if (!*line || damaged) {
+        // nothing after damage can be trusted to line up
+      }
+      else if (!has_header) {
+        err = strcmp(line, s_header) ? -1 : 0;
+        has_header = 1;
+      }
+      else if ((arg = skip_prefix(line, s_output)) == 0
+        || parse_entry(self->entries, arg, sequence++)) {
+
+        // the end of a run that was stopped while recording
+        damaged = 1;
+      }
+
+      SAFE_FREE(line);
+      ERR_REGION_ERROR_BUBBLE(err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    ERR_REGION_CMP_CHECK(!has_header, err);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE(line);
+
+  return err;
+}
+
+static errno_t parse_entry(cue_journal_entry_vector_t* entries, char const* arg, size_t sequence) {
+  errno_t err = 0;
+  cue_journal_entry_t* entry = 0;
+  unsigned long long* fields[4];
+  char* end = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(entry = calloc(1, sizeof(*entry)), err);
+    entry->sequence = sequence;
+
+    // size mtime source_size source_mtime quality path, where only the
+    // path may hold spaces
+    fields[0] = &entry->size;
+    fields[1] = &entry->mtime;
+    fields[2] = &entry->source_size;
+    fields[3] = &entry->source_mtime;
+
+    for (size_t i = 0; i < sizeof(fields) / sizeof(*fields); ++i) {
+      *fields[i] = strtoull(arg, &end, 10);
+      ERR_REGION_CMP_CHECK(end == arg || *end != ' ', err);
+      arg = end + 1;
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    entry->quality = strtof(arg, &end);
+    ERR_REGION_CMP_CHECK(end == arg || *end != ' ', err);
+    arg = end + 1;
+
+    ERR_REGION_CMP_CHECK(!*arg, err);
+    ERR_REGION_NULL_CHECK(entry->path = _strdup(arg), err);
+    ERR_REGION_NULL_CHECK(entries->push(entries, entry), err);
+
+    return err;
+
+  } ERR_REGION_END()
+
+  if (entry) entry_release(entry);
+
+  return err;
+}
+
+static errno_t write_entries(line_writer_i* writer, cue_journal_entry_vector_t const* entries) {
+  errno_t err = 0;
+
+  ERR_REGION_BEGIN() {
+    for (size_t i = 0; i < entries->get_length(entries); ++i) {
+      cue_journal_entry_t const* entry = entries->get(entries, i);
+
+      // enough digits that the quality reads back exactly
+      ERR_REGION_CMP_CHECK(!line_writer_write_fmt(writer, "%s%llu %llu %llu %llu %.9g %s", s_output,
+        entry->size, entry->mtime, entry->source_size, entry->source_mtime,
+        entry->quality, entry->path), err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+  } ERR_REGION_END()
+
+  return err;
+}
+
+static void clear_entries(cue_journal_entry_vector_t* entries) {
+  while (entries->get_length(entries)) {
+    entries->pop(entries);
+  }
+}
+
+static char const* skip_prefix(char const* line, char const* prefix) {
+  size_t len = strlen(prefix);
+  return strncmp(line, prefix, len) == 0 ? line + len : NULL;
+}
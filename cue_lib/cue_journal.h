@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stddef.h>
+#include <time.h>
+
+#include "object_vector.h"
+
+struct th_mutex;
+
+// an output a conversion finished, along with the source it was made from
+typedef struct cue_journal_entry {
+  char const* path;  // owned, relative to the target root
+  unsigned long long size;
+  unsigned long long mtime;
+  unsigned long long source_size;
+  unsigned long long source_mtime;
+  float quality;
+  size_t sequence;  // order it was recorded in, so that a later record of a path wins
+} cue_journal_entry_t;
+
+extern struct object_vector_params cue_journal_entry_vector_ops;
+
+typedef struct cue_journal_entry_vector {
+  object_vector_t vector_t;
+  INSERT_OBJECT_VECTOR_METHODS(cue_journal_entry_vector, cue_journal_entry_t)
+} cue_journal_entry_vector_t;
+
+DECLARE_OBJECT_VECTOR(cue_journal_entry_vector, cue_journal_entry_t)
+
+// the outputs finished so far by a conversion that may itself not finish.
+// the manifest only learns of a cue once all of its files are done, so a
+// run stopped part way would otherwise have to make them all again.
+// outputs are recorded in batches, each synced to disk along with the
+// files it names, so that small files don't each pay for a sync
+typedef struct cue_journal {
+  char const* path;  // owned, where the journal is kept
+  char const* target_root;  // owned
+  struct cue_journal_entry_vector* entries;  // owned, as loaded, sorted by path
+  struct cue_journal_entry_vector* pending;  // owned, finished but not yet recorded
+  short rewritten;  // the file holds just the loaded entries and those since
+  time_t last_flush;
+  struct th_mutex* lock;  // owned, guards pending and the file
+} cue_journal_t;
+
+// where the journal of a target root is kept, one per shard or worker, just
+// as with the manifest.  the caller frees the path
+char const* cue_journal_path(char const* target_root, size_t shard, size_t num_shards,
+  char const* worker_opt);
+
+struct cue_journal* cue_journal_alloc(char const* path, char const* target_root);
+errno_t cue_journal_init(struct cue_journal* self, char const* path, char const* target_root);
+void cue_journal_uninit(struct cue_journal* self);
+void cue_journal_free(struct cue_journal* self);
+
+// a missing journal isn't an error.  a journal cut short by the end of a
+// run keeps what it held up to the damage
+errno_t cue_journal_load(struct cue_journal* self);
+
+// the latest loaded record of an output, if any
+struct cue_journal_entry const* cue_journal_find(struct cue_journal const* self, char const* path);
+
+// records an output just put in place, made from source at quality.  safe
+// to call from several threads at once
+errno_t cue_journal_add(struct cue_journal* self, char const* path, char const* source_path, float quality);
+
+// syncs every output added since the last flush, then records them
+errno_t cue_journal_flush(struct cue_journal* self);
+
+// removes the journal, once nothing it holds is needed any more
+errno_t cue_journal_discard(struct cue_journal* self);
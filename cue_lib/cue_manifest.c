@@ -0,0 +1,662 @@
+#include "cue_manifest.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "err_helpers.h"
+#include "mem_helpers.h"
+#include "cue_file.h"
+#include "filesystem.h"
+#include "path.h"
+#include "file_line_reader.h"
+#include "file_line_writer.h"
+#include "thread_helpers.h"
+#include "format_helpers.h"
+#include "hash_helpers.h"
+
+static void* acquire(void const* instance);
+static void file_release(void* instance);
+static void entry_release(void* instance);
+static int compare_entries(void const* lhs, void const* rhs);
+static void sort_entries(cue_manifest_entry_vector_t* entries);
+static cue_manifest_entry_t* find_entry(cue_manifest_entry_vector_t const* entries, char const* cue_path);
+static cue_manifest_entry_t* entry_alloc(char const* cue_path, float quality);
+static errno_t add_file(
+  cue_manifest_file_vector_t* files,
+  cue_manifest_file_t const* previous,
+  char const* path,
+  char const* relative_path,
+  unsigned long long known_hash,
+  short hash);
+static cue_manifest_file_t const* find_file(cue_manifest_file_vector_t const* files, char const* path);
+static errno_t read_entries(struct cue_manifest* self, line_reader_i* reader);
+static errno_t parse_file(cue_manifest_file_vector_t* files, char const* arg, short has_hash);
+static errno_t write_files(line_writer_i* writer, char const* prefix, cue_manifest_file_vector_t const* files, short has_hash);
+static errno_t write_entry(line_writer_i* writer, cue_manifest_entry_t const* entry);
+static char const* skip_prefix(char const* line, char const* prefix);
+
+static const char s_header[] = "CUE MANIFEST";
+static const char s_footer[] = "END OF MANIFEST";
+static const char s_cue[] = "Cue: ";
+static const char s_quality[] = "Quality: ";
+static const char s_source[] = "Source: ";
+static const char s_output[] = "Output: ";
+
+struct object_vector_params cue_manifest_file_vector_ops = {
+  acquire,
+  file_release,
+};
+
+struct object_vector_params cue_manifest_entry_vector_ops = {
+  acquire,
+  entry_release,
+};
+
+static void* acquire(void const* instance) {
+  return (void*)instance;
+}
+
+static void file_release(void* instance) {
+  cue_manifest_file_t* file = (cue_manifest_file_t*)instance;
+  SAFE_FREE(file->path);
+  SAFE_FREE(file);
+}
+
+static void entry_release(void* instance) {
+  cue_manifest_entry_t* entry = (cue_manifest_entry_t*)instance;
+  SAFE_FREE(entry->cue_path);
+  SAFE_FREE_HANDLER(entry->sources, cue_manifest_file_vector_free);
+  SAFE_FREE_HANDLER(entry->outputs, cue_manifest_file_vector_free);
+  SAFE_FREE(entry);
+}
+
+IMPLEMENT_OBJECT_VECTOR(cue_manifest_file_vector, cue_manifest_file_t)
+IMPLEMENT_OBJECT_VECTOR(cue_manifest_entry_vector, cue_manifest_entry_t)
+
+char const* cue_manifest_path(char const* target_root, size_t shard, size_t num_shards,
+  char const* worker_opt) {
+
+  char const* name = 0;
+  char const* path = 0;
+
+  if (worker_opt) {
+    name = msnprintf("cue_manifest_%s.txt", worker_opt);
+  }
+  else if (num_shards) {
+    name = msnprintf("cue_manifest_%zu_of_%zu.txt", shard, num_shards);
+  }
+  else {
+    name = _strdup("cue_manifest.txt");
+  }
+
+  if (!name) return NULL;
+
+  path = join_dir_file_path(target_root, name);
+  SAFE_FREE(name);
+
+  return path;
+}
+
+struct cue_manifest* cue_manifest_alloc(char const* path, char const* source_root, char const* target_root) {
+  cue_manifest_t* self = malloc(sizeof(*self));
+  if (!self) return NULL;
+
+  errno_t err = cue_manifest_init(self, path, source_root, target_root);
+  if (!err) return self;
+
+  SAFE_FREE(self);
+  return NULL;
+}
+
+errno_t cue_manifest_init(struct cue_manifest* self, char const* path, char const* source_root, char const* target_root) {
+  errno_t err = 0;
+
+  memset(self, 0, sizeof(*self));
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(self->path = _strdup(path), err);
+    ERR_REGION_NULL_CHECK(self->source_root = _strdup(source_root), err);
+    ERR_REGION_NULL_CHECK(self->target_root = _strdup(target_root), err);
+    ERR_REGION_NULL_CHECK(self->entries = cue_manifest_entry_vector_alloc(), err);
+    ERR_REGION_NULL_CHECK(self->added = cue_manifest_entry_vector_alloc(), err);
+    ERR_REGION_NULL_CHECK(self->lock = th_mutex_alloc(), err);
+
+    return err;
+
+  } ERR_REGION_END()
+
+  cue_manifest_uninit(self);
+
+  return err;
+}
+
+void cue_manifest_uninit(struct cue_manifest* self) {
+  SAFE_FREE_HANDLER(self->lock, th_mutex_free);
+  SAFE_FREE_HANDLER(self->added, cue_manifest_entry_vector_free);
+  SAFE_FREE_HANDLER(self->entries, cue_manifest_entry_vector_free);
+  SAFE_FREE(self->target_root);
+  SAFE_FREE(self->source_root);
+  SAFE_FREE(self->path);
+}
+
+void cue_manifest_free(struct cue_manifest* self) {
+  cue_manifest_uninit(self);
+  SAFE_FREE(self);
+}
+
+errno_t cue_manifest_load(struct cue_manifest* self) {
+  errno_t err = 0;
+  file_line_reader_t reader = { 0 };
+
+  ERR_REGION_BEGIN() {
+    if (!file_exists(self->path)) return err;
+
+    ERR_REGION_ERROR_CHECK(file_line_reader_init_path(&reader, self->path), err);
+    err = read_entries(self, &reader.line_reader);
+
+  } ERR_REGION_END()
+
+  file_line_reader_uninit(&reader);
+
+  if (err) {
+    // a damaged manifest is dropped rather than trusted, leaving the
+    // run to treat the target as it would without one
+    cue_manifest_entry_vector_t* entries = self->entries;
+    while (entries->get_length(entries)) {
+      entries->pop(entries);
+    }
+
+    self->loaded = 0;
+    return 0;
+  }
+
+  sort_entries(self->entries);
+  self->loaded = 1;
+
+  return err;
+}
+
+errno_t cue_manifest_save(struct cue_manifest* self) {
+  errno_t err = 0;
+  file_line_writer_t writer = { 0 };
+  line_writer_i* line_writer = &writer.line_writer;
+  cue_manifest_entry_vector_t* entries = self->entries;
+  cue_manifest_entry_vector_t* added = self->added;
+  char const* dir = 0;
+  char const* part_path = 0;
+
+  ERR_REGION_BEGIN() {
+    // nothing is being added any more, so it can be searched too
+    sort_entries(added);
+
+    // a run that converted nothing may not have made the target yet
+    ERR_REGION_NULL_CHECK(dir = path_dir_part(self->path), err);
+    ERR_REGION_ERROR_CHECK(ensure_dir(dir), err);
+
+    // written aside, so a save that doesn't finish leaves the old manifest
+    ERR_REGION_NULL_CHECK(part_path = path_part_file(self->path), err);
+    ERR_REGION_ERROR_CHECK(file_line_writer_init_path(&writer, part_path), err);
+    ERR_REGION_CMP_CHECK(!line_writer_write_fmt(line_writer, "%s", s_header), err);
+
+    for (size_t i = 0; i < entries->get_length(entries); ++i) {
+      cue_manifest_entry_t const* entry = entries->get(entries, i);
+
+      // anything converted again this run replaces what was loaded
+      if (!entry->keep || find_entry(added, entry->cue_path)) continue;
+
+      ERR_REGION_ERROR_CHECK(write_entry(line_writer, entry), err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    for (size_t i = 0; i < added->get_length(added); ++i) {
+      ERR_REGION_ERROR_CHECK(write_entry(line_writer, added->get(added, i)), err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    ERR_REGION_CMP_CHECK(!line_writer_write_fmt(line_writer, "%s", s_footer), err);
+    ERR_REGION_CMP_CHECK(fflush(writer.fid), err);
+    file_line_writer_uninit(&writer);
+
+    // on disk before it replaces the old one, since a journal is only
+    // discarded once the manifest holds what it did
+    ERR_REGION_ERROR_CHECK(sync_file(part_path), err);
+    ERR_REGION_ERROR_CHECK(replace_file(part_path, self->path), err);
+
+  } ERR_REGION_END()
+
+  file_line_writer_uninit(&writer);
+  if (err && part_path) delete_file(part_path);
+  SAFE_FREE(part_path);
+  SAFE_FREE(dir);
+
+  return err;
+}
+
+errno_t cue_manifest_settle(struct cue_manifest* self) {
+  errno_t err = 0;
+  cue_manifest_entry_vector_t* entries = self->entries;
+  cue_manifest_entry_vector_t* added = self->added;
+  cue_manifest_entry_t* entry = 0;
+
+  // a cue converted again takes over its loaded entry, which is searched
+  // while still sorted, and the entry added is left holding the old files
+  for (size_t i = 0; i < added->get_length(added); ++i) {
+    cue_manifest_entry_t* update = (cue_manifest_entry_t*)added->get(added, i);
+    cue_manifest_entry_t* loaded = find_entry(entries, update->cue_path);
+    cue_manifest_file_vector_t* files = 0;
+    float quality = 0;
+
+    if (!loaded) continue;
+
+    files = loaded->sources;
+    loaded->sources = update->sources;
+    update->sources = files;
+
+    files = loaded->outputs;
+    loaded->outputs = update->outputs;
+    update->outputs = files;
+
+    quality = loaded->quality;
+    loaded->quality = update->quality;
+    update->quality = quality;
+
+    loaded->keep = 1;
+    update->keep = 0;
+  }
+
+  ERR_REGION_BEGIN() {
+    while (added->get_length(added)) {
+      ERR_REGION_ERROR_CHECK(added->pop_keep(added, &entry), err);
+
+      if (entry->keep) {
+        ERR_REGION_NULL_CHECK(entries->push(entries, entry), err);
+      }
+      else {
+        entry_release(entry);
+      }
+
+      entry = 0;
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+  } ERR_REGION_END()
+
+  if (entry) entry_release(entry);
+  sort_entries(entries);
+
+  return err;
+}
+
+struct cue_manifest_entry* cue_manifest_find(struct cue_manifest const* self, char const* cue_path) {
+  return find_entry(self->entries, path_relative_part(self->source_root, cue_path));
+}
+
+short cue_manifest_is_current(struct cue_manifest const* self, struct cue_manifest_entry* entry, float quality) {
+  cue_manifest_file_vector_t* sources = entry->sources;
+  cue_manifest_file_vector_t* outputs = entry->outputs;
+  char const* path = 0;
+  short current = 1;
+
+  if (entry->quality != quality) return 0;
+
+  for (size_t i = 0; current && i < sources->get_length(sources); ++i) {
+    cue_manifest_file_t* source = (cue_manifest_file_t*)sources->get(sources, i);
+    unsigned long long size = 0, mtime = 0, hash = 0;
+
+    path = join_dir_file_path(self->source_root, source->path);
+    current = path
+      && !file_size(path, &size)
+      && !file_mtime(path, &mtime)
+      && size == source->size;
+
+    // a file that was only touched, or copied, still has the same content.
+    // one recorded without a hash can't be told from one that changed
+    if (current && mtime != source->mtime) {
+      current = source->hash && !hash_file(path, &hash) && hash == source->hash;
+      if (current) source->mtime = mtime;
+    }
+
+    SAFE_FREE(path);
+  }
+
+  // a conversion that stopped part way may have left some outputs missing
+  // or cut short, and anything else touching them makes them suspect too
+  for (size_t i = 0; current && i < outputs->get_length(outputs); ++i) {
+    cue_manifest_file_t const* output = outputs->get(outputs, i);
+    unsigned long long size = 0, mtime = 0;
+
+    path = join_dir_file_path(self->target_root, output->path);
+    current = path
+      && !file_size(path, &size)
+      && !file_mtime(path, &mtime)
+      && size == output->size
+      && mtime == output->mtime;
+
+    SAFE_FREE(path);
+  }
+
+  return current;
+}
+
+struct cue_manifest_file const* cue_manifest_find_source(
+  struct cue_manifest const* self,
+  struct cue_manifest_entry const* entry,
+  char const* path) {
+
+  return find_file(entry->sources, path_relative_part(self->source_root, path));
+}
+
+struct cue_manifest_file const* cue_manifest_find_output(
+  struct cue_manifest const* self,
+  struct cue_manifest_entry const* entry,
+  char const* path) {
+
+  return find_file(entry->outputs, path_relative_part(self->target_root, path));
+}
+
+errno_t cue_manifest_add(
+  struct cue_manifest* self,
+  char const* cue_path,
+  char const* target_cue_path,
+  struct cue_sheet const* source_sheet,
+  struct cue_sheet const* target_sheet,
+  float quality,
+  short hash_cue,
+  unsigned long long const* file_hashes) {
+
+  errno_t err = 0;
+  cue_manifest_entry_t* entry = 0;
+  cue_manifest_entry_t const* previous = 0;
+  char const* src_dir = 0;
+  char const* trg_dir = 0;
+  char const* path = 0;
+
+  ERR_REGION_BEGIN() {
+    entry = entry_alloc(path_relative_part(self->source_root, cue_path), quality);
+    ERR_REGION_NULL_CHECK(entry, err);
+
+    // the loaded entries don't change during the run, so need no lock
+    previous = find_entry(self->entries, entry->cue_path);
+
+    ERR_REGION_NULL_CHECK(src_dir = path_dir_part(cue_path), err);
+    ERR_REGION_NULL_CHECK(trg_dir = path_dir_part(target_cue_path), err);
+
+    ERR_REGION_ERROR_CHECK(add_file(entry->sources,
+      previous ? find_file(previous->sources, entry->cue_path) : NULL,
+      cue_path, entry->cue_path, 0, hash_cue), err);
+    ERR_REGION_ERROR_CHECK(add_file(entry->outputs, NULL, target_cue_path,
+      path_relative_part(self->target_root, target_cue_path), 0, 0), err);
+
+    // the target sheet was derived from the source, so the files pair up
+    for (short i = 0; i < source_sheet->num_files; ++i) {
+      char const* relative_path = 0;
+
+      ERR_REGION_NULL_CHECK(path = join_dir_file_path(src_dir, source_sheet->file[i]->filename), err);
+      relative_path = path_relative_part(self->source_root, path);
+      ERR_REGION_ERROR_CHECK(add_file(entry->sources,
+        previous ? find_file(previous->sources, relative_path) : NULL,
+        path, relative_path, file_hashes ? file_hashes[i] : 0, 0), err);
+      SAFE_FREE(path);
+
+      ERR_REGION_NULL_CHECK(path = join_dir_file_path(trg_dir, target_sheet->file[i]->filename), err);
+      ERR_REGION_ERROR_CHECK(add_file(entry->outputs, NULL, path,
+        path_relative_part(self->target_root, path), 0, 0), err);
+      SAFE_FREE(path);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    th_mutex_lock(self->lock);
+    if (!self->added->push(self->added, entry)) err = -1;
+    th_mutex_unlock(self->lock);
+
+    ERR_REGION_ERROR_BUBBLE(err);
+    entry = 0;
+
+  } ERR_REGION_END()
+
+  SAFE_FREE_HANDLER(entry, entry_release);
+  SAFE_FREE(path);
+  SAFE_FREE(trg_dir);
+  SAFE_FREE(src_dir);
+
+  return err;
+}
+
+static int compare_entries(void const* lhs, void const* rhs) {
+  cue_manifest_entry_t const* a = *(cue_manifest_entry_t const* const*)lhs;
+  cue_manifest_entry_t const* b = *(cue_manifest_entry_t const* const*)rhs;
+
+  return strcmp(a->cue_path, b->cue_path);
+}
+
+static void sort_entries(cue_manifest_entry_vector_t* entries) {
+  size_t length = entries->get_length(entries);
+  if (length < 2) return;
+
+  qsort((void*)entries->get_buffer(entries), length, sizeof(cue_manifest_entry_t*), compare_entries);
+}
+
+static cue_manifest_entry_t* find_entry(cue_manifest_entry_vector_t const* entries, char const* cue_path) {
+  cue_manifest_entry_t key = { 0 };
+  cue_manifest_entry_t const* key_ptr = &key;
+  cue_manifest_entry_t const** found = 0;
+  size_t length = entries->get_length(entries);
+
+  if (!length) return NULL;
+
+  key.cue_path = cue_path;
+  found = bsearch(&key_ptr, entries->get_buffer(entries), length, sizeof(cue_manifest_entry_t*), compare_entries);
+
+  return found ? (cue_manifest_entry_t*)*found : NULL;
+}
+
+static cue_manifest_entry_t* entry_alloc(char const* cue_path, float quality) {
+  errno_t err = 0;
+  cue_manifest_entry_t* entry = calloc(1, sizeof(*entry));
+  if (!entry) return NULL;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(entry->cue_path = _strdup(cue_path), err);
+    ERR_REGION_NULL_CHECK(entry->sources = cue_manifest_file_vector_alloc(), err);
+    ERR_REGION_NULL_CHECK(entry->outputs = cue_manifest_file_vector_alloc(), err);
+    entry->quality = quality;
+    entry->keep = 1;
+
+  } ERR_REGION_END()
+
+  if (err) SAFE_FREE_HANDLER(entry, entry_release);
+
+  return entry;
+}
+
+static cue_manifest_file_t const* find_file(cue_manifest_file_vector_t const* files, char const* path) {
+  // a cue names only a handful of files
+  for (size_t i = 0; i < files->get_length(files); ++i) {
+    cue_manifest_file_t const* file = files->get(files, i);
+    if (strcmp(file->path, path) == 0) return file;
+  }
+
+  return NULL;
+}
+
+static errno_t add_file(
+  cue_manifest_file_vector_t* files,
+  cue_manifest_file_t const* previous,
+  char const* path,
+  char const* relative_path,
+  unsigned long long known_hash,
+  short hash) {
+
+  errno_t err = 0;
+  cue_manifest_file_t* file = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(file = calloc(1, sizeof(*file)), err);
+    ERR_REGION_NULL_CHECK(file->path = _strdup(relative_path), err);
+
+    ERR_REGION_ERROR_CHECK(file_size(path, &file->size), err);
+    ERR_REGION_ERROR_CHECK(file_mtime(path, &file->mtime), err);
+    if (known_hash) {
+      // already hashed on its way through this run
+      file->hash = known_hash;
+    }
+    else if (previous && previous->hash
+      && previous->size == file->size && previous->mtime == file->mtime) {
+      // unchanged since it was last hashed, so spare reading it again
+      file->hash = previous->hash;
+    }
+    else if (hash) {
+      ERR_REGION_ERROR_CHECK(hash_file(path, &file->hash), err);
+    }
+
+    ERR_REGION_NULL_CHECK(files->push(files, file), err);
+
+    return err;
+
+  } ERR_REGION_END()
+
+  if (file) file_release(file);
+
+  return err;
+}
+
+static errno_t read_entries(struct cue_manifest* self, line_reader_i* reader) {
+  errno_t err = 0;
+  char const* line = 0;
+  size_t bytes = 0;
+  char const* arg = 0;
+  short has_header = 0;
+  short has_footer = 0;
+  cue_manifest_entry_t* entry = 0;
+
+  ERR_REGION_BEGIN() {
+    while (reader->read_line(reader, &line, &bytes) != (size_t)EOF) {
+      ERR_REGION_NULL_CHECK(line, err);
+
+      if (!*line) {
+        // blank lines carry nothing
+      }
+      else if (has_footer) {
+        err = -1;
+      }
+      else if (!has_header) {
+        err = strcmp(line, s_header) ? -1 : 0;
+        has_header = 1;
+      }
+      else if (strcmp(line, s_footer) == 0) {
+        has_footer = 1;
+      }
+      else if ((arg = skip_prefix(line, s_cue)) != 0) {
+        // kept only once this run finds it still current
+        entry = entry_alloc(arg, 0);
+        if (entry) entry->keep = 0;
+        if (!entry || !self->entries->push(self->entries, entry)) err = -1;
+      }
+      else if (!entry) {
+        // everything else belongs to a cue
+        err = -1;
+      }
+      else if ((arg = skip_prefix(line, s_quality)) != 0) {
+        char* end = 0;
+        entry->quality = strtof(arg, &end);
+        if (end == arg || *end) err = -1;
+      }
+      else if ((arg = skip_prefix(line, s_source)) != 0) {
+        err = parse_file(entry->sources, arg, 1);
+      }
+      else if ((arg = skip_prefix(line, s_output)) != 0) {
+        err = parse_file(entry->outputs, arg, 0);
+      }
+      else {
+        err = -1;
+      }
+
+      SAFE_FREE(line);
+      ERR_REGION_ERROR_BUBBLE(err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    // a manifest cut short might be missing the cues that matter
+    ERR_REGION_CMP_CHECK(!has_footer, err);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE(line);
+
+  return err;
+}
+
+static errno_t parse_file(cue_manifest_file_vector_t* files, char const* arg, short has_hash) {
+  errno_t err = 0;
+  cue_manifest_file_t* file = 0;
+  char* end = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(file = calloc(1, sizeof(*file)), err);
+
+    // size mtime [hash] path, where only the path may hold spaces
+    file->size = strtoull(arg, &end, 10);
+    ERR_REGION_CMP_CHECK(end == arg || *end != ' ', err);
+    arg = end + 1;
+
+    file->mtime = strtoull(arg, &end, 10);
+    ERR_REGION_CMP_CHECK(end == arg || *end != ' ', err);
+    arg = end + 1;
+
+    if (has_hash) {
+      file->hash = strtoull(arg, &end, 16);
+      ERR_REGION_CMP_CHECK(end == arg || *end != ' ', err);
+      arg = end + 1;
+    }
+
+    ERR_REGION_NULL_CHECK(file->path = _strdup(arg), err);
+    ERR_REGION_NULL_CHECK(files->push(files, file), err);
+
+    return err;
+
+  } ERR_REGION_END()
+
+  if (file) file_release(file);
+
+  return err;
+}
+
+static errno_t write_entry(line_writer_i* writer, cue_manifest_entry_t const* entry) {
+  errno_t err = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_CMP_CHECK(!line_writer_write_fmt(writer, "%s%s", s_cue, entry->cue_path), err);
+
+    // enough digits that the quality reads back exactly
+    ERR_REGION_CMP_CHECK(!line_writer_write_fmt(writer, "%s%.9g", s_quality, entry->quality), err);
+
+    ERR_REGION_ERROR_CHECK(write_files(writer, s_source, entry->sources, 1), err);
+    ERR_REGION_ERROR_CHECK(write_files(writer, s_output, entry->outputs, 0), err);
+
+  } ERR_REGION_END()
+
+  return err;
+}
+
+static errno_t write_files(line_writer_i* writer, char const* prefix, cue_manifest_file_vector_t const* files, short has_hash) {
+  errno_t err = 0;
+
+  ERR_REGION_BEGIN() {
+    for (size_t i = 0; i < files->get_length(files); ++i) {
+      cue_manifest_file_t const* file = files->get(files, i);
+
+      if (has_hash) {
+        ERR_REGION_CMP_CHECK(!line_writer_write_fmt(writer, "%s%llu %llu %016llx %s", prefix,
+          file->size, file->mtime, file->hash, file->path), err);
+      }
+      else {
+        ERR_REGION_CMP_CHECK(!line_writer_write_fmt(writer, "%s%llu %llu %s", prefix,
+          file->size, file->mtime, file->path), err);
+      }
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+  } ERR_REGION_END()
+
+  return err;
+}
+
+static char const* skip_prefix(char const* line, char const* prefix) {
+  size_t len = strlen(prefix);
+  return strncmp(line, prefix, len) == 0 ? line + len : NULL;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "object_vector.h"
+
+struct cue_sheet;
+struct th_mutex;
+
+// one file a conversion read or wrote.  a later run compares these against
+// the file as it is now, to tell whether the conversion needs doing again
+typedef struct cue_manifest_file {
+  char const* path;  // owned, relative to the source or target root
+  unsigned long long size;
+  unsigned long long mtime;
+  unsigned long long hash;  // 0 when the content was never hashed, as with outputs
+} cue_manifest_file_t;
+
+extern struct object_vector_params cue_manifest_file_vector_ops;
+
+typedef struct cue_manifest_file_vector {
+  object_vector_t vector_t;
+  INSERT_OBJECT_VECTOR_METHODS(cue_manifest_file_vector, cue_manifest_file_t)
+} cue_manifest_file_vector_t;
+
+DECLARE_OBJECT_VECTOR(cue_manifest_file_vector, cue_manifest_file_t)
+
+// everything known about a cue that was converted
+typedef struct cue_manifest_entry {
+  char const* cue_path;  // owned, relative to the source root
+  float quality;
+  short keep;  // still current, so written out with the manifest
+  struct cue_manifest_file_vector* sources;  // owned, the cue itself first
+  struct cue_manifest_file_vector* outputs;  // owned, the cue first
+} cue_manifest_entry_t;
+
+extern struct object_vector_params cue_manifest_entry_vector_ops;
+
+typedef struct cue_manifest_entry_vector {
+  object_vector_t vector_t;
+  INSERT_OBJECT_VECTOR_METHODS(cue_manifest_entry_vector, cue_manifest_entry_t)
+} cue_manifest_entry_vector_t;
+
+DECLARE_OBJECT_VECTOR(cue_manifest_entry_vector, cue_manifest_entry_t)
+
+// the conversions already done into a target, kept in a file in the target
+// root, so that a repeat run only converts what changed since
+typedef struct cue_manifest {
+  char const* path;  // owned, where the manifest is kept
+  char const* source_root;  // owned
+  char const* target_root;  // owned
+  short loaded;  // a manifest was found at path
+  struct cue_manifest_entry_vector* entries;  // owned, as loaded, sorted by cue path
+  struct cue_manifest_entry_vector* added;  // owned, recorded during this run
+  struct th_mutex* lock;  // owned, guards added
+} cue_manifest_t;
+
+// where the manifest of a target root is kept.  shards of a conversion each
+// keep their own, as they run at once, as do workers sharing it by claims.
+// the caller frees the path
+char const* cue_manifest_path(char const* target_root, size_t shard, size_t num_shards,
+  char const* worker_opt);
+
+struct cue_manifest* cue_manifest_alloc(char const* path, char const* source_root, char const* target_root);
+errno_t cue_manifest_init(struct cue_manifest* self, char const* path, char const* source_root, char const* target_root);
+void cue_manifest_uninit(struct cue_manifest* self);
+void cue_manifest_free(struct cue_manifest* self);
+
+// a missing manifest isn't an error, it just leaves nothing loaded
+errno_t cue_manifest_load(struct cue_manifest* self);
+// writes out the entries kept or added during this run
+errno_t cue_manifest_save(struct cue_manifest* self);
+// folds the entries added into those loaded, as though the manifest had
+// been saved and loaded again, so that it can serve another run
+errno_t cue_manifest_settle(struct cue_manifest* self);
+
+// the loaded entry for a source cue, if any
+struct cue_manifest_entry* cue_manifest_find(struct cue_manifest const* self, char const* cue_path);
+
+// whether the entry still describes the cue, converted at quality.  checks
+// sizes and times first, and only hashes a source whose time alone changed
+// and that was hashed when recorded
+short cue_manifest_is_current(struct cue_manifest const* self, struct cue_manifest_entry* entry, float quality);
+
+// the loaded record of one source or output of an entry, if any
+struct cue_manifest_file const* cue_manifest_find_source(
+  struct cue_manifest const* self,
+  struct cue_manifest_entry const* entry,
+  char const* path);
+struct cue_manifest_file const* cue_manifest_find_output(
+  struct cue_manifest const* self,
+  struct cue_manifest_entry const* entry,
+  char const* path);
+
+// records the conversion of a cue, for a later run to compare against.
+// hash_cue also hashes the cue sheet.  the files it lists are never read
+// here, as that would read every encoded source a second time: file_hashes,
+// if given, holds the hash_file value of each file of the source sheet that
+// was read whole along the way, or 0 where it wasn't, and the rest are
+// recorded by size and time alone.  a source whose loaded record still
+// matches its size and time keeps the hash it had.  safe to call from
+// several threads at once
+errno_t cue_manifest_add(
+  struct cue_manifest* self,
+  char const* cue_path,
+  char const* target_cue_path,
+  struct cue_sheet const* source_sheet,
+  struct cue_sheet const* target_sheet,
+  float quality,
+  short hash_cue,
+  unsigned long long const* file_hashes);
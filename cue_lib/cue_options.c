@@ -1,12 +1,25 @@
 #include "cue_options.h"
 
+#include <ctype.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "err_helpers.h"
 #include "mem_helpers.h"
+#include "string_vector.h"
+#include "cue_traverse_partial_report.h"
+
+static errno_t parse_count(char const* arg, int* count);
+static short is_worker_name(char const* arg);
+static errno_t parse_copy_strategy(char const* arg, copy_strategy_t* strategy);
 
 static const char k_help_message[] = 
-"[-tQw] [-f filter_path] [-q quality] [-r report_path] source_directory target_directory\n"
+"[-tQw] [-f filter_path] [-q quality] [-r report_path] [-j jobs] [-c copies] [-e encodes] [--shard k/N] [--store store_dir] [--cue-cache cache_file]\n"
+"    [--catalog catalog_file] [--claim worker] [--watch [--settle seconds]] [--copy-strategy how]\n"
+"    [--scan-threads threads]\n"
+"    source_directory target_directory\n"
+"    --merge [-Q] [-r report_path] partial_report...\n"
+"    --query catalog_file [type=T] [status=S] [under=dir]\n"
 "\n"
 "-t - test mode - just examine the cues, don't convert\n"
 "-Q - quiet mode - no console output\n"
@@ -22,6 +35,82 @@ static const char k_help_message[] =
 "-q quality - compression quality - quality should be a number\n"
 "             between -1 (poorest) and 10 (best).  Fractional\n"
 "             values are permitted.  Defaults to 3.\n"
+"-j jobs - parallel jobs - number of cue files to convert at\n"
+"          the same time.  0 uses one job per processor.\n"
+"          Defaults to 1.\n"
+"-c copies - parallel copies - number of files to copy at the\n"
+"            same time, across all cues.  Keep this low for\n"
+"            spinning disks.  Defaults to the number of jobs.\n"
+"-e encodes - parallel encodes - number of files to encode at\n"
+"             the same time, across all cues.  Defaults to the\n"
+"             number of jobs.\n"
+"--shard k/N - shard - convert only the k-th of N shares of the\n"
+"              cues, so that N machines can split a conversion.\n"
+"              Cues are assigned by their path under the source\n"
+"              directory.  The report is written as a partial\n"
+"              report, for --merge.\n"
+"--store store_dir - file store - keep every file made in\n"
+"                    store_dir, by its content and settings,\n"
+"                    and link or copy a file already there\n"
+"                    rather than making it again.  Duplicate\n"
+"                    tracks are then only encoded once.\n"
+"--cue-cache cache_file - cue cache - keep the parsed cues in\n"
+"                         cache_file, and load a cue that\n"
+"                         hasn't changed since from there rather\n"
+"                         than reading it again.  Speeds up test\n"
+"                         runs over slow shares.\n"
+"--catalog catalog_file - catalog - after the run, write an\n"
+"                         index of every cue found, with its\n"
+"                         files, tracks, sizes and status, for\n"
+"                         --query.\n"
+"--claim worker - claim mode - split the cues with any number of\n"
+"                 other conversions of the same target, run on\n"
+"                 this machine or others sharing it, each taking\n"
+"                 the next cue no other has claimed.  worker is\n"
+"                 a name of letters, digits, '-', '_' and '.'\n"
+"                 that differs between the conversions, and that\n"
+"                 a conversion restarted after it stopped should\n"
+"                 reuse.  A claim left by a conversion that\n"
+"                 stopped is taken over after two minutes.\n"
+"--watch - watch mode - after converting, keep watching the\n"
+"          source, and convert the cues of each directory\n"
+"          in which anything is added or changed.  Runs\n"
+"          until stopped.\n"
+"--settle seconds - settle time - in watch mode, how long a\n"
+"                   directory must go without changes before\n"
+"                   its cues are converted, so that discs still\n"
+"                   being copied in are left alone.  Defaults to\n"
+"                   5.\n"
+"--copy-strategy how - copy strategy - how the files\n"
+"                      that need no converting, such as\n"
+"                      data tracks, are copied.  auto\n"
+"                      lets a target on the volume of\n"
+"                      its source share the source's\n"
+"                      blocks where the filesystem can,\n"
+"                      copy writes every byte again, and\n"
+"                      link makes each target another\n"
+"                      name for its source, for mirrors\n"
+"                      that are only read, copying where\n"
+"                      the volumes differ.  Defaults to\n"
+"                      auto.\n"
+"--scan-threads threads - scan threads - number of source\n"
+"                         directories to read at the same\n"
+"                         time while looking for cues, which\n"
+"                         speeds up shares where each read\n"
+"                         waits on the network.  Cues are\n"
+"                         then found in no set order, so the\n"
+"                         report lists them by path.  0 uses\n"
+"                         one thread per processor.  Defaults\n"
+"                         to 1.\n"
+"--merge - merge mode - combine the partial reports of every\n"
+"          shard into the usual report, rather than converting.\n"
+"--query catalog_file - query mode - list the cues of a catalog\n"
+"                       and total their files, bytes and audio,\n"
+"                       without reading the collection.  type=T\n"
+"                       picks cues with a file of type T, such as\n"
+"                       WAV, status=S those a run transformed,\n"
+"                       failed or skipped, and under=dir those in\n"
+"                       a directory of the source.\n"
 "source_directory - location to start the conversion traversal\n"
 "target_directory - location to replicate the source directory\n"
 "                   structure, copying and converting as needed.\n"
@@ -52,6 +141,12 @@ void cue_options_uninit(struct cue_options* self) {
   SAFE_FREE(self->target_dir);
   SAFE_FREE(self->report_path);
   SAFE_FREE(self->filter_path);
+  SAFE_FREE(self->store_path);
+  SAFE_FREE(self->cue_cache_path);
+  SAFE_FREE(self->catalog_path);
+  SAFE_FREE(self->claim_owner);
+  SAFE_FREE_HANDLER(self->partial_paths, string_vector_free);
+  SAFE_FREE_HANDLER(self->query_terms, string_vector_free);
 }
 
 void cue_options_free(struct cue_options* self) {
@@ -63,16 +158,37 @@ errno_t cue_options_load_from_args(struct cue_options* self, int argc, char cons
   errno_t err = 0;
   char const* report_path = 0;
   char const* filter_path = 0;
+  char const* store_path = 0;
+  char const* cue_cache_path = 0;
+  char const* catalog_path = 0;
+  char const* claim_owner = 0;
   char const* src_dir = 0;
   char const* trg_dir = 0;
   char const* report_path_dup = 0;
   char const* filter_path_dup = 0;
+  char const* store_path_dup = 0;
+  char const* cue_cache_path_dup = 0;
+  char const* catalog_path_dup = 0;
+  char const* claim_owner_dup = 0;
   char const* src_dir_dup = 0;
   char const* trg_dir_dup = 0;
   short quiet = 0;
   short test_only = 0;
   short overwrite = 0;
   float quality = 3;
+  int jobs = 1;
+  int copy_jobs = 0;
+  int encode_jobs = 0;
+  size_t shard = 0;
+  size_t num_shards = 0;
+  short merge = 0;
+  string_vector_t* partial_paths = 0;
+  short query = 0;
+  string_vector_t* query_terms = 0;
+  short watch = 0;
+  int settle_seconds = -1;
+  copy_strategy_t copy_strategy = EWC_CS_AUTO;
+  int scan_threads = 1;
 
   // -Q -r <report.file> <src_dir> <trg_dir>
 
@@ -91,6 +207,91 @@ errno_t cue_options_load_from_args(struct cue_options* self, int argc, char cons
       // must be a short option
       ERR_REGION_CMP_CHECK((!*(arg + 1)), err);
 
+      // or a whole word long option
+      if (*(arg + 1) == '-') {
+        if (strcmp(arg, "--shard") == 0) {
+          if (i > argc - 2) {
+            err = -1;
+          }
+          else {
+            err = cue_traverse_partial_report_parse_shard(argv[++i], &shard, &num_shards);
+          }
+        }
+        else if (strcmp(arg, "--store") == 0) {
+          if (i > argc - 2) {
+            err = -1;
+          }
+          else {
+            store_path = argv[++i];
+          }
+        }
+        else if (strcmp(arg, "--cue-cache") == 0) {
+          if (i > argc - 2) {
+            err = -1;
+          }
+          else {
+            cue_cache_path = argv[++i];
+          }
+        }
+        else if (strcmp(arg, "--catalog") == 0 || strcmp(arg, "--query") == 0) {
+          // a query reads the catalog a run wrote, so names it the same way
+          if (i > argc - 2 || catalog_path) {
+            err = -1;
+          }
+          else {
+            query = strcmp(arg, "--query") == 0;
+            catalog_path = argv[++i];
+          }
+        }
+        else if (strcmp(arg, "--claim") == 0) {
+          // the name is part of the names of files in the target
+          if (i > argc - 2 || !is_worker_name(argv[i + 1])) {
+            err = -1;
+          }
+          else {
+            claim_owner = argv[++i];
+          }
+        }
+        else if (strcmp(arg, "--watch") == 0) {
+          watch = 1;
+        }
+        else if (strcmp(arg, "--settle") == 0) {
+          if (i > argc - 2) {
+            err = -1;
+          }
+          else {
+            err = parse_count(argv[++i], &settle_seconds);
+          }
+        }
+        else if (strcmp(arg, "--copy-strategy") == 0) {
+          if (i > argc - 2) {
+            err = -1;
+          }
+          else {
+            err = parse_copy_strategy(argv[++i], &copy_strategy);
+          }
+        }
+        else if (strcmp(arg, "--scan-threads") == 0) {
+          if (i > argc - 2) {
+            err = -1;
+          }
+          else {
+            err = parse_count(argv[++i], &scan_threads);
+          }
+        }
+        else if (strcmp(arg, "--merge") == 0) {
+          merge = 1;
+        }
+        else {
+          // unknown
+          err = -1;
+        }
+
+        ERR_REGION_ERROR_BUBBLE(err);
+
+        continue;
+      }
+
       // check (possibly clumped) single letter options
       short done = 0;
       short still_looking = 0;
@@ -167,6 +368,33 @@ errno_t cue_options_load_from_args(struct cue_options* self, int argc, char cons
           }
         break;
 
+        case 'j':
+          if (i > argc - 2) {
+            err = -1;
+          }
+          else {
+            err = parse_count(argv[++i], &jobs);
+          }
+        break;
+
+        case 'c':
+          if (i > argc - 2) {
+            err = -1;
+          }
+          else {
+            err = parse_count(argv[++i], &copy_jobs);
+          }
+        break;
+
+        case 'e':
+          if (i > argc - 2) {
+            err = -1;
+          }
+          else {
+            err = parse_count(argv[++i], &encode_jobs);
+          }
+        break;
+
         default:
         // unknown
         err = -1;
@@ -177,36 +405,115 @@ errno_t cue_options_load_from_args(struct cue_options* self, int argc, char cons
 
     } ERR_REGION_ERROR_BUBBLE(err);
 
-    // must still be two options, the src and the trg
-    ERR_REGION_CMP_CHECK(i > argc-2, err);
+    // only a watch waits for things to settle
+    ERR_REGION_CMP_CHECK(settle_seconds >= 0 && !watch, err);
+    if (settle_seconds < 0) settle_seconds = 5;
+
+    if (query) {
+      // a query only reads the catalog
+      ERR_REGION_CMP_CHECK(merge, err);
+      ERR_REGION_CMP_CHECK(num_shards, err);
+      ERR_REGION_CMP_CHECK(store_path, err);
+      ERR_REGION_CMP_CHECK(cue_cache_path, err);
+      ERR_REGION_CMP_CHECK(claim_owner, err);
+      ERR_REGION_CMP_CHECK(watch, err);
+      ERR_REGION_CMP_CHECK(copy_strategy != EWC_CS_AUTO, err);
+      ERR_REGION_CMP_CHECK(scan_threads != 1, err);
+
+      // the rest are the terms, if any
+      ERR_REGION_NULL_CHECK(query_terms = string_vector_alloc(), err);
+      for (; i < argc; ++i) {
+        ERR_REGION_NULL_CHECK(query_terms->push(query_terms, argv[i]), err);
+      } ERR_REGION_ERROR_BUBBLE(err);
+    }
+    else if (merge) {
+      // a merge doesn't convert, so it can't be a shard of one, use a
+      // store, or read any cues
+      ERR_REGION_CMP_CHECK(num_shards, err);
+      ERR_REGION_CMP_CHECK(store_path, err);
+      ERR_REGION_CMP_CHECK(cue_cache_path, err);
+      ERR_REGION_CMP_CHECK(catalog_path, err);
+      ERR_REGION_CMP_CHECK(claim_owner, err);
+      ERR_REGION_CMP_CHECK(watch, err);
+      ERR_REGION_CMP_CHECK(copy_strategy != EWC_CS_AUTO, err);
+      ERR_REGION_CMP_CHECK(scan_threads != 1, err);
+
+      // the rest are the partial reports, at least one of them
+      ERR_REGION_CMP_CHECK(i > argc - 1, err);
+
+      ERR_REGION_NULL_CHECK(partial_paths = string_vector_alloc(), err);
+      for (; i < argc; ++i) {
+        ERR_REGION_NULL_CHECK(partial_paths->push(partial_paths, argv[i]), err);
+      } ERR_REGION_ERROR_BUBBLE(err);
+    }
+    else {
+      // shards split the cues up front, and claims as they go, so only
+      // one of them is used.  a test run converts nothing to claim
+      ERR_REGION_CMP_CHECK(claim_owner && (num_shards || test_only), err);
+
+      // shards merge their reports in the order every one of them found
+      // the cues in, which only a single thread keeps to
+      ERR_REGION_CMP_CHECK(num_shards && scan_threads != 1, err);
+
+      // must still be two options, the src and the trg
+      ERR_REGION_CMP_CHECK(i > argc-2, err);
+
+      src_dir = argv[i++];
+      trg_dir = argv[i++];
 
-    src_dir = argv[i++];
-    trg_dir = argv[i++];
+      // make sure we used all the options
+      ERR_REGION_CMP_CHECK(i != argc, err);
 
-    // make sure we used all the options
-    ERR_REGION_CMP_CHECK(i != argc, err);
+      // allocate the string copies to use in the options
+      ERR_REGION_NULL_CHECK(src_dir_dup = _strdup(src_dir), err);
+      ERR_REGION_NULL_CHECK(trg_dir_dup = _strdup(trg_dir), err);
+    }
 
-    // allocate the string copies to use in the options
-    ERR_REGION_NULL_CHECK(src_dir_dup = _strdup(src_dir), err);
-    ERR_REGION_NULL_CHECK(trg_dir_dup = _strdup(trg_dir), err);
     if (report_path) ERR_REGION_NULL_CHECK(report_path_dup = _strdup(report_path), err);
     if (filter_path) ERR_REGION_NULL_CHECK(filter_path_dup = _strdup(filter_path), err);
+    if (store_path) ERR_REGION_NULL_CHECK(store_path_dup = _strdup(store_path), err);
+    if (cue_cache_path) ERR_REGION_NULL_CHECK(cue_cache_path_dup = _strdup(cue_cache_path), err);
+    if (catalog_path) ERR_REGION_NULL_CHECK(catalog_path_dup = _strdup(catalog_path), err);
+    if (claim_owner) ERR_REGION_NULL_CHECK(claim_owner_dup = _strdup(claim_owner), err);
 
     // everything we need is allocated, so release existing resources and update
     SAFE_FREE(self->source_dir);
     SAFE_FREE(self->target_dir);
     SAFE_FREE(self->report_path);
     SAFE_FREE(self->filter_path);
+    SAFE_FREE(self->store_path);
+    SAFE_FREE(self->cue_cache_path);
+    SAFE_FREE(self->catalog_path);
+    SAFE_FREE(self->claim_owner);
+    SAFE_FREE_HANDLER(self->partial_paths, string_vector_free);
+    SAFE_FREE_HANDLER(self->query_terms, string_vector_free);
 
     self->source_dir = src_dir_dup;
     self->target_dir = trg_dir_dup;
     self->report_path = report_path_dup;
     self->filter_path = filter_path_dup;
+    self->store_path = store_path_dup;
+    self->cue_cache_path = cue_cache_path_dup;
+    self->catalog_path = catalog_path_dup;
+    self->claim_owner = claim_owner_dup;
     self->generate_report = (report_path != 0);
     self->quiet = quiet;
     self->test_only = test_only;
     self->overwrite = overwrite;
     self->quality = quality;
+    self->jobs = jobs;
+    self->copy_jobs = copy_jobs;
+    self->encode_jobs = encode_jobs;
+    self->shard = shard;
+    self->num_shards = num_shards;
+    self->merge = merge;
+    self->partial_paths = partial_paths;
+    self->query = query;
+    self->query_terms = query_terms;
+    self->watch = watch;
+    self->settle_seconds = settle_seconds;
+    self->copy_strategy = copy_strategy;
+    self->scan_threads = scan_threads;
 
     return err;
 
@@ -216,10 +523,56 @@ errno_t cue_options_load_from_args(struct cue_options* self, int argc, char cons
   SAFE_FREE(trg_dir_dup);
   SAFE_FREE(report_path_dup);
   SAFE_FREE(filter_path_dup);
+  SAFE_FREE(store_path_dup);
+  SAFE_FREE(cue_cache_path_dup);
+  SAFE_FREE(catalog_path_dup);
+  SAFE_FREE(claim_owner_dup);
+  SAFE_FREE_HANDLER(partial_paths, string_vector_free);
+  SAFE_FREE_HANDLER(query_terms, string_vector_free);
 
   return err;
 }
 
+static errno_t parse_count(char const* arg, int* count) {
+  char* end = 0;
+  long l = strtol(arg, &end, 10);
+
+  if (end == arg || *end || l < 0) return -1;
+
+  *count = (int)l;
+  return 0;
+}
+
 char const* cue_options_get_help(void) {
   return k_help_message;
 }
+
+static errno_t parse_copy_strategy(char const* arg, copy_strategy_t* strategy) {
+  if (strcmp(arg, "auto") == 0) {
+    *strategy = EWC_CS_AUTO;
+  }
+  else if (strcmp(arg, "copy") == 0) {
+    *strategy = EWC_CS_COPY;
+  }
+  else if (strcmp(arg, "link") == 0) {
+    *strategy = EWC_CS_LINK;
+  }
+  else {
+    return -1;
+  }
+
+  return 0;
+}
+
+// at most 64 of the characters safe in a file name anywhere
+static short is_worker_name(char const* arg) {
+  size_t length = strlen(arg);
+
+  if (!length || length > 64 || *arg == '.') return 0;
+
+  for (char const* c = arg; *c; ++c) {
+    if (!isalnum((unsigned char)*c) && !strchr("-_.", *c)) return 0;
+  }
+
+  return 1;
+}
@@ -2,16 +2,37 @@
 
 #include <stddef.h>
 
+#include "filesystem.h"
+
+struct string_vector;
+
 typedef struct cue_options {
   char const *source_dir;
   char const *target_dir;
   char const* report_path;
   char const* filter_path;
+  char const* store_path;  // NULL makes every file without a store
+  char const* cue_cache_path;  // NULL parses every cue
+  char const* catalog_path;  // written after the run, or read by a query, NULL for neither
+  char const* claim_owner;  // names this conversion in the claims it shares the cues by, NULL claims none
   short generate_report;
   short quiet;
   short test_only;
   short overwrite;
   float quality;
+  int jobs;
+  int copy_jobs;  // 0 uses the job count
+  int encode_jobs;  // 0 uses the job count
+  size_t shard;  // 1 based share of the cues to convert, when num_shards is set
+  size_t num_shards;  // 0 converts every cue
+  short merge;  // combine partial reports rather than converting
+  struct string_vector* partial_paths;  // owned, the reports to merge
+  short query;  // answer from the catalog rather than converting
+  struct string_vector* query_terms;  // owned, what the query picks
+  short watch;  // after converting, keep converting what changes in the source
+  int settle_seconds;  // how long a watched directory must go unchanged before it is converted
+  copy_strategy_t copy_strategy;  // how files that need no converting are copied to the target
+  int scan_threads;  // source directories read at once, 0 uses one per processor
 } cue_options_t;
 
 struct cue_options* cue_options_alloc();
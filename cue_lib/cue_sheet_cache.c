@@ -0,0 +1,530 @@
+#include "cue_sheet_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "err_helpers.h"
+#include "mem_helpers.h"
+#include "cue_file.h"
+#include "cue_parser.h"
+#include "filesystem.h"
+#include "path.h"
+#include "thread_helpers.h"
+#include "hash_helpers.h"
+
+// writes values out in a fixed little endian layout, hashing as it goes
+typedef struct cache_writer {
+  FILE* file;
+  hash_state_t hash;
+  short failed;
+} cache_writer_t;
+
+// reads values back from a cache held whole in memory
+typedef struct cache_reader {
+  unsigned char const* at;
+  unsigned char const* end;
+  short failed;
+} cache_reader_t;
+
+static void* acquire(void const* instance);
+static void entry_release(void* instance);
+static int compare_entries(void const* lhs, void const* rhs);
+static void sort_entries(cue_sheet_cache_entry_vector_t* entries);
+static cue_sheet_cache_entry_t* find_entry(cue_sheet_cache_entry_vector_t const* entries, char const* cue_path);
+static errno_t read_entries(struct cue_sheet_cache* self, unsigned char const* bytes, size_t length);
+static cue_sheet_cache_entry_t* read_entry(cache_reader_t* reader);
+static cue_sheet_t* read_sheet(cache_reader_t* reader);
+static void write_entry(cache_writer_t* writer, cue_sheet_cache_entry_t const* entry);
+static void write_sheet(cache_writer_t* writer, cue_sheet_t const* sheet);
+static void write_bytes(cache_writer_t* writer, void const* bytes, size_t length);
+static void write_uint(cache_writer_t* writer, unsigned long long value, size_t size);
+static void write_str(cache_writer_t* writer, char const* str);
+static void write_time(cache_writer_t* writer, cue_time_t const* time);
+static unsigned char const* read_bytes(cache_reader_t* reader, size_t length);
+static unsigned long long read_uint(cache_reader_t* reader, size_t size);
+static void read_time(cache_reader_t* reader, cue_time_t* time);
+
+// changes whenever the layout does, so an old cache is just dropped
+static const char s_magic[] = "CUESHEETCACHE01";
+
+// the files of a sheet, their tracks and indexes are all counted in shorts
+#define COUNT_SIZE 2
+
+struct object_vector_params cue_sheet_cache_entry_vector_ops = {
+  acquire,
+  entry_release,
+};
+
+static void* acquire(void const* instance) {
+  return (void*)instance;
+}
+
+static void entry_release(void* instance) {
+  cue_sheet_cache_entry_t* entry = (cue_sheet_cache_entry_t*)instance;
+  SAFE_FREE(entry->cue_path);
+  SAFE_FREE_HANDLER(entry->sheet, cue_sheet_free);
+  SAFE_FREE(entry);
+}
+
+IMPLEMENT_OBJECT_VECTOR(cue_sheet_cache_entry_vector, cue_sheet_cache_entry_t)
+
+struct cue_sheet_cache* cue_sheet_cache_alloc(char const* path) {
+  cue_sheet_cache_t* self = malloc(sizeof(*self));
+  if (!self) return NULL;
+
+  errno_t err = cue_sheet_cache_init(self, path);
+  if (!err) return self;
+
+  SAFE_FREE(self);
+  return NULL;
+}
+
+errno_t cue_sheet_cache_init(struct cue_sheet_cache* self, char const* path) {
+  errno_t err = 0;
+
+  memset(self, 0, sizeof(*self));
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(self->path = _strdup(path), err);
+    ERR_REGION_NULL_CHECK(self->entries = cue_sheet_cache_entry_vector_alloc(), err);
+    ERR_REGION_NULL_CHECK(self->added = cue_sheet_cache_entry_vector_alloc(), err);
+    ERR_REGION_NULL_CHECK(self->lock = th_mutex_alloc(), err);
+
+    return err;
+
+  } ERR_REGION_END()
+
+  cue_sheet_cache_uninit(self);
+
+  return err;
+}
+
+void cue_sheet_cache_uninit(struct cue_sheet_cache* self) {
+  SAFE_FREE_HANDLER(self->lock, th_mutex_free);
+  SAFE_FREE_HANDLER(self->added, cue_sheet_cache_entry_vector_free);
+  SAFE_FREE_HANDLER(self->entries, cue_sheet_cache_entry_vector_free);
+  SAFE_FREE(self->path);
+}
+
+void cue_sheet_cache_free(struct cue_sheet_cache* self) {
+  cue_sheet_cache_uninit(self);
+  SAFE_FREE(self);
+}
+
+errno_t cue_sheet_cache_load(struct cue_sheet_cache* self) {
+  errno_t err = 0;
+  FILE* file = 0;
+  unsigned char* bytes = 0;
+  unsigned long long size = 0;
+
+  ERR_REGION_BEGIN() {
+    if (!file_exists(self->path)) return err;
+
+    // the whole cache in one read, which is the point of having it
+    ERR_REGION_ERROR_CHECK(file_size(self->path, &size), err);
+    ERR_REGION_CMP_CHECK(size > (size_t)-1, err);
+    ERR_REGION_NULL_CHECK(bytes = malloc(size ? (size_t)size : 1), err);
+
+    fopen_s(&file, self->path, "rb");
+    ERR_REGION_NULL_CHECK(file, err);
+    ERR_REGION_CMP_CHECK(fread(bytes, 1, (size_t)size, file) != size, err);
+
+    err = read_entries(self, bytes, (size_t)size);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE_HANDLER(file, fclose);
+  SAFE_FREE(bytes);
+
+  if (err) {
+    // a damaged cache is dropped rather than trusted, so every cue is
+    // just parsed again
+    cue_sheet_cache_entry_vector_t* entries = self->entries;
+    while (entries->get_length(entries)) {
+      entries->pop(entries);
+    }
+
+    self->loaded = 0;
+    return 0;
+  }
+
+  sort_entries(self->entries);
+  self->loaded = 1;
+
+  return err;
+}
+
+errno_t cue_sheet_cache_save(struct cue_sheet_cache* self) {
+  errno_t err = 0;
+  cache_writer_t writer;
+  cue_sheet_cache_entry_vector_t* entries = self->entries;
+  cue_sheet_cache_entry_vector_t* added = self->added;
+  unsigned long long count = added->get_length(added);
+  unsigned long long digest = 0;
+  char const* dir = 0;
+  char const* part_path = 0;
+
+  memset(&writer, 0, sizeof(writer));
+  hash_state_init(&writer.hash, 0);
+
+  for (size_t i = 0; i < entries->get_length(entries); ++i) {
+    if (entries->get(entries, i)->keep) ++count;
+  }
+
+  // a run that found every cue as it was loaded has nothing new to keep
+  if (self->loaded && !added->get_length(added) && count == entries->get_length(entries)) {
+    return err;
+  }
+
+  ERR_REGION_BEGIN() {
+    // a bare file name is in the current directory, which is already there
+    if (strstr(self->path, k_path_separator)) {
+      ERR_REGION_NULL_CHECK(dir = path_dir_part(self->path), err);
+      ERR_REGION_ERROR_CHECK(ensure_dir(dir), err);
+    }
+
+    // written aside, so a save that doesn't finish leaves the old cache
+    ERR_REGION_NULL_CHECK(part_path = path_part_file(self->path), err);
+    fopen_s(&writer.file, part_path, "wb");
+    ERR_REGION_NULL_CHECK(writer.file, err);
+
+    write_bytes(&writer, s_magic, sizeof(s_magic));
+    write_uint(&writer, count, 4);
+
+    // a cue is only parsed again when it changed, so the two never overlap
+    for (size_t i = 0; i < entries->get_length(entries); ++i) {
+      cue_sheet_cache_entry_t const* entry = entries->get(entries, i);
+      if (entry->keep) write_entry(&writer, entry);
+    }
+
+    for (size_t i = 0; i < added->get_length(added); ++i) {
+      write_entry(&writer, added->get(added, i));
+    }
+
+    // lets the load tell a whole cache from a damaged one
+    digest = hash_state_digest(&writer.hash);
+    write_uint(&writer, digest, 8);
+
+    ERR_REGION_CMP_CHECK(writer.failed, err);
+
+    ERR_REGION_CMP_CHECK(fclose(writer.file), err);
+    writer.file = 0;
+    ERR_REGION_ERROR_CHECK(replace_file(part_path, self->path), err);
+
+  } ERR_REGION_END()
+
+  if (writer.file) fclose(writer.file);
+  if (err && part_path) delete_file(part_path);
+  SAFE_FREE(part_path);
+  SAFE_FREE(dir);
+
+  return err;
+}
+
+struct cue_sheet* cue_sheet_cache_parse_filename(
+  struct cue_sheet_cache* self,
+  char const* filename,
+  struct cue_sheet_process_result* result_opt) {
+
+  errno_t err = 0;
+  unsigned long long size = 0, mtime = 0;
+  cue_sheet_cache_entry_t* loaded = 0;
+  cue_sheet_cache_entry_t* entry = 0;
+  cue_sheet_t* sheet = 0;
+
+  // a file that can't be looked at can't be checked against the cache
+  if (file_size(filename, &size) || file_mtime(filename, &mtime)) {
+    return cue_sheet_parse_filename(filename, result_opt);
+  }
+
+  // the loaded entries don't change during the run, so need no lock
+  loaded = find_entry(self->entries, filename);
+  if (loaded && loaded->size == size && loaded->mtime == mtime) {
+    sheet = cue_sheet_alloc_copy(loaded->sheet);
+    if (sheet) {
+      loaded->keep = 1;
+
+      th_mutex_lock(self->lock);
+      ++self->hits;
+      th_mutex_unlock(self->lock);
+
+      return sheet;
+    }
+  }
+
+  sheet = cue_sheet_parse_filename(filename, result_opt);
+  if (!sheet) return sheet;
+
+  // a sheet that couldn't be kept is just parsed again next time
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(entry = calloc(1, sizeof(*entry)), err);
+    ERR_REGION_NULL_CHECK(entry->cue_path = _strdup(filename), err);
+    ERR_REGION_NULL_CHECK(entry->sheet = cue_sheet_alloc_copy(sheet), err);
+    entry->size = size;
+    entry->mtime = mtime;
+    entry->keep = 1;
+
+    th_mutex_lock(self->lock);
+    if (!self->added->push(self->added, entry)) err = -1;
+    th_mutex_unlock(self->lock);
+
+    ERR_REGION_ERROR_BUBBLE(err);
+    entry = 0;
+
+  } ERR_REGION_END()
+
+  SAFE_FREE_HANDLER(entry, entry_release);
+
+  return sheet;
+}
+
+static int compare_entries(void const* lhs, void const* rhs) {
+  cue_sheet_cache_entry_t const* a = *(cue_sheet_cache_entry_t const* const*)lhs;
+  cue_sheet_cache_entry_t const* b = *(cue_sheet_cache_entry_t const* const*)rhs;
+
+  return strcmp(a->cue_path, b->cue_path);
+}
+
+static void sort_entries(cue_sheet_cache_entry_vector_t* entries) {
+  size_t length = entries->get_length(entries);
+  if (length < 2) return;
+
+  qsort((void*)entries->get_buffer(entries), length, sizeof(cue_sheet_cache_entry_t*), compare_entries);
+}
+
+static cue_sheet_cache_entry_t* find_entry(cue_sheet_cache_entry_vector_t const* entries, char const* cue_path) {
+  cue_sheet_cache_entry_t key = { 0 };
+  cue_sheet_cache_entry_t const* key_ptr = &key;
+  cue_sheet_cache_entry_t const** found = 0;
+  size_t length = entries->get_length(entries);
+
+  if (!length) return NULL;
+
+  key.cue_path = cue_path;
+  found = bsearch(&key_ptr, entries->get_buffer(entries), length, sizeof(cue_sheet_cache_entry_t*), compare_entries);
+
+  return found ? (cue_sheet_cache_entry_t*)*found : NULL;
+}
+
+static errno_t read_entries(struct cue_sheet_cache* self, unsigned char const* bytes, size_t length) {
+  errno_t err = 0;
+  cache_reader_t reader;
+  cue_sheet_cache_entry_t* entry = 0;
+  unsigned long long count = 0;
+
+  ERR_REGION_BEGIN() {
+    // everything but the digest at the end must hash to it
+    ERR_REGION_CMP_CHECK(length < sizeof(s_magic) + 4 + 8, err);
+    reader.at = bytes + length - 8;
+    reader.end = bytes + length;
+    reader.failed = 0;
+    ERR_REGION_CMP_CHECK(read_uint(&reader, 8) != hash_bytes(0, bytes, length - 8), err);
+
+    reader.at = bytes;
+    reader.end = bytes + length - 8;
+
+    ERR_REGION_CMP_CHECK(memcmp(read_bytes(&reader, sizeof(s_magic)), s_magic, sizeof(s_magic)), err);
+    count = read_uint(&reader, 4);
+
+    for (unsigned long long i = 0; i < count; ++i) {
+      ERR_REGION_NULL_CHECK(entry = read_entry(&reader), err);
+      ERR_REGION_NULL_CHECK(self->entries->push(self->entries, entry), err);
+      entry = 0;
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    // nothing may follow the last entry
+    ERR_REGION_CMP_CHECK(reader.failed || reader.at != reader.end, err);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE_HANDLER(entry, entry_release);
+
+  return err;
+}
+
+static cue_sheet_cache_entry_t* read_entry(cache_reader_t* reader) {
+  errno_t err = 0;
+  cue_sheet_cache_entry_t* entry = calloc(1, sizeof(*entry));
+  if (!entry) return NULL;
+
+  ERR_REGION_BEGIN() {
+    size_t path_len = (size_t)read_uint(reader, 4);
+    unsigned char const* path = read_bytes(reader, path_len);
+    ERR_REGION_CMP_CHECK(reader->failed, err);
+
+    ERR_REGION_NULL_CHECK(entry->cue_path = malloc(path_len + 1), err);
+    memcpy((char*)entry->cue_path, path, path_len);
+    ((char*)entry->cue_path)[path_len] = 0;
+
+    entry->size = read_uint(reader, 8);
+    entry->mtime = read_uint(reader, 8);
+    ERR_REGION_NULL_CHECK(entry->sheet = read_sheet(reader), err);
+
+  } ERR_REGION_END()
+
+  if (err) SAFE_FREE_HANDLER(entry, entry_release);
+
+  return entry;
+}
+
+static cue_sheet_t* read_sheet(cache_reader_t* reader) {
+  errno_t err = 0;
+  cue_sheet_t* sheet = cue_sheet_alloc();
+  if (!sheet) return NULL;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(sheet->file, err);
+
+    short num_files = (short)read_uint(reader, COUNT_SIZE);
+    for (short i = 0; i < num_files; ++i) {
+      cue_file_t* file = 0;
+      ERR_REGION_NULL_CHECK(file = cue_sheet_new_file(sheet), err);
+
+      size_t name_len = (size_t)read_uint(reader, 4);
+      char const* name = (char const*)read_bytes(reader, name_len);
+      ERR_REGION_CMP_CHECK(reader->failed, err);
+      cue_file_set_filename_range(file, name, name + name_len);
+
+      file->type = (cue_file_type_t)read_uint(reader, 1);
+      ERR_REGION_CMP_CHECK(file->type >= EWC_CFT_LAST, err);
+
+      short num_tracks = (short)read_uint(reader, COUNT_SIZE);
+      for (short j = 0; j < num_tracks; ++j) {
+        cue_track_t* track = 0;
+        ERR_REGION_NULL_CHECK(track = cue_file_new_track(file), err);
+
+        track->track = (short)read_uint(reader, 2);
+        track->mode = (cue_track_mode_t)read_uint(reader, 1);
+        ERR_REGION_CMP_CHECK(track->mode >= EWC_CTM_LAST, err);
+        read_time(reader, &track->pregap);
+
+        short num_indexes = (short)read_uint(reader, COUNT_SIZE);
+        for (short k = 0; k < num_indexes; ++k) {
+          cue_index_t* index = 0;
+          ERR_REGION_NULL_CHECK(index = cue_track_new_index(track), err);
+
+          index->index = (short)read_uint(reader, 2);
+          read_time(reader, &index->timestamp);
+        } ERR_REGION_ERROR_BUBBLE(err);
+
+        // a count that runs off the end reads as zeros, so stop there
+        ERR_REGION_CMP_CHECK(reader->failed, err);
+      } ERR_REGION_ERROR_BUBBLE(err);
+
+      ERR_REGION_CMP_CHECK(reader->failed, err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    ERR_REGION_CMP_CHECK(reader->failed, err);
+
+    return sheet;
+
+  } ERR_REGION_END()
+
+  cue_sheet_free(sheet);
+
+  return NULL;
+}
+
+static void write_entry(cache_writer_t* writer, cue_sheet_cache_entry_t const* entry) {
+  write_str(writer, entry->cue_path);
+  write_uint(writer, entry->size, 8);
+  write_uint(writer, entry->mtime, 8);
+  write_sheet(writer, entry->sheet);
+}
+
+static void write_sheet(cache_writer_t* writer, cue_sheet_t const* sheet) {
+  write_uint(writer, (unsigned short)sheet->num_files, COUNT_SIZE);
+
+  for (short i = 0; i < sheet->num_files; ++i) {
+    cue_file_t const* file = sheet->file[i];
+
+    write_str(writer, file->filename);
+    write_uint(writer, file->type, 1);
+    write_uint(writer, (unsigned short)file->num_tracks, COUNT_SIZE);
+
+    for (short j = 0; j < file->num_tracks; ++j) {
+      cue_track_t const* track = file->track[j];
+
+      write_uint(writer, (unsigned short)track->track, 2);
+      write_uint(writer, track->mode, 1);
+      write_time(writer, &track->pregap);
+      write_uint(writer, (unsigned short)track->num_indexes, COUNT_SIZE);
+
+      for (short k = 0; k < track->num_indexes; ++k) {
+        cue_index_t const* index = &track->index[k];
+
+        write_uint(writer, (unsigned short)index->index, 2);
+        write_time(writer, &index->timestamp);
+      }
+    }
+  }
+}
+
+static void write_bytes(cache_writer_t* writer, void const* bytes, size_t length) {
+  if (writer->failed) return;
+
+  if (fwrite(bytes, 1, length, writer->file) != length) {
+    writer->failed = 1;
+    return;
+  }
+
+  hash_state_update(&writer->hash, bytes, length);
+}
+
+static void write_uint(cache_writer_t* writer, unsigned long long value, size_t size) {
+  unsigned char bytes[8];
+
+  for (size_t i = 0; i < size; ++i) {
+    bytes[i] = (unsigned char)(value >> (8 * i));
+  }
+
+  write_bytes(writer, bytes, size);
+}
+
+static void write_str(cache_writer_t* writer, char const* str) {
+  size_t length = strlen(str);
+
+  write_uint(writer, length, 4);
+  write_bytes(writer, str, length);
+}
+
+static void write_time(cache_writer_t* writer, cue_time_t const* time) {
+  write_uint(writer, (unsigned short)time->minutes, 2);
+  write_uint(writer, (unsigned short)time->seconds, 2);
+  write_uint(writer, (unsigned short)time->frames, 2);
+}
+
+// past the end, the reader fails and every read after gives zeros
+static unsigned char const* read_bytes(cache_reader_t* reader, size_t length) {
+  static const unsigned char s_zeros[sizeof(s_magic)] = { 0 };
+  unsigned char const* bytes = reader->at;
+
+  if (reader->failed || (size_t)(reader->end - reader->at) < length) {
+    reader->failed = 1;
+    return s_zeros;
+  }
+
+  reader->at += length;
+
+  return bytes;
+}
+
+static unsigned long long read_uint(cache_reader_t* reader, size_t size) {
+  unsigned char const* bytes = read_bytes(reader, size);
+  unsigned long long value = 0;
+
+  if (reader->failed) return 0;
+
+  for (size_t i = size; i > 0; --i) {
+    value = (value << 8) | bytes[i - 1];
+  }
+
+  return value;
+}
+
+static void read_time(cache_reader_t* reader, cue_time_t* time) {
+  time->minutes = (short)read_uint(reader, 2);
+  time->seconds = (short)read_uint(reader, 2);
+  time->frames = (short)read_uint(reader, 2);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "object_vector.h"
+
+struct cue_sheet;
+struct cue_sheet_process_result;
+struct th_mutex;
+
+// a cue sheet as it was parsed, along with what its file looked like then
+typedef struct cue_sheet_cache_entry {
+  char const* cue_path;  // owned, as it was given to be parsed
+  unsigned long long size;
+  unsigned long long mtime;
+  short keep;  // used during this run, so written out with the cache
+  struct cue_sheet* sheet;  // owned
+} cue_sheet_cache_entry_t;
+
+extern struct object_vector_params cue_sheet_cache_entry_vector_ops;
+
+typedef struct cue_sheet_cache_entry_vector {
+  object_vector_t vector_t;
+  INSERT_OBJECT_VECTOR_METHODS(cue_sheet_cache_entry_vector, cue_sheet_cache_entry_t)
+} cue_sheet_cache_entry_vector_t;
+
+DECLARE_OBJECT_VECTOR(cue_sheet_cache_entry_vector, cue_sheet_cache_entry_t)
+
+// parsed cue sheets, kept in a binary file between runs.  a cue whose size
+// and time still match is loaded from the cache rather than opened again,
+// so a run over an unchanged collection reads one file instead of every cue
+typedef struct cue_sheet_cache {
+  char const* path;  // owned, where the cache is kept
+  short loaded;  // a usable cache was found at path
+  struct cue_sheet_cache_entry_vector* entries;  // owned, as loaded, sorted by cue path
+  struct cue_sheet_cache_entry_vector* added;  // owned, parsed during this run
+  struct th_mutex* lock;  // owned, guards added and hits
+  size_t hits;  // cues this run took from the cache
+} cue_sheet_cache_t;
+
+struct cue_sheet_cache* cue_sheet_cache_alloc(char const* path);
+errno_t cue_sheet_cache_init(struct cue_sheet_cache* self, char const* path);
+void cue_sheet_cache_uninit(struct cue_sheet_cache* self);
+void cue_sheet_cache_free(struct cue_sheet_cache* self);
+
+// a missing or damaged cache isn't an error, it just leaves nothing loaded
+errno_t cue_sheet_cache_load(struct cue_sheet_cache* self);
+// writes out the entries used or added during this run, unless that is
+// just what was loaded
+errno_t cue_sheet_cache_save(struct cue_sheet_cache* self);
+
+// as cue_sheet_parse_filename, but takes the sheet from the cache when the
+// file is unchanged, and otherwise adds what it parsed.  sheets that fail
+// to parse aren't kept, so their errors are reported every time.  the
+// caller frees the sheet.  safe to call from several threads at once
+struct cue_sheet* cue_sheet_cache_parse_filename(
+  struct cue_sheet_cache* self,
+  char const* filename,
+  struct cue_sheet_process_result* result_opt);
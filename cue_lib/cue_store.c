@@ -0,0 +1,163 @@
+#include "cue_store.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "err_helpers.h"
+#include "mem_helpers.h"
+#include "format_helpers.h"
+#include "hash_helpers.h"
+#include "filesystem.h"
+#include "path.h"
+#include "thread_helpers.h"
+
+static char const* stored_path(cue_store_t const* self, unsigned long long key);
+static errno_t place_file(char const* src, char const* dst);
+
+struct cue_store* cue_store_alloc(char const* path) {
+  cue_store_t* self = malloc(sizeof(*self));
+  if (!self) return NULL;
+
+  errno_t err = cue_store_init(self, path);
+  if (!err) return self;
+
+  SAFE_FREE(self);
+  return NULL;
+}
+
+errno_t cue_store_init(struct cue_store* self, char const* path) {
+  errno_t err = 0;
+
+  memset(self, 0, sizeof(*self));
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(self->path = _strdup(path), err);
+    ERR_REGION_NULL_CHECK(self->lock = th_mutex_alloc(), err);
+    ERR_REGION_ERROR_CHECK(ensure_dir(self->path), err);
+
+    return err;
+
+  } ERR_REGION_END()
+
+  cue_store_uninit(self);
+
+  return err;
+}
+
+void cue_store_uninit(struct cue_store* self) {
+  SAFE_FREE_HANDLER(self->lock, th_mutex_free);
+  SAFE_FREE(self->path);
+}
+
+void cue_store_free(struct cue_store* self) {
+  cue_store_uninit(self);
+  SAFE_FREE(self);
+}
+
+unsigned long long cue_store_key(unsigned long long content_hash, char const* params) {
+  // the same content made another way is another file
+  return hash_cstr(content_hash, params);
+}
+
+errno_t cue_store_fetch(struct cue_store* self, unsigned long long key, char const* path) {
+  errno_t err = 0;
+  char const* stored = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(stored = stored_path(self, key), err);
+    ERR_REGION_CMP_CHECK(!file_exists(stored), err);
+
+    // writing through an old link would change the stored file, and every
+    // other file linked to it, so the old file goes first
+    if (file_exists(path)) {
+      ERR_REGION_ERROR_CHECK(delete_file(path), err);
+    }
+
+    ERR_REGION_ERROR_CHECK(place_file(stored, path), err);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE(stored);
+
+  return err;
+}
+
+errno_t cue_store_add(struct cue_store* self, unsigned long long key, char const* path) {
+  errno_t err = 0;
+  char const* stored = 0;
+  char const* dir = 0;
+  char const* temp = 0;
+  unsigned long long temp_id = 0;
+  short created = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(stored = stored_path(self, key), err);
+    if (file_exists(stored)) return err;
+
+    ERR_REGION_NULL_CHECK(dir = path_dir_part(stored), err);
+    ERR_REGION_ERROR_CHECK(ensure_dir(dir), err);
+
+    // a link appears whole, or not at all
+    if (!link_file(path, stored)) return err;
+
+    // a copy doesn't, so it is made under a name of its own and renamed
+    // into place, leaving it to whichever copy gets there first.  the name
+    // is claimed by creating it, as other processes sharing the store count
+    // from the same place, and one that stopped may have left its copy
+    while (!created) {
+      th_mutex_lock(self->lock);
+      temp_id = self->next_temp++;
+      th_mutex_unlock(self->lock);
+
+      SAFE_FREE(temp);
+      ERR_REGION_NULL_CHECK(temp = msnprintf("%s.%llu.tmp", stored, temp_id), err);
+      ERR_REGION_ERROR_CHECK(create_file_exclusive(temp, "", 0, &created), err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    ERR_REGION_ERROR_CHECK(copy_file(path, temp), err);
+
+    if (rename_file(temp, stored)) {
+      ERR_REGION_CMP_CHECK(!file_exists(stored), err);
+    }
+    else {
+      created = 0;
+    }
+
+  } ERR_REGION_END()
+
+  // the name claimed goes, unless it was renamed into place
+  if (created) delete_file(temp);
+
+  SAFE_FREE(temp);
+  SAFE_FREE(dir);
+  SAFE_FREE(stored);
+
+  return err;
+}
+
+static char const* stored_path(cue_store_t const* self, unsigned long long key) {
+  // spread over subdirectories, so that none grows too large to list
+  return msnprintf("%s%s%02llx%s%016llx",
+    self->path, k_path_separator, key >> 56, k_path_separator, key);
+}
+
+static errno_t place_file(char const* src, char const* dst) {
+  errno_t err = 0;
+  char const* dir = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(dir = path_dir_part(dst), err);
+    ERR_REGION_ERROR_CHECK(ensure_dir(dir), err);
+
+    // a link costs nothing, but isn't always possible
+    if (link_file(src, dst)) {
+      ERR_REGION_ERROR_CHECK(copy_file(src, dst), err);
+    }
+
+  } ERR_REGION_END()
+
+  SAFE_FREE(dir);
+
+  return err;
+}
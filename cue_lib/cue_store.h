@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+
+struct th_mutex;
+
+// files already made, kept by a key derived from everything that decides
+// their content.  a file whose key is found is linked or copied from the
+// store rather than made again, so duplicate tracks across a collection
+// are only encoded once
+typedef struct cue_store {
+  char const* path;  // owned, the root of the store
+  struct th_mutex* lock;  // owned, guards next_temp
+  unsigned long long next_temp;  // names files being copied in, skipping any name already taken
+} cue_store_t;
+
+struct cue_store* cue_store_alloc(char const* path);
+errno_t cue_store_init(struct cue_store* self, char const* path);
+void cue_store_uninit(struct cue_store* self);
+void cue_store_free(struct cue_store* self);
+
+// the key for the file made from content with the given hash_file value.
+// params names whatever else decides the result, such as the encode settings
+unsigned long long cue_store_key(unsigned long long content_hash, char const* params);
+
+// makes path the file stored under key, replacing whatever was there.
+// fails, leaving path alone, when nothing is stored under key
+errno_t cue_store_fetch(struct cue_store* self, unsigned long long key, char const* path);
+
+// keeps the file at path under key, unless something already is.  safe to
+// call from several threads at once
+errno_t cue_store_add(struct cue_store* self, unsigned long long key, char const* path);
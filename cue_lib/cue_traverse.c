@@ -1,164 +1,443 @@
 #include "cue_traverse.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include "err_helpers.h"
 #include "filesystem.h"
-#include "string_vector.h"
+#include "directory_traversal.h"
 #include "char_vector.h"
 #include "string_helpers.h"
 #include "mem_helpers.h"
 #include "cue_traverse_report.h"
+#include "cue_traverse_report_collector.h"
 #include "cue_traverse_record.h"
+#include "cue_traverse_job.h"
 #include "cue_parser.h"
 #include "cue_file.h"
 #include "cue_status_info.h"
 #include "cue_transform.h"
+#include "cue_manifest.h"
+#include "cue_journal.h"
+#include "cue_claims.h"
+#include "cue_store.h"
+#include "cue_sheet_cache.h"
+#include "directory_cache.h"
+#include "hash_helpers.h"
 #include "path.h"
 #include "file_line_writer.h"
 #include "format_helpers.h"
 #include "regex_helper.h"
+#include "thread_helpers.h"
+#include "worker_pool.h"
+#include "wait_group.h"
 
 #include "oggenc.h"
 
-static short is_cue_file(char const *filename);
-static errno_t convert_record(cue_traverse_visitor_t* self, cue_traverse_record_t *record, short reort_only);
-static errno_t write_transformed_cue(cue_traverse_record_t const* record);
-static errno_t process_track_files(cue_traverse_visitor_t* self, cue_traverse_record_t const* record);
+static short visit_cue(cue_traverse_visitor_t* self, parallel_visitor_state_t const* state);
+static void run_job(void* arg, size_t worker);
+static void run_track_job(void* arg, size_t worker);
+static errno_t report_record(cue_traverse_visitor_t* self, size_t shard, size_t sequence,
+  cue_traverse_record_t* record, cue_traverse_report_type_t type);
+static errno_t write_status(cue_traverse_visitor_t* self,
+  char const* src_path, short overwriting, char const* status);
+static errno_t skip_record(cue_traverse_visitor_t* self, size_t sequence,
+  cue_traverse_record_t* record, char const* status, char const* detail);
+static errno_t load_record(cue_traverse_visitor_t* self, cue_traverse_record_t* record);
+static short claim_job(cue_traverse_visitor_t* self, cue_traverse_job_t* job);
+static cue_traverse_report_type_t job_report_type(cue_traverse_job_t const* job);
+static short adopt_target(cue_traverse_visitor_t* self, cue_traverse_record_t const* record);
+static unsigned long long estimate_work(cue_traverse_record_t const* record);
+static unsigned long long size_job(cue_traverse_visitor_t* self, cue_traverse_record_t const* record);
+static char* progress_status(cue_traverse_visitor_t* self, cue_traverse_job_t const* job, char const* status);
+static errno_t convert_record(cue_traverse_visitor_t* self, cue_traverse_record_t *record, short reort_only,
+  unsigned long long* source_hashes);
+static errno_t ensure_target_dir(cue_traverse_visitor_t* self, cue_traverse_record_t const* record);
+static errno_t write_transformed_cue(cue_traverse_visitor_t* self, cue_traverse_record_t const* record);
+static errno_t process_track_files(cue_traverse_visitor_t* self, cue_traverse_record_t const* record,
+  unsigned long long* source_hashes);
+static short is_track_fresh(cue_traverse_visitor_t* self,
+  cue_manifest_entry_t const* entry, cue_track_job_t const* job);
+static short is_track_journaled(cue_traverse_visitor_t* self, cue_track_job_t const* job,
+  unsigned long long src_size, unsigned long long src_mtime,
+  unsigned long long trg_size, unsigned long long trg_mtime);
+static errno_t track_key(cue_traverse_visitor_t* self, cue_track_job_t* job, unsigned long long* key);
 static errno_t convert_file(
   cue_traverse_visitor_t* self,
   char const* src_path, cue_file_type_t src_type,
-  char const* trg_path, cue_file_type_t trg_type);
+  char const* trg_path, char const* out_path, cue_file_type_t trg_type,
+  int threads);
 static errno_t convert_to_ogg(
   cue_traverse_visitor_t* self,
   char const* src_path, cue_file_type_t src_type,
-  char const* trg_path);
+  char const* trg_path, char const* out_path, int threads);
+static int claim_encode_threads(cue_traverse_visitor_t* self, int wanted);
+static void release_encode_threads(cue_traverse_visitor_t* self, int claimed);
+static unsigned int stream_serial(char const* path);
+static short in_shard(cue_traverse_visitor_t const* self, char const* src_path);
+
+// blocks of 1024 samples read ahead of each encode
+#define ENCODE_PIPELINE_DEPTH 64
+
+// encoded pages are written out in batches of about this many bytes
+#define ENCODE_WRITE_BUFFER (256 * 1024)
 
 //
 // cue traversal visitor
 //
 
 static short ctv_visit(parallel_visitor_t *self_t, parallel_visitor_state_t const* state) {
-
   cue_traverse_visitor_t* self = (cue_traverse_visitor_t*)self_t->self;
-  file_handle_i const* directory = state->base_state->directory;
+  short keep_traversing = 1;
+
+  // the traversal, filtered as cue_traverse_visitor_filter has it, hands
+  // over nothing but cues, so the threads reading directories only meet
+  // here for those
+  if (self->visit_lock) th_mutex_lock(self->visit_lock);
+  keep_traversing = visit_cue(self, state);
+  if (self->visit_lock) th_mutex_unlock(self->visit_lock);
+
+  return keep_traversing;
+}
+
+// with several threads visiting, only one at a time gets here
+static short visit_cue(cue_traverse_visitor_t* self, parallel_visitor_state_t const* state) {
   directory_entry_i const* entry = state->base_state->entry;
 
   short keep_traversing = 1;
   char const *dst_path = 0;
   char const *src_path = 0;
   cue_traverse_record_t* record = 0;
-  cue_traverse_record_t const *added = 0;
-  short transformed = 0;
-  cue_traverse_report_t *report = self->report;
-  line_writer_i *writer = 0;
+  cue_traverse_job_t* job = 0;
+  short overwriting = 0;
+  short skip = 0;
+  size_t sequence = 0;
+  cue_manifest_entry_t* manifest_entry = 0;
   char *buf = 0;
   char const *filename = 0;
 
   ERR_REGION_BEGIN() {
-
     filename = entry->get_name(entry);
-    if (is_cue_file(filename)) {
-      // found a cue
+    sequence = self->sequence++;
 
-      writer = self->writer;
+    // create a traverse record for this
+    src_path = state->base_state->path;
 
-      // create a traverse record for this
-      src_path = join_dir_file_path(
-        directory->get_path(directory),
-        filename
-      );
-      ERR_REGION_NULL_CHECK_CODE(src_path, keep_traversing, 0);
+    // cues of other shards are left for them, and aren't reported.  they
+    // still took a sequence number, so partial reports merge in order
+    if (!in_shard(self, src_path)) return keep_traversing;
 
-      ERR_REGION_CMP_CHECK_CODE(
-        ! line_writer_write_fmt(writer, "%s%s", "Processing ", src_path), 
-        keep_traversing, 0);
+    dst_path = state->parallel_path;
 
-      dst_path = state->parallel_path;
-
-      record = cue_traverse_record_alloc_with_paths(dst_path, src_path);
-      ERR_REGION_NULL_CHECK_CODE(record, keep_traversing, 0);
-
-      // if the destination already exists, and we are not in overwrite mode,
-      // just terminate this visit
-
-      if (file_exists(dst_path)) {
-        if (!self->overwrite) {
-          ERR_REGION_CMP_CHECK_CODE(
-            !line_writer_write_fmt(writer, "%s%s", "  ", "skipping, already exists."),
-            keep_traversing, 0);
-          ERR_REGION_NULL_CHECK_CODE(buf = msnprintf("%s already exists.", dst_path), 
-            keep_traversing, 0);
-          ERR_REGION_NULL_CHECK_CODE(
-            cue_sheet_process_result_add_status(record->result, buf), 
-            keep_traversing, 0);
-          SAFE_FREE(buf);
-          ERR_REGION_NULL_CHECK_CODE(
-            cue_traverse_report_add_record(report, record, EWC_CTR_SKIPPED),
-            keep_traversing, 0);
-
-          // don't need the source path
-          SAFE_FREE(src_path);
-
-          return keep_traversing;
-        }
-        else {
-          ERR_REGION_CMP_CHECK_CODE(
-            !line_writer_write_fmt(writer, "%s%s", "  ", "overwriting... "),
-            keep_traversing, 0);
-        }
+    record = cue_traverse_record_alloc_with_paths(dst_path, src_path);
+    ERR_REGION_NULL_CHECK_CODE(record, keep_traversing, 0);
+    record->sequence = sequence;
+
+    // a cue the manifest says is unchanged since it was converted, with
+    // all of its outputs still there, needn't even be parsed
+    if (self->manifest && !self->overwrite) {
+      manifest_entry = cue_manifest_find(self->manifest, src_path);
+      if (manifest_entry && cue_manifest_is_current(self->manifest, manifest_entry, self->quality)) {
+        manifest_entry->keep = 1;
+
+        ERR_REGION_NULL_CHECK_CODE(buf = msnprintf("%s is up to date.", dst_path),
+          keep_traversing, 0);
+        ERR_REGION_ERROR_CHECK_CODE(
+          skip_record(self, sequence, record, "skipping, up to date.", buf),
+          keep_traversing, 0);
+        record = 0;
+
+        SAFE_FREE(buf);
+
+        return keep_traversing;
       }
+    }
 
-      // if we have filters, check whether to filter this one out
-      if (self->num_filters) {
-        if (regex_matches_any(self->filters, self->num_filters, filename)) {
-          ERR_REGION_CMP_CHECK_CODE(
-            !line_writer_write_fmt(writer, "%s%s", "  ", "skipping, matches filter."),
-            keep_traversing, 0);
-          ERR_REGION_NULL_CHECK_CODE(buf = msnprintf("%s matched a filter.", filename),
-            keep_traversing, 0);
-          ERR_REGION_NULL_CHECK_CODE(
-            cue_sheet_process_result_add_status(record->result, buf),
-            keep_traversing, 0);
-          SAFE_FREE(buf);
-          ERR_REGION_NULL_CHECK_CODE(
-            cue_traverse_report_add_record(report, record, EWC_CTR_SKIPPED),
-            keep_traversing, 0);
-
-          // don't need the source path
-          SAFE_FREE(src_path);
-
-          return keep_traversing;
-        }
+    // if the destination already exists, and we are not in overwrite mode,
+    // just terminate this visit.  with a manifest, only a complete target
+    // is left alone, and one the manifest says is stale is converted again
+
+    if (directory_cache_file_exists(self->target_cache, dst_path)) {
+      if (!self->overwrite && !manifest_entry) {
+        // a complete target the manifest doesn't know yet is recorded as
+        // it is.  without a manifest to say otherwise, assume it's complete
+        skip = !self->manifest
+          || adopt_target(self, record)
+          || !self->manifest->loaded;
       }
 
-      // don't need the source path
-      SAFE_FREE(src_path);
+      if (skip) {
+        ERR_REGION_NULL_CHECK_CODE(buf = msnprintf("%s already exists.", dst_path), 
+          keep_traversing, 0);
+        ERR_REGION_ERROR_CHECK_CODE(
+          skip_record(self, sequence, record, "skipping, already exists.", buf),
+          keep_traversing, 0);
+        record = 0;
+
+        SAFE_FREE(buf);
+
+        return keep_traversing;
+      }
+      else {
+        overwriting = 1;
+      }
+    }
 
+    // if we have filters, check whether to filter this one out
+    if (self->num_filters) {
+      if (regex_matches_any(self->filters, self->num_filters, filename)) {
+        ERR_REGION_ERROR_CHECK_CODE(
+          write_status(self, src_path, overwriting, "skipping, matches filter."),
+          keep_traversing, 0);
+        ERR_REGION_NULL_CHECK_CODE(buf = msnprintf("%s matched a filter.", filename),
+          keep_traversing, 0);
+        ERR_REGION_NULL_CHECK_CODE(
+          cue_sheet_process_result_add_status(record->result, buf),
+          keep_traversing, 0);
+        SAFE_FREE(buf);
+        ERR_REGION_ERROR_CHECK_CODE(
+          report_record(self, 0, sequence, record, EWC_CTR_SKIPPED),
+          keep_traversing, 0);
+
+        return keep_traversing;
+      }
+    }
+
+    // the job takes over the record
+    job = cue_traverse_job_alloc(record, overwriting);
+    ERR_REGION_NULL_CHECK_CODE(job, keep_traversing, 0);
+    job->visitor = self;
+    job->sequence = sequence;
+    record = 0;
+
+    if (self->pool) {
+      // only sized for now, finish runs the conversions once every cue is
+      // known, so they start largest first and the total is fixed
+      job->work = size_job(self, job->record);
+
+      ERR_REGION_NULL_CHECK_CODE(self->pending->push(self->pending, job), keep_traversing, 0);
+      self->total_work += job->work;
+      ++self->total_jobs;
+      job = 0;
+    }
+    else {
       // try to convert
-      transformed = convert_record(self, record, self->report_only) == 0;
+      run_job(job, 0);
+      ERR_REGION_ERROR_CHECK_CODE(job->write_err, keep_traversing, 0);
 
-      ERR_REGION_CMP_CHECK_CODE(
-        !line_writer_write_fmt(writer, "%s%s", "  ", transformed ? "Success." : "FAILED!"), 
+      // add the appropriate report category
+      record = cue_traverse_job_detach_record(job);
+      ERR_REGION_ERROR_CHECK_CODE(
+        report_record(self, 0, sequence, record, job_report_type(job)),
         keep_traversing, 0);
+      record = 0;
 
-      // add the appropriate report category
-      added = cue_traverse_report_add_record(report, record,
-        transformed ? EWC_CTR_TRANSFORMED : EWC_CTR_FAILED);
-      ERR_REGION_NULL_CHECK_CODE(added, keep_traversing, 0);
+      SAFE_FREE_HANDLER(job, cue_traverse_job_free);
     }
 
     return keep_traversing;
 
   } ERR_REGION_END()
 
+  SAFE_FREE_HANDLER(job, cue_traverse_job_free);
   SAFE_FREE_HANDLER(record, cue_traverse_record_free);
-  SAFE_FREE(src_path);
   SAFE_FREE(buf);
 
   return keep_traversing;
 }
 
+static void run_job(void* arg, size_t worker) {
+  cue_traverse_job_t* job = (cue_traverse_job_t*)arg;
+  cue_traverse_visitor_t* self = job->visitor;
+
+  char const* status = 0;
+  char* buf = 0;
+  unsigned long long* source_hashes = 0;
+  short claimed = 0;
+
+  job->load_err = load_record(self, job->record);
+
+  // the claim is only taken as the conversion starts, so that cues are
+  // shared out as the processes get to them rather than as they are found
+  if (!job->load_err && self->claims) {
+    claimed = claim_job(self, job);
+  }
+
+  // whatever the copies and the store read along the way, so the manifest
+  // needn't read it again.  a file that wasn't hashed, such as an encoded
+  // one, or any without room for the hashes, is recorded by size and time
+  if (!job->load_err && !job->claimed_elsewhere && self->manifest && job->record->source_sheet->num_files) {
+    source_hashes = calloc(job->record->source_sheet->num_files, sizeof(*source_hashes));
+  }
+
+  job->transformed = !job->load_err
+    && (claimed || !self->claims)
+    && convert_record(self, job->record, self->report_only, source_hashes) == 0;
+
+  if (job->claimed_elsewhere) {
+    status = "skipping, claimed elsewhere.";
+  }
+  else {
+    status = job->transformed ? "Success." : "FAILED!";
+  }
+
+  if (self->pool) {
+    // fall back to the plain status if there is no room for the progress
+    buf = progress_status(self, job, status);
+    if (buf) status = buf;
+  }
+
+  job->write_err = write_status(self, job->record->source_path, job->overwriting, status);
+
+  SAFE_FREE(buf);
+
+  // a cue that couldn't be recorded is just converted again next time, so
+  // that alone doesn't fail it
+  if (job->transformed && self->manifest && !self->report_only) {
+    cue_manifest_add(self->manifest, job->record->source_path, job->record->target_path,
+      job->record->source_sheet, job->record->target_sheet, self->quality, 1, source_hashes);
+  }
+
+  SAFE_FREE(source_hashes);
+
+  // a claim that can't be released goes stale, and whoever takes it over
+  // finds the cue already converted
+  if (claimed) {
+    cue_claims_release(self->claims, path_relative_part(self->source_path, job->record->source_path));
+  }
+
+  if (self->pool) {
+    // the worker's own shard, so there is nothing to lock
+    job->report_err = report_record(self, worker + 1, job->sequence, job->record, job_report_type(job));
+    if (!job->report_err) cue_traverse_job_detach_record(job);
+  }
+}
+
+// whether this process is to convert the cue of the job.  a cue claimed by
+// another process, or that one converted while this one was getting to it,
+// is left to them
+static short claim_job(cue_traverse_visitor_t* self, cue_traverse_job_t* job) {
+  cue_traverse_record_t* record = job->record;
+  char const* key = path_relative_part(self->source_path, record->source_path);
+  short acquired = 0;
+  char* buf = 0;
+
+  if (cue_claims_acquire(self->claims, key, &acquired)) {
+    buf = msnprintf("Failed to claim cue: %s", record->target_path);
+    if (buf) cue_sheet_process_result_add_error(record->result, buf);
+    SAFE_FREE(buf);
+
+    return 0;
+  }
+
+  // the target cue is written last, so once it is there the rest is too
+  if (acquired && !job->overwriting && file_exists(record->target_path)) {
+    cue_claims_release(self->claims, key);
+    acquired = 0;
+  }
+
+  if (!acquired) {
+    job->claimed_elsewhere = 1;
+
+    buf = msnprintf("%s was claimed by another process.", record->target_path);
+    if (buf) cue_sheet_process_result_add_status(record->result, buf);
+    SAFE_FREE(buf);
+  }
+
+  return acquired;
+}
+
+static cue_traverse_report_type_t job_report_type(cue_traverse_job_t const* job) {
+  if (job->claimed_elsewhere) return EWC_CTR_SKIPPED;
+
+  return job->transformed ? EWC_CTR_TRANSFORMED : EWC_CTR_FAILED;
+}
+
+static errno_t report_record(cue_traverse_visitor_t* self, size_t shard, size_t sequence,
+  cue_traverse_record_t* record, cue_traverse_report_type_t type) {
+
+  if (self->collector) {
+    return cue_traverse_report_collector_add_record(self->collector, shard, sequence, record, type);
+  }
+
+  return cue_traverse_report_add_record(self->report, record, type) ? 0 : -1;
+}
+
+// reports a cue as skipped, which takes over the record unless it fails
+static errno_t skip_record(cue_traverse_visitor_t* self, size_t sequence,
+  cue_traverse_record_t* record, char const* status, char const* detail) {
+
+  errno_t err = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_ERROR_CHECK(write_status(self, record->source_path, 0, status), err);
+    ERR_REGION_NULL_CHECK(cue_sheet_process_result_add_status(record->result, detail), err);
+    ERR_REGION_ERROR_CHECK(report_record(self, 0, sequence, record, EWC_CTR_SKIPPED), err);
+
+  } ERR_REGION_END()
+
+  return err;
+}
+
+static char* progress_status(cue_traverse_visitor_t* self, cue_traverse_job_t const* job, char const* status) {
+  size_t done_jobs, total_jobs;
+  unsigned long long done_work, total_work;
+  unsigned long long elapsed, remaining = 0;
+
+  th_mutex_lock(self->output_lock);
+  self->done_work += job->work;
+  done_jobs = ++self->done_jobs;
+  done_work = self->done_work;
+  total_work = self->total_work;
+  total_jobs = self->total_jobs;
+  th_mutex_unlock(self->output_lock);
+
+  if (!total_work || !done_work) {
+    return msnprintf("%s [%zu/%zu]", status, done_jobs, total_jobs);
+  }
+
+  // assume the rest goes at the rate seen so far
+  elapsed = (unsigned long long)(time(NULL) - self->start_time);
+  if (done_work < total_work) {
+    remaining = (unsigned long long)((double)elapsed * (total_work - done_work) / done_work);
+  }
+
+  return msnprintf("%s [%zu/%zu, %u%%, about %llum%02llus left]",
+    status, done_jobs, total_jobs,
+    (unsigned int)(done_work * 100 / total_work),
+    remaining / 60, remaining % 60);
+}
+
+static errno_t write_status(cue_traverse_visitor_t* self,
+  char const* src_path, short overwriting, char const* status) {
+
+  errno_t err = 0;
+  line_writer_i* writer = self->writer;
+
+  // lines for one cue stay together even when several jobs finish at once
+  if (self->output_lock) th_mutex_lock(self->output_lock);
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_CMP_CHECK(
+      !line_writer_write_fmt(writer, "%s%s", "Processing ", src_path), err);
+
+    if (overwriting) {
+      ERR_REGION_CMP_CHECK(
+        !line_writer_write_fmt(writer, "%s%s", "  ", "overwriting... "), err);
+    }
+
+    ERR_REGION_CMP_CHECK(
+      !line_writer_write_fmt(writer, "%s%s", "  ", status), err);
+
+  } ERR_REGION_END()
+
+  if (self->output_lock) th_mutex_unlock(self->output_lock);
+
+  return err;
+}
+
 errno_t cue_traverse_visitor_init(cue_traverse_visitor_t* self,
   cue_traverse_visitor_opts_t const *opts) {
 
@@ -178,14 +457,69 @@ errno_t cue_traverse_visitor_init(cue_traverse_visitor_t* self,
     self->writer = opts->writer;
     self->filters = opts->filters;
     self->num_filters = opts->num_filters;
+    self->encode_jobs = opts->encode_jobs;
+    self->copy_strategy = opts->copy_strategy;
+    self->shard = opts->shard;
+    self->num_shards = opts->num_shards;
+    self->manifest = opts->manifest;
+    self->store = opts->store;
+    self->journal = opts->journal;
+    self->claims = opts->claims;
+    self->sheet_cache = opts->sheet_cache;
 
     ERR_REGION_NULL_CHECK(source_path_str = _strdup(opts->source_path), err);
+    ERR_REGION_NULL_CHECK(self->target_cache = directory_cache_alloc(), err);
 
     report = cue_traverse_report_alloc();
     ERR_REGION_NULL_CHECK(report, err);
 
     self->source_path = source_path_str;
     self->report = report;
+    source_path_str = 0;
+    report = 0;
+
+    if (opts->scan_threads > 1) {
+      ERR_REGION_NULL_CHECK(self->visit_lock = th_mutex_alloc(), err);
+    }
+
+    if (opts->jobs > 1) {
+      ERR_REGION_NULL_CHECK(self->output_lock = th_mutex_alloc(), err);
+      ERR_REGION_NULL_CHECK(self->pending = cue_traverse_job_vector_alloc(), err);
+
+      // keep a little work queued so that workers don't wait on the traversal
+      self->pool = worker_pool_alloc(opts->jobs, opts->jobs * 2);
+      ERR_REGION_NULL_CHECK(self->pool, err);
+
+      self->collector = cue_traverse_report_collector_alloc(self->pool->num_workers + 1);
+      ERR_REGION_NULL_CHECK(self->collector, err);
+    }
+    else if (opts->scan_threads > 1) {
+      // just the traversal's shard, to put the cues back in order
+      self->collector = cue_traverse_report_collector_alloc(1);
+      ERR_REGION_NULL_CHECK(self->collector, err);
+    }
+
+    // the threads reading directories find the cues in a different order
+    // each run, so the report can't follow it
+    if (self->collector && opts->scan_threads > 1) {
+      self->collector->by_path = 1;
+    }
+
+    // files get their own pools, since cue workers block waiting on them
+    if (opts->jobs > 1 || opts->copy_jobs > 1 || opts->encode_jobs > 1) {
+      size_t copy_jobs = opts->copy_jobs > 1 ? opts->copy_jobs : 1;
+      size_t encode_jobs = opts->encode_jobs > 1 ? opts->encode_jobs : 1;
+
+      self->copy_pool = worker_pool_alloc(copy_jobs, copy_jobs * 2);
+      ERR_REGION_NULL_CHECK(self->copy_pool, err);
+
+      self->encode_pool = worker_pool_alloc(encode_jobs, encode_jobs * 2);
+      ERR_REGION_NULL_CHECK(self->encode_pool, err);
+
+      ERR_REGION_NULL_CHECK(self->encode_lock = th_mutex_alloc(), err);
+      ERR_REGION_NULL_CHECK(self->encode_threads_freed = th_cond_alloc(), err);
+      self->free_encode_threads = (int)encode_jobs;
+    }
 
     return err;
 
@@ -193,39 +527,203 @@ errno_t cue_traverse_visitor_init(cue_traverse_visitor_t* self,
 
   SAFE_FREE_HANDLER(report, cue_traverse_report_free);
   SAFE_FREE(source_path_str);
+  cue_traverse_visitor_uninit(self);
+
+  return err;
+}
+
+errno_t cue_traverse_visitor_finish(cue_traverse_visitor_t* self) {
+  errno_t err = 0;
+  cue_traverse_job_vector_t* pending = self->pending;
+  cue_traverse_job_t** order = 0;
+  size_t length = 0;
+
+  if (!self->pool) {
+    // only the order of what several threads found is left to settle
+    if (self->collector) err = cue_traverse_report_collector_merge(self->collector, self->report);
+    return err;
+  }
+
+  ERR_REGION_BEGIN() {
+    length = pending->get_length(pending);
+
+    // start the largest jobs first, so that a long one discovered late
+    // doesn't end up running alone after everything else has finished
+    if (length) {
+      order = malloc(length * sizeof(*order));
+      ERR_REGION_NULL_CHECK(order, err);
+      memcpy(order, pending->get_buffer(pending), length * sizeof(*order));
+      cue_traverse_jobs_sort_largest_first(order, length);
+    }
+
+    self->start_time = time(NULL);
+
+    for (size_t i = 0; i < length; ++i) {
+      ERR_REGION_ERROR_CHECK(worker_pool_submit(self->pool, run_job, order[i]), err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    worker_pool_wait(self->pool);
+
+    for (size_t i = 0; i < length; ++i) {
+      cue_traverse_job_t* job = (cue_traverse_job_t*)pending->get(pending, i);
+
+      ERR_REGION_ERROR_CHECK(job->write_err, err);
+      ERR_REGION_ERROR_CHECK(job->report_err, err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    // the shards come back together in discovery order, just as a single
+    // thread would have filled the report, or by path if several found them
+    ERR_REGION_ERROR_CHECK(cue_traverse_report_collector_merge(self->collector, self->report), err);
+
+  } ERR_REGION_END()
+
+  // nothing may be released while a submitted job is still running
+  worker_pool_wait(self->pool);
+
+  SAFE_FREE(order);
+
+  // the records now belong to the collector or the report, so just release the jobs
+  while (pending->get_length(pending)) {
+    pending->pop(pending);
+  }
 
   return err;
 }
 
 void cue_traverse_visitor_uninit(cue_traverse_visitor_t* self) {
+  // stop the workers before releasing anything they may touch
+  SAFE_FREE_HANDLER(self->pool, worker_pool_free);
+  SAFE_FREE_HANDLER(self->copy_pool, worker_pool_free);
+  SAFE_FREE_HANDLER(self->encode_pool, worker_pool_free);
+  SAFE_FREE_HANDLER(self->encode_threads_freed, th_cond_free);
+  SAFE_FREE_HANDLER(self->encode_lock, th_mutex_free);
+  SAFE_FREE_HANDLER(self->pending, cue_traverse_job_vector_free);
+  SAFE_FREE_HANDLER(self->collector, cue_traverse_report_collector_free);
+  SAFE_FREE_HANDLER(self->output_lock, th_mutex_free);
+  SAFE_FREE_HANDLER(self->visit_lock, th_mutex_free);
   SAFE_FREE_HANDLER(self->report, cue_traverse_report_free);
+  SAFE_FREE_HANDLER(self->target_cache, directory_cache_free);
   SAFE_FREE(self->source_path);
   parallel_visitor_uninit(&self->pv_t);
 }
 
+errno_t cue_traverse_visitor_restart(cue_traverse_visitor_t* self, char const* target_path) {
+  errno_t err = 0;
+  char const* root_path = 0;
+  cue_traverse_report_t* report = 0;
+  directory_cache_t* target_cache = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(root_path = _strdup(target_path), err);
+    ERR_REGION_NULL_CHECK(report = cue_traverse_report_alloc(), err);
+    // the target may have changed since the last pass
+    ERR_REGION_NULL_CHECK(target_cache = directory_cache_alloc(), err);
+
+    SAFE_FREE(self->pv_t.root_path);
+    self->pv_t.root_path = root_path;
+    self->pv_t.handler_i.parallel_root = root_path;
+    root_path = 0;
+
+    SAFE_FREE_HANDLER(self->report, cue_traverse_report_free);
+    self->report = report;
+    report = 0;
+
+    SAFE_FREE_HANDLER(self->target_cache, directory_cache_free);
+    self->target_cache = target_cache;
+    target_cache = 0;
+
+    self->sequence = 0;
+    self->total_work = 0;
+    self->done_work = 0;
+    self->total_jobs = 0;
+    self->done_jobs = 0;
+
+  } ERR_REGION_END()
+
+  SAFE_FREE_HANDLER(target_cache, directory_cache_free);
+  SAFE_FREE_HANDLER(report, cue_traverse_report_free);
+  SAFE_FREE(root_path);
+
+  return err;
+}
+
 struct cue_traverse_report *cue_traverse_visitor_detach_report(cue_traverse_visitor_t* self) {
   struct cue_traverse_report* report = self->report;
   self->report = NULL;
   return report;
 }
 
-static const char s_cue_suffix[] = ".cue";
+static char const* const s_cue_suffixes[] = { ".cue" };
+
+void cue_traverse_visitor_filter(directory_traversal_options_t* opts) {
+  opts->files_only = 1;
+  opts->suffixes = s_cue_suffixes;
+  opts->num_suffixes = sizeof(s_cue_suffixes) / sizeof(*s_cue_suffixes);
+}
+
+// copying a file costs far less than encoding the same number of bytes
+#define COPY_WORK_DIVISOR 16
+
+static unsigned long long estimate_work(cue_traverse_record_t const* record) {
+  cue_sheet_t const* src = record->source_sheet;
+  cue_sheet_t const* trg = record->target_sheet;
+  char const* src_dir = 0;
+  char const* src_path = 0;
+  unsigned long long work = 0;
+
+  src_dir = path_dir_part(record->source_path);
+  if (!src_dir) return work;
+
+  for (short i = 0; i < src->num_files; ++i) {
+    unsigned long long size = 0;
+
+    src_path = join_dir_file_path(src_dir, src->file[i]->filename);
+    if (!src_path) break;
+
+    // a missing file fails quickly, so it adds nothing
+    if (!file_size(src_path, &size)) {
+      work += src->file[i]->type == trg->file[i]->type ? size / COPY_WORK_DIVISOR : size;
+    }
+
+    SAFE_FREE(src_path);
+  }
+
+  SAFE_FREE(src_dir);
+
+  return work;
+}
+
+// the estimate comes from a parse of its own, which is dropped again, so
+// only the paths of the cues waiting on the traversal are held
+static unsigned long long size_job(cue_traverse_visitor_t* self, cue_traverse_record_t const* record) {
+  cue_traverse_record_t* parsed = 0;
+  unsigned long long work = 0;
 
-static short is_cue_file(char const* filename) {
-  return cstr_ends_with(filename, s_cue_suffix);
+  parsed = cue_traverse_record_alloc_with_paths(record->target_path, record->source_path);
+  if (!parsed) return work;
+
+  // a cue that doesn't parse fails quickly, so it adds nothing
+  if (!load_record(self, parsed)) work = estimate_work(parsed);
+
+  cue_traverse_record_free(parsed);
+
+  return work;
 }
 
-static errno_t convert_record(cue_traverse_visitor_t* self, cue_traverse_record_t * record, short report_only) {
+static errno_t load_record(cue_traverse_visitor_t* self, cue_traverse_record_t* record) {
   errno_t err = 0;
   cue_sheet_t* src = 0;
   cue_sheet_t* converted = 0;
   char const* src_path = record->source_path;
-  char const* trg_path = record->target_path;
-  char *buf = 0;
 
   ERR_REGION_BEGIN() {
-    // try to load the source cue
-    src = cue_sheet_parse_filename(src_path, record->result);
+    // try to load the source cue, from the cache if it hasn't changed
+    if (self->sheet_cache) {
+      src = cue_sheet_cache_parse_filename(self->sheet_cache, src_path, record->result);
+    }
+    else {
+      src = cue_sheet_parse_filename(src_path, record->result);
+    }
     ERR_REGION_NULL_CHECK(src, err);
 
     cue_sheet_t* local_src = src;
@@ -242,10 +740,61 @@ static errno_t convert_record(cue_traverse_visitor_t* self, cue_traverse_record_
     converted = NULL;
     record->target_sheet = local_converted;
 
-    // if we are actually running, try to write the converted cue
+  } ERR_REGION_END()
+
+  return err;
+}
+
+// records an existing target in the manifest, if every file it would have
+// been converted to is there.  the sources aren't hashed, as they can't be
+// known to be what the target was converted from
+static short adopt_target(cue_traverse_visitor_t* self, cue_traverse_record_t const* record) {
+  cue_traverse_record_t* parsed = 0;
+  char const* trg_dir = 0;
+  char const* path = 0;
+  short complete = 0;
+
+  parsed = cue_traverse_record_alloc_with_paths(record->target_path, record->source_path);
+  if (!parsed) return complete;
+
+  // a cue that doesn't parse can't have been converted
+  complete = !load_record(self, parsed)
+    && (trg_dir = path_dir_part(parsed->target_path)) != 0;
+
+  for (short i = 0; complete && i < parsed->target_sheet->num_files; ++i) {
+    path = join_dir_file_path(trg_dir, parsed->target_sheet->file[i]->filename);
+    complete = path && directory_cache_file_exists(self->target_cache, path);
+
+    SAFE_FREE(path);
+  }
+
+  complete = complete && !cue_manifest_add(self->manifest, parsed->source_path, parsed->target_path,
+    parsed->source_sheet, parsed->target_sheet, self->quality, 0, NULL);
+
+  SAFE_FREE(trg_dir);
+  cue_traverse_record_free(parsed);
+
+  return complete;
+}
+
+static errno_t convert_record(cue_traverse_visitor_t* self, cue_traverse_record_t * record, short report_only,
+  unsigned long long* source_hashes) {
+
+  errno_t err = 0;
+  char const* trg_path = record->target_path;
+  char *buf = 0;
+
+  ERR_REGION_BEGIN() {
+    // if we are actually running, make the files, then write the converted
+    // cue.  the cue goes last, so that a target cue only names finished files
     if (!report_only) {
       errno_t write_err;
-      write_err = write_transformed_cue(record);
+      write_err = ensure_target_dir(self, record);
+
+      if (!write_err) {
+        ERR_REGION_ERROR_CHECK(process_track_files(self, record, source_hashes), err);
+        write_err = write_transformed_cue(self, record);
+      }
 
       // if there was an error creating the cue, log it here as a line 0 error
       if (write_err) {
@@ -257,8 +806,6 @@ static errno_t convert_record(cue_traverse_visitor_t* self, cue_traverse_record_
       }
 
       ERR_REGION_ERROR_CHECK(write_err, err);
-
-      ERR_REGION_ERROR_CHECK(process_track_files(self, record), err);
     }
 
   } ERR_REGION_END()
@@ -268,24 +815,17 @@ static errno_t convert_record(cue_traverse_visitor_t* self, cue_traverse_record_
   return err;
 }
 
-static errno_t write_transformed_cue(cue_traverse_record_t const *record) {
+static errno_t ensure_target_dir(cue_traverse_visitor_t* self, cue_traverse_record_t const* record) {
   errno_t err = 0;
   char const *dir = 0;
-  cue_sheet_t const *cue = record->target_sheet;
-  char const *path = record->target_path;
-  cue_sheet_process_result_t *result = record->result;
 
   ERR_REGION_BEGIN() {
 
-    dir = path_dir_part(path);
+    dir = path_dir_part(record->target_path);
     ERR_REGION_NULL_CHECK(dir, err);
 
-    // ensure that the target directory exists
-    ERR_REGION_ERROR_CHECK(ensure_dir(dir), err);
+    ERR_REGION_ERROR_CHECK(directory_cache_ensure_dir(self->target_cache, dir), err);
 
-    // create a writer for the desired file
-    ERR_REGION_ERROR_CHECK(cue_sheet_write_filename(cue, path), err);
-    
   } ERR_REGION_END()
 
   SAFE_FREE(dir);
@@ -293,13 +833,43 @@ static errno_t write_transformed_cue(cue_traverse_record_t const *record) {
   return err;
 }
 
-static errno_t process_track_files(cue_traverse_visitor_t* self, cue_traverse_record_t const * record) {
+static errno_t write_transformed_cue(cue_traverse_visitor_t* self, cue_traverse_record_t const *record) {
+  errno_t err = 0;
+  char const *part_path = 0;
+  cue_sheet_t const *cue = record->target_sheet;
+  char const *path = record->target_path;
+
+  ERR_REGION_BEGIN() {
+
+    part_path = path_part_file(path);
+    ERR_REGION_NULL_CHECK(part_path, err);
+
+    // written aside and renamed into place, so an old cue is only replaced
+    // by a whole one
+    ERR_REGION_ERROR_CHECK(cue_sheet_write_filename(cue, part_path), err);
+    ERR_REGION_ERROR_CHECK(replace_file(part_path, path), err);
+    ERR_REGION_ERROR_CHECK(directory_cache_add_file(self->target_cache, path), err);
+    
+  } ERR_REGION_END()
+
+  if (err && part_path) delete_file(part_path);
+
+  SAFE_FREE(part_path);
+
+  return err;
+}
+
+static errno_t process_track_files(cue_traverse_visitor_t* self, cue_traverse_record_t const * record,
+  unsigned long long* source_hashes) {
 
   // we can assume that the number of files in the source and target cues
   // are the same, since the target was derived from the source.
   // we iterate over both cues, comparing the types of corresponding
   // files.  If they are the same, just copy them.  If they differ
   // (target is OGG) then we convert during the copy.
+  // with file pools, every file is started at once, copies and encodes
+  // each limited by their own pool, and the outcomes are gathered back in
+  // cue order once they have all finished.
 
   errno_t err = 0;
   cue_sheet_t const* src = record->source_sheet;
@@ -309,6 +879,14 @@ static errno_t process_track_files(cue_traverse_visitor_t* self, cue_traverse_re
   char const* trg_dir = 0;
   char const* src_path = 0;
   char const* trg_path = 0;
+  cue_track_job_t** jobs = 0;
+  cue_manifest_entry_t const* entry = 0;
+  wait_group_t group;
+  short grouped = 0;
+  short started = 0;
+  char* buf = 0;
+
+  memset(&group, 0, sizeof(group));
 
   ERR_REGION_BEGIN() {
     src_dir = path_dir_part(record->source_path);
@@ -316,6 +894,12 @@ static errno_t process_track_files(cue_traverse_visitor_t* self, cue_traverse_re
     trg_dir = path_dir_part(record->target_path);
     ERR_REGION_NULL_CHECK(trg_dir, err);
 
+    jobs = calloc(num_files, sizeof(*jobs));
+    ERR_REGION_NULL_CHECK(jobs, err);
+
+    // what the last run recorded, to tell which files are still fresh
+    if (self->manifest) entry = cue_manifest_find(self->manifest, record->source_path);
+
     for (short i = 0; i < num_files; ++i) {
       cue_file_t const *src_file = src->file[i];
       cue_file_t const *trg_file = trg->file[i];
@@ -326,11 +910,22 @@ static errno_t process_track_files(cue_traverse_visitor_t* self, cue_traverse_re
       trg_path = join_dir_file_path(trg_dir, trg_file->filename);
       ERR_REGION_NULL_CHECK(trg_path, err);
 
-      if (src_file->type == trg_file->type) {
-        ERR_REGION_ERROR_CHECK(copy_file(src_path, trg_path), err);
-      }
-      else {
-        ERR_REGION_ERROR_CHECK(convert_file(self, src_path, src_file->type, trg_path, trg_file->type), err);
+      jobs[i] = cue_track_job_alloc(src_path, src_file->type, trg_path, trg_file->type);
+      ERR_REGION_NULL_CHECK(jobs[i], err);
+      jobs[i]->visitor = self;
+
+      // a cue with a single long file would otherwise leave the other
+      // workers idle, so let its encode spread across whatever they leave free
+      jobs[i]->threads = num_files == 1 ? self->encode_jobs : 1;
+
+      // when a cue is converted again, only redo the files that changed
+      if (is_track_fresh(self, entry, jobs[i])) {
+        jobs[i]->up_to_date = 1;
+
+        buf = msnprintf("Kept up to date file: %s", trg_path);
+        ERR_REGION_NULL_CHECK(buf, err);
+        ERR_REGION_NULL_CHECK(cue_sheet_process_result_add_status(record->result, buf), err);
+        SAFE_FREE(buf);
       }
 
       SAFE_FREE(trg_path);
@@ -338,8 +933,70 @@ static errno_t process_track_files(cue_traverse_visitor_t* self, cue_traverse_re
 
     } ERR_REGION_ERROR_BUBBLE(err);
 
+    if (self->copy_pool) {
+      ERR_REGION_ERROR_CHECK(wait_group_init(&group), err);
+      grouped = 1;
+      wait_group_add(&group, num_files);
+
+      for (; started < num_files; ++started) {
+        cue_track_job_t* job = jobs[started];
+        worker_pool_t* pool = job->src_type == job->trg_type ? self->copy_pool : self->encode_pool;
+
+        job->group = &group;
+        ERR_REGION_ERROR_CHECK(worker_pool_submit(pool, run_track_job, job), err);
+      } ERR_REGION_ERROR_BUBBLE(err);
+
+      wait_group_wait(&group);
+    }
+    else {
+      // stop at the first failure, as there is nothing else in flight
+      for (; started < num_files; ++started) {
+        run_track_job(jobs[started], 0);
+        if (jobs[started]->err) break;
+      }
+    }
+
+    // record every file that was reused or failed, in cue order
+    for (short i = 0; i < num_files; ++i) {
+      if (source_hashes && jobs[i]->hashed) source_hashes[i] = jobs[i]->src_hash;
+
+      if (jobs[i]->reused) {
+        buf = msnprintf("Reused stored file: %s", jobs[i]->trg_path);
+        ERR_REGION_NULL_CHECK(buf, err);
+        ERR_REGION_NULL_CHECK(cue_sheet_process_result_add_status(record->result, buf), err);
+        SAFE_FREE(buf);
+      }
+
+      if (!jobs[i]->err) continue;
+
+      buf = msnprintf("Failed to create file: %s", jobs[i]->trg_path);
+      ERR_REGION_NULL_CHECK(buf, err);
+      ERR_REGION_NULL_CHECK(cue_sheet_process_result_add_error(record->result, buf), err);
+      SAFE_FREE(buf);
+
+      if (!err) err = jobs[i]->err;
+    } ERR_REGION_ERROR_BUBBLE(err);
+
   } ERR_REGION_END()
 
+  if (grouped) {
+    // account for anything that never made it into the pool, then make
+    // sure no worker is still using a job before releasing them
+    for (; started < num_files; ++started) {
+      wait_group_done(&group);
+    }
+    wait_group_wait(&group);
+    wait_group_uninit(&group);
+  }
+
+  if (jobs) {
+    for (short i = 0; i < num_files; ++i) {
+      SAFE_FREE_HANDLER(jobs[i], cue_track_job_free);
+    }
+  }
+
+  SAFE_FREE(jobs);
+  SAFE_FREE(buf);
   SAFE_FREE(src_path);
   SAFE_FREE(trg_path);
   SAFE_FREE(src_dir);
@@ -348,15 +1005,204 @@ static errno_t process_track_files(cue_traverse_visitor_t* self, cue_traverse_re
   return err;
 }
 
+// whether the target of a track job still matches its source.  a copy
+// keeps the time of its source, so it only has to be the same size and no
+// older.  an encode can't be compared with its source directly, so both
+// have to be just as the manifest recorded them, at this quality
+static short is_track_fresh(cue_traverse_visitor_t* self,
+  cue_manifest_entry_t const* entry, cue_track_job_t const* job) {
+
+  unsigned long long src_size = 0, src_mtime = 0;
+  unsigned long long trg_size = 0, trg_mtime = 0;
+  cue_manifest_file_t const* source = 0;
+  cue_manifest_file_t const* output = 0;
+
+  if (file_size(job->trg_path, &trg_size) || file_mtime(job->trg_path, &trg_mtime)) return 0;
+  if (file_size(job->src_path, &src_size) || file_mtime(job->src_path, &src_mtime)) return 0;
+
+  // a copy keeps the time of its source, so any other time, earlier or
+  // later, means one of them changed since, as with a source restored from
+  // an older backup
+  if (job->src_type == job->trg_type) return trg_size == src_size && trg_mtime == src_mtime;
+
+  // an encode finished by a run that stopped before its cue was done
+  if (self->journal && is_track_journaled(self, job, src_size, src_mtime, trg_size, trg_mtime)) return 1;
+
+  if (!entry || entry->quality != self->quality) return 0;
+
+  source = cue_manifest_find_source(self->manifest, entry, job->src_path);
+  output = cue_manifest_find_output(self->manifest, entry, job->trg_path);
+
+  return source && source->size == src_size && source->mtime == src_mtime
+    && output && output->size == trg_size && output->mtime == trg_mtime;
+}
+
+static short is_track_journaled(cue_traverse_visitor_t* self, cue_track_job_t const* job,
+  unsigned long long src_size, unsigned long long src_mtime,
+  unsigned long long trg_size, unsigned long long trg_mtime) {
+
+  cue_journal_entry_t const* entry = cue_journal_find(self->journal, job->trg_path);
+
+  return entry && entry->quality == self->quality
+    && entry->source_size == src_size && entry->source_mtime == src_mtime
+    && entry->size == trg_size && entry->mtime == trg_mtime;
+}
+
+// the store key for a track job.  encodes of the same content at other
+// settings differ, and so do copies of it.  the source is hashed here, so
+// the job keeps that hash for the manifest
+static errno_t track_key(cue_traverse_visitor_t* self, cue_track_job_t* job, unsigned long long* key) {
+  errno_t err = 0;
+  char* params = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_ERROR_CHECK(hash_file(job->src_path, &job->src_hash), err);
+    job->hashed = 1;
+
+    if (job->src_type == job->trg_type) {
+      ERR_REGION_NULL_CHECK(params = msnprintf("copy"), err);
+    }
+    else {
+      ERR_REGION_NULL_CHECK(params = msnprintf("encode %d to %d at %.9g",
+        (int)job->src_type, (int)job->trg_type, self->quality), err);
+    }
+
+    *key = cue_store_key(job->src_hash, params);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE(params);
+
+  return err;
+}
+
+static void run_track_job(void* arg, size_t worker) {
+  cue_track_job_t* job = (cue_track_job_t*)arg;
+  cue_traverse_visitor_t* self = job->visitor;
+  unsigned long long key = 0;
+  short keyed = 0;
+  char const* part_path = 0;
+
+  // track jobs keep nothing of their own worker's
+  (void)worker;
+
+  if (!job->up_to_date) {
+    // the target is made aside and renamed into place once whole, so a run
+    // that stops part way never leaves a partial file under a real name
+    part_path = path_part_file(job->trg_path);
+    if (!part_path) job->err = -1;
+
+    // a part left by a stopped run may be linked into the store, and writing
+    // through the link would change the stored file too
+    if (!job->err && directory_cache_file_exists(self->target_cache, part_path)) {
+      job->err = delete_file(part_path);
+    }
+  }
+
+  // a file that can't be keyed is just made as it would be without a store.
+  // linking to the source is as cheap as fetching from the store
+  if (!job->up_to_date && !job->err && self->store
+    && !(job->src_type == job->trg_type && self->copy_strategy == EWC_CS_LINK)) {
+    keyed = !track_key(self, job, &key);
+    job->reused = keyed && !cue_store_fetch(self->store, key, part_path);
+  }
+
+  if (job->up_to_date || job->err || job->reused) {
+    // nothing to make
+  }
+  else if (job->src_type == job->trg_type) {
+    // the copy hashes the source too, from the cache where the system
+    // moved the bytes, so the manifest needn't read it again
+    job->err = copy_file_as(job->src_path, part_path, self->copy_strategy,
+      job->hashed ? NULL : &job->src_hash);
+    job->hashed = job->hashed || !job->err;
+  }
+  else {
+    int threads = claim_encode_threads(self, job->threads);
+
+    job->err = convert_file(self,
+      job->src_path, job->src_type,
+      job->trg_path, part_path, job->trg_type,
+      threads);
+
+    release_encode_threads(self, threads);
+  }
+
+  if (!job->up_to_date && !job->err) {
+    // replacing the name rather than writing through it also leaves any
+    // old target linked into the store untouched
+    job->err = replace_file(part_path, job->trg_path);
+  }
+
+  if (!job->up_to_date && job->err && part_path) {
+    // leave the old target be, and drop whatever was made of the new one
+    delete_file(part_path);
+  }
+
+  // a file that couldn't be stored is just made again when next needed
+  if (!job->up_to_date && !job->err && !job->reused && keyed) {
+    cue_store_add(self->store, key, job->trg_path);
+  }
+
+  if (!job->up_to_date && !job->err) {
+    job->err = directory_cache_add_file(self->target_cache, job->trg_path);
+  }
+
+  // only encodes are journaled, since a copy is judged fresh by its size and
+  // time alone.  an output that isn't journaled is just made again if the run
+  // doesn't finish
+  if (!job->up_to_date && !job->err && self->journal && job->src_type != job->trg_type) {
+    cue_journal_add(self->journal, job->trg_path, job->src_path, self->quality);
+  }
+
+  SAFE_FREE(part_path);
+
+  if (job->group) wait_group_done(job->group);
+}
+
+// takes up to wanted of the encode threads, and at least one, waiting for
+// one to be free.  every encode holds at least one while it runs, so with as
+// many threads as pool workers, a wait only lasts while another encode has
+// spread across several, and the pool never runs more than encode_jobs
+static int claim_encode_threads(cue_traverse_visitor_t* self, int wanted) {
+  int claimed = 0;
+
+  if (!self->encode_lock) return wanted;
+
+  th_mutex_lock(self->encode_lock);
+
+  while (!self->free_encode_threads) {
+    th_cond_wait(self->encode_threads_freed, self->encode_lock);
+  }
+
+  claimed = wanted < 1 ? 1 : wanted;
+  if (claimed > self->free_encode_threads) claimed = self->free_encode_threads;
+  self->free_encode_threads -= claimed;
+
+  th_mutex_unlock(self->encode_lock);
+
+  return claimed;
+}
+
+static void release_encode_threads(cue_traverse_visitor_t* self, int claimed) {
+  if (!self->encode_lock) return;
+
+  th_mutex_lock(self->encode_lock);
+  self->free_encode_threads += claimed;
+  th_cond_broadcast(self->encode_threads_freed);
+  th_mutex_unlock(self->encode_lock);
+}
+
 static errno_t convert_file(
   cue_traverse_visitor_t* self,
   char const* src_path, cue_file_type_t src_type,
-  char const* trg_path, cue_file_type_t trg_type) {
+  char const* trg_path, char const* out_path, cue_file_type_t trg_type,
+  int threads) {
 
   errno_t err = 0;
 
   if (trg_type == EWC_CFT_OGG) {
-    err = convert_to_ogg(self, src_path, src_type, trg_path);
+    err = convert_to_ogg(self, src_path, src_type, trg_path, out_path, threads);
   }
   else
   {
@@ -367,60 +1213,72 @@ static errno_t convert_file(
   return err;
 }
 
-#define FLOAT_BUF_LEN (10)
-
 static errno_t convert_to_ogg(
   cue_traverse_visitor_t* self,
   char const *src_path, cue_file_type_t src_type, 
-  char const* trg_path) {
+  char const* trg_path, char const* out_path, int threads) {
 
   errno_t err = 0;
-  string_vector_t *argv = 0;
+  oggenc_params_t params;
+
+  memset(&params, 0, sizeof(params));
+  params.quality = self->quality;
+  params.serial = stream_serial(trg_path);
+  params.threads = threads;
+  params.pipeline = ENCODE_PIPELINE_DEPTH;
+  params.write_buffer = ENCODE_WRITE_BUFFER;
+  params.write_behind = 1;
+  params.in_path = src_path;
+  params.out_path = out_path;
+
+  // configure the input for oggenc
+  switch (src_type) {
+    case EWC_CFT_BINARY:
+      params.format = OGGENC_INPUT_RAW;
+      break;
 
-  char buf[FLOAT_BUF_LEN];
+    case EWC_CFT_WAV:
+      params.format = OGGENC_INPUT_WAV;
+      break;
 
-  snprintf(buf, FLOAT_BUF_LEN, "%.2g", self->quality);
+    default:
+      // we don't know how to do this
+      return -1;
+  }
 
-  ERR_REGION_BEGIN() {
-    ERR_REGION_NULL_CHECK(argv = string_vector_alloc(), err);
-    ERR_REGION_NULL_CHECK(argv->push(argv, "oggenc"), err);
-    
-    // configure the arguments for oggenc
-    switch (src_type) {
-      case EWC_CFT_BINARY: {
-        ERR_REGION_NULL_CHECK(argv->push(argv, "-Q"), err);
-        ERR_REGION_NULL_CHECK(argv->push(argv, "--utf8"), err);
-        ERR_REGION_NULL_CHECK(argv->push(argv, "-r"), err);
-        ERR_REGION_NULL_CHECK(argv->push(argv, "-q"), err);
-        ERR_REGION_NULL_CHECK(argv->push(argv, buf), err);
-        ERR_REGION_NULL_CHECK(argv->push(argv, "-o"), err);
-        ERR_REGION_NULL_CHECK(argv->push(argv, trg_path), err);
-        ERR_REGION_NULL_CHECK(argv->push(argv, src_path), err);
-      }
-      break;
+  // invoke oggenc
+  err = encode_with_params(&params);
 
-      case EWC_CFT_WAV: {
-        ERR_REGION_NULL_CHECK(argv->push(argv, "-Q"), err);
-        ERR_REGION_NULL_CHECK(argv->push(argv, "--utf8"), err);
-        ERR_REGION_NULL_CHECK(argv->push(argv, "-q"), err);
-        ERR_REGION_NULL_CHECK(argv->push(argv, buf), err);
-        ERR_REGION_NULL_CHECK(argv->push(argv, "-o"), err);
-        ERR_REGION_NULL_CHECK(argv->push(argv, trg_path), err);
-        ERR_REGION_NULL_CHECK(argv->push(argv, src_path), err);
-      }
-      break;
+  return err;
+}
 
-      default:
-        // we don't know how to do this
-        err = -1;
-    } ERR_REGION_ERROR_BUBBLE(err);
+static unsigned int stream_serial(char const* path) {
+  // derive the serial from the target so that repeat runs produce the same bytes
+  unsigned int hash = 2166136261u;
+
+  for (; *path; ++path) {
+    hash ^= (unsigned char)*path;
+    hash *= 16777619u;
+  }
 
-    // invoke oggenc
-    ERR_REGION_ERROR_CHECK(encode_with_arguments(argv->get_length(argv), argv->get_buffer(argv)), err);
+  return hash;
+}
 
-  } ERR_REGION_END ()
+static short in_shard(cue_traverse_visitor_t const* self, char const* src_path) {
+  // hash the path under the source directory, so that machines mounting the
+  // collection in different places still agree on the shards
+  unsigned long long hash = 14695981039346656037ull;
+  char const* path = 0;
 
-  SAFE_FREE_HANDLER(argv, string_vector_free);
+  if (self->num_shards < 2) return 1;
 
-  return err;
+  for (path = path_relative_part(self->source_path, src_path); *path; ++path) {
+    // either separator hashes the same
+    unsigned char c = (unsigned char)(*path == '\\' ? '/' : *path);
+
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+
+  return (short)(hash % self->num_shards == self->shard - 1);
 }
@@ -1,14 +1,28 @@
 #pragma once
 
 #include <stddef.h>
+#include <time.h>
 
 #include "parallel_visitor.h"
+#include "filesystem.h"
 
 struct cue_sheet;
 struct cue_traverse_record;
 struct cue_traverse_record_vector;
 struct cue_traverse_report;
+struct cue_traverse_report_collector;
+struct cue_traverse_job_vector;
 struct line_writer;
+struct worker_pool;
+struct th_mutex;
+struct th_cond;
+struct cue_manifest;
+struct cue_store;
+struct cue_journal;
+struct cue_claims;
+struct cue_sheet_cache;
+struct directory_cache;
+struct directory_traversal_options;
 
 typedef struct cue_traverse_visitor_opts {
   char const* target_path;  // weak ref
@@ -19,6 +33,18 @@ typedef struct cue_traverse_visitor_opts {
   struct line_writer *writer;  // weak ref
   char const * const *filters;  // weak ref
   int num_filters;
+  int jobs;  // cues converted at once, 1 or less converts inline
+  int copy_jobs;  // files copied at once across all cues, 1 or less copies in cue order
+  int encode_jobs;  // files encoded at once across all cues, 1 or less encodes in cue order
+  copy_strategy_t copy_strategy;  // how files that need no converting are copied
+  int scan_threads;  // threads the traversal visits from, 1 or less visits from one
+  size_t shard;  // 1 based share of the cues to convert, when num_shards is set
+  size_t num_shards;  // 0 converts every cue
+  struct cue_manifest* manifest;  // weak ref, NULL decides by the target alone
+  struct cue_store* store;  // weak ref, NULL makes every file
+  struct cue_journal* journal;  // weak ref, NULL records nothing of a run that may not finish
+  struct cue_claims* claims;  // weak ref, NULL converts every cue found, without claiming it
+  struct cue_sheet_cache* sheet_cache;  // weak ref, NULL parses every cue
 } cue_traverse_visitor_opts_t;
 
 typedef struct cue_traverse_visitor {
@@ -31,9 +57,50 @@ typedef struct cue_traverse_visitor {
   struct line_writer* writer;  // weak ref
   char const* const* filters;  // weak ref
   int num_filters;
+  int encode_jobs;
+  copy_strategy_t copy_strategy;
+  size_t shard;
+  size_t num_shards;
+  struct cue_manifest* manifest;  // weak ref, loaded by the caller, which saves it after finish
+  struct cue_store* store;  // weak ref
+  struct cue_journal* journal;  // weak ref, loaded by the caller, which flushes it after finish
+  struct cue_claims* claims;  // weak ref
+  struct cue_sheet_cache* sheet_cache;  // weak ref, loaded by the caller, which saves it after finish
+  struct directory_cache* target_cache;  // owned, what is known of the target directories
+  struct worker_pool* pool;  // owned, NULL when converting inline
+  // copies are disk bound and encodes cpu bound, so each has its own limit.
+  // both are NULL when files are processed in order
+  struct worker_pool* copy_pool;  // owned
+  struct worker_pool* encode_pool;  // owned
+  // encode_jobs threads are shared by every encode in flight, so one that
+  // spreads across several leaves the others fewer
+  struct th_mutex* encode_lock;  // owned, guards free_encode_threads, NULL without an encode pool
+  struct th_cond* encode_threads_freed;  // owned
+  int free_encode_threads;
+  struct cue_traverse_job_vector* pending;  // owned, queued jobs in discovery order
+  struct cue_traverse_report_collector* collector;  // owned, shard 0 for the traversal, then one per worker
+  size_t sequence;  // discovery order of the next cue found
+  struct th_mutex* output_lock;  // owned, guards writer and progress when pooled
+  struct th_mutex* visit_lock;  // owned, lets one thread at a time handle a cue, NULL when only one visits
+  unsigned long long total_work;  // estimated cost of every job, known before any starts
+  unsigned long long done_work;
+  size_t total_jobs;
+  size_t done_jobs;
+  time_t start_time;  // when the first job was started
 } cue_traverse_visitor_t;
 
 errno_t cue_traverse_visitor_init(cue_traverse_visitor_t* self, cue_traverse_visitor_opts_t const *opts);
+// run the conversions found, largest first, then add them
+// all to the report in discovery order, or by source path when several
+// threads found them
+errno_t cue_traverse_visitor_finish(cue_traverse_visitor_t* self);
+// starts another pass, into target_path, after finish.  the pools and
+// everything the options named carry on, while the report, which replaces
+// any not detached, and what is known of the target start afresh
+errno_t cue_traverse_visitor_restart(cue_traverse_visitor_t* self, char const* target_path);
 struct cue_traverse_report* cue_traverse_visitor_detach_report(cue_traverse_visitor_t* self);
 void cue_traverse_visitor_uninit(cue_traverse_visitor_t* self);
+// narrows a traversal to the cue files, which are all the visitor is to be
+// handed
+void cue_traverse_visitor_filter(struct directory_traversal_options* opts);
 
@@ -0,0 +1,91 @@
+#include "cue_traverse_job.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "err_helpers.h"
+#include "mem_helpers.h"
+#include "cue_traverse_record.h"
+
+static void* acquire(void const* instance);
+static void release(void* instance);
+static int compare_jobs(void const* lhs, void const* rhs);
+
+struct object_vector_params cue_traverse_job_vector_ops = {
+  acquire,
+  release,
+};
+
+static void release(void* instance) {
+  cue_traverse_job_free((cue_traverse_job_t*)instance);
+}
+
+static void* acquire(void const* instance) {
+  return (void*)instance;
+}
+
+IMPLEMENT_OBJECT_VECTOR(cue_traverse_job_vector, cue_traverse_job_t)
+
+cue_traverse_job_t* cue_traverse_job_alloc(struct cue_traverse_record* record, short overwriting) {
+  cue_traverse_job_t* self = malloc(sizeof(*self));
+  if (!self) return NULL;
+
+  memset(self, 0, sizeof(*self));
+  self->record = record;
+  self->overwriting = overwriting;
+
+  return self;
+}
+
+struct cue_traverse_record* cue_traverse_job_detach_record(cue_traverse_job_t* self) {
+  struct cue_traverse_record* record = self->record;
+  self->record = NULL;
+  return record;
+}
+
+void cue_traverse_job_free(cue_traverse_job_t* self) {
+  SAFE_FREE_HANDLER(self->record, cue_traverse_record_free);
+  SAFE_FREE(self);
+}
+
+void cue_traverse_jobs_sort_largest_first(cue_traverse_job_t** jobs, size_t length) {
+  qsort(jobs, length, sizeof(*jobs), compare_jobs);
+}
+
+static int compare_jobs(void const* lhs, void const* rhs) {
+  cue_traverse_job_t const* a = *(cue_traverse_job_t const* const*)lhs;
+  cue_traverse_job_t const* b = *(cue_traverse_job_t const* const*)rhs;
+
+  if (a->work != b->work) return a->work < b->work ? 1 : -1;
+  if (a->sequence != b->sequence) return a->sequence < b->sequence ? -1 : 1;
+  return 0;
+}
+
+cue_track_job_t* cue_track_job_alloc(
+  char const* src_path, cue_file_type_t src_type,
+  char const* trg_path, cue_file_type_t trg_type) {
+
+  errno_t err = 0;
+  cue_track_job_t* self = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(self = malloc(sizeof(*self)), err);
+    memset(self, 0, sizeof(*self));
+
+    ERR_REGION_NULL_CHECK(self->src_path = _strdup(src_path), err);
+    ERR_REGION_NULL_CHECK(self->trg_path = _strdup(trg_path), err);
+    self->src_type = src_type;
+    self->trg_type = trg_type;
+
+  } ERR_REGION_END()
+
+  if (err) SAFE_FREE_HANDLER(self, cue_track_job_free);
+
+  return self;
+}
+
+void cue_track_job_free(cue_track_job_t* self) {
+  SAFE_FREE(self->src_path);
+  SAFE_FREE(self->trg_path);
+  SAFE_FREE(self);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "object_vector.h"
+#include "cue_file.h"
+
+#include <stddef.h>
+
+struct cue_traverse_record;
+struct cue_traverse_visitor;
+struct wait_group;
+
+typedef struct cue_traverse_job {
+  struct cue_traverse_visitor* visitor;  // weak ref
+  struct cue_traverse_record* record;  // owned until handed to a report
+  short overwriting;
+  short transformed;
+  short claimed_elsewhere;  // another process converted the cue, or is converting it
+  errno_t load_err;
+  errno_t write_err;
+  errno_t report_err;
+  unsigned long long work;  // estimated cost, used to start the biggest jobs first
+  size_t sequence;  // discovery order, breaks ties between equal estimates
+} cue_traverse_job_t;
+
+cue_traverse_job_t* cue_traverse_job_alloc(struct cue_traverse_record* record, short overwriting);
+struct cue_traverse_record* cue_traverse_job_detach_record(cue_traverse_job_t* self);
+void cue_traverse_job_free(cue_traverse_job_t* self);
+// orders an array of weak refs largest estimate first, and equal estimates
+// in discovery order
+void cue_traverse_jobs_sort_largest_first(cue_traverse_job_t** jobs, size_t length);
+
+extern struct object_vector_params cue_traverse_job_vector_ops;
+
+typedef struct cue_traverse_job_vector {
+  object_vector_t vector_t;
+  INSERT_OBJECT_VECTOR_METHODS(cue_traverse_job_vector, cue_traverse_job_t)
+} cue_traverse_job_vector_t;
+
+DECLARE_OBJECT_VECTOR(cue_traverse_job_vector, cue_traverse_job_t)
+
+// copies or converts one file referenced by a cue
+typedef struct cue_track_job {
+  struct cue_traverse_visitor* visitor;  // weak ref
+  struct wait_group* group;  // weak ref, notified when the job completes
+  char const* src_path;  // owned
+  char const* trg_path;  // owned
+  cue_file_type_t src_type;
+  cue_file_type_t trg_type;
+  int threads;  // threads a single encode would like, as many as are free are used
+  short up_to_date;  // the target is already fresh, so the job does nothing
+  short reused;  // the target came from the store rather than being made
+  short hashed;  // the source was read whole along the way, giving src_hash
+  unsigned long long src_hash;  // the hash_file value of the source
+  errno_t err;
+} cue_track_job_t;
+
+cue_track_job_t* cue_track_job_alloc(
+  char const* src_path, cue_file_type_t src_type,
+  char const* trg_path, cue_file_type_t trg_type);
+void cue_track_job_free(cue_track_job_t* self);
@@ -0,0 +1,288 @@
+#include "cue_traverse_partial_report.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cue_traverse_report.h"
+#include "cue_traverse_report_collector.h"
+#include "cue_traverse_record.h"
+#include "cue_status_info.h"
+#include "line_reader.h"
+#include "line_writer.h"
+#include "err_helpers.h"
+#include "mem_helpers.h"
+
+static errno_t write_records(
+  struct line_writer* writer,
+  struct cue_traverse_record_vector* list,
+  cue_traverse_report_type_t type);
+static char const* skip_prefix(char const* line, char const* prefix);
+static errno_t parse_cue(char const* arg, cue_traverse_report_type_t* type, size_t* sequence);
+static errno_t parse_info(cue_traverse_record_t* record, char const* line);
+static errno_t replace_path(char const** path, char const* value);
+static errno_t add_record(
+  struct cue_traverse_report_collector* collector,
+  size_t collector_shard,
+  cue_traverse_record_t** record,
+  cue_traverse_report_type_t type);
+
+static const char s_header[] = "PARTIAL CONVERSION REPORT";
+static const char s_footer[] = "END OF REPORT";
+static const char s_shard[] = "Shard: ";
+static const char s_cue[] = "Cue: ";
+static const char s_source[] = "Source: ";
+static const char s_target[] = "Target: ";
+static const char s_status[] = "Status: ";
+static const char s_error[] = "Error: ";
+static const char s_parse_error[] = "Parse error: ";
+
+// indexed by cue_traverse_report_type_t
+static char const* const s_type_names[] = {
+  "transformed",
+  "failed",
+  "skipped",
+};
+
+errno_t cue_traverse_partial_report_write(
+  struct line_writer* writer,
+  struct cue_traverse_report const* report,
+  size_t shard,
+  size_t num_shards) {
+
+  errno_t err = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_CMP_CHECK(!line_writer_write_fmt(writer, "%s", s_header), err);
+    ERR_REGION_CMP_CHECK(!line_writer_write_fmt(writer, "%s%zu/%zu", s_shard, shard, num_shards), err);
+
+    ERR_REGION_ERROR_CHECK(write_records(writer, report->transformed_list, EWC_CTR_TRANSFORMED), err);
+    ERR_REGION_ERROR_CHECK(write_records(writer, report->failed_list, EWC_CTR_FAILED), err);
+    ERR_REGION_ERROR_CHECK(write_records(writer, report->skipped_list, EWC_CTR_SKIPPED), err);
+
+    // lets the reader tell a finished shard from one that was cut short
+    ERR_REGION_CMP_CHECK(!line_writer_write_fmt(writer, "%s", s_footer), err);
+
+  } ERR_REGION_END()
+
+  return err;
+}
+
+static errno_t write_records(
+  struct line_writer* writer,
+  struct cue_traverse_record_vector* list,
+  cue_traverse_report_type_t type) {
+
+  errno_t err = 0;
+
+  ERR_REGION_BEGIN() {
+    for (size_t i = 0; i < list->get_length(list); ++i) {
+      cue_traverse_record_t const* record = list->get(list, i);
+
+      ERR_REGION_CMP_CHECK(!line_writer_write_fmt(writer, "%s%s %zu", s_cue, s_type_names[type], record->sequence), err);
+      ERR_REGION_CMP_CHECK(!line_writer_write_fmt(writer, "%s%s", s_source, record->source_path), err);
+      ERR_REGION_CMP_CHECK(!line_writer_write_fmt(writer, "%s%s", s_target, record->target_path), err);
+
+      cue_status_info_vector_t* info_list = record->result->info_list;
+      for (size_t j = 0; j < info_list->get_length(info_list); ++j) {
+        cue_status_info_t const* info = info_list->get(info_list, j);
+
+        switch (info->type) {
+          case EWC_CST_STATUS:
+            ERR_REGION_CMP_CHECK(!line_writer_write_fmt(writer, "%s%s", s_status, info->detail), err);
+            break;
+
+          case EWC_CST_ERROR:
+            ERR_REGION_CMP_CHECK(!line_writer_write_fmt(writer, "%s%s", s_error, info->detail), err);
+            break;
+
+          case EWC_CST_PARSE_ERROR:
+            ERR_REGION_CMP_CHECK(!line_writer_write_fmt(writer, "%s%zu: %s", s_parse_error,
+              info->line_num, info->detail), err);
+            break;
+
+          default:
+            break;
+        }
+      } ERR_REGION_ERROR_BUBBLE(err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+  } ERR_REGION_END()
+
+  return err;
+}
+
+errno_t cue_traverse_partial_report_read(
+  struct line_reader* reader,
+  struct cue_traverse_report_collector* collector,
+  size_t collector_shard,
+  size_t* shard,
+  size_t* num_shards) {
+
+  errno_t err = 0;
+  char const* line = 0;
+  size_t bytes = 0;
+  char const* arg = 0;
+  short has_header = 0;
+  short has_shard = 0;
+  short has_footer = 0;
+  size_t read_shard = 0;
+  size_t read_num_shards = 0;
+  cue_traverse_record_t* record = 0;
+  cue_traverse_report_type_t type = EWC_CTR_TRANSFORMED;
+
+  ERR_REGION_BEGIN() {
+    while (reader->read_line(reader, &line, &bytes) != (size_t)EOF) {
+      ERR_REGION_NULL_CHECK(line, err);
+
+      if (!*line) {
+        // blank lines carry nothing
+      }
+      else if (has_footer) {
+        // nothing may follow the end of the report
+        err = -1;
+      }
+      else if (!has_header) {
+        err = strcmp(line, s_header) ? -1 : 0;
+        has_header = 1;
+      }
+      else if (!has_shard) {
+        arg = skip_prefix(line, s_shard);
+        err = arg ? cue_traverse_partial_report_parse_shard(arg, &read_shard, &read_num_shards) : -1;
+        has_shard = 1;
+      }
+      else if (strcmp(line, s_footer) == 0) {
+        err = add_record(collector, collector_shard, &record, type);
+        has_footer = 1;
+      }
+      else if ((arg = skip_prefix(line, s_cue)) != 0) {
+        size_t sequence = 0;
+
+        // a new cue finishes the one before it
+        err = add_record(collector, collector_shard, &record, type);
+        if (!err) err = parse_cue(arg, &type, &sequence);
+        if (!err) {
+          record = cue_traverse_record_alloc_with_paths("", "");
+          if (record) record->sequence = sequence;
+          else err = -1;
+        }
+      }
+      else {
+        // everything else describes the current cue
+        err = record ? parse_info(record, line) : -1;
+      }
+
+      SAFE_FREE(line);
+      ERR_REGION_ERROR_BUBBLE(err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    ERR_REGION_CMP_CHECK(!has_footer, err);
+
+    *shard = read_shard;
+    *num_shards = read_num_shards;
+
+  } ERR_REGION_END()
+
+  SAFE_FREE(line);
+  SAFE_FREE_HANDLER(record, cue_traverse_record_free);
+
+  return err;
+}
+
+errno_t cue_traverse_partial_report_parse_shard(char const* arg, size_t* shard, size_t* num_shards) {
+  char* end = 0;
+  unsigned long long k = 0, n = 0;
+
+  k = strtoull(arg, &end, 10);
+  if (end == arg || *end != '/') return -1;
+
+  arg = end + 1;
+  n = strtoull(arg, &end, 10);
+  if (end == arg || *end) return -1;
+
+  if (k < 1 || k > n) return -1;
+
+  *shard = (size_t)k;
+  *num_shards = (size_t)n;
+  return 0;
+}
+
+static char const* skip_prefix(char const* line, char const* prefix) {
+  size_t len = strlen(prefix);
+  return strncmp(line, prefix, len) == 0 ? line + len : NULL;
+}
+
+static errno_t parse_cue(char const* arg, cue_traverse_report_type_t* type, size_t* sequence) {
+  char* end = 0;
+
+  for (int i = 0; i < EWC_CTR_LAST; ++i) {
+    char const* rest = skip_prefix(arg, s_type_names[i]);
+    if (!rest || *rest != ' ') continue;
+
+    ++rest;
+    unsigned long long value = strtoull(rest, &end, 10);
+    if (end == rest || *end) return -1;
+
+    *type = (cue_traverse_report_type_t)i;
+    *sequence = (size_t)value;
+    return 0;
+  }
+
+  return -1;
+}
+
+static errno_t parse_info(cue_traverse_record_t* record, char const* line) {
+  char const* arg = 0;
+
+  if ((arg = skip_prefix(line, s_source)) != 0) {
+    return replace_path(&record->source_path, arg);
+  }
+
+  if ((arg = skip_prefix(line, s_target)) != 0) {
+    return replace_path(&record->target_path, arg);
+  }
+
+  if ((arg = skip_prefix(line, s_status)) != 0) {
+    return cue_sheet_process_result_add_status(record->result, arg) ? 0 : -1;
+  }
+
+  if ((arg = skip_prefix(line, s_error)) != 0) {
+    return cue_sheet_process_result_add_error(record->result, arg) ? 0 : -1;
+  }
+
+  if ((arg = skip_prefix(line, s_parse_error)) != 0) {
+    char* end = 0;
+    unsigned long long line_num = strtoull(arg, &end, 10);
+    if (end == arg || strncmp(end, ": ", 2) != 0) return -1;
+
+    return cue_sheet_process_result_add_parse_error(record->result, (size_t)line_num, end + 2) ? 0 : -1;
+  }
+
+  return -1;
+}
+
+static errno_t replace_path(char const** path, char const* value) {
+  char const* copy = _strdup(value);
+  if (!copy) return -1;
+
+  SAFE_FREE(*path);
+  *path = copy;
+
+  return 0;
+}
+
+static errno_t add_record(
+  struct cue_traverse_report_collector* collector,
+  size_t collector_shard,
+  cue_traverse_record_t** record,
+  cue_traverse_report_type_t type) {
+
+  errno_t err = 0;
+
+  if (!*record) return err;
+
+  err = cue_traverse_report_collector_add_record(collector, collector_shard, (*record)->sequence, *record, type);
+  if (!err) *record = 0;
+
+  return err;
+}
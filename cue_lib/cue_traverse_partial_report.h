@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stddef.h>
+
+struct line_reader;
+struct line_writer;
+struct cue_traverse_report;
+struct cue_traverse_report_collector;
+
+// a partial report is what one shard of a conversion found.  unlike the
+// report writer output, it keeps everything needed to rebuild the records,
+// including their discovery order, so partial reports from every shard can
+// be merged into the report a single run would have produced
+
+// shard is 1 based, out of num_shards
+errno_t cue_traverse_partial_report_write(
+  struct line_writer* writer,
+  struct cue_traverse_report const* report,
+  size_t shard,
+  size_t num_shards);
+
+// adds the records of one partial report to collector_shard of the collector,
+// and returns which shard the report came from.  fails on a truncated report,
+// after which the collector shard may hold some of its records
+errno_t cue_traverse_partial_report_read(
+  struct line_reader* reader,
+  struct cue_traverse_report_collector* collector,
+  size_t collector_shard,
+  size_t* shard,
+  size_t* num_shards);
+
+// parses the k/N notation used for shards, with 1 <= k <= N
+errno_t cue_traverse_partial_report_parse_shard(char const* arg, size_t* shard, size_t* num_shards);
@@ -171,6 +171,7 @@ errno_t cue_traverse_record_copy_from(cue_traverse_record_t* self, cue_traverse_
     self->source_path = source_path;
     self->target_sheet = target_sheet;
     self->source_sheet = source_sheet;
+    self->sequence = src->sequence;
 
     SAFE_FREE_HANDLER(old_target_sheet, cue_sheet_free);
     SAFE_FREE_HANDLER(old_source_sheet, cue_sheet_free);
@@ -12,6 +12,7 @@ typedef struct cue_traverse_record {
   char const *source_path;
   struct cue_sheet* source_sheet;
   struct cue_sheet_process_result *result;
+  size_t sequence;  // discovery order of the cue within its traversal
 } cue_traverse_record_t;
 
 cue_traverse_record_t* cue_traverse_record_alloc(void);
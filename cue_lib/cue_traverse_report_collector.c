@@ -0,0 +1,187 @@
+#include "cue_traverse_report_collector.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "err_helpers.h"
+#include "mem_helpers.h"
+#include "cue_traverse_record.h"
+
+static void* acquire(void const* instance);
+static void release(void* instance);
+static int compare_entries(void const* lhs, void const* rhs);
+static int compare_entry_paths(void const* lhs, void const* rhs);
+
+struct object_vector_params cue_traverse_report_entry_vector_ops = {
+  acquire,
+  release,
+};
+
+static void release(void* instance) {
+  cue_traverse_report_entry_t* entry = (cue_traverse_report_entry_t*)instance;
+  SAFE_FREE_HANDLER(entry->record, cue_traverse_record_free);
+  SAFE_FREE(entry);
+}
+
+static void* acquire(void const* instance) {
+  return (void*)instance;
+}
+
+IMPLEMENT_OBJECT_VECTOR(cue_traverse_report_entry_vector, cue_traverse_report_entry_t)
+
+struct cue_traverse_report_collector* cue_traverse_report_collector_alloc(size_t num_shards) {
+  cue_traverse_report_collector_t* self = malloc(sizeof(*self));
+  if (!self) return NULL;
+
+  errno_t err = cue_traverse_report_collector_init(self, num_shards);
+  if (!err) return self;
+
+  SAFE_FREE(self);
+  return NULL;
+}
+
+errno_t cue_traverse_report_collector_init(struct cue_traverse_report_collector* self, size_t num_shards) {
+  errno_t err = 0;
+
+  memset(self, 0, sizeof(*self));
+
+  if (!num_shards) num_shards = 1;
+
+  ERR_REGION_BEGIN() {
+    self->shards = calloc(num_shards, sizeof(*self->shards));
+    ERR_REGION_NULL_CHECK(self->shards, err);
+
+    for (; self->num_shards < num_shards; ++self->num_shards) {
+      cue_traverse_report_entry_vector_t* shard = cue_traverse_report_entry_vector_alloc();
+      ERR_REGION_NULL_CHECK(shard, err);
+
+      self->shards[self->num_shards] = shard;
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    return err;
+
+  } ERR_REGION_END()
+
+  cue_traverse_report_collector_uninit(self);
+
+  return err;
+}
+
+void cue_traverse_report_collector_uninit(struct cue_traverse_report_collector* self) {
+  if (self->shards) {
+    for (size_t i = 0; i < self->num_shards; ++i) {
+      SAFE_FREE_HANDLER(self->shards[i], cue_traverse_report_entry_vector_free);
+    }
+  }
+
+  self->num_shards = 0;
+  SAFE_FREE(self->shards);
+}
+
+void cue_traverse_report_collector_free(struct cue_traverse_report_collector* self) {
+  cue_traverse_report_collector_uninit(self);
+  SAFE_FREE(self);
+}
+
+errno_t cue_traverse_report_collector_add_record(
+  struct cue_traverse_report_collector* self,
+  size_t shard,
+  size_t sequence,
+  struct cue_traverse_record* record,
+  cue_traverse_report_type_t type) {
+
+  errno_t err = 0;
+  cue_traverse_report_entry_t* entry = 0;
+  cue_traverse_report_entry_vector_t* entries = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_CMP_CHECK(shard >= self->num_shards, err);
+    entries = self->shards[shard];
+
+    ERR_REGION_NULL_CHECK(entry = malloc(sizeof(*entry)), err);
+    entry->sequence = sequence;
+    entry->type = type;
+    entry->record = record;
+
+    ERR_REGION_NULL_CHECK(entries->push(entries, entry), err);
+
+    return err;
+
+  } ERR_REGION_END()
+
+  // the caller keeps the record on failure
+  SAFE_FREE(entry);
+
+  return err;
+}
+
+errno_t cue_traverse_report_collector_merge(
+  struct cue_traverse_report_collector* self,
+  struct cue_traverse_report* report) {
+
+  errno_t err = 0;
+  cue_traverse_report_entry_t** order = 0;
+  size_t length = 0;
+
+  ERR_REGION_BEGIN() {
+    for (size_t i = 0; i < self->num_shards; ++i) {
+      length += self->shards[i]->get_length(self->shards[i]);
+    }
+
+    if (!length) return err;
+
+    order = malloc(length * sizeof(*order));
+    ERR_REGION_NULL_CHECK(order, err);
+
+    size_t gathered = 0;
+    for (size_t i = 0; i < self->num_shards; ++i) {
+      cue_traverse_report_entry_vector_t* entries = self->shards[i];
+      size_t shard_length = entries->get_length(entries);
+
+      memcpy(order + gathered, entries->get_buffer(entries), shard_length * sizeof(*order));
+      gathered += shard_length;
+    }
+
+    qsort(order, length, sizeof(*order), self->by_path ? compare_entry_paths : compare_entries);
+
+    for (size_t i = 0; i < length; ++i) {
+      cue_traverse_report_entry_t* entry = order[i];
+
+      ERR_REGION_NULL_CHECK(
+        cue_traverse_report_add_record(report, entry->record, entry->type),
+        err);
+      entry->record = 0;
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE(order);
+
+  // the records now belong to the report, so just release the entries.
+  // after a failure, whatever wasn't merged stays with the collector
+  if (!err) {
+    for (size_t i = 0; i < self->num_shards; ++i) {
+      cue_traverse_report_entry_vector_t* entries = self->shards[i];
+      while (entries->get_length(entries)) {
+        entries->pop(entries);
+      }
+    }
+  }
+
+  return err;
+}
+
+static int compare_entries(void const* lhs, void const* rhs) {
+  cue_traverse_report_entry_t const* a = *(cue_traverse_report_entry_t const* const*)lhs;
+  cue_traverse_report_entry_t const* b = *(cue_traverse_report_entry_t const* const*)rhs;
+
+  if (a->sequence != b->sequence) return a->sequence < b->sequence ? -1 : 1;
+  return 0;
+}
+
+static int compare_entry_paths(void const* lhs, void const* rhs) {
+  cue_traverse_report_entry_t const* a = *(cue_traverse_report_entry_t const* const*)lhs;
+  cue_traverse_report_entry_t const* b = *(cue_traverse_report_entry_t const* const*)rhs;
+
+  return strcmp(a->record->source_path, b->record->source_path);
+}
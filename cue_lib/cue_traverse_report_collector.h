@@ -0,0 +1,53 @@
+#pragma once
+
+#include "object_vector.h"
+#include "cue_traverse_report.h"
+
+#include <stddef.h>
+
+struct cue_traverse_record;
+
+typedef struct cue_traverse_report_entry {
+  size_t sequence;  // discovery order of the cue
+  cue_traverse_report_type_t type;
+  struct cue_traverse_record* record;  // owned until merged into a report
+} cue_traverse_report_entry_t;
+
+extern struct object_vector_params cue_traverse_report_entry_vector_ops;
+
+typedef struct cue_traverse_report_entry_vector {
+  object_vector_t vector_t;
+  INSERT_OBJECT_VECTOR_METHODS(cue_traverse_report_entry_vector, cue_traverse_report_entry_t)
+} cue_traverse_report_entry_vector_t;
+
+DECLARE_OBJECT_VECTOR(cue_traverse_report_entry_vector, cue_traverse_report_entry_t)
+
+// gathers records from several threads, each adding to a shard of its own
+// without locking, then merges them into a report in discovery order, so
+// the report matches one filled by a single thread
+typedef struct cue_traverse_report_collector {
+  struct cue_traverse_report_entry_vector** shards;  // owned
+  size_t num_shards;
+  // records found by several threads at once have no discovery order to
+  // keep, so they are merged by source path instead, the same every run
+  short by_path;
+} cue_traverse_report_collector_t;
+
+struct cue_traverse_report_collector* cue_traverse_report_collector_alloc(size_t num_shards);
+errno_t cue_traverse_report_collector_init(struct cue_traverse_report_collector* self, size_t num_shards);
+void cue_traverse_report_collector_uninit(struct cue_traverse_report_collector* self);
+void cue_traverse_report_collector_free(struct cue_traverse_report_collector* self);
+
+// takes the record on success.  only one thread may use a shard at a time
+errno_t cue_traverse_report_collector_add_record(
+  struct cue_traverse_report_collector* self,
+  size_t shard,
+  size_t sequence,
+  struct cue_traverse_record* record,
+  cue_traverse_report_type_t type);
+
+// moves every collected record into report, ordered by sequence, or by
+// source path when by_path is set.  the shards must no longer be in use
+errno_t cue_traverse_report_collector_merge(
+  struct cue_traverse_report_collector* self,
+  struct cue_traverse_report* report);
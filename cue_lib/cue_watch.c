@@ -0,0 +1,168 @@
+#include "cue_watch.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "err_helpers.h"
+#include "mem_helpers.h"
+#include "path.h"
+#include "directory_watch.h"
+#include "string_vector.h"
+
+static void* acquire(void const* instance);
+static void dir_release(void* instance);
+static errno_t note_change(cue_watch_t* self, char const* dir, short tree, time_t now);
+static void clear_strings(string_vector_t* strings);
+
+struct object_vector_params cue_watch_dir_vector_ops = {
+  acquire,
+  dir_release,
+};
+
+static void* acquire(void const* instance) {
+  return (void*)instance;
+}
+
+static void dir_release(void* instance) {
+  cue_watch_dir_t* dir = (cue_watch_dir_t*)instance;
+  SAFE_FREE(dir->path);
+  SAFE_FREE(dir);
+}
+
+IMPLEMENT_OBJECT_VECTOR(cue_watch_dir_vector, cue_watch_dir_t)
+
+struct cue_watch* cue_watch_alloc(char const* root, unsigned long settle_seconds) {
+  cue_watch_t* self = malloc(sizeof(*self));
+  if (!self) return NULL;
+
+  errno_t err = cue_watch_init(self, root, settle_seconds);
+  if (!err) return self;
+
+  SAFE_FREE(self);
+  return NULL;
+}
+
+errno_t cue_watch_init(struct cue_watch* self, char const* root, unsigned long settle_seconds) {
+  errno_t err = 0;
+
+  memset(self, 0, sizeof(*self));
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(self->root = _strdup(root), err);
+    ERR_REGION_NULL_CHECK(self->pending = cue_watch_dir_vector_alloc(), err);
+    ERR_REGION_NULL_CHECK(self->files = string_vector_alloc(), err);
+    ERR_REGION_NULL_CHECK(self->dirs = string_vector_alloc(), err);
+    ERR_REGION_NULL_CHECK(self->watch = directory_watch_open(root), err);
+    self->settle_seconds = settle_seconds;
+
+    return err;
+
+  } ERR_REGION_END()
+
+  cue_watch_uninit(self);
+
+  return err;
+}
+
+void cue_watch_uninit(struct cue_watch* self) {
+  SAFE_FREE_HANDLER(self->watch, directory_watch_close);
+  SAFE_FREE_HANDLER(self->dirs, string_vector_free);
+  SAFE_FREE_HANDLER(self->files, string_vector_free);
+  SAFE_FREE_HANDLER(self->pending, cue_watch_dir_vector_free);
+  SAFE_FREE(self->root);
+}
+
+void cue_watch_free(struct cue_watch* self) {
+  cue_watch_uninit(self);
+  SAFE_FREE(self);
+}
+
+errno_t cue_watch_wait(struct cue_watch* self, unsigned long milliseconds,
+  struct string_vector* dirs, struct string_vector* trees) {
+
+  errno_t err = 0;
+  cue_watch_dir_vector_t* pending = self->pending;
+  char const* dir = 0;
+  time_t now = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_ERROR_CHECK(directory_watch_wait(self->watch, milliseconds, self->files, self->dirs), err);
+
+    now = time(NULL);
+
+    // any file may be one a cue names, so any of them changing means the
+    // cues beside it are looked at again.  those that didn't really change
+    // are passed over by the manifest
+    for (size_t i = 0; i < self->files->get_length(self->files); ++i) {
+      ERR_REGION_NULL_CHECK(dir = path_dir_part(self->files->get(self->files, i)), err);
+      ERR_REGION_ERROR_CHECK(note_change(self, dir, 0, now), err);
+      SAFE_FREE(dir);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    for (size_t i = 0; i < self->dirs->get_length(self->dirs); ++i) {
+      ERR_REGION_ERROR_CHECK(note_change(self, self->dirs->get(self->dirs, i), 1, now), err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    // from the end, so that handing one out doesn't move those still to go
+    for (size_t i = pending->get_length(pending); i-- > 0; ) {
+      cue_watch_dir_t const* changed = pending->get(pending, i);
+
+      if (now - changed->changed < (time_t)self->settle_seconds) continue;
+
+      if (changed->tree) {
+        ERR_REGION_NULL_CHECK(trees->push(trees, changed->path), err);
+      }
+      else {
+        ERR_REGION_NULL_CHECK(dirs->push(dirs, changed->path), err);
+      }
+
+      ERR_REGION_ERROR_CHECK(pending->delete_at(pending, i), err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+  } ERR_REGION_END()
+
+  // a change that couldn't be noted is lost either way
+  clear_strings(self->files);
+  clear_strings(self->dirs);
+  SAFE_FREE(dir);
+
+  return err;
+}
+
+// a directory already waiting starts waiting again
+static errno_t note_change(cue_watch_t* self, char const* dir, short tree, time_t now) {
+  errno_t err = 0;
+  cue_watch_dir_vector_t* pending = self->pending;
+  cue_watch_dir_t* changed = 0;
+
+  for (size_t i = 0; i < pending->get_length(pending); ++i) {
+    cue_watch_dir_t* waiting = (cue_watch_dir_t*)pending->get(pending, i);
+
+    if (strcmp(waiting->path, dir) == 0) {
+      waiting->changed = now;
+      waiting->tree = waiting->tree || tree;
+      return err;
+    }
+  }
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(changed = calloc(1, sizeof(*changed)), err);
+    ERR_REGION_NULL_CHECK(changed->path = _strdup(dir), err);
+    changed->tree = tree;
+    changed->changed = now;
+
+    ERR_REGION_NULL_CHECK(pending->push(pending, changed), err);
+    changed = 0;
+
+  } ERR_REGION_END()
+
+  if (changed) dir_release(changed);
+
+  return err;
+}
+
+static void clear_strings(string_vector_t* strings) {
+  while (strings->get_length(strings)) {
+    strings->pop(strings);
+  }
+}
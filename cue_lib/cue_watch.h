@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stddef.h>
+#include <time.h>
+
+#include "object_vector.h"
+
+struct directory_watch;
+struct string_vector;
+
+// a directory something changed in, waiting for the changes to stop
+typedef struct cue_watch_dir {
+  char const* path;  // owned
+  short tree;  // made or moved in, so everything under it is new too
+  time_t changed;  // when anything in it last changed
+} cue_watch_dir_t;
+
+extern struct object_vector_params cue_watch_dir_vector_ops;
+
+typedef struct cue_watch_dir_vector {
+  object_vector_t vector_t;
+  INSERT_OBJECT_VECTOR_METHODS(cue_watch_dir_vector, cue_watch_dir_t)
+} cue_watch_dir_vector_t;
+
+DECLARE_OBJECT_VECTOR(cue_watch_dir_vector, cue_watch_dir_t)
+
+// changes under a source root, gathered by directory.  a cue and the files
+// it names are kept side by side, so the directory a change was in is all
+// that needs looking at again.  a directory is only handed out once it has
+// settled, with nothing in it changing for a while, so that discs still
+// being copied in aren't converted part way
+typedef struct cue_watch {
+  char const* root;  // owned
+  unsigned long settle_seconds;
+  struct directory_watch* watch;  // owned
+  struct cue_watch_dir_vector* pending;  // owned, directories yet to settle
+  struct string_vector* files;  // owned, changed files, while they are sorted into directories
+  struct string_vector* dirs;  // owned, changed directories, likewise
+} cue_watch_t;
+
+// starts watching at once, so that whatever changes while the caller goes
+// on to look at the root as it is now isn't missed
+struct cue_watch* cue_watch_alloc(char const* root, unsigned long settle_seconds);
+errno_t cue_watch_init(struct cue_watch* self, char const* root, unsigned long settle_seconds);
+void cue_watch_uninit(struct cue_watch* self);
+void cue_watch_free(struct cue_watch* self);
+
+// waits up to milliseconds for changes, then hands out the directories
+// that have settled since the last wait.  dirs gets those whose own files
+// changed, and trees those made or moved in, which are to be looked at
+// along with everything under them
+errno_t cue_watch_wait(struct cue_watch* self, unsigned long milliseconds,
+  struct string_vector* dirs, struct string_vector* trees);
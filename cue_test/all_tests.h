@@ -3,6 +3,8 @@
 #include <stddef.h>
 
 errno_t test_string_join(void);
+errno_t test_glob_matches(void);
+errno_t test_hash(void);
 errno_t test_getline(void);
 errno_t test_cue(void);
 errno_t test_cue_copy(void);
@@ -11,6 +13,8 @@ errno_t test_cue_errors(void);
 errno_t test_cue_traverse(void);
 errno_t test_list_dir(void);
 errno_t test_traverse_dirs(void);
+errno_t test_traverse_dirs_parallel(void);
+errno_t test_traverse_dirs_filtered(void);
 errno_t test_enumerate_path(void);
 errno_t test_ensure_path(void);
 errno_t test_string_stack(void);
@@ -24,7 +28,30 @@ errno_t test_double_queue(void);
 errno_t test_parallel_traverse(void);
 errno_t test_cue_options(void);
 errno_t test_cue_convert(void);
+errno_t test_cue_convert_jobs(void);
+errno_t test_cue_schedule(void);
+errno_t test_cue_report_collector(void);
+errno_t test_cue_partial_report(void);
+errno_t test_cue_convert_shards(void);
 errno_t test_cue_overwrite(void);
+errno_t test_cue_manifest(void);
+errno_t test_cue_restored_source(void);
+errno_t test_cue_copy_counts(void);
+errno_t test_cue_store(void);
+errno_t test_cue_journal(void);
+errno_t test_cue_claims(void);
+errno_t test_cue_watch(void);
+errno_t test_cue_sheet_cache(void);
+errno_t test_cue_catalog(void);
 errno_t test_copy_dir(void);
+errno_t test_file_size(void);
+errno_t test_file_mtime(void);
+errno_t test_copy_file_hashed(void);
+errno_t test_copy_file_as(void);
+errno_t test_copy_file_failure(void);
+errno_t test_directory_cache(void);
 errno_t test_regex(void);
 errno_t test_read_write_all(void);
+errno_t test_oggenc_segmented(void);
+errno_t test_oggenc_sink(void);
+errno_t test_oggenc_pipeline(void);
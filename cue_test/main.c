@@ -10,8 +10,10 @@
 
 #include "all_tests.h"
 
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
+#endif
 
 #include <stdio.h>
 
@@ -23,6 +25,8 @@ int main(int argc, char const* argv[]) {
   errno_t result = 0;
 
   result = test_string_join() || result;
+  result = test_glob_matches() || result;
+  result = test_hash() || result;
   result = test_getline() || result;
   result = test_cue() || result;
   result = test_cue_copy() || result;
@@ -30,6 +34,8 @@ int main(int argc, char const* argv[]) {
   result = test_cue_errors() || result;
   result = test_list_dir() || result;
   result = test_traverse_dirs() || result;
+  result = test_traverse_dirs_parallel() || result;
+  result = test_traverse_dirs_filtered() || result;
   result = test_ensure_path() || result;
   result = test_enumerate_path() || result;
   result = test_string_stack() || result;
@@ -44,10 +50,35 @@ int main(int argc, char const* argv[]) {
   result = test_cue_traverse() || result;
   result = test_cue_options() || result;
   result = test_cue_convert() || result;
+  result = test_cue_convert_jobs() || result;
+  result = test_cue_schedule() || result;
+  result = test_cue_report_collector() || result;
+  result = test_cue_partial_report() || result;
+  result = test_cue_convert_shards() || result;
   result = test_cue_overwrite() || result;
+  result = test_cue_manifest() || result;
+  result = test_cue_restored_source() || result;
+  result = test_cue_copy_counts() || result;
+  result = test_cue_store() || result;
+  result = test_cue_journal() || result;
+  result = test_cue_claims() || result;
+  result = test_cue_watch() || result;
+  result = test_cue_sheet_cache() || result;
+  result = test_cue_catalog() || result;
   result = test_copy_dir() || result;
+  result = test_file_size() || result;
+  result = test_file_mtime() || result;
+  result = test_copy_file_hashed() || result;
+  result = test_copy_file_as() || result;
+  result = test_copy_file_failure() || result;
+  result = test_directory_cache() || result;
   result = test_regex() || result;
   result = test_read_write_all() || result;
+  result = test_oggenc_segmented() || result;
+  result = test_oggenc_sink() || result;
+  result = test_oggenc_pipeline() || result;
 
   printf("%s\n", result ? "FAILURE!" : "All passed.");
+
+  return result ? 1 : 0;
 }
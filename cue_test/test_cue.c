@@ -13,19 +13,29 @@
 #include "directory_traversal.h"
 #include "cue_traverse_report.h"
 #include "cue_traverse_report_writer.h"
+#include "cue_traverse_report_collector.h"
+#include "cue_traverse_partial_report.h"
 #include "cue_traverse_record.h"
+#include "cue_traverse_job.h"
 #include "char_vector.h"
 #include "filesystem.h"
+#include "path.h"
 #include "cue_options.h"
 #include "string_vector.h"
 #include "cue_convert.h"
+#include "cue_sheet_cache.h"
+#include "cue_catalog.h"
+#include "cue_journal.h"
+#include "cue_manifest.h"
+#include "cue_claims.h"
+#include "cue_watch.h"
 
 #include "test_helpers.h"
 #include "err_helpers.h"
 #include "test_visitors.h"
 
-static const char s_cue_src_dir[] = "..\\test_data\\cue_dir";
-static const char s_cue_trg_dir[] = "..\\test_data\\new_cue_dir";
+static const char s_cue_src_dir[] = TEST_DATA SEP "cue_dir";
+static const char s_cue_trg_dir[] = TEST_DATA SEP "new_cue_dir";
 
 static char const* s_cue_sheet[] = {
 "FILE \"track01.bin\" BINARY",
@@ -311,8 +321,8 @@ typedef struct {
 } conversion_rec_t;
 
 static conversion_rec_t s_traverse_transformed[] = {
-  { "..\\test_data\\cue_dir\\a\\a1game\\a1game.cue", "..\\test_data\\new_cue_dir\\a\\a1game\\a1game.cue" },
-  { "..\\test_data\\cue_dir\\b\\b2game\\b2game.cue", "..\\test_data\\new_cue_dir\\b\\b2game\\b2game.cue" },
+  { TEST_DATA SEP "cue_dir" SEP "a" SEP "a1game" SEP "a1game.cue", TEST_DATA SEP "new_cue_dir" SEP "a" SEP "a1game" SEP "a1game.cue" },
+  { TEST_DATA SEP "cue_dir" SEP "b" SEP "b2game" SEP "b2game.cue", TEST_DATA SEP "new_cue_dir" SEP "b" SEP "b2game" SEP "b2game.cue" },
   0,
 };
 
@@ -350,26 +360,72 @@ static const dir_entry_fields_t s_test_traverse_result[] = {
 static const size_t s_test_traverse_result_len =
 sizeof(s_test_traverse_result) / sizeof(*s_test_traverse_result);
 
+// a conversion also leaves its manifest in the target root
+static const dir_entry_fields_t s_test_convert_result[] = {
+  {"a", 1},
+  {"a1game", 1},
+  {"a1game.cue", 0},
+  {"track01.ogg", 0},
+  {"track02.bin", 0},
+  {"track03.ogg", 0},
+  {"track04.ogg", 0},
+  {"track05.mp3", 0},
+  {"b", 1},
+  {"b2game", 1},
+  {"b2game.cue", 0},
+  {"track01.ogg", 0},
+  {"track02.bin", 0},
+  {"track03.ogg", 0},
+  {"track04.ogg", 0},
+  {"track05.mp3", 0},
+  {"cue_manifest.txt", 0},
+};
+
+static const size_t s_test_convert_result_len =
+sizeof(s_test_convert_result) / sizeof(*s_test_convert_result);
+
+// with one manifest per shard
+static const dir_entry_fields_t s_test_shard_result[] = {
+  {"a", 1},
+  {"a1game", 1},
+  {"a1game.cue", 0},
+  {"track01.ogg", 0},
+  {"track02.bin", 0},
+  {"track03.ogg", 0},
+  {"track04.ogg", 0},
+  {"track05.mp3", 0},
+  {"b", 1},
+  {"b2game", 1},
+  {"b2game.cue", 0},
+  {"track01.ogg", 0},
+  {"track02.bin", 0},
+  {"track03.ogg", 0},
+  {"track04.ogg", 0},
+  {"track05.mp3", 0},
+  {"cue_manifest_1_of_2.txt", 0},
+  {"cue_manifest_2_of_2.txt", 0},
+};
+
+static const size_t s_test_shard_result_len =
+sizeof(s_test_shard_result) / sizeof(*s_test_shard_result);
+
+// the report lists records in traversal order, which is the order the file
+// system lists entries in, so each record may be anywhere in the report
 static short compare_record_lists(
   cue_traverse_record_vector_t* report_recs,
   conversion_rec_t const* test_recs, size_t len) {
 
-  short match = 1;
-  for (size_t i = 0; i < len; ++i) {
-    cue_traverse_record_t const* record = report_recs->get(report_recs, i);
-
-    char const *rec, *test;
-    rec = record->source_path;
-    test = test_recs[i].src;
-    if (!test) { match = 0; break; }
-    match = strcmp(rec, test) == 0;
-    if (!match) break;
-
-    rec = record->target_path;
-    test = test_recs[i].dst;
-    if (!test) { match = 0; break; }
-    match = strcmp(rec, test) == 0;
-    if (!match) break;
+  short match = report_recs->get_length(report_recs) == len;
+  for (size_t i = 0; i < len && match; ++i) {
+    if (!test_recs[i].src || !test_recs[i].dst) { match = 0; break; }
+
+    match = 0;
+    for (size_t j = 0; j < len && !match; ++j) {
+      cue_traverse_record_t const* record = report_recs->get(report_recs, j);
+
+      match = strcmp(record->source_path, test_recs[i].src) == 0
+        && strcmp(record->target_path, test_recs[i].dst) == 0;
+    }
   }
 
   return match;
@@ -403,6 +459,24 @@ static errno_t compare_report(cue_traverse_report_t* report, conversion_recs_t c
   return err;
 }
 
+// checks the entries under path, in whatever order the file system lists
+// them
+static errno_t check_dir_entries(char const* path, dir_entry_fields_t const* result, size_t result_len) {
+  unordered_visitor_t visitor;
+  errno_t err = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_ERROR_CHECK(unordered_visitor_init(&visitor, result, result_len, 0), err);
+
+    traverse_dir_path(path, &visitor.handler_i);
+    if (!visitor.passed || visitor.line != result_len) err = -1;
+
+    unordered_visitor_uninit(&visitor);
+  } ERR_REGION_END()
+
+  return err;
+}
+
 //#define PRINT_REPORT
 
 errno_t test_cue_traverse(void) {
@@ -411,7 +485,7 @@ errno_t test_cue_traverse(void) {
   cue_traverse_report_writer_t writer;
   array_line_writer_t line_writer;
   null_line_writer_t null_line_writer;
-  compare_visitor_t cv;
+  directory_traversal_options_t traversal_opts;
   errno_t err = 0;
 
   printf("Checking cue traversal... ");
@@ -433,7 +507,10 @@ errno_t test_cue_traverse(void) {
       &visitor, 
       &visitor_opts), err);
 
-    traverse_dir_path(s_cue_src_dir, &visitor.pv_t.handler_i);
+    memset(&traversal_opts, 0, sizeof(traversal_opts));
+    traversal_opts.should_descend = 1;
+    cue_traverse_visitor_filter(&traversal_opts);
+    traverse_dir_path_opts(s_cue_src_dir, &traversal_opts, &visitor.pv_t.handler_i);
 
     cue_traverse_report_t *report = visitor.report;
 
@@ -442,9 +519,7 @@ errno_t test_cue_traverse(void) {
     ERR_REGION_ERROR_CHECK(compare_report(report, &s_traverse_results), err);
 
     // make sure the expected directory structure exists
-    compare_visitor_init(&cv, s_test_traverse_result, s_test_traverse_result_len);
-    traverse_dir_path(s_cue_trg_dir, &cv.handler_i);
-    ERR_REGION_CMP_CHECK(cv.line != s_test_traverse_result_len, err);
+    ERR_REGION_ERROR_CHECK(check_dir_entries(s_cue_trg_dir, s_test_traverse_result, s_test_traverse_result_len), err);
 
   } ERR_REGION_END()
 
@@ -472,6 +547,23 @@ typedef struct cue_options_test_result {
   short test_only;
   short overwrite;
   float quality;
+  int jobs;
+  int copy_jobs;
+  int encode_jobs;
+  size_t shard;
+  size_t num_shards;
+  short merge;
+  size_t num_partial_paths;
+  char const* store_path;
+  char const* cue_cache_path;
+  char const* catalog_path;
+  short query;
+  size_t num_query_terms;
+  char const* claim_owner;
+  short watch;
+  int settle_seconds;
+  copy_strategy_t copy_strategy;
+  int scan_threads;  // 0 expects the default
 } cue_options_test_result_t;
 
 static errno_t compare_options_result(cue_options_t const* opts, cue_options_test_result_t const* result) {
@@ -490,6 +582,31 @@ static errno_t compare_options_result(cue_options_t const* opts, cue_options_tes
     ERR_REGION_CMP_CHECK(opts->test_only != result->test_only, err);
     ERR_REGION_CMP_CHECK(opts->overwrite != result->overwrite, err);
     ERR_REGION_CMP_CHECK(opts->quality != result->quality, err);
+    ERR_REGION_CMP_CHECK(opts->jobs != result->jobs, err);
+    ERR_REGION_CMP_CHECK(opts->copy_jobs != result->copy_jobs, err);
+    ERR_REGION_CMP_CHECK(opts->encode_jobs != result->encode_jobs, err);
+    ERR_REGION_CMP_CHECK(opts->shard != result->shard, err);
+    ERR_REGION_CMP_CHECK(opts->num_shards != result->num_shards, err);
+    ERR_REGION_CMP_CHECK(opts->merge != result->merge, err);
+    ERR_REGION_CMP_CHECK(opts->partial_paths != 0 && result->num_partial_paths == 0, err);
+    if (result->num_partial_paths) ERR_REGION_CMP_CHECK(
+      opts->partial_paths->get_length(opts->partial_paths) != result->num_partial_paths, err);
+    ERR_REGION_CMP_CHECK(opts->store_path != 0 && result->store_path == 0, err);
+    if (result->store_path) ERR_REGION_CMP_CHECK(!opts->store_path || strcmp(opts->store_path, result->store_path) != 0, err);
+    ERR_REGION_CMP_CHECK(opts->cue_cache_path != 0 && result->cue_cache_path == 0, err);
+    if (result->cue_cache_path) ERR_REGION_CMP_CHECK(!opts->cue_cache_path || strcmp(opts->cue_cache_path, result->cue_cache_path) != 0, err);
+    ERR_REGION_CMP_CHECK(opts->catalog_path != 0 && result->catalog_path == 0, err);
+    if (result->catalog_path) ERR_REGION_CMP_CHECK(!opts->catalog_path || strcmp(opts->catalog_path, result->catalog_path) != 0, err);
+    ERR_REGION_CMP_CHECK(opts->query != result->query, err);
+    ERR_REGION_CMP_CHECK(opts->query_terms != 0 && !result->query, err);
+    if (result->query) ERR_REGION_CMP_CHECK(
+      opts->query_terms->get_length(opts->query_terms) != result->num_query_terms, err);
+    ERR_REGION_CMP_CHECK(opts->claim_owner != 0 && result->claim_owner == 0, err);
+    if (result->claim_owner) ERR_REGION_CMP_CHECK(!opts->claim_owner || strcmp(opts->claim_owner, result->claim_owner) != 0, err);
+    ERR_REGION_CMP_CHECK(opts->watch != result->watch, err);
+    if (result->watch) ERR_REGION_CMP_CHECK(opts->settle_seconds != result->settle_seconds, err);
+    ERR_REGION_CMP_CHECK(opts->copy_strategy != result->copy_strategy, err);
+    ERR_REGION_CMP_CHECK(opts->scan_threads != (result->scan_threads ? result->scan_threads : 1), err);
 
   } ERR_REGION_END()
 
@@ -527,6 +644,7 @@ errno_t test_cue_options(void) {
         .test_only = 0,
         .overwrite = 1,
         .quality = 3,
+        .jobs = 1,
       };
 
       ERR_REGION_ERROR_CHECK(cue_options_load_from_args(&opts, argc, argv), err);
@@ -550,6 +668,7 @@ errno_t test_cue_options(void) {
         .source_dir = "src dir",
         .target_dir = "trg dir",
         .quality = 3,
+        .jobs = 1,
       };
 
       ERR_REGION_ERROR_CHECK(cue_options_load_from_args(&opts, argc, argv), err);
@@ -600,109 +719,1856 @@ errno_t test_cue_options(void) {
       cue_options_uninit(&opts);
     } ERR_REGION_END() ERR_REGION_ERROR_BUBBLE(err);
 
-  } ERR_REGION_END()
+    // test 6. parallel jobs
+    ERR_REGION_BEGIN() {
+      ERR_REGION_ERROR_CHECK(cue_options_init(&opts), err);
 
-  printf("%s\n", err ? "FAILED!" : "passed.");
+      char const* argv[] = {
+        "-j",
+        "4",
+        "src dir",
+        "trg dir",
+      };
+      size_t argc = sizeof(argv) / sizeof(*argv);
 
-  return err;
-}
+      cue_options_test_result_t result = {
+        .source_dir = "src dir",
+        .target_dir = "trg dir",
+        .quality = 3,
+        .jobs = 4,
+      };
 
-errno_t test_cue_convert(void) {
-  errno_t err = 0;
-  string_vector_t *argv = 0;
-  cue_convert_env_t env;
-  compare_visitor_t cv;
+      ERR_REGION_ERROR_CHECK(cue_options_load_from_args(&opts, argc, argv), err);
 
-  env.out = stdout; 
-  env.err = stderr;
+      err = compare_options_result(&opts, &result);
 
-  printf("Checking cue convert... ");
+      cue_options_uninit(&opts);
+    } ERR_REGION_END() ERR_REGION_ERROR_BUBBLE(err);
 
-  ERR_REGION_BEGIN() {
-    
-    ERR_REGION_NULL_CHECK(argv = string_vector_alloc(), err);
-    ERR_REGION_NULL_CHECK(argv->push(argv, "some_dir\\cue_tests"), err);
-    ERR_REGION_NULL_CHECK(argv->push(argv, "-Q"), err);
-    ERR_REGION_NULL_CHECK(argv->push(argv, "-q"), err);
-    ERR_REGION_NULL_CHECK(argv->push(argv, "5"), err);
-    ERR_REGION_NULL_CHECK(argv->push(argv, s_cue_src_dir), err);
-    ERR_REGION_NULL_CHECK(argv->push(argv, s_cue_trg_dir), err);
+    // test 7. bad job count
+    ERR_REGION_BEGIN() {
+      ERR_REGION_ERROR_CHECK(cue_options_init(&opts), err);
 
-    ERR_REGION_ERROR_CHECK(cue_convert_with_args(
-      argv->get_length(argv),
-      argv->get_buffer(argv),
-      &env, 0), err);
+      char const* argv[] = {
+        "-j",
+        "many",
+        "src dir",
+        "trg dir",
+      };
+      size_t argc = sizeof(argv) / sizeof(*argv);
 
-    // make sure the expected directory structure exists
-    compare_visitor_init(&cv, s_test_traverse_result, s_test_traverse_result_len);
-    traverse_dir_path(s_cue_trg_dir, &cv.handler_i);
-    ERR_REGION_CMP_CHECK(cv.line != s_test_traverse_result_len, err);
+      ERR_REGION_CMP_CHECK(!cue_options_load_from_args(&opts, argc, argv), err);
 
-  } ERR_REGION_END()
+      cue_options_uninit(&opts);
+    } ERR_REGION_END() ERR_REGION_ERROR_BUBBLE(err);
 
-  delete_dir(s_cue_trg_dir);
-  SAFE_FREE_HANDLER(argv, string_vector_free);
+    // test 8. separate copy and encode limits
+    ERR_REGION_BEGIN() {
+      ERR_REGION_ERROR_CHECK(cue_options_init(&opts), err);
 
-  printf("%s\n", err ? "FAILED!" : "passed.");
+      char const* argv[] = {
+        "-j",
+        "4",
+        "-c",
+        "1",
+        "-e",
+        "8",
+        "src dir",
+        "trg dir",
+      };
+      size_t argc = sizeof(argv) / sizeof(*argv);
 
-  return err;
-}
+      cue_options_test_result_t result = {
+        .source_dir = "src dir",
+        .target_dir = "trg dir",
+        .quality = 3,
+        .jobs = 4,
+        .copy_jobs = 1,
+        .encode_jobs = 8,
+      };
 
-errno_t test_cue_overwrite(void) {
-  errno_t err = 0;
-  string_vector_t* argv = 0;
-  cue_convert_env_t env;
-  cue_traverse_report_t *report = 0;
+      ERR_REGION_ERROR_CHECK(cue_options_load_from_args(&opts, argc, argv), err);
 
-  env.out = stdout;
-  env.err = stderr;
+      err = compare_options_result(&opts, &result);
 
-  printf("Checking cue overwrite... ");
+      cue_options_uninit(&opts);
+    } ERR_REGION_END() ERR_REGION_ERROR_BUBBLE(err);
 
-  ERR_REGION_BEGIN() {
+    // test 9. bad copy count
+    ERR_REGION_BEGIN() {
+      ERR_REGION_ERROR_CHECK(cue_options_init(&opts), err);
 
-    // copy over the src directory to cause an overwrite conflict
-    ERR_REGION_ERROR_CHECK(copy_dir(s_cue_src_dir, s_cue_trg_dir), err);
+      char const* argv[] = {
+        "-c",
+        "-1",
+        "src dir",
+        "trg dir",
+      };
+      size_t argc = sizeof(argv) / sizeof(*argv);
 
-    // do a convert run without overwrite, should convert nothing
-    ERR_REGION_NULL_CHECK(argv = string_vector_alloc(), err);
-    ERR_REGION_NULL_CHECK(argv->push(argv, "some_dir\\cue_tests"), err);
-    ERR_REGION_NULL_CHECK(argv->push(argv, "-Q"), err);
-    ERR_REGION_NULL_CHECK(argv->push(argv, s_cue_src_dir), err);
-    ERR_REGION_NULL_CHECK(argv->push(argv, s_cue_trg_dir), err);
+      ERR_REGION_CMP_CHECK(!cue_options_load_from_args(&opts, argc, argv), err);
 
-    ERR_REGION_ERROR_CHECK(cue_convert_with_args(
-      argv->get_length(argv),
-      argv->get_buffer(argv),
-      &env, &report), err);
+      cue_options_uninit(&opts);
+    } ERR_REGION_END() ERR_REGION_ERROR_BUBBLE(err);
 
-    // make sure nothing was converted
-    ERR_REGION_NULL_CHECK(report, err);
-    ERR_REGION_CMP_CHECK(report->found_cue_count != 2, err);
-    ERR_REGION_CMP_CHECK(report->skipped_cue_count != 2, err);
+    // test 10. one shard of several
+    ERR_REGION_BEGIN() {
+      ERR_REGION_ERROR_CHECK(cue_options_init(&opts), err);
 
-    // reset values to reuse
-    SAFE_FREE_HANDLER(report, cue_traverse_report_free);
-    report = 0;
+      char const* argv[] = {
+        "-Q",
+        "--shard",
+        "2/3",
+        "src dir",
+        "trg dir",
+      };
+      size_t argc = sizeof(argv) / sizeof(*argv);
 
-    // do the convert again, but with force
-    ERR_REGION_NULL_CHECK(argv->insert_at(argv, 2, "-w"), err);
+      cue_options_test_result_t result = {
+        .source_dir = "src dir",
+        .target_dir = "trg dir",
+        .quiet = 1,
+        .quality = 3,
+        .jobs = 1,
+        .shard = 2,
+        .num_shards = 3,
+      };
 
-    ERR_REGION_ERROR_CHECK(cue_convert_with_args(
-      argv->get_length(argv),
-      argv->get_buffer(argv),
-      &env, &report), err);
+      ERR_REGION_ERROR_CHECK(cue_options_load_from_args(&opts, argc, argv), err);
 
-    // make sure the two items were converted
-    ERR_REGION_NULL_CHECK(report, err);
-    ERR_REGION_CMP_CHECK(report->found_cue_count != 2, err);
-    ERR_REGION_CMP_CHECK(report->transformed_cue_count != 2, err);
+      err = compare_options_result(&opts, &result);
 
-  } ERR_REGION_END()
+      cue_options_uninit(&opts);
+    } ERR_REGION_END() ERR_REGION_ERROR_BUBBLE(err);
 
-  delete_dir(s_cue_trg_dir);
-  SAFE_FREE_HANDLER(argv, string_vector_free);
-  SAFE_FREE_HANDLER(report, cue_traverse_report_free);
+    // test 11. shard past the number of shards
+    ERR_REGION_BEGIN() {
+      ERR_REGION_ERROR_CHECK(cue_options_init(&opts), err);
+
+      char const* argv[] = {
+        "--shard",
+        "4/3",
+        "src dir",
+        "trg dir",
+      };
+      size_t argc = sizeof(argv) / sizeof(*argv);
+
+      ERR_REGION_CMP_CHECK(!cue_options_load_from_args(&opts, argc, argv), err);
+
+      cue_options_uninit(&opts);
+    } ERR_REGION_END() ERR_REGION_ERROR_BUBBLE(err);
+
+    // test 12. merging partial reports
+    ERR_REGION_BEGIN() {
+      ERR_REGION_ERROR_CHECK(cue_options_init(&opts), err);
+
+      char const* argv[] = {
+        "--merge",
+        "-r",
+        "report path",
+        "part 1",
+        "part 2",
+        "part 3",
+      };
+      size_t argc = sizeof(argv) / sizeof(*argv);
+
+      cue_options_test_result_t result = {
+        .generate_report = 1,
+        .report_path = "report path",
+        .quality = 3,
+        .jobs = 1,
+        .merge = 1,
+        .num_partial_paths = 3,
+      };
+
+      ERR_REGION_ERROR_CHECK(cue_options_load_from_args(&opts, argc, argv), err);
+
+      err = compare_options_result(&opts, &result);
+
+      cue_options_uninit(&opts);
+    } ERR_REGION_END() ERR_REGION_ERROR_BUBBLE(err);
+
+    // test 13. unknown long option
+    ERR_REGION_BEGIN() {
+      ERR_REGION_ERROR_CHECK(cue_options_init(&opts), err);
+
+      char const* argv[] = {
+        "--shards",
+        "1/2",
+        "src dir",
+        "trg dir",
+      };
+      size_t argc = sizeof(argv) / sizeof(*argv);
+
+      ERR_REGION_CMP_CHECK(!cue_options_load_from_args(&opts, argc, argv), err);
+
+      cue_options_uninit(&opts);
+    } ERR_REGION_END() ERR_REGION_ERROR_BUBBLE(err);
+
+    // test 14. a file store
+    ERR_REGION_BEGIN() {
+      ERR_REGION_ERROR_CHECK(cue_options_init(&opts), err);
+
+      char const* argv[] = {
+        "--store",
+        "store dir",
+        "src dir",
+        "trg dir",
+      };
+      size_t argc = sizeof(argv) / sizeof(*argv);
+
+      cue_options_test_result_t result = {
+        .source_dir = "src dir",
+        .target_dir = "trg dir",
+        .quality = 3,
+        .jobs = 1,
+        .store_path = "store dir",
+      };
+
+      ERR_REGION_ERROR_CHECK(cue_options_load_from_args(&opts, argc, argv), err);
+
+      err = compare_options_result(&opts, &result);
+
+      cue_options_uninit(&opts);
+    } ERR_REGION_END() ERR_REGION_ERROR_BUBBLE(err);
+
+    // test 15. a merge makes no files to store
+    ERR_REGION_BEGIN() {
+      ERR_REGION_ERROR_CHECK(cue_options_init(&opts), err);
+
+      char const* argv[] = {
+        "--merge",
+        "--store",
+        "store dir",
+        "part 1",
+      };
+      size_t argc = sizeof(argv) / sizeof(*argv);
+
+      ERR_REGION_CMP_CHECK(!cue_options_load_from_args(&opts, argc, argv), err);
+
+      cue_options_uninit(&opts);
+    } ERR_REGION_END() ERR_REGION_ERROR_BUBBLE(err);
+
+    // test 16. a cue cache, with a test run
+    ERR_REGION_BEGIN() {
+      ERR_REGION_ERROR_CHECK(cue_options_init(&opts), err);
+
+      char const* argv[] = {
+        "-t",
+        "--cue-cache",
+        "cache file",
+        "src dir",
+        "trg dir",
+      };
+      size_t argc = sizeof(argv) / sizeof(*argv);
+
+      cue_options_test_result_t result = {
+        .source_dir = "src dir",
+        .target_dir = "trg dir",
+        .test_only = 1,
+        .quality = 3,
+        .jobs = 1,
+        .cue_cache_path = "cache file",
+      };
+
+      ERR_REGION_ERROR_CHECK(cue_options_load_from_args(&opts, argc, argv), err);
+
+      err = compare_options_result(&opts, &result);
+
+      cue_options_uninit(&opts);
+    } ERR_REGION_END() ERR_REGION_ERROR_BUBBLE(err);
+
+    // test 17. a merge reads no cues to cache
+    ERR_REGION_BEGIN() {
+      ERR_REGION_ERROR_CHECK(cue_options_init(&opts), err);
+
+      char const* argv[] = {
+        "--merge",
+        "--cue-cache",
+        "cache file",
+        "part 1",
+      };
+      size_t argc = sizeof(argv) / sizeof(*argv);
+
+      ERR_REGION_CMP_CHECK(!cue_options_load_from_args(&opts, argc, argv), err);
+
+      cue_options_uninit(&opts);
+    } ERR_REGION_END() ERR_REGION_ERROR_BUBBLE(err);
+
+    // test 18. a run writing a catalog
+    ERR_REGION_BEGIN() {
+      ERR_REGION_ERROR_CHECK(cue_options_init(&opts), err);
+
+      char const* argv[] = {
+        "--catalog",
+        "catalog file",
+        "src dir",
+        "trg dir",
+      };
+      size_t argc = sizeof(argv) / sizeof(*argv);
+
+      cue_options_test_result_t result = {
+        .source_dir = "src dir",
+        .target_dir = "trg dir",
+        .quality = 3,
+        .jobs = 1,
+        .catalog_path = "catalog file",
+      };
+
+      ERR_REGION_ERROR_CHECK(cue_options_load_from_args(&opts, argc, argv), err);
+
+      err = compare_options_result(&opts, &result);
+
+      cue_options_uninit(&opts);
+    } ERR_REGION_END() ERR_REGION_ERROR_BUBBLE(err);
+
+    // test 19. a query of the catalog, taking the rest as its terms
+    ERR_REGION_BEGIN() {
+      ERR_REGION_ERROR_CHECK(cue_options_init(&opts), err);
+
+      char const* argv[] = {
+        "--query",
+        "catalog file",
+        "type=wav",
+        "under=a",
+      };
+      size_t argc = sizeof(argv) / sizeof(*argv);
+
+      cue_options_test_result_t result = {
+        .quality = 3,
+        .jobs = 1,
+        .catalog_path = "catalog file",
+        .query = 1,
+        .num_query_terms = 2,
+      };
+
+      ERR_REGION_ERROR_CHECK(cue_options_load_from_args(&opts, argc, argv), err);
+
+      err = compare_options_result(&opts, &result);
+
+      cue_options_uninit(&opts);
+    } ERR_REGION_END() ERR_REGION_ERROR_BUBBLE(err);
+
+    // test 20. a query converts nothing, so can't use a store
+    ERR_REGION_BEGIN() {
+      ERR_REGION_ERROR_CHECK(cue_options_init(&opts), err);
+
+      char const* argv[] = {
+        "--store",
+        "store dir",
+        "--query",
+        "catalog file",
+      };
+      size_t argc = sizeof(argv) / sizeof(*argv);
+
+      ERR_REGION_CMP_CHECK(!cue_options_load_from_args(&opts, argc, argv), err);
+
+      cue_options_uninit(&opts);
+    } ERR_REGION_END() ERR_REGION_ERROR_BUBBLE(err);
+
+    // test 21. a worker sharing the cues by claims
+    ERR_REGION_BEGIN() {
+      ERR_REGION_ERROR_CHECK(cue_options_init(&opts), err);
+
+      char const* argv[] = {
+        "--claim",
+        "host-1.a",
+        "src dir",
+        "trg dir",
+      };
+      size_t argc = sizeof(argv) / sizeof(*argv);
+
+      cue_options_test_result_t result = {
+        .source_dir = "src dir",
+        .target_dir = "trg dir",
+        .quality = 3,
+        .jobs = 1,
+        .claim_owner = "host-1.a",
+      };
+
+      ERR_REGION_ERROR_CHECK(cue_options_load_from_args(&opts, argc, argv), err);
+
+      err = compare_options_result(&opts, &result);
+
+      cue_options_uninit(&opts);
+    } ERR_REGION_END() ERR_REGION_ERROR_BUBBLE(err);
+
+    // test 22. a worker name must be safe in a file name, and claims
+    // don't mix with shards
+    ERR_REGION_BEGIN() {
+      ERR_REGION_ERROR_CHECK(cue_options_init(&opts), err);
+
+      char const* bad_name[] = {
+        "--claim",
+        "a\\b",
+        "src dir",
+        "trg dir",
+      };
+      char const* with_shard[] = {
+        "--claim",
+        "a",
+        "--shard",
+        "1/2",
+        "src dir",
+        "trg dir",
+      };
+
+      ERR_REGION_CMP_CHECK(!cue_options_load_from_args(&opts,
+        sizeof(bad_name) / sizeof(*bad_name), bad_name), err);
+      ERR_REGION_CMP_CHECK(!cue_options_load_from_args(&opts,
+        sizeof(with_shard) / sizeof(*with_shard), with_shard), err);
+
+      cue_options_uninit(&opts);
+    } ERR_REGION_END() ERR_REGION_ERROR_BUBBLE(err);
+
+    // test 23. watching the source after converting it
+    ERR_REGION_BEGIN() {
+      ERR_REGION_ERROR_CHECK(cue_options_init(&opts), err);
+
+      char const* argv[] = {
+        "--watch",
+        "--settle",
+        "30",
+        "src dir",
+        "trg dir",
+      };
+      size_t argc = sizeof(argv) / sizeof(*argv);
+
+      cue_options_test_result_t result = {
+        .source_dir = "src dir",
+        .target_dir = "trg dir",
+        .quality = 3,
+        .jobs = 1,
+        .watch = 1,
+        .settle_seconds = 30,
+      };
+
+      ERR_REGION_ERROR_CHECK(cue_options_load_from_args(&opts, argc, argv), err);
+
+      err = compare_options_result(&opts, &result);
+
+      cue_options_uninit(&opts);
+    } ERR_REGION_END() ERR_REGION_ERROR_BUBBLE(err);
+
+    // test 24. only a conversion can watch, and only a watch settles
+    ERR_REGION_BEGIN() {
+      ERR_REGION_ERROR_CHECK(cue_options_init(&opts), err);
+
+      char const* settle_only[] = {
+        "--settle",
+        "30",
+        "src dir",
+        "trg dir",
+      };
+      char const* with_merge[] = {
+        "--watch",
+        "--merge",
+        "partial 1",
+      };
+
+      ERR_REGION_CMP_CHECK(!cue_options_load_from_args(&opts,
+        sizeof(settle_only) / sizeof(*settle_only), settle_only), err);
+      ERR_REGION_CMP_CHECK(!cue_options_load_from_args(&opts,
+        sizeof(with_merge) / sizeof(*with_merge), with_merge), err);
+
+      cue_options_uninit(&opts);
+    } ERR_REGION_END() ERR_REGION_ERROR_BUBBLE(err);
+
+    // test 25. linking the files that need no converting
+    ERR_REGION_BEGIN() {
+      ERR_REGION_ERROR_CHECK(cue_options_init(&opts), err);
+
+      char const* argv[] = {
+        "--copy-strategy",
+        "link",
+        "src dir",
+        "trg dir",
+      };
+      size_t argc = sizeof(argv) / sizeof(*argv);
+
+      cue_options_test_result_t result = {
+        .source_dir = "src dir",
+        .target_dir = "trg dir",
+        .quality = 3,
+        .jobs = 1,
+        .copy_strategy = EWC_CS_LINK,
+      };
+
+      ERR_REGION_ERROR_CHECK(cue_options_load_from_args(&opts, argc, argv), err);
+
+      err = compare_options_result(&opts, &result);
+
+      cue_options_uninit(&opts);
+    } ERR_REGION_END() ERR_REGION_ERROR_BUBBLE(err);
+
+    // test 26. only known strategies, and only when converting
+    ERR_REGION_BEGIN() {
+      ERR_REGION_ERROR_CHECK(cue_options_init(&opts), err);
+
+      char const* unknown[] = {
+        "--copy-strategy",
+        "move",
+        "src dir",
+        "trg dir",
+      };
+      char const* with_merge[] = {
+        "--copy-strategy",
+        "copy",
+        "--merge",
+        "partial 1",
+      };
+
+      ERR_REGION_CMP_CHECK(!cue_options_load_from_args(&opts,
+        sizeof(unknown) / sizeof(*unknown), unknown), err);
+      ERR_REGION_CMP_CHECK(!cue_options_load_from_args(&opts,
+        sizeof(with_merge) / sizeof(*with_merge), with_merge), err);
+
+      cue_options_uninit(&opts);
+    } ERR_REGION_END() ERR_REGION_ERROR_BUBBLE(err);
+
+    // test 27. reading the source on several threads
+    ERR_REGION_BEGIN() {
+      ERR_REGION_ERROR_CHECK(cue_options_init(&opts), err);
+
+      char const* argv[] = {
+        "--scan-threads",
+        "16",
+        "src dir",
+        "trg dir",
+      };
+      size_t argc = sizeof(argv) / sizeof(*argv);
+
+      cue_options_test_result_t result = {
+        .source_dir = "src dir",
+        .target_dir = "trg dir",
+        .quality = 3,
+        .jobs = 1,
+        .scan_threads = 16,
+      };
+
+      ERR_REGION_ERROR_CHECK(cue_options_load_from_args(&opts, argc, argv), err);
+
+      err = compare_options_result(&opts, &result);
+
+      cue_options_uninit(&opts);
+    } ERR_REGION_END() ERR_REGION_ERROR_BUBBLE(err);
+
+    // test 28. shards must all find the cues in the same order
+    ERR_REGION_BEGIN() {
+      ERR_REGION_ERROR_CHECK(cue_options_init(&opts), err);
+
+      char const* with_shard[] = {
+        "--scan-threads",
+        "16",
+        "--shard",
+        "1/2",
+        "src dir",
+        "trg dir",
+      };
+
+      ERR_REGION_CMP_CHECK(!cue_options_load_from_args(&opts,
+        sizeof(with_shard) / sizeof(*with_shard), with_shard), err);
+
+      cue_options_uninit(&opts);
+    } ERR_REGION_END() ERR_REGION_ERROR_BUBBLE(err);
+
+  } ERR_REGION_END()
+
+  printf("%s\n", err ? "FAILED!" : "passed.");
+
+  return err;
+}
+
+errno_t test_cue_convert(void) {
+  errno_t err = 0;
+  string_vector_t *argv = 0;
+  cue_convert_env_t env;
+
+  env.out = stdout; 
+  env.err = stderr;
+
+  printf("Checking cue convert... ");
+
+  ERR_REGION_BEGIN() {
+    
+    ERR_REGION_NULL_CHECK(argv = string_vector_alloc(), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "some_dir\\cue_tests"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "-Q"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "-q"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "5"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, s_cue_src_dir), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, s_cue_trg_dir), err);
+
+    ERR_REGION_ERROR_CHECK(cue_convert_with_args(
+      argv->get_length(argv),
+      argv->get_buffer(argv),
+      &env, 0), err);
+
+    // make sure the expected directory structure exists
+    ERR_REGION_ERROR_CHECK(check_dir_entries(s_cue_trg_dir, s_test_convert_result, s_test_convert_result_len), err);
+
+  } ERR_REGION_END()
+
+  delete_dir(s_cue_trg_dir);
+  SAFE_FREE_HANDLER(argv, string_vector_free);
+
+  printf("%s\n", err ? "FAILED!" : "passed.");
+
+  return err;
+}
+
+errno_t test_cue_convert_jobs(void) {
+  errno_t err = 0;
+  string_vector_t *argv = 0;
+  cue_convert_env_t env;
+  cue_traverse_report_t *report = 0;
+
+  env.out = stdout; 
+  env.err = stderr;
+
+  printf("Checking cue convert with jobs... ");
+
+  ERR_REGION_BEGIN() {
+    
+    ERR_REGION_NULL_CHECK(argv = string_vector_alloc(), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "some_dir\\cue_tests"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "-Q"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "-j"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "4"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "-c"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "1"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, s_cue_src_dir), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, s_cue_trg_dir), err);
+
+    ERR_REGION_ERROR_CHECK(cue_convert_with_args(
+      argv->get_length(argv),
+      argv->get_buffer(argv),
+      &env, &report), err);
+
+    // everything should have been converted, just as with a single job
+    ERR_REGION_NULL_CHECK(report, err);
+    ERR_REGION_CMP_CHECK(report->found_cue_count != 2, err);
+    ERR_REGION_CMP_CHECK(report->transformed_cue_count != 2, err);
+
+    // make sure the expected directory structure exists
+    ERR_REGION_ERROR_CHECK(check_dir_entries(s_cue_trg_dir, s_test_convert_result, s_test_convert_result_len), err);
+
+  } ERR_REGION_END()
+
+  delete_dir(s_cue_trg_dir);
+  SAFE_FREE_HANDLER(report, cue_traverse_report_free);
+  SAFE_FREE_HANDLER(argv, string_vector_free);
+
+  printf("%s\n", err ? "FAILED!" : "passed.");
+
+  return err;
+}
+
+errno_t test_cue_schedule(void) {
+  errno_t err = 0;
+  cue_traverse_visitor_t visitor = { 0 };
+  cue_traverse_visitor_opts_t visitor_opts = { 0 };
+  array_line_writer_t line_writer;
+  directory_traversal_options_t traversal_opts;
+  cue_traverse_job_t jobs[4];
+  cue_traverse_job_t* order[4];
+  unsigned long long const work[] = { 5, 9, 9, 1 };
+  size_t const expected[] = { 1, 2, 0, 3 };
+  unsigned long long total_work = 0;
+
+  printf("Checking cue convert schedule... ");
+
+  array_line_writer_init(&line_writer);
+
+  ERR_REGION_BEGIN() {
+    // the largest go first, and equal ones in the order they were found
+    for (size_t i = 0; i < 4; ++i) {
+      memset(jobs + i, 0, sizeof(*jobs));
+      jobs[i].work = work[i];
+      jobs[i].sequence = i;
+      order[i] = jobs + i;
+    }
+
+    cue_traverse_jobs_sort_largest_first(order, 4);
+
+    for (size_t i = 0; i < 4; ++i) {
+      ERR_REGION_CMP_CHECK(order[i]->sequence != expected[i], err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    visitor_opts.target_path = s_cue_trg_dir;
+    visitor_opts.source_path = s_cue_src_dir;
+    visitor_opts.writer = &line_writer.line_writer;
+    visitor_opts.jobs = 2;
+
+    ERR_REGION_ERROR_CHECK(cue_traverse_visitor_init(&visitor, &visitor_opts), err);
+
+    memset(&traversal_opts, 0, sizeof(traversal_opts));
+    traversal_opts.should_descend = 1;
+    cue_traverse_visitor_filter(&traversal_opts);
+    traverse_dir_path_opts(s_cue_src_dir, &traversal_opts, &visitor.pv_t.handler_i);
+
+    // every cue is sized before any is started, so the totals are final
+    ERR_REGION_CMP_CHECK(line_writer.num_lines != 0, err);
+    ERR_REGION_CMP_CHECK(visitor.total_jobs != 2, err);
+    ERR_REGION_CMP_CHECK(visitor.pending->get_length(visitor.pending) != 2, err);
+
+    // the tracks of a1game that are encoded, as the rest are empty
+    for (size_t i = 0; i < 2; ++i) {
+      total_work += visitor.pending->get(visitor.pending, i)->work;
+    }
+
+    ERR_REGION_CMP_CHECK(total_work != 176400 + 176444, err);
+    ERR_REGION_CMP_CHECK(visitor.total_work != total_work, err);
+
+    ERR_REGION_ERROR_CHECK(cue_traverse_visitor_finish(&visitor), err);
+    ERR_REGION_CMP_CHECK(visitor.report->transformed_cue_count != 2, err);
+    ERR_REGION_CMP_CHECK(visitor.done_work != total_work, err);
+
+    // so the progress of each counts against all of them, and the last
+    // done is all of the work
+    for (int i = 0; i < line_writer.num_lines; ++i) {
+      char const* line = line_writer.lines[i];
+
+      if (strstr(line, "Success.")) {
+        ERR_REGION_CMP_CHECK(!strstr(line, "/2"), err);
+      }
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    ERR_REGION_CMP_CHECK(line_writer.num_lines != 4, err);
+    ERR_REGION_CMP_CHECK(!strstr(line_writer.lines[3], "[2/2, 100%"), err);
+
+  } ERR_REGION_END()
+
+  delete_dir(s_cue_trg_dir);
+  cue_traverse_visitor_uninit(&visitor);
+  array_line_writer_uninit(&line_writer);
+
+  printf("%s\n", err ? "FAILED!" : "passed.");
+
+  return err;
+}
+
+errno_t test_cue_overwrite(void) {
+  errno_t err = 0;
+  string_vector_t* argv = 0;
+  cue_convert_env_t env;
+  cue_traverse_report_t *report = 0;
+
+  env.out = stdout;
+  env.err = stderr;
+
+  printf("Checking cue overwrite... ");
+
+  ERR_REGION_BEGIN() {
+
+    // copy over the src directory to cause an overwrite conflict
+    ERR_REGION_ERROR_CHECK(copy_dir(s_cue_src_dir, s_cue_trg_dir), err);
+
+    // do a convert run without overwrite, should convert nothing
+    ERR_REGION_NULL_CHECK(argv = string_vector_alloc(), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "some_dir\\cue_tests"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "-Q"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, s_cue_src_dir), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, s_cue_trg_dir), err);
+
+    ERR_REGION_ERROR_CHECK(cue_convert_with_args(
+      argv->get_length(argv),
+      argv->get_buffer(argv),
+      &env, &report), err);
+
+    // make sure nothing was converted
+    ERR_REGION_NULL_CHECK(report, err);
+    ERR_REGION_CMP_CHECK(report->found_cue_count != 2, err);
+    ERR_REGION_CMP_CHECK(report->skipped_cue_count != 2, err);
+
+    // reset values to reuse
+    SAFE_FREE_HANDLER(report, cue_traverse_report_free);
+    report = 0;
+
+    // do the convert again, but with force
+    ERR_REGION_NULL_CHECK(argv->insert_at(argv, 2, "-w"), err);
+
+    ERR_REGION_ERROR_CHECK(cue_convert_with_args(
+      argv->get_length(argv),
+      argv->get_buffer(argv),
+      &env, &report), err);
+
+    // make sure the two items were converted
+    ERR_REGION_NULL_CHECK(report, err);
+    ERR_REGION_CMP_CHECK(report->found_cue_count != 2, err);
+    ERR_REGION_CMP_CHECK(report->transformed_cue_count != 2, err);
+
+  } ERR_REGION_END()
+
+  delete_dir(s_cue_trg_dir);
+  SAFE_FREE_HANDLER(argv, string_vector_free);
+  SAFE_FREE_HANDLER(report, cue_traverse_report_free);
+
+  printf("%s\n", err ? "FAILED!" : "passed.");
+
+  return err;
+}
+
+static char const s_manifest_output[] = TEST_DATA SEP "new_cue_dir" SEP "a" SEP "a1game" SEP "track01.ogg";
+
+// runs a quiet conversion of src_dir at the given quality, returning its
+// report
+static errno_t convert_dir_at_quality(char const* src_dir, char const* quality, short overwrite, cue_traverse_report_t** report) {
+  errno_t err = 0;
+  string_vector_t* argv = 0;
+  cue_convert_env_t env;
+
+  env.out = stdout;
+  env.err = stderr;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(argv = string_vector_alloc(), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "some_dir\\cue_tests"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "-Q"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "-q"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, quality), err);
+    if (overwrite) {
+      ERR_REGION_NULL_CHECK(argv->push(argv, "-w"), err);
+    }
+    ERR_REGION_NULL_CHECK(argv->push(argv, src_dir), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, s_cue_trg_dir), err);
+
+    ERR_REGION_ERROR_CHECK(cue_convert_with_args(
+      argv->get_length(argv),
+      argv->get_buffer(argv),
+      &env, report), err);
+
+    ERR_REGION_NULL_CHECK(*report, err);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE_HANDLER(argv, string_vector_free);
+
+  return err;
+}
+
+static errno_t convert_at_quality(char const* quality, short overwrite, cue_traverse_report_t** report) {
+  return convert_dir_at_quality(s_cue_src_dir, quality, overwrite, report);
+}
+
+// the status lines of a record that mention text
+static size_t count_statuses(cue_traverse_record_t const* record, char const* text) {
+  cue_status_info_vector_t* info_list = 0;
+  size_t count = 0;
+
+  if (!record) return 0;
+  info_list = record->result->info_list;
+
+  for (size_t i = 0; i < info_list->get_length(info_list); ++i) {
+    cue_status_info_t const* info = info_list->get(info_list, i);
+    if (info->type == EWC_CST_STATUS && strstr(info->detail, text)) ++count;
+  }
+
+  return count;
+}
+
+// the record of the cue named name, wherever the traversal put it
+static cue_traverse_record_t const* find_record(cue_traverse_record_vector_t* list, char const* name) {
+  for (size_t i = 0; i < list->get_length(list); ++i) {
+    cue_traverse_record_t const* record = list->get(list, i);
+    if (strstr(record->source_path, name)) return record;
+  }
+
+  return 0;
+}
+
+static char const s_manifest_path[] = TEST_DATA SEP "new_cue_dir" SEP "cue_manifest.txt";
+static char const s_manifest_cue[] = TEST_DATA SEP "cue_dir" SEP "a" SEP "a1game" SEP "a1game.cue";
+static char const s_manifest_copied[] = TEST_DATA SEP "cue_dir" SEP "a" SEP "a1game" SEP "track01.ogg";
+static char const s_manifest_encoded[] = TEST_DATA SEP "cue_dir" SEP "a" SEP "a1game" SEP "track04.wav";
+
+errno_t test_cue_manifest(void) {
+  errno_t err = 0;
+  cue_traverse_report_t* report = 0;
+  cue_manifest_t* manifest = 0;
+  cue_manifest_entry_t* entry = 0;
+  cue_manifest_file_t const* copied = 0;
+  cue_manifest_file_t const* encoded = 0;
+
+  printf("Checking cue manifest... ");
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_ERROR_CHECK(convert_at_quality("5", 0, &report), err);
+    ERR_REGION_CMP_CHECK(report->transformed_cue_count != 2, err);
+    SAFE_FREE_HANDLER(report, cue_traverse_report_free);
+
+    // copies are hashed as they stream, but encoded sources aren't read
+    // again just to hash them
+    ERR_REGION_NULL_CHECK(manifest = cue_manifest_alloc(s_manifest_path, s_cue_src_dir, s_cue_trg_dir), err);
+    ERR_REGION_ERROR_CHECK(cue_manifest_load(manifest), err);
+    ERR_REGION_NULL_CHECK(entry = cue_manifest_find(manifest, s_manifest_cue), err);
+    ERR_REGION_NULL_CHECK(copied = cue_manifest_find_source(manifest, entry, s_manifest_copied), err);
+    ERR_REGION_NULL_CHECK(encoded = cue_manifest_find_source(manifest, entry, s_manifest_encoded), err);
+    ERR_REGION_CMP_CHECK(!copied->hash || encoded->hash || !encoded->size, err);
+    SAFE_FREE_HANDLER(manifest, cue_manifest_free);
+
+    // nothing changed, so nothing is converted, or even parsed
+    ERR_REGION_ERROR_CHECK(convert_at_quality("5", 0, &report), err);
+    ERR_REGION_CMP_CHECK(report->skipped_cue_count != 2, err);
+
+    cue_traverse_record_t const* skipped = report->skipped_list->get(report->skipped_list, 0);
+    cue_status_info_t const* info = skipped->result->info_list->get(skipped->result->info_list, 0);
+    ERR_REGION_CMP_CHECK(!strstr(info->detail, "is up to date."), err);
+    SAFE_FREE_HANDLER(report, cue_traverse_report_free);
+
+    // a missing output makes just that cue stale
+    ERR_REGION_ERROR_CHECK(delete_file(s_manifest_output), err);
+    ERR_REGION_ERROR_CHECK(convert_at_quality("5", 0, &report), err);
+    ERR_REGION_CMP_CHECK(report->transformed_cue_count != 1, err);
+    ERR_REGION_CMP_CHECK(report->skipped_cue_count != 1, err);
+    ERR_REGION_CMP_CHECK(!file_exists(s_manifest_output), err);
+    SAFE_FREE_HANDLER(report, cue_traverse_report_free);
+
+    // as does converting at another quality
+    ERR_REGION_ERROR_CHECK(convert_at_quality("4", 0, &report), err);
+    ERR_REGION_CMP_CHECK(report->transformed_cue_count != 2, err);
+    SAFE_FREE_HANDLER(report, cue_traverse_report_free);
+
+    ERR_REGION_ERROR_CHECK(convert_at_quality("4", 0, &report), err);
+    ERR_REGION_CMP_CHECK(report->skipped_cue_count != 2, err);
+    SAFE_FREE_HANDLER(report, cue_traverse_report_free);
+
+    // overwriting converts every cue again, but keeps files that are fresh
+    ERR_REGION_ERROR_CHECK(convert_at_quality("4", 1, &report), err);
+    ERR_REGION_CMP_CHECK(report->transformed_cue_count != 2, err);
+    ERR_REGION_CMP_CHECK(count_statuses(find_record(report->transformed_list, "a1game.cue"), "Kept up to date file") != 5, err);
+    SAFE_FREE_HANDLER(report, cue_traverse_report_free);
+
+    // while a file that is missing is made again
+    ERR_REGION_ERROR_CHECK(delete_file(s_manifest_output), err);
+    ERR_REGION_ERROR_CHECK(convert_at_quality("4", 1, &report), err);
+    ERR_REGION_CMP_CHECK(count_statuses(find_record(report->transformed_list, "a1game.cue"), "Kept up to date file") != 4, err);
+    ERR_REGION_CMP_CHECK(!file_exists(s_manifest_output), err);
+
+  } ERR_REGION_END()
+
+  delete_dir(s_cue_trg_dir);
+  SAFE_FREE_HANDLER(manifest, cue_manifest_free);
+  SAFE_FREE_HANDLER(report, cue_traverse_report_free);
+
+  printf("%s\n", err ? "FAILED!" : "passed.");
+
+  return err;
+}
+
+static char const s_restored_src_dir[] = TEST_DATA SEP "restored_cue_dir";
+static char const s_restored_track[] = TEST_DATA SEP "restored_cue_dir" SEP "a" SEP "a1game" SEP "track01.ogg";
+static char const s_restored_backup[] = TEST_DATA SEP "cue_dir" SEP "a" SEP "a1game" SEP "track01.ogg";
+
+errno_t test_cue_restored_source(void) {
+  errno_t err = 0;
+  cue_traverse_report_t* report = 0;
+  unsigned long long src_mtime = 0;
+  unsigned long long trg_mtime = 0;
+
+  printf("Checking cue convert of a restored source... ");
+
+  ERR_REGION_BEGIN() {
+    // a source newer than its backup is copied, keeping its time
+    ERR_REGION_ERROR_CHECK(copy_dir(s_cue_src_dir, s_restored_src_dir), err);
+    ERR_REGION_ERROR_CHECK(touch_file(s_restored_track), err);
+    ERR_REGION_ERROR_CHECK(convert_dir_at_quality(s_restored_src_dir, "5", 0, &report), err);
+    ERR_REGION_CMP_CHECK(report->transformed_cue_count != 2, err);
+    SAFE_FREE_HANDLER(report, cue_traverse_report_free);
+
+    // then restoring the backup, of the same size, moves the source's time
+    // back before the copy's, which doesn't make the copy any fresher
+    ERR_REGION_ERROR_CHECK(copy_file(s_restored_backup, s_restored_track), err);
+    ERR_REGION_ERROR_CHECK(file_mtime(s_restored_track, &src_mtime), err);
+    ERR_REGION_ERROR_CHECK(file_mtime(s_manifest_output, &trg_mtime), err);
+    ERR_REGION_CMP_CHECK(src_mtime >= trg_mtime, err);
+
+    // the manifest finds the content unchanged by its hash, so overwriting is
+    // what puts each track of the cue to the freshness test
+    ERR_REGION_ERROR_CHECK(convert_dir_at_quality(s_restored_src_dir, "5", 1, &report), err);
+    ERR_REGION_CMP_CHECK(report->transformed_cue_count != 2, err);
+    ERR_REGION_CMP_CHECK(count_statuses(find_record(report->transformed_list, "a1game.cue"), "Kept up to date file") != 4, err);
+    ERR_REGION_ERROR_CHECK(file_mtime(s_manifest_output, &trg_mtime), err);
+    ERR_REGION_CMP_CHECK(trg_mtime != src_mtime, err);
+
+  } ERR_REGION_END()
+
+  delete_dir(s_cue_trg_dir);
+  delete_dir(s_restored_src_dir);
+  SAFE_FREE_HANDLER(report, cue_traverse_report_free);
+
+  printf("%s\n", err ? "FAILED!" : "passed.");
+
+  return err;
+}
+
+// the tracks of the test cues that are copied rather than encoded
+#define COPIED_TRACKS 8
+
+errno_t test_cue_copy_counts(void) {
+  errno_t err = 0;
+  cue_traverse_report_t* report = 0;
+  copy_counts_t before;
+  copy_counts_t after;
+
+  printf("Checking cue convert copy counts... ");
+
+  ERR_REGION_BEGIN() {
+    // the tracks are hashed for the manifest, yet still left to the system
+    // to copy, rather than passed through the process
+    copy_counts_get(&before);
+    ERR_REGION_ERROR_CHECK(convert_at_quality("5", 0, &report), err);
+    copy_counts_get(&after);
+
+    ERR_REGION_CMP_CHECK(report->transformed_cue_count != 2, err);
+    ERR_REGION_CMP_CHECK(after.buffered != before.buffered, err);
+    ERR_REGION_CMP_CHECK((after.shared - before.shared) + (after.by_system - before.by_system) != COPIED_TRACKS, err);
+
+  } ERR_REGION_END()
+
+  delete_dir(s_cue_trg_dir);
+  SAFE_FREE_HANDLER(report, cue_traverse_report_free);
+
+  printf("%s\n", err ? "FAILED!" : "passed.");
+
+  return err;
+}
+
+static char const s_journal_path[] = TEST_DATA SEP "new_cue_dir" SEP "cue_journal.txt";
+static char const s_journal_output[] = TEST_DATA SEP "new_cue_dir" SEP "a" SEP "a1game" SEP "track04.ogg";
+static char const s_journal_source[] = TEST_DATA SEP "cue_dir" SEP "a" SEP "a1game" SEP "track04.wav";
+
+errno_t test_cue_journal(void) {
+  errno_t err = 0;
+  cue_traverse_report_t* report = 0;
+  cue_journal_t* journal = 0;
+  cue_journal_entry_t const* entry = 0;
+  unsigned long long size = 0;
+  FILE* file = 0;
+
+  printf("Checking cue journal... ");
+
+  ERR_REGION_BEGIN() {
+    // a run that finishes leaves neither a journal nor any parts behind
+    ERR_REGION_ERROR_CHECK(convert_at_quality("5", 0, &report), err);
+    ERR_REGION_CMP_CHECK(report->transformed_cue_count != 2, err);
+    ERR_REGION_CMP_CHECK(file_exists(s_journal_path), err);
+    ERR_REGION_CMP_CHECK(file_exists(TEST_DATA SEP "new_cue_dir" SEP "a" SEP "a1game" SEP "track04.ogg.part"), err);
+    ERR_REGION_CMP_CHECK(file_exists(TEST_DATA SEP "new_cue_dir" SEP "a" SEP "a1game" SEP "a1game.cue.part"), err);
+    SAFE_FREE_HANDLER(report, cue_traverse_report_free);
+
+    // a recorded output is found again once the journal is loaded
+    ERR_REGION_NULL_CHECK(journal = cue_journal_alloc(s_journal_path, s_cue_trg_dir), err);
+    ERR_REGION_ERROR_CHECK(cue_journal_load(journal), err);
+    ERR_REGION_CMP_CHECK(cue_journal_find(journal, s_journal_output), err);
+    ERR_REGION_ERROR_CHECK(cue_journal_add(journal, s_journal_output, s_journal_source, 5.0f), err);
+    ERR_REGION_ERROR_CHECK(cue_journal_flush(journal), err);
+    SAFE_FREE_HANDLER(journal, cue_journal_free);
+
+    // along with a line cut short by a stopped run, which is ignored
+    fopen_s(&file, s_journal_path, "ab");
+    ERR_REGION_NULL_CHECK(file, err);
+    fputs("Output: 12 3", file);
+    fclose(file);
+
+    ERR_REGION_NULL_CHECK(journal = cue_journal_alloc(s_journal_path, s_cue_trg_dir), err);
+    ERR_REGION_ERROR_CHECK(cue_journal_load(journal), err);
+    ERR_REGION_NULL_CHECK(entry = cue_journal_find(journal, s_journal_output), err);
+    ERR_REGION_ERROR_CHECK(file_size(s_journal_output, &size), err);
+    ERR_REGION_CMP_CHECK(entry->size != size || entry->quality != 5.0f, err);
+    ERR_REGION_CMP_CHECK(cue_journal_find(journal, s_manifest_output), err);
+    SAFE_FREE_HANDLER(journal, cue_journal_free);
+
+    // a run stopped before its cue, or the manifest, was written keeps the
+    // encode it journaled, rather than making it again
+    ERR_REGION_ERROR_CHECK(delete_file(TEST_DATA SEP "new_cue_dir" SEP "cue_manifest.txt"), err);
+    ERR_REGION_ERROR_CHECK(delete_file(TEST_DATA SEP "new_cue_dir" SEP "a" SEP "a1game" SEP "a1game.cue"), err);
+    ERR_REGION_ERROR_CHECK(convert_at_quality("5", 0, &report), err);
+    ERR_REGION_CMP_CHECK(report->transformed_cue_count != 1, err);
+    ERR_REGION_CMP_CHECK(count_statuses(report->transformed_list->get(report->transformed_list, 0),
+      "Kept up to date file: " TEST_DATA SEP "new_cue_dir" SEP "a" SEP "a1game" SEP "track04.ogg") != 1, err);
+
+    // and with every cue converted, the journal is done with
+    ERR_REGION_CMP_CHECK(file_exists(s_journal_path), err);
+
+  } ERR_REGION_END()
+
+  delete_dir(s_cue_trg_dir);
+  SAFE_FREE_HANDLER(journal, cue_journal_free);
+  SAFE_FREE_HANDLER(report, cue_traverse_report_free);
+
+  printf("%s\n", err ? "FAILED!" : "passed.");
+
+  return err;
+}
+
+static char const s_claims_dir[] = TEST_DATA SEP "new_cue_dir" SEP "cue_claims";
+static char const s_claimed_cue[] = "a" SEP "a1game" SEP "a1game.cue";
+
+// runs a quiet conversion as the named claiming worker
+static errno_t convert_as_worker(char const* worker, cue_traverse_report_t** report) {
+  errno_t err = 0;
+  string_vector_t* argv = 0;
+  cue_convert_env_t env;
+
+  env.out = stdout;
+  env.err = stderr;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(argv = string_vector_alloc(), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "some_dir\\cue_tests"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "-Q"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "--claim"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, worker), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, s_cue_src_dir), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, s_cue_trg_dir), err);
+
+    ERR_REGION_ERROR_CHECK(cue_convert_with_args(
+      argv->get_length(argv),
+      argv->get_buffer(argv),
+      &env, report), err);
+
+    ERR_REGION_NULL_CHECK(*report, err);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE_HANDLER(argv, string_vector_free);
+
+  return err;
+}
+
+errno_t test_cue_claims(void) {
+  errno_t err = 0;
+  cue_traverse_report_t* report = 0;
+  cue_claims_t* first = 0;
+  cue_claims_t* second = 0;
+  cue_claims_t* restarted = 0;
+  cue_claims_t* impatient = 0;
+  short acquired = 0;
+
+  printf("Checking cue claims... ");
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(first = cue_claims_alloc(s_claims_dir, "first", 120), err);
+    ERR_REGION_NULL_CHECK(second = cue_claims_alloc(s_claims_dir, "second", 120), err);
+    ERR_REGION_NULL_CHECK(restarted = cue_claims_alloc(s_claims_dir, "first", 120), err);
+    ERR_REGION_NULL_CHECK(impatient = cue_claims_alloc(s_claims_dir, "impatient", 0), err);
+
+    // only the first to ask gets a claim, even within the process
+    ERR_REGION_ERROR_CHECK(cue_claims_acquire(first, "x", &acquired), err);
+    ERR_REGION_CMP_CHECK(!acquired, err);
+    ERR_REGION_ERROR_CHECK(cue_claims_acquire(first, "x", &acquired), err);
+    ERR_REGION_CMP_CHECK(acquired, err);
+    ERR_REGION_ERROR_CHECK(cue_claims_acquire(second, "x", &acquired), err);
+    ERR_REGION_CMP_CHECK(acquired, err);
+
+    // a worker restarted under the same name takes back what it left
+    ERR_REGION_ERROR_CHECK(cue_claims_acquire(restarted, "x", &acquired), err);
+    ERR_REGION_CMP_CHECK(!acquired, err);
+
+    // and a claim older than a worker's patience is taken over
+    ERR_REGION_ERROR_CHECK(cue_claims_acquire(impatient, "x", &acquired), err);
+    ERR_REGION_CMP_CHECK(!acquired, err);
+
+    // once released, the next to ask gets it
+    ERR_REGION_ERROR_CHECK(cue_claims_release(impatient, "x"), err);
+    ERR_REGION_CMP_CHECK(!cue_claims_release(impatient, "x"), err);
+    ERR_REGION_ERROR_CHECK(cue_claims_acquire(second, "x", &acquired), err);
+    ERR_REGION_CMP_CHECK(!acquired, err);
+    ERR_REGION_ERROR_CHECK(cue_claims_release(second, "x"), err);
+
+    // a cue another worker holds is skipped, and the rest converted
+    ERR_REGION_ERROR_CHECK(cue_claims_acquire(second, s_claimed_cue, &acquired), err);
+    ERR_REGION_CMP_CHECK(!acquired, err);
+    ERR_REGION_ERROR_CHECK(convert_as_worker("worker", &report), err);
+    ERR_REGION_CMP_CHECK(report->transformed_cue_count != 1, err);
+    ERR_REGION_CMP_CHECK(report->skipped_cue_count != 1, err);
+    ERR_REGION_CMP_CHECK(!file_exists(TEST_DATA SEP "new_cue_dir" SEP "cue_manifest_worker.txt"), err);
+    ERR_REGION_CMP_CHECK(file_exists(TEST_DATA SEP "new_cue_dir" SEP "a" SEP "a1game" SEP "a1game.cue"), err);
+    SAFE_FREE_HANDLER(report, cue_traverse_report_free);
+
+    // until it lets it go
+    ERR_REGION_ERROR_CHECK(cue_claims_release(second, s_claimed_cue), err);
+    ERR_REGION_ERROR_CHECK(convert_as_worker("worker", &report), err);
+    ERR_REGION_CMP_CHECK(report->transformed_cue_count != 1, err);
+    ERR_REGION_CMP_CHECK(report->skipped_cue_count != 1, err);
+    ERR_REGION_CMP_CHECK(!file_exists(TEST_DATA SEP "new_cue_dir" SEP "a" SEP "a1game" SEP "a1game.cue"), err);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE_HANDLER(impatient, cue_claims_free);
+  SAFE_FREE_HANDLER(restarted, cue_claims_free);
+  SAFE_FREE_HANDLER(second, cue_claims_free);
+  SAFE_FREE_HANDLER(first, cue_claims_free);
+  delete_dir(s_cue_trg_dir);
+  SAFE_FREE_HANDLER(report, cue_traverse_report_free);
+
+  printf("%s\n", err ? "FAILED!" : "passed.");
+
+  return err;
+}
+
+static const char s_cue_store_dir[] = TEST_DATA SEP "cue_store";
+
+// runs a quiet conversion using the test store, returning its report
+static errno_t convert_with_store(cue_traverse_report_t** report) {
+  errno_t err = 0;
+  string_vector_t* argv = 0;
+  cue_convert_env_t env;
+
+  env.out = stdout;
+  env.err = stderr;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(argv = string_vector_alloc(), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "some_dir\\cue_tests"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "-Q"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "--store"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, s_cue_store_dir), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, s_cue_src_dir), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, s_cue_trg_dir), err);
+
+    ERR_REGION_ERROR_CHECK(cue_convert_with_args(
+      argv->get_length(argv),
+      argv->get_buffer(argv),
+      &env, report), err);
+
+    ERR_REGION_NULL_CHECK(*report, err);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE_HANDLER(argv, string_vector_free);
+
+  return err;
+}
+
+errno_t test_cue_store(void) {
+  errno_t err = 0;
+  cue_traverse_report_t* report = 0;
+  cue_traverse_record_vector_t* list = 0;
+
+  printf("Checking cue store... ");
+
+  ERR_REGION_BEGIN() {
+    // the empty test files are all one content, so only the first of them
+    // is copied, and everything after is reused.  which cue comes first is
+    // up to the file system, but either way seven files are reused
+    ERR_REGION_ERROR_CHECK(convert_with_store(&report), err);
+    list = report->transformed_list;
+    ERR_REGION_CMP_CHECK(report->transformed_cue_count != 2, err);
+    ERR_REGION_CMP_CHECK(count_statuses(list->get(list, 0), "Reused stored file")
+      + count_statuses(list->get(list, 1), "Reused stored file") != 7, err);
+    SAFE_FREE_HANDLER(report, cue_traverse_report_free);
+
+    // once stored, even the encodes needn't be made again
+    ERR_REGION_ERROR_CHECK(delete_dir(s_cue_trg_dir), err);
+    ERR_REGION_ERROR_CHECK(convert_with_store(&report), err);
+    list = report->transformed_list;
+    ERR_REGION_CMP_CHECK(report->transformed_cue_count != 2, err);
+    ERR_REGION_CMP_CHECK(count_statuses(list->get(list, 0), "Reused stored file") != 5, err);
+    ERR_REGION_CMP_CHECK(count_statuses(list->get(list, 1), "Reused stored file") != 5, err);
+    ERR_REGION_CMP_CHECK(!file_exists(TEST_DATA SEP "new_cue_dir" SEP "a" SEP "a1game" SEP "track03.ogg"), err);
+
+  } ERR_REGION_END()
+
+  delete_dir(s_cue_trg_dir);
+  delete_dir(s_cue_store_dir);
+  SAFE_FREE_HANDLER(report, cue_traverse_report_free);
+
+  printf("%s\n", err ? "FAILED!" : "passed.");
+
+  return err;
+}
+
+static const char s_cue_sheet_cache_path[] = TEST_DATA SEP "cue_sheet_cache.bin";
+static const char s_cached_cue[] = TEST_DATA SEP "cue_dir" SEP "a" SEP "a1game" SEP "a1game.cue";
+
+// runs a quiet test conversion using the test cue cache
+static errno_t audit_with_cache(cue_traverse_report_t** report) {
+  errno_t err = 0;
+  string_vector_t* argv = 0;
+  cue_convert_env_t env;
+
+  env.out = stdout;
+  env.err = stderr;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(argv = string_vector_alloc(), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "some_dir\\cue_tests"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "-Qt"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "--cue-cache"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, s_cue_sheet_cache_path), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, s_cue_src_dir), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, s_cue_trg_dir), err);
+
+    ERR_REGION_ERROR_CHECK(cue_convert_with_args(
+      argv->get_length(argv),
+      argv->get_buffer(argv),
+      &env, report), err);
+
+    ERR_REGION_NULL_CHECK(*report, err);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE_HANDLER(argv, string_vector_free);
+
+  return err;
+}
+
+errno_t test_cue_sheet_cache(void) {
+  errno_t err = 0;
+  cue_traverse_report_t* report = 0;
+  cue_sheet_cache_t* cache = 0;
+  cue_sheet_t* parsed = 0;
+  cue_sheet_t* cached = 0;
+  array_line_writer_t parsed_lines = { 0 };
+  array_line_writer_t cached_lines = { 0 };
+
+  array_line_writer_init(&parsed_lines);
+  array_line_writer_init(&cached_lines);
+
+  printf("Checking cue sheet cache... ");
+
+  ERR_REGION_BEGIN() {
+    // the first audit parses every cue, and keeps them
+    ERR_REGION_ERROR_CHECK(audit_with_cache(&report), err);
+    ERR_REGION_CMP_CHECK(report->transformed_cue_count != 2, err);
+    ERR_REGION_CMP_CHECK(!file_exists(s_cue_sheet_cache_path), err);
+    SAFE_FREE_HANDLER(report, cue_traverse_report_free);
+
+    // so the next finds the same cues without reading them
+    ERR_REGION_ERROR_CHECK(audit_with_cache(&report), err);
+    ERR_REGION_CMP_CHECK(report->transformed_cue_count != 2, err);
+
+    ERR_REGION_NULL_CHECK(cache = cue_sheet_cache_alloc(s_cue_sheet_cache_path), err);
+    ERR_REGION_ERROR_CHECK(cue_sheet_cache_load(cache), err);
+    ERR_REGION_CMP_CHECK(!cache->loaded, err);
+    ERR_REGION_CMP_CHECK(cache->entries->get_length(cache->entries) != 2, err);
+
+    // and a cached sheet is just what parsing gives
+    ERR_REGION_NULL_CHECK(cached = cue_sheet_cache_parse_filename(cache, s_cached_cue, 0), err);
+    ERR_REGION_CMP_CHECK(cache->hits != 1, err);
+    ERR_REGION_NULL_CHECK(parsed = cue_sheet_parse_filename(s_cached_cue, 0), err);
+
+    ERR_REGION_ERROR_CHECK(cue_sheet_write(parsed, &parsed_lines.line_writer), err);
+    ERR_REGION_ERROR_CHECK(cue_sheet_write(cached, &cached_lines.line_writer), err);
+    ERR_REGION_CMP_CHECK(!compare_string_arrays(parsed_lines.lines, parsed_lines.num_lines,
+      cached_lines.lines, cached_lines.num_lines), err);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE_HANDLER(cached, cue_sheet_free);
+  SAFE_FREE_HANDLER(parsed, cue_sheet_free);
+  SAFE_FREE_HANDLER(cache, cue_sheet_cache_free);
+  SAFE_FREE_HANDLER(report, cue_traverse_report_free);
+  array_line_writer_uninit(&cached_lines);
+  array_line_writer_uninit(&parsed_lines);
+  delete_file(s_cue_sheet_cache_path);
+
+  printf("%s\n", err ? "FAILED!" : "passed.");
+
+  return err;
+}
+
+static const char s_cue_catalog_path[] = TEST_DATA SEP "cue_catalog.bin";
+
+static char const* s_catalog_wav_terms[] = {
+  "type=wav",
+};
+
+// the wav plays for a second, going by its size, while the lengths of the
+// compressed tracks, and of the binary cut shorter than its index, are
+// unknown
+static char const* s_catalog_wav_result[] = {
+  "CATALOG QUERY",
+  "Source directory: " TEST_DATA SEP "cue_dir",
+  "Matching cues:",
+  "  a" SEP "a1game" SEP "a1game.cue (transformed)",
+  "Matched total: 1",
+  "Files: 5",
+  "Bytes: 352844",
+  "Audio: 0:00:01",
+  "Audio tracks of unknown length: 3",
+};
+
+static char const* s_catalog_under_terms[] = {
+  "status=transformed",
+  "under=b" SEP,
+};
+
+static char const* s_catalog_under_result[] = {
+  "CATALOG QUERY",
+  "Source directory: " TEST_DATA SEP "cue_dir",
+  "Matching cues:",
+  "  b" SEP "b2game" SEP "b2game.cue (transformed)",
+  "Matched total: 1",
+  "Files: 5",
+  "Bytes: 0",
+  "Audio: 0:00:00",
+  "Audio tracks of unknown length: 4",
+};
+
+// runs a query against the open catalog, comparing what it writes
+static errno_t check_catalog_query(
+  cue_catalog_t const* catalog,
+  char const** terms, size_t num_terms,
+  char const** expected, size_t num_expected) {
+
+  errno_t err = 0;
+  cue_catalog_query_t query;
+  array_line_writer_t writer = { 0 };
+
+  array_line_writer_init(&writer);
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_ERROR_CHECK(cue_catalog_query_parse(&query, terms, num_terms), err);
+    ERR_REGION_ERROR_CHECK(cue_catalog_query_write(catalog, &query, &writer.line_writer), err);
+    ERR_REGION_CMP_CHECK(!compare_string_arrays(expected, (int)num_expected, writer.lines, writer.num_lines), err);
+
+  } ERR_REGION_END()
+
+  array_line_writer_uninit(&writer);
+
+  return err;
+}
+
+errno_t test_cue_catalog(void) {
+  errno_t err = 0;
+  string_vector_t* argv = 0;
+  cue_convert_env_t env;
+  cue_catalog_t* catalog = 0;
+  cue_catalog_query_t query;
+  char const* bad_terms[] = { "type=flac" };
+
+  env.out = stdout;
+  env.err = stderr;
+
+  printf("Checking cue catalog... ");
+
+  ERR_REGION_BEGIN() {
+    // a test run is enough to catalog the collection
+    ERR_REGION_NULL_CHECK(argv = string_vector_alloc(), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "some_dir\\cue_tests"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "-Qt"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "--catalog"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, s_cue_catalog_path), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, s_cue_src_dir), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, s_cue_trg_dir), err);
+
+    ERR_REGION_ERROR_CHECK(cue_convert_with_args(
+      argv->get_length(argv),
+      argv->get_buffer(argv),
+      &env, 0), err);
+
+    ERR_REGION_NULL_CHECK(catalog = cue_catalog_alloc(s_cue_catalog_path), err);
+    ERR_REGION_CMP_CHECK(catalog->header->num_cues != 2, err);
+    ERR_REGION_CMP_CHECK(catalog->header->num_files != 10, err);
+
+    ERR_REGION_ERROR_CHECK(check_catalog_query(catalog,
+      s_catalog_wav_terms, sizeof(s_catalog_wav_terms) / sizeof(*s_catalog_wav_terms),
+      s_catalog_wav_result, sizeof(s_catalog_wav_result) / sizeof(*s_catalog_wav_result)), err);
+
+    ERR_REGION_ERROR_CHECK(check_catalog_query(catalog,
+      s_catalog_under_terms, sizeof(s_catalog_under_terms) / sizeof(*s_catalog_under_terms),
+      s_catalog_under_result, sizeof(s_catalog_under_result) / sizeof(*s_catalog_under_result)), err);
+
+    // a type no cue sheet names is refused
+    ERR_REGION_CMP_CHECK(!cue_catalog_query_parse(&query, bad_terms, 1), err);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE_HANDLER(catalog, cue_catalog_free);
+  SAFE_FREE_HANDLER(argv, string_vector_free);
+  delete_file(s_cue_catalog_path);
+
+  printf("%s\n", err ? "FAILED!" : "passed.");
+
+  return err;
+}
+
+typedef struct collector_test_entry {
+  size_t shard;
+  size_t sequence;
+  char const* source_path;
+  cue_traverse_report_type_t type;
+} collector_test_entry_t;
+
+// added shard by shard, so out of discovery order
+static const collector_test_entry_t s_collector_entries[] = {
+  {0, 1, "b.cue", EWC_CTR_SKIPPED},
+  {0, 4, "e.cue", EWC_CTR_SKIPPED},
+  {1, 3, "d.cue", EWC_CTR_TRANSFORMED},
+  {1, 0, "a.cue", EWC_CTR_TRANSFORMED},
+  {2, 5, "f.cue", EWC_CTR_FAILED},
+  {2, 2, "c.cue", EWC_CTR_TRANSFORMED},
+};
+
+static const size_t s_collector_entries_len =
+  sizeof(s_collector_entries) / sizeof(*s_collector_entries);
+
+static char const* s_collector_transformed[] = { "a.cue", "c.cue", "d.cue" };
+static char const* s_collector_skipped[] = { "b.cue", "e.cue" };
+
+static short compare_record_paths(cue_traverse_record_vector_t const* list, char const** paths, size_t num_paths) {
+  if (list->get_length(list) != num_paths) return 0;
+
+  for (size_t i = 0; i < num_paths; ++i) {
+    if (strcmp(list->get(list, i)->source_path, paths[i]) != 0) return 0;
+  }
+
+  return 1;
+}
+
+errno_t test_cue_report_collector(void) {
+  errno_t err = 0;
+  cue_traverse_report_collector_t* collector = 0;
+  cue_traverse_report_t* report = 0;
+  cue_traverse_record_t* record = 0;
+
+  printf("Checking cue report collector... ");
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(collector = cue_traverse_report_collector_alloc(3), err);
+    ERR_REGION_NULL_CHECK(report = cue_traverse_report_alloc(), err);
+
+    for (size_t i = 0; i < s_collector_entries_len; ++i) {
+      collector_test_entry_t const* entry = s_collector_entries + i;
+
+      record = cue_traverse_record_alloc_with_paths("target", entry->source_path);
+      ERR_REGION_NULL_CHECK(record, err);
+
+      ERR_REGION_ERROR_CHECK(cue_traverse_report_collector_add_record(
+        collector, entry->shard, entry->sequence, record, entry->type), err);
+      record = 0;
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    // no such shard
+    record = cue_traverse_record_alloc_with_paths("target", "g.cue");
+    ERR_REGION_NULL_CHECK(record, err);
+    ERR_REGION_CMP_CHECK(!cue_traverse_report_collector_add_record(
+      collector, 3, 6, record, EWC_CTR_SKIPPED), err);
+
+    ERR_REGION_ERROR_CHECK(cue_traverse_report_collector_merge(collector, report), err);
+
+    ERR_REGION_CMP_CHECK(report->found_cue_count != 6, err);
+    ERR_REGION_CMP_CHECK(report->transformed_cue_count != 3, err);
+    ERR_REGION_CMP_CHECK(report->failed_cue_count != 1, err);
+    ERR_REGION_CMP_CHECK(report->skipped_cue_count != 2, err);
+
+    ERR_REGION_CMP_CHECK(!compare_record_paths(report->transformed_list, s_collector_transformed, 3), err);
+    ERR_REGION_CMP_CHECK(!compare_record_paths(report->skipped_list, s_collector_skipped, 2), err);
+
+    SAFE_FREE_HANDLER(report, cue_traverse_report_free);
+    SAFE_FREE_HANDLER(collector, cue_traverse_report_collector_free);
+
+    // by path, whatever order the records were found in
+    ERR_REGION_NULL_CHECK(collector = cue_traverse_report_collector_alloc(3), err);
+    ERR_REGION_NULL_CHECK(report = cue_traverse_report_alloc(), err);
+    collector->by_path = 1;
+
+    for (size_t i = 0; i < s_collector_entries_len; ++i) {
+      collector_test_entry_t const* entry = s_collector_entries + i;
+
+      record = cue_traverse_record_alloc_with_paths("target", entry->source_path);
+      ERR_REGION_NULL_CHECK(record, err);
+
+      ERR_REGION_ERROR_CHECK(cue_traverse_report_collector_add_record(
+        collector, entry->shard, s_collector_entries_len - entry->sequence, record, entry->type), err);
+      record = 0;
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    ERR_REGION_ERROR_CHECK(cue_traverse_report_collector_merge(collector, report), err);
+
+    ERR_REGION_CMP_CHECK(report->found_cue_count != 6, err);
+    ERR_REGION_CMP_CHECK(!compare_record_paths(report->transformed_list, s_collector_transformed, 3), err);
+    ERR_REGION_CMP_CHECK(!compare_record_paths(report->skipped_list, s_collector_skipped, 2), err);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE_HANDLER(record, cue_traverse_record_free);
+  SAFE_FREE_HANDLER(report, cue_traverse_report_free);
+  SAFE_FREE_HANDLER(collector, cue_traverse_report_collector_free);
+
+  printf("%s\n", err ? "FAILED!" : "passed.");
+
+  return err;
+}
+
+// adds a record to report, giving it the sequence and one status entry
+static errno_t add_partial_test_record(
+  cue_traverse_report_t* report,
+  char const* source_path,
+  size_t sequence,
+  cue_traverse_report_type_t type,
+  cue_status_type_t info_type,
+  char const* detail) {
+
+  errno_t err = 0;
+  cue_traverse_record_t* record = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(record = cue_traverse_record_alloc_with_paths("target", source_path), err);
+    record->sequence = sequence;
+
+    if (info_type == EWC_CST_STATUS) {
+      ERR_REGION_NULL_CHECK(cue_sheet_process_result_add_status(record->result, detail), err);
+    }
+    else if (info_type == EWC_CST_ERROR) {
+      ERR_REGION_NULL_CHECK(cue_sheet_process_result_add_error(record->result, detail), err);
+    }
+    else {
+      ERR_REGION_NULL_CHECK(cue_sheet_process_result_add_parse_error(record->result, 12, detail), err);
+    }
+
+    ERR_REGION_NULL_CHECK(cue_traverse_report_add_record(report, record, type), err);
+    record = 0;
+
+  } ERR_REGION_END()
+
+  SAFE_FREE_HANDLER(record, cue_traverse_record_free);
+
+  return err;
+}
+
+static char const* s_partial_transformed[] = { "a.cue", "b.cue", "d.cue" };
+static char const* s_partial_failed[] = { "c.cue" };
+static char const* s_partial_skipped[] = { "e.cue" };
+
+errno_t test_cue_partial_report(void) {
+  errno_t err = 0;
+  cue_traverse_report_t* first = 0;
+  cue_traverse_report_t* second = 0;
+  cue_traverse_report_t* merged = 0;
+  cue_traverse_report_collector_t* collector = 0;
+  cue_traverse_report_collector_t* truncated = 0;
+  array_line_writer_t first_lines = { 0 };
+  array_line_writer_t second_lines = { 0 };
+  array_line_reader_t reader;
+  size_t shard = 0, num_shards = 0;
+
+  printf("Checking cue partial report... ");
+
+  ERR_REGION_BEGIN() {
+    array_line_writer_init(&first_lines);
+    array_line_writer_init(&second_lines);
+
+    // two shards of one traversal, each in its own discovery order
+    ERR_REGION_NULL_CHECK(first = cue_traverse_report_alloc(), err);
+    ERR_REGION_ERROR_CHECK(add_partial_test_record(first, "b.cue", 1, EWC_CTR_TRANSFORMED, EWC_CST_STATUS, "converted"), err);
+    ERR_REGION_ERROR_CHECK(add_partial_test_record(first, "c.cue", 2, EWC_CTR_FAILED, EWC_CST_PARSE_ERROR, "FILE"), err);
+    ERR_REGION_ERROR_CHECK(add_partial_test_record(first, "e.cue", 4, EWC_CTR_SKIPPED, EWC_CST_STATUS, "already exists."), err);
+
+    ERR_REGION_NULL_CHECK(second = cue_traverse_report_alloc(), err);
+    ERR_REGION_ERROR_CHECK(add_partial_test_record(second, "a.cue", 0, EWC_CTR_TRANSFORMED, EWC_CST_STATUS, "converted"), err);
+    ERR_REGION_ERROR_CHECK(add_partial_test_record(second, "d.cue", 3, EWC_CTR_TRANSFORMED, EWC_CST_ERROR, "odd, but kept"), err);
+
+    ERR_REGION_ERROR_CHECK(cue_traverse_partial_report_write(&first_lines.line_writer, first, 1, 2), err);
+    ERR_REGION_ERROR_CHECK(cue_traverse_partial_report_write(&second_lines.line_writer, second, 2, 2), err);
+
+    // a report cut short is refused
+    ERR_REGION_NULL_CHECK(truncated = cue_traverse_report_collector_alloc(1), err);
+    array_line_reader_init_lines(&reader, (char const**)first_lines.lines, first_lines.num_lines - 1);
+    ERR_REGION_CMP_CHECK(!cue_traverse_partial_report_read(&reader.line_reader, truncated, 0, &shard, &num_shards), err);
+
+    ERR_REGION_NULL_CHECK(collector = cue_traverse_report_collector_alloc(2), err);
+
+    // read the second first, the merge restores the order
+    array_line_reader_init_lines(&reader, (char const**)second_lines.lines, second_lines.num_lines);
+    ERR_REGION_ERROR_CHECK(cue_traverse_partial_report_read(&reader.line_reader, collector, 0, &shard, &num_shards), err);
+    ERR_REGION_CMP_CHECK(shard != 2 || num_shards != 2, err);
+
+    array_line_reader_init_lines(&reader, (char const**)first_lines.lines, first_lines.num_lines);
+    ERR_REGION_ERROR_CHECK(cue_traverse_partial_report_read(&reader.line_reader, collector, 1, &shard, &num_shards), err);
+    ERR_REGION_CMP_CHECK(shard != 1 || num_shards != 2, err);
+
+    ERR_REGION_NULL_CHECK(merged = cue_traverse_report_alloc(), err);
+    ERR_REGION_ERROR_CHECK(cue_traverse_report_collector_merge(collector, merged), err);
+
+    ERR_REGION_CMP_CHECK(merged->found_cue_count != 5, err);
+    ERR_REGION_CMP_CHECK(!compare_record_paths(merged->transformed_list, s_partial_transformed, 3), err);
+    ERR_REGION_CMP_CHECK(!compare_record_paths(merged->failed_list, s_partial_failed, 1), err);
+    ERR_REGION_CMP_CHECK(!compare_record_paths(merged->skipped_list, s_partial_skipped, 1), err);
+
+    // the details come back too
+    cue_traverse_record_t const* failed = merged->failed_list->get(merged->failed_list, 0);
+    cue_status_info_t const* info = failed->result->info_list->get(failed->result->info_list, 0);
+    ERR_REGION_CMP_CHECK(strcmp(failed->target_path, "target") != 0, err);
+    ERR_REGION_CMP_CHECK(!failed->result->has_errors, err);
+    ERR_REGION_CMP_CHECK(info->type != EWC_CST_PARSE_ERROR || info->line_num != 12, err);
+    ERR_REGION_CMP_CHECK(strcmp(info->detail, "FILE") != 0, err);
+
+    cue_traverse_record_t const* skipped = merged->skipped_list->get(merged->skipped_list, 0);
+    info = skipped->result->info_list->get(skipped->result->info_list, 0);
+    ERR_REGION_CMP_CHECK(!skipped->result->has_status, err);
+    ERR_REGION_CMP_CHECK(strcmp(info->detail, "already exists.") != 0, err);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE_HANDLER(truncated, cue_traverse_report_collector_free);
+  SAFE_FREE_HANDLER(collector, cue_traverse_report_collector_free);
+  SAFE_FREE_HANDLER(merged, cue_traverse_report_free);
+  SAFE_FREE_HANDLER(second, cue_traverse_report_free);
+  SAFE_FREE_HANDLER(first, cue_traverse_report_free);
+  array_line_writer_uninit(&second_lines);
+  array_line_writer_uninit(&first_lines);
+
+  printf("%s\n", err ? "FAILED!" : "passed.");
+
+  return err;
+}
+
+static char const* const s_shard_reports[] = {
+  TEST_DATA SEP "shard_1.txt",
+  TEST_DATA SEP "shard_2.txt",
+};
+
+errno_t test_cue_convert_shards(void) {
+  errno_t err = 0;
+  string_vector_t* argv = 0;
+  cue_convert_env_t env;
+  cue_traverse_report_t* report = 0;
+  char shard_arg[16];
+
+  env.out = stdout;
+  env.err = stderr;
+
+  printf("Checking cue convert with shards... ");
+
+  ERR_REGION_BEGIN() {
+
+    // each shard converts its share into the same target
+    for (size_t i = 0; i < 2; ++i) {
+      snprintf(shard_arg, sizeof(shard_arg), "%zu/2", i + 1);
+
+      ERR_REGION_NULL_CHECK(argv = string_vector_alloc(), err);
+      ERR_REGION_NULL_CHECK(argv->push(argv, "some_dir\\cue_tests"), err);
+      ERR_REGION_NULL_CHECK(argv->push(argv, "-Q"), err);
+      ERR_REGION_NULL_CHECK(argv->push(argv, "--shard"), err);
+      ERR_REGION_NULL_CHECK(argv->push(argv, shard_arg), err);
+      ERR_REGION_NULL_CHECK(argv->push(argv, "-r"), err);
+      ERR_REGION_NULL_CHECK(argv->push(argv, s_shard_reports[i]), err);
+      ERR_REGION_NULL_CHECK(argv->push(argv, s_cue_src_dir), err);
+      ERR_REGION_NULL_CHECK(argv->push(argv, s_cue_trg_dir), err);
+
+      ERR_REGION_ERROR_CHECK(cue_convert_with_args(
+        argv->get_length(argv),
+        argv->get_buffer(argv),
+        &env, 0), err);
+
+      SAFE_FREE_HANDLER(argv, string_vector_free);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    // a merge of only some shards would leave cues out
+    ERR_REGION_NULL_CHECK(argv = string_vector_alloc(), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "some_dir\\cue_tests"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "-Q"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, "--merge"), err);
+    ERR_REGION_NULL_CHECK(argv->push(argv, s_shard_reports[1]), err);
+
+    ERR_REGION_CMP_CHECK(!cue_convert_with_args(
+      argv->get_length(argv),
+      argv->get_buffer(argv),
+      &env, 0), err);
+
+    ERR_REGION_NULL_CHECK(argv->push(argv, s_shard_reports[0]), err);
+
+    ERR_REGION_ERROR_CHECK(cue_convert_with_args(
+      argv->get_length(argv),
+      argv->get_buffer(argv),
+      &env, &report), err);
+
+    // together, the shards did what a single run would have
+    ERR_REGION_NULL_CHECK(report, err);
+    ERR_REGION_ERROR_CHECK(compare_report(report, &s_traverse_results), err);
+
+    ERR_REGION_ERROR_CHECK(check_dir_entries(s_cue_trg_dir, s_test_shard_result, s_test_shard_result_len), err);
+
+  } ERR_REGION_END()
+
+  delete_dir(s_cue_trg_dir);
+  delete_file(s_shard_reports[0]);
+  delete_file(s_shard_reports[1]);
+  SAFE_FREE_HANDLER(report, cue_traverse_report_free);
+  SAFE_FREE_HANDLER(argv, string_vector_free);
+
+  printf("%s\n", err ? "FAILED!" : "passed.");
+
+  return err;
+}
+
+static const char s_watch_dir[] = TEST_DATA SEP "watch_dir";
+static const char s_watch_file[] = TEST_DATA SEP "watch_dir" SEP "disc.cue";
+static const char s_watch_sub_dir[] = TEST_DATA SEP "watch_dir" SEP "disc";
+
+// waits for the watch to hand out at least count directories
+static errno_t wait_for_settled(cue_watch_t* watch, string_vector_t* dirs, string_vector_t* trees, size_t count) {
+  errno_t err = 0;
+
+  ERR_REGION_BEGIN() {
+    for (int i = 0; i < 20 && dirs->get_length(dirs) + trees->get_length(trees) < count; ++i) {
+      ERR_REGION_ERROR_CHECK(cue_watch_wait(watch, 250, dirs, trees), err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+  } ERR_REGION_END()
+
+  return err;
+}
+
+errno_t test_cue_watch(void) {
+  errno_t err = 0;
+  cue_watch_t* watch = 0;
+  string_vector_t* dirs = 0;
+  string_vector_t* trees = 0;
+  FILE* file = 0;
+
+  printf("Checking cue watch... ");
+
+  ERR_REGION_BEGIN() {
+    delete_dir(s_watch_dir);
+    ERR_REGION_ERROR_CHECK(ensure_dir(s_watch_dir), err);
+    ERR_REGION_NULL_CHECK(dirs = string_vector_alloc(), err);
+    ERR_REGION_NULL_CHECK(trees = string_vector_alloc(), err);
+
+    // with nothing to wait for, a change is handed out straight away
+    ERR_REGION_NULL_CHECK(watch = cue_watch_alloc(s_watch_dir, 0), err);
+
+    fopen_s(&file, s_watch_file, "wb");
+    ERR_REGION_NULL_CHECK(file, err);
+    fputs("FILE \"disc.bin\" BINARY\n", file);
+    fclose(file);
+    ERR_REGION_ERROR_CHECK(make_dir(s_watch_sub_dir), err);
+
+    // the file by the directory it is in, and the new directory whole
+    ERR_REGION_ERROR_CHECK(wait_for_settled(watch, dirs, trees, 2), err);
+    ERR_REGION_CMP_CHECK(dirs->get_length(dirs) != 1, err);
+    ERR_REGION_CMP_CHECK(strcmp(dirs->get(dirs, 0), s_watch_dir) != 0, err);
+    ERR_REGION_CMP_CHECK(trees->get_length(trees) != 1, err);
+    ERR_REGION_CMP_CHECK(strcmp(trees->get(trees, 0), s_watch_sub_dir) != 0, err);
+    dirs->pop(dirs);
+    trees->pop(trees);
+    SAFE_FREE_HANDLER(watch, cue_watch_free);
+
+    // otherwise a directory is held until it has gone quiet
+    ERR_REGION_NULL_CHECK(watch = cue_watch_alloc(s_watch_dir, 60), err);
+    ERR_REGION_ERROR_CHECK(delete_file(s_watch_file), err);
+
+    fopen_s(&file, s_watch_file, "wb");
+    ERR_REGION_NULL_CHECK(file, err);
+    fclose(file);
+
+    for (int i = 0; i < 20 && !watch->pending->get_length(watch->pending); ++i) {
+      ERR_REGION_ERROR_CHECK(cue_watch_wait(watch, 250, dirs, trees), err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    ERR_REGION_CMP_CHECK(watch->pending->get_length(watch->pending) != 1, err);
+    ERR_REGION_CMP_CHECK(dirs->get_length(dirs) || trees->get_length(trees), err);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE_HANDLER(watch, cue_watch_free);
+  SAFE_FREE_HANDLER(trees, string_vector_free);
+  SAFE_FREE_HANDLER(dirs, string_vector_free);
+  delete_dir(s_watch_dir);
 
   printf("%s\n", err ? "FAILED!" : "passed.");
 
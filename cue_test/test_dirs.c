@@ -4,21 +4,36 @@
 #include <string.h>
 
 #include "filesystem.h"
+#include "directory_cache.h"
 #include "directory_traversal.h"
 #include "directory_traversal_handler.h"
 #include "path.h"
 #include "string_vector.h"
 #include "string_helpers.h"
 #include "mem_helpers.h"
+#include "hash_helpers.h"
 #include "err_helpers.h"
 #include "char_vector.h"
+#include "test_helpers.h"
 #include "test_visitors.h"
 
-static const char s_test_dir[] = "..\\test_data\\test_dir";
-static const char s_test_delete_dir[] = "..\\test_data\\ensure_dir";
-static const char s_test_ensure_dir[] = "..\\test_data\\ensure_dir\\a\\dir\\to\\ensure";
-static const char s_parallel_dir[] = "p:\\parallel_path";
-static const char s_copy_dir[] = "..\\test_data\\copy_dir";
+static const char s_test_dir[] = TEST_DATA SEP "test_dir";
+static const char s_test_delete_dir[] = TEST_DATA SEP "ensure_dir";
+static const char s_test_ensure_dir[] = TEST_DATA SEP "ensure_dir" SEP "a" SEP "dir" SEP "to" SEP "ensure";
+static const char s_parallel_dir[] = "p:" SEP "parallel_path";
+static const char s_copy_dir[] = TEST_DATA SEP "copy_dir";
+static const char s_size_file[] = TEST_DATA SEP "cue_dir" SEP "a" SEP "a1game" SEP "track03.bin";
+static const char s_copy_file[] = TEST_DATA SEP "copy_file.bin";
+static const char s_size_missing_file[] = TEST_DATA SEP "cue_dir" SEP "a" SEP "a1game" SEP "missing.bin";
+static const unsigned long long s_size_file_bytes = 176400;
+static const char s_size_file_upper[] = TEST_DATA SEP "cue_dir" SEP "a" SEP "a1game" SEP "TRACK03.BIN";
+static const char s_cache_dir[] = TEST_DATA SEP "dir_cache";
+static const char s_cache_ensure_dir[] = TEST_DATA SEP "dir_cache" SEP "a" SEP "b";
+static const char s_cache_other_dir[] = TEST_DATA SEP "dir_cache" SEP "a" SEP "c";
+static const char s_cache_file[] = TEST_DATA SEP "dir_cache" SEP "a" SEP "b" SEP "file.bin";
+static const char s_copy_fail_dir[] = TEST_DATA SEP "copy_fail";
+static const char s_copy_fail_file[] = TEST_DATA SEP "copy_fail" SEP "kept.bin";
+static const char s_copy_fail_content[] = "kept";
 
 //#define PRINT_ONLY
 
@@ -46,6 +61,38 @@ static const dir_entry_fields_t s_test_traverse_result[] = {
 static const size_t s_test_traverse_result_len =
   sizeof(s_test_traverse_result) / sizeof(*s_test_traverse_result);
 
+// files ending in 02 or matching file01?1, from the whole tree
+static const dir_entry_fields_t s_test_filtered_result[] = {
+  {"file0101", 0},
+  {"file0102", 0},
+  {"file0202", 0},
+  {"file02", 0},
+};
+
+static const size_t s_test_filtered_result_len =
+  sizeof(s_test_filtered_result) / sizeof(*s_test_filtered_result);
+
+// files ending in 02 from the top only, where directories aren't held to it
+static const dir_entry_fields_t s_test_filtered_list_result[] = {
+  {"dir01", 1},
+  {"dir02", 1},
+  {"file02", 0},
+};
+
+static const size_t s_test_filtered_list_result_len =
+  sizeof(s_test_filtered_list_result) / sizeof(*s_test_filtered_list_result);
+
+static char const* const s_filter_suffixes[] = { "02" };
+static char const* const s_filter_patterns[] = { "file01?1" };
+
+// only the file copied over, with nothing left of the failed copy
+static const dir_entry_fields_t s_copy_fail_result[] = {
+  {"kept.bin", 0},
+};
+
+static const size_t s_copy_fail_result_len =
+  sizeof(s_copy_fail_result) / sizeof(*s_copy_fail_result);
+
 static const dir_entry_fields_t s_test_ensure_result[] = {
   {"a", 1},
   {"dir", 1},
@@ -56,6 +103,8 @@ static const dir_entry_fields_t s_test_ensure_result[] = {
 static const size_t s_test_ensure_result_len =
 sizeof(s_test_ensure_result) / sizeof(*s_test_ensure_result);
 
+// drives aren't enumerated, nor are the . and .. parts
+#ifdef _WIN32
 static char const *s_path_enum_paths[] = {
   "r:\\emu\\roms\\pcecd\\a\\akumajo",
   "\\emu\\roms\\pcecd\\a\\akumajo",
@@ -67,6 +116,19 @@ static char const* s_path_enum_paths_0[] = { "r:\\emu", "r:\\emu\\roms", "r:\\em
 static char const* s_path_enum_paths_1[] = { "\\emu", "\\emu\\roms", "\\emu\\roms\\pcecd", "\\emu\\roms\\pcecd\\a", "\\emu\\roms\\pcecd\\a\\akumajo", NULL };
 static char const* s_path_enum_paths_2[] = { "r:\\emu", "r:\\emu\\.\\.\\.\\akumajo", NULL };
 static char const* s_path_enum_paths_3[] = { "r:\\emu", "r:\\emu\\.\\..\\.\\akumajo", NULL };
+#else
+static char const *s_path_enum_paths[] = {
+  "emu/roms/pcecd/a/akumajo",
+  "/emu/roms/pcecd/a/akumajo",
+  "emu/././akumajo",
+  "/emu/./.././akumajo",
+};
+
+static char const* s_path_enum_paths_0[] = { "emu", "emu/roms", "emu/roms/pcecd", "emu/roms/pcecd/a", "emu/roms/pcecd/a/akumajo", NULL };
+static char const* s_path_enum_paths_1[] = { "/emu", "/emu/roms", "/emu/roms/pcecd", "/emu/roms/pcecd/a", "/emu/roms/pcecd/a/akumajo", NULL };
+static char const* s_path_enum_paths_2[] = { "emu", "emu/././akumajo", NULL };
+static char const* s_path_enum_paths_3[] = { "/emu", "/emu/./.././akumajo", NULL };
+#endif
 
 static char const** s_path_enum_path_parts[] = {
   s_path_enum_paths_0,
@@ -76,14 +138,14 @@ static char const** s_path_enum_path_parts[] = {
 };
 
 static char const* s_parallel_dirs[] = {
-  "p:\\parallel_path\\dir01",
-  "p:\\parallel_path\\dir01\\file0101",
-  "p:\\parallel_path\\dir01\\file0102",
-  "p:\\parallel_path\\dir02",
-  "p:\\parallel_path\\dir02\\file0201",
-  "p:\\parallel_path\\dir02\\file0202",
-  "p:\\parallel_path\\file01",
-  "p:\\parallel_path\\file02",
+  "p:" SEP "parallel_path" SEP "dir01",
+  "p:" SEP "parallel_path" SEP "dir01" SEP "file0101",
+  "p:" SEP "parallel_path" SEP "dir01" SEP "file0102",
+  "p:" SEP "parallel_path" SEP "dir02",
+  "p:" SEP "parallel_path" SEP "dir02" SEP "file0201",
+  "p:" SEP "parallel_path" SEP "dir02" SEP "file0202",
+  "p:" SEP "parallel_path" SEP "file01",
+  "p:" SEP "parallel_path" SEP "file02",
 };
 
 //
@@ -99,23 +161,94 @@ void test_traverse_dirs_print(void) {
 
 errno_t test_traverse_dirs(void) {
 #ifndef PRINT_ONLY
-  compare_visitor_t visitor;
-  compare_visitor_init(&visitor, s_test_traverse_result, s_test_traverse_result_len);
+  unordered_visitor_t visitor;
+  short passed = 0;
 
   printf("Checking traversal of directory %s... ", s_test_dir);
 
-  traverse_dir_path(s_test_dir, &visitor.handler_i);
-
-  if (visitor.line != s_test_traverse_result_len) visitor.passed = 0;
+  if (!unordered_visitor_init(&visitor, s_test_traverse_result, s_test_traverse_result_len, 0)) {
+    traverse_dir_path(s_test_dir, &visitor.handler_i);
+    passed = visitor.passed && visitor.line == s_test_traverse_result_len;
+    unordered_visitor_uninit(&visitor);
+  }
 
-  printf("%s\n", visitor.passed ? "passed." : "FAILED!");
+  printf("%s\n", passed ? "passed." : "FAILED!");
 
-  return !visitor.passed;
+  return !passed;
 #else
   test_traverse_dirs_print();
 #endif
 }
 
+errno_t test_traverse_dirs_parallel(void) {
+  errno_t err = 0;
+  unordered_visitor_t visitor = { 0 };
+  directory_traversal_options_t opts;
+
+  printf("Checking parallel traversal of directory %s... ", s_test_dir);
+
+  for (short post_visit = 0; post_visit < 2 && !err; ++post_visit) {
+    memset(&opts, 0, sizeof(opts));
+    opts.should_descend = 1;
+    opts.post_visit = post_visit;
+    opts.threads = 4;
+
+    err = unordered_visitor_init(&visitor, s_test_traverse_result, s_test_traverse_result_len, post_visit);
+    if (err) break;
+
+    if (!traverse_dir_path_opts(s_test_dir, &opts, &visitor.handler_i)) err = -1;
+    if (!visitor.passed || visitor.line != s_test_traverse_result_len) err = -1;
+
+    unordered_visitor_uninit(&visitor);
+  }
+
+  printf("%s\n", err ? "FAILED!" : "passed.");
+
+  return err;
+}
+
+errno_t test_traverse_dirs_filtered(void) {
+  unordered_visitor_t visitor;
+  directory_traversal_options_t opts;
+  short passed = 1;
+
+  printf("Checking filtered traversal of directory %s... ", s_test_dir);
+
+  if (unordered_visitor_init(&visitor, s_test_filtered_result, s_test_filtered_result_len, 0)) {
+    printf("%s\n", "FAILED!");
+    return -1;
+  }
+
+  memset(&opts, 0, sizeof(opts));
+  opts.should_descend = 1;
+  opts.files_only = 1;
+  opts.suffixes = s_filter_suffixes;
+  opts.num_suffixes = sizeof(s_filter_suffixes) / sizeof(*s_filter_suffixes);
+  opts.patterns = s_filter_patterns;
+  opts.num_patterns = sizeof(s_filter_patterns) / sizeof(*s_filter_patterns);
+
+  traverse_dir_path_opts(s_test_dir, &opts, &visitor.handler_i);
+  if (!visitor.passed || visitor.line != s_test_filtered_result_len) passed = 0;
+  unordered_visitor_uninit(&visitor);
+
+  if (unordered_visitor_init(&visitor, s_test_filtered_list_result, s_test_filtered_list_result_len, 0)) {
+    printf("%s\n", "FAILED!");
+    return -1;
+  }
+
+  memset(&opts, 0, sizeof(opts));
+  opts.suffixes = s_filter_suffixes;
+  opts.num_suffixes = sizeof(s_filter_suffixes) / sizeof(*s_filter_suffixes);
+
+  traverse_dir_path_opts(s_test_dir, &opts, &visitor.handler_i);
+  if (!visitor.passed || visitor.line != s_test_filtered_list_result_len) passed = 0;
+  unordered_visitor_uninit(&visitor);
+
+  printf("%s\n", passed ? "passed." : "FAILED!");
+
+  return !passed;
+}
+
 void test_list_dir_print(void) {
   print_visitor_t visitor;
   print_visitor_init(&visitor);
@@ -128,21 +261,23 @@ void test_list_dir_print(void) {
 
 errno_t test_list_dir(void) {
 #ifndef PRINT_ONLY
-  compare_visitor_t visitor;
-  compare_visitor_init(&visitor, s_test_list_dir_result, s_test_list_dir_result_len);
+  unordered_visitor_t visitor;
+  short passed = 0;
 
   directory_traversal_options_t opts;
   memset(&opts, 0, sizeof(opts));
 
   printf("Checking listing of directory %s... ", s_test_dir);
 
-  traverse_dir_path_opts(s_test_dir, &opts, &visitor.handler_i);
-
-  if (visitor.line != s_test_list_dir_result_len) visitor.passed = 0;
+  if (!unordered_visitor_init(&visitor, s_test_list_dir_result, s_test_list_dir_result_len, 0)) {
+    traverse_dir_path_opts(s_test_dir, &opts, &visitor.handler_i);
+    passed = visitor.passed && visitor.line == s_test_list_dir_result_len;
+    unordered_visitor_uninit(&visitor);
+  }
 
-  printf("%s\n", visitor.passed ? "passed." : "FAILED!");
+  printf("%s\n", passed ? "passed." : "FAILED!");
 
-  return ! visitor.passed;
+  return !passed;
 #else
   test_list_dir_print();
 #endif
@@ -152,7 +287,7 @@ static void print_path_enumeration(char const* path) {
   path_enumerator_i* i = enumerate_path(path);
   while (i->has_next(i)) {
     path_enumerate_status_t status = i->next(i);
-    printf("%.*s\n", status.path_end - status.full_path_start, status.full_path_start);
+    printf("%.*s\n", (int)(status.path_end - status.full_path_start), status.full_path_start);
   }
 
   i->dispose(i);
@@ -238,19 +373,20 @@ errno_t test_enumerate_path(void) {
 
 errno_t test_parallel_traverse(void) {
   parallel_traverse_visitor_t visitor;
+  short passed = 0;
 
   printf("Checking parallel path enumeration... ");
 
   size_t result_len = sizeof(s_parallel_dirs) / sizeof(*s_parallel_dirs);
-  parallel_traverse_visitor_init(&visitor, s_parallel_dir, s_parallel_dirs, result_len);
-
-  traverse_dir_path(s_test_dir, &visitor.pv_t.handler_i);
-
-  parallel_traverse_visitor_uninit(&visitor);
+  if (!parallel_traverse_visitor_init(&visitor, s_parallel_dir, s_parallel_dirs, result_len)) {
+    traverse_dir_path(s_test_dir, &visitor.pv_t.handler_i);
+    passed = visitor.passed && visitor.line == result_len;
+    parallel_traverse_visitor_uninit(&visitor);
+  }
 
-  printf("%s\n", visitor.passed ? "passed." : "FAILED!");
+  printf("%s\n", passed ? "passed." : "FAILED!");
 
-  return visitor.passed ? 0 : -1;
+  return passed ? 0 : -1;
 }
 
 errno_t test_copy_dir(void) {
@@ -258,24 +394,228 @@ errno_t test_copy_dir(void) {
 
   printf("Checking directory copying... ");
 
-  compare_visitor_t visitor;
+  unordered_visitor_t visitor = { 0 };
 
   ERR_REGION_BEGIN() {
 
     // configure as though listing the test dir, since we are making a copy
-    compare_visitor_init(&visitor, s_test_traverse_result, s_test_traverse_result_len);
+    ERR_REGION_ERROR_CHECK(unordered_visitor_init(&visitor, s_test_traverse_result, s_test_traverse_result_len, 0), err);
 
     ERR_REGION_ERROR_CHECK(copy_dir(s_test_dir, s_copy_dir), err);
 
     traverse_dir_path(s_copy_dir, &visitor.handler_i);
 
-    ERR_REGION_CMP_CHECK(visitor.line != s_test_traverse_result_len, err);
+    ERR_REGION_CMP_CHECK(!visitor.passed || visitor.line != s_test_traverse_result_len, err);
 
   } ERR_REGION_END()
 
+  unordered_visitor_uninit(&visitor);
+
   delete_dir(s_copy_dir);
 
   printf("%s\n", err ? "FAILED!" : "passed.");
 
   return err;
-}
\ No newline at end of file
+}
+
+errno_t test_copy_file_failure(void) {
+  errno_t err = 0;
+  FILE* file = 0;
+  char content[sizeof(s_copy_fail_content)] = { 0 };
+  unordered_visitor_t visitor = { 0 };
+
+  printf("Checking failed file copy... ");
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_ERROR_CHECK(ensure_dir(s_copy_fail_dir), err);
+    ERR_REGION_ERROR_CHECK(fopen_s(&file, s_copy_fail_file, "wb"), err);
+    ERR_REGION_CMP_CHECK(fwrite(s_copy_fail_content, 1, sizeof(s_copy_fail_content), file) != sizeof(s_copy_fail_content), err);
+    ERR_REGION_CMP_CHECK(fclose(file), err);
+    file = 0;
+
+    // a directory opens, but can't be read as a file, so the copy fails
+    // part way, after the file it copies to is made
+    ERR_REGION_CMP_CHECK(!copy_file(s_test_dir, s_copy_fail_file), err);
+    ERR_REGION_CMP_CHECK(!copy_file_as(s_test_dir, s_copy_fail_file, EWC_CS_COPY, NULL), err);
+    ERR_REGION_CMP_CHECK(!copy_file(s_size_missing_file, s_copy_fail_file), err);
+
+    // the file that was there is just as it was
+    ERR_REGION_ERROR_CHECK(fopen_s(&file, s_copy_fail_file, "rb"), err);
+    ERR_REGION_CMP_CHECK(fread(content, 1, sizeof(content), file) != sizeof(content), err);
+    ERR_REGION_CMP_CHECK(memcmp(content, s_copy_fail_content, sizeof(content)) != 0, err);
+
+    ERR_REGION_ERROR_CHECK(unordered_visitor_init(&visitor, s_copy_fail_result, s_copy_fail_result_len, 0), err);
+    traverse_dir_path(s_copy_fail_dir, &visitor.handler_i);
+    ERR_REGION_CMP_CHECK(!visitor.passed || visitor.line != s_copy_fail_result_len, err);
+
+  } ERR_REGION_END()
+
+  if (file) fclose(file);
+  unordered_visitor_uninit(&visitor);
+  delete_dir(s_copy_fail_dir);
+
+  printf("%s\n", err ? "FAILED!" : "passed.");
+
+  return err;
+}
+
+errno_t test_file_size(void) {
+  errno_t err = 0;
+  unsigned long long size = 0;
+
+  printf("Checking file size %s... ", s_size_file);
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_ERROR_CHECK(file_size(s_size_file, &size), err);
+    ERR_REGION_CMP_CHECK(size != s_size_file_bytes, err);
+
+    // a missing file reports an error rather than a size
+    ERR_REGION_CMP_CHECK(!file_size(s_size_missing_file, &size), err);
+
+  } ERR_REGION_END()
+
+  printf("%s\n", err ? "FAILED!" : "passed.");
+
+  return err;
+}
+
+errno_t test_file_mtime(void) {
+  errno_t err = 0;
+  unsigned long long mtime = 0;
+
+  printf("Checking file mtime %s... ", s_size_file);
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_ERROR_CHECK(file_mtime(s_size_file, &mtime), err);
+    ERR_REGION_CMP_CHECK(!mtime, err);
+
+    ERR_REGION_CMP_CHECK(!file_mtime(s_size_missing_file, &mtime), err);
+
+  } ERR_REGION_END()
+
+  printf("%s\n", err ? "FAILED!" : "passed.");
+
+  return err;
+}
+
+errno_t test_copy_file_hashed(void) {
+  errno_t err = 0;
+  unsigned long long copied_hash = 0;
+  unsigned long long hash = 0;
+  unsigned long long size = 0;
+
+  printf("Checking hashed file copy %s... ", s_size_file);
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_ERROR_CHECK(copy_file_hashed(s_size_file, s_copy_file, &copied_hash), err);
+
+    ERR_REGION_ERROR_CHECK(file_size(s_copy_file, &size), err);
+    ERR_REGION_CMP_CHECK(size != s_size_file_bytes, err);
+
+    // the hash taken during the copy is the one of the content
+    ERR_REGION_ERROR_CHECK(hash_file(s_copy_file, &hash), err);
+    ERR_REGION_CMP_CHECK(hash != copied_hash, err);
+
+    ERR_REGION_CMP_CHECK(!copy_file_hashed(s_size_missing_file, s_copy_file, &copied_hash), err);
+
+  } ERR_REGION_END()
+
+  delete_file(s_copy_file);
+
+  printf("%s\n", err ? "FAILED!" : "passed.");
+
+  return err;
+}
+
+errno_t test_copy_file_as(void) {
+  errno_t err = 0;
+  unsigned long long copied_hash = 0;
+  unsigned long long hash = 0;
+  unsigned long long size = 0;
+  unsigned long long mtime = 0;
+  unsigned long long copied_mtime = 0;
+
+  printf("Checking file copy strategies %s... ", s_size_file);
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_ERROR_CHECK(hash_file(s_size_file, &hash), err);
+    ERR_REGION_ERROR_CHECK(file_mtime(s_size_file, &mtime), err);
+
+    // however it's made, the copy has the content and time of the source
+    for (copy_strategy_t strategy = EWC_CS_AUTO; strategy < EWC_CS_LAST; ++strategy) {
+      ERR_REGION_ERROR_CHECK(copy_file_as(s_size_file, s_copy_file, strategy, &copied_hash), err);
+      ERR_REGION_CMP_CHECK(copied_hash != hash, err);
+
+      ERR_REGION_ERROR_CHECK(file_size(s_copy_file, &size), err);
+      ERR_REGION_CMP_CHECK(size != s_size_file_bytes, err);
+      ERR_REGION_ERROR_CHECK(file_mtime(s_copy_file, &copied_mtime), err);
+      ERR_REGION_CMP_CHECK(copied_mtime != mtime, err);
+
+      // a link can't replace a file, so this one is copied over the last
+      ERR_REGION_ERROR_CHECK(copy_file_as(s_size_file, s_copy_file, strategy, NULL), err);
+      ERR_REGION_ERROR_CHECK(hash_file(s_copy_file, &copied_hash), err);
+      ERR_REGION_CMP_CHECK(copied_hash != hash, err);
+
+      ERR_REGION_ERROR_CHECK(delete_file(s_copy_file), err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    ERR_REGION_CMP_CHECK(!copy_file_as(s_size_missing_file, s_copy_file, EWC_CS_LINK, NULL), err);
+
+  } ERR_REGION_END()
+
+  delete_file(s_copy_file);
+
+  printf("%s\n", err ? "FAILED!" : "passed.");
+
+  return err;
+}
+
+errno_t test_directory_cache(void) {
+  errno_t err = 0;
+  directory_cache_t* cache = 0;
+  size_t creates = 0;
+
+  printf("Checking directory cache %s... ", s_cache_dir);
+
+  if (file_exists(s_cache_dir)) {
+    delete_dir(s_cache_dir);
+  }
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(cache = directory_cache_alloc(), err);
+
+    // files in the same directory are all answered by one listing
+    ERR_REGION_CMP_CHECK(!directory_cache_file_exists(cache, s_size_file), err);
+    ERR_REGION_CMP_CHECK(directory_cache_file_exists(cache, s_size_missing_file), err);
+    ERR_REGION_CMP_CHECK(directory_cache_file_exists(cache, s_size_file_upper) != k_path_ignores_case, err);
+    ERR_REGION_CMP_CHECK(cache->listings != 1, err);
+
+    // a missing directory holds nothing
+    ERR_REGION_CMP_CHECK(directory_cache_file_exists(cache, s_cache_file), err);
+
+    ERR_REGION_ERROR_CHECK(directory_cache_ensure_dir(cache, s_cache_ensure_dir), err);
+    ERR_REGION_CMP_CHECK(!file_exists(s_cache_ensure_dir), err);
+
+    // a file written behind its back isn't seen until it is added
+    ERR_REGION_ERROR_CHECK(copy_file(s_size_file, s_cache_file), err);
+    ERR_REGION_CMP_CHECK(directory_cache_file_exists(cache, s_cache_file), err);
+    ERR_REGION_ERROR_CHECK(directory_cache_add_file(cache, s_cache_file), err);
+    ERR_REGION_CMP_CHECK(!directory_cache_file_exists(cache, s_cache_file), err);
+
+    // beside a directory already made, only the new level is created, and
+    // only once
+    creates = cache->creates;
+    ERR_REGION_ERROR_CHECK(directory_cache_ensure_dir(cache, s_cache_other_dir), err);
+    ERR_REGION_ERROR_CHECK(directory_cache_ensure_dir(cache, s_cache_other_dir), err);
+    ERR_REGION_CMP_CHECK(cache->creates != creates + 1, err);
+    ERR_REGION_CMP_CHECK(!file_exists(s_cache_other_dir), err);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE_HANDLER(cache, directory_cache_free);
+  delete_dir(s_cache_dir);
+
+  printf("%s\n", err ? "FAILED!" : "passed.");
+
+  return err;
+}
@@ -2,12 +2,13 @@
 
 #include "file_helpers.h"
 #include "mem_helpers.h"
+#include "test_helpers.h"
 
 static char const *s_test_files[] = {
-  "..\\test_data\\empty_file",
-  "..\\test_data\\short_file",
-  "..\\test_data\\win_file",
-  "..\\test_data\\unix_file",
+  TEST_DATA SEP "empty_file",
+  TEST_DATA SEP "short_file",
+  TEST_DATA SEP "win_file",
+  TEST_DATA SEP "unix_file",
 };
 
 static const short s_test_file_lines[] = { 0, 1, 5, 5 };
@@ -6,6 +6,7 @@
 
 #include "string_helpers.h"
 #include "mem_helpers.h"
+#include "hash_helpers.h"
 
 short compare_string_arrays(char const* const* arr1, int arr1_len, char const* const* arr2, int arr2_len) {
   if (arr1_len != arr2_len) return 0;
@@ -50,3 +51,80 @@ errno_t test_string_join(void) {
   printf("%s\n", result ? "FAILED!" : "passed.");
   return result;
 }
+
+typedef struct {
+  char const* str;
+  char const* pattern;
+  short matches;
+} glob_test_t;
+
+static const glob_test_t s_glob_tests[] = {
+  {"game.cue", "*.cue", 1},
+  {"game.cue.bak", "*.cue", 0},
+  {".cue", "*.cue", 1},
+  {"track01.bin", "track??.bin", 1},
+  {"track1.bin", "track??.bin", 0},
+  {"a.b.c", "*.*", 1},
+  {"abcabd", "*abd", 1},
+  {"", "*", 1},
+  {"", "?", 0},
+  {"name", "name", 1},
+  {"name", "Name", 0},
+};
+
+static const size_t s_glob_tests_len = sizeof(s_glob_tests) / sizeof(*s_glob_tests);
+
+errno_t test_glob_matches(void) {
+  errno_t result = 0;
+
+  printf("Checking glob matching... ");
+
+  for (size_t i = 0; i < s_glob_tests_len; ++i) {
+    if (cstr_glob_matches(s_glob_tests[i].str, s_glob_tests[i].pattern) != s_glob_tests[i].matches) result = -1;
+  }
+
+  printf("%s\n", result ? "FAILED!" : "passed.");
+  return result;
+}
+
+typedef struct {
+  char const* value;
+  unsigned long long hash;
+} hash_test_t;
+
+// published xxh64 values, with a seed of 0
+static const hash_test_t s_hash_tests[] = {
+  {"", 0xEF46DB3751D8E999ull},
+  {"a", 0xD24EC4F1A98C6E5Bull},
+  {"abc", 0x44BC2CF5AD770999ull},
+  {"Nobody inspects the spammish repetition", 0xFBCEA83C8A378BF1ull},
+};
+
+static const size_t s_hash_tests_len = sizeof(s_hash_tests) / sizeof(*s_hash_tests);
+
+errno_t test_hash(void) {
+  errno_t result = 0;
+  unsigned char bytes[1000];
+  hash_state_t state;
+
+  printf("Checking hashing... ");
+
+  for (size_t i = 0; i < s_hash_tests_len; ++i) {
+    if (hash_cstr(0, s_hash_tests[i].value) != s_hash_tests[i].hash) result = -1;
+  }
+
+  // fed in uneven pieces, across several stripes, it should still match
+  for (size_t i = 0; i < sizeof(bytes); ++i) {
+    bytes[i] = (unsigned char)(i * 7);
+  }
+
+  hash_state_init(&state, 0);
+  for (size_t i = 0; i < sizeof(bytes); i += 13) {
+    hash_state_update(&state, bytes + i, sizeof(bytes) - i < 13 ? sizeof(bytes) - i : 13);
+  }
+
+  if (hash_state_digest(&state) != hash_bytes(0, bytes, sizeof(bytes))) result = -1;
+
+  printf("%s\n", result ? "FAILED!" : "passed.");
+  return result;
+}
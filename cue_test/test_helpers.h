@@ -1,4 +1,12 @@
 #pragma once
 
+#include "filesystem.h"
+
+// test paths are spelled with the separator of the platform, so that the
+// same files are made and looked for everywhere.  the tests run from
+// cue_test, beside test_data
+#define SEP PATH_SEPARATOR
+#define TEST_DATA ".." SEP "test_data"
+
 short compare_string_arrays(char const* const* arr1, int arr1_len, char const* const* arr2, int arr2_len);
 void dump_string_array(char const* const* array, int num_lines);
@@ -0,0 +1,409 @@
+#include "all_tests.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <ogg/ogg.h>
+
+#include "err_helpers.h"
+#include "mem_helpers.h"
+#include "filesystem.h"
+#include "oggenc.h"
+#include "sink.h"
+#include "test_helpers.h"
+
+#define RAW_RATE 44100
+#define RAW_FRAME 4  // 16 bit stereo
+#define TWO_PI 6.283185307179586
+
+static char const s_segment_raw[] = TEST_DATA SEP "segment.raw";
+static char const s_segment_serial[] = TEST_DATA SEP "segment_serial.ogg";
+static char const s_segment_parallel[] = TEST_DATA SEP "segment_parallel.ogg";
+static char const s_sink_output[] = TEST_DATA SEP "sink.ogg";
+static char const s_pipeline_raw[] = TEST_DATA SEP "pipeline.raw";
+static char const s_pipeline_wav[] = TEST_DATA SEP "cue_dir" SEP "a" SEP "a1game" SEP "track04.wav";
+static char const s_pipeline_expected[] = TEST_DATA SEP "pipeline_expected.ogg";
+static char const s_pipeline_output[] = TEST_DATA SEP "pipeline.ogg";
+
+// a ring of a single block, which wraps on every read, a few small ones,
+// and one deeper than the longest input is long, which meets the end
+// before it ever fills
+static int const s_pipeline_depths[] = { 1, 2, 3, 64, 1024 };
+#define NUM_PIPELINE_DEPTHS (sizeof(s_pipeline_depths) / sizeof(*s_pipeline_depths))
+
+// the largest page ogg allows, a 282 byte header and 255 segments of 255
+#define MAX_PAGE_HEADER 282
+#define MAX_PAGE_BODY (255 * 255)
+
+// well past what the buffers of the sink hold at once, however large they
+// are made, so they all fill and are written over several times
+#define SINK_TEST_BYTES (8L * 1024 * 1024)
+
+// a chord whose notes drift, with a little noise and a quiet spell every
+// few seconds, so the encoder has transients to switch block sizes on.  the
+// same every run, as the noise comes from a fixed seed
+static errno_t write_raw(char const* path, long samples) {
+  errno_t err = 0;
+  FILE* file = 0;
+  unsigned char* block = 0;
+  unsigned int seed = 1;
+  long const block_samples = 4096;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_ERROR_CHECK(fopen_s(&file, path, "wb"), err);
+    ERR_REGION_NULL_CHECK(block = malloc(block_samples * RAW_FRAME), err);
+
+    for (long start = 0; start < samples; start += block_samples) {
+      long count = samples - start < block_samples ? samples - start : block_samples;
+
+      for (long i = 0; i < count; ++i) {
+        double t = (double)(start + i) / RAW_RATE;
+        double level = fmod(t, 7.0) < 0.5 ? 0.02 : 0.3;
+        double drift = 1.0 + 0.05 * sin(TWO_PI * t / 11.0);
+
+        for (int channel = 0; channel < 2; ++channel) {
+          double value = 0;
+          short pcm = 0;
+
+          seed = seed * 1103515245 + 12345;
+          value += sin(TWO_PI * 220.0 * drift * t + channel);
+          value += 0.5 * sin(TWO_PI * 277.2 * drift * t);
+          value += 0.25 * sin(TWO_PI * 329.6 * t);
+          value += 0.1 * ((double)((seed >> 16) & 0x7fff) / 0x4000 - 1.0);
+
+          pcm = (short)(value * level * 16384);
+          block[i * RAW_FRAME + channel * 2] = (unsigned char)(pcm & 0xff);
+          block[i * RAW_FRAME + channel * 2 + 1] = (unsigned char)((pcm >> 8) & 0xff);
+        }
+      }
+
+      ERR_REGION_CMP_CHECK(fwrite(block, RAW_FRAME, count, file) != (size_t)count, err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+  } ERR_REGION_END()
+
+  if (file && fclose(file) && !err) err = -1;
+  SAFE_FREE(block);
+
+  return err;
+}
+
+static errno_t read_all(char const* path, unsigned char** data, long* length) {
+  errno_t err = 0;
+  FILE* file = 0;
+  unsigned char* buffer = 0;
+  long size = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_ERROR_CHECK(fopen_s(&file, path, "rb"), err);
+    ERR_REGION_CMP_CHECK(fseek(file, 0, SEEK_END), err);
+    ERR_REGION_CMP_CHECK((size = ftell(file)) < 0, err);
+    ERR_REGION_CMP_CHECK(fseek(file, 0, SEEK_SET), err);
+
+    ERR_REGION_NULL_CHECK(buffer = malloc(size ? size : 1), err);
+    ERR_REGION_CMP_CHECK(fread(buffer, 1, size, file) != (size_t)size, err);
+
+    *data = buffer;
+    *length = size;
+    buffer = 0;
+
+  } ERR_REGION_END()
+
+  if (file) fclose(file);
+  SAFE_FREE(buffer);
+
+  return err;
+}
+
+static short files_match(char const* lhs, char const* rhs) {
+  unsigned char* lhs_data = 0;
+  unsigned char* rhs_data = 0;
+  long lhs_length = 0;
+  long rhs_length = 0;
+  short match = 0;
+
+  match = !read_all(lhs, &lhs_data, &lhs_length)
+    && !read_all(rhs, &rhs_data, &rhs_length)
+    && lhs_length == rhs_length
+    && memcmp(lhs_data, rhs_data, lhs_length) == 0;
+
+  SAFE_FREE(lhs_data);
+  SAFE_FREE(rhs_data);
+
+  return match;
+}
+
+typedef struct ogg_summary {
+  long pages;
+  long headers;  // vorbis header packets
+  long audio;  // packets after the headers
+  ogg_int64_t granulepos;  // of the last page
+} ogg_summary_t;
+
+// reads a single vorbis stream back with libogg, failing if its pages
+// don't follow on from each other, or its positions ever go backwards
+static errno_t summarize_ogg(char const* path, ogg_summary_t* summary) {
+  errno_t err = 0;
+  unsigned char* data = 0;
+  long length = 0;
+  ogg_sync_state sync;
+  ogg_stream_state stream;
+  ogg_page page;
+  ogg_packet packet;
+  short streaming = 0;
+  short ended = 0;
+
+  memset(summary, 0, sizeof(*summary));
+  ogg_sync_init(&sync);
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_ERROR_CHECK(read_all(path, &data, &length), err);
+    memcpy(ogg_sync_buffer(&sync, length), data, length);
+    ogg_sync_wrote(&sync, length);
+
+    while (ogg_sync_pageout(&sync, &page) == 1) {
+      ERR_REGION_CMP_CHECK(ended, err);
+
+      if (!streaming) {
+        ERR_REGION_CMP_CHECK(!ogg_page_bos(&page), err);
+        ogg_stream_init(&stream, ogg_page_serialno(&page));
+        streaming = 1;
+      }
+
+      ERR_REGION_CMP_CHECK(ogg_stream_pagein(&stream, &page), err);
+      ++summary->pages;
+
+      // a page on which no packet ends has no position
+      if (ogg_page_granulepos(&page) != -1) {
+        ERR_REGION_CMP_CHECK(ogg_page_granulepos(&page) < summary->granulepos, err);
+        summary->granulepos = ogg_page_granulepos(&page);
+      }
+
+      ended = (short)ogg_page_eos(&page);
+
+      while (ogg_stream_packetout(&stream, &packet) == 1) {
+        short header = packet.bytes >= 7 && (packet.packet[0] & 1)
+          && memcmp(packet.packet + 1, "vorbis", 6) == 0;
+
+        // every header comes before any audio
+        ERR_REGION_CMP_CHECK(header && summary->audio, err);
+        if (header) ++summary->headers;
+        else ++summary->audio;
+      } ERR_REGION_ERROR_BUBBLE(err);
+
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    ERR_REGION_CMP_CHECK(!ended, err);
+
+  } ERR_REGION_END()
+
+  if (streaming) ogg_stream_clear(&stream);
+  ogg_sync_clear(&sync);
+  SAFE_FREE(data);
+
+  return err;
+}
+
+static errno_t encode_file(oggenc_input_format_t format, char const* in_path, char const* out_path,
+  int threads, int pipeline) {
+
+  oggenc_params_t params;
+
+  memset(&params, 0, sizeof(params));
+  params.format = format;
+  params.quality = 3;
+  params.serial = 1234;
+  params.threads = threads;
+  params.pipeline = pipeline;
+  params.in_path = in_path;
+  params.out_path = out_path;
+
+  return encode_with_params(&params);
+}
+
+errno_t test_oggenc_segmented(void) {
+  errno_t err = 0;
+  ogg_summary_t serial;
+  ogg_summary_t parallel;
+  oggenc_counts_t before;
+  oggenc_counts_t after;
+  // two segments' worth, and some, so that the last one is uneven
+  long const samples = RAW_RATE * 60 * 2 + 12345;
+
+  printf("Checking oggenc segmented encode... ");
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_ERROR_CHECK(write_raw(s_segment_raw, samples), err);
+    ERR_REGION_ERROR_CHECK(encode_file(OGGENC_INPUT_RAW, s_segment_raw, s_segment_serial, 1, 0), err);
+
+    // which may well come out byte for byte as the serial encode, so only
+    // the counts tell that it was really split, rather than falling back
+    oggenc_counts_get(&before);
+    ERR_REGION_ERROR_CHECK(encode_file(OGGENC_INPUT_RAW, s_segment_raw, s_segment_parallel, 2, 0), err);
+    oggenc_counts_get(&after);
+
+    ERR_REGION_CMP_CHECK(after.segmented - before.segmented != 1, err);
+    ERR_REGION_CMP_CHECK(after.unspliced != before.unspliced, err);
+
+    ERR_REGION_ERROR_CHECK(summarize_ogg(s_segment_serial, &serial), err);
+    ERR_REGION_ERROR_CHECK(summarize_ogg(s_segment_parallel, &parallel), err);
+
+    // the splice leaves a single stream, with one set of headers, that ends
+    // on the last sample just as the serial one does
+    ERR_REGION_CMP_CHECK(serial.headers != 3, err);
+    ERR_REGION_CMP_CHECK(parallel.headers != 3, err);
+    ERR_REGION_CMP_CHECK(serial.granulepos != samples, err);
+    ERR_REGION_CMP_CHECK(parallel.granulepos != samples, err);
+    ERR_REGION_CMP_CHECK(!parallel.audio, err);
+
+  } ERR_REGION_END()
+
+  delete_file(s_segment_raw);
+  delete_file(s_segment_serial);
+  delete_file(s_segment_parallel);
+
+  printf("%s\n", err ? "FAILED!" : "passed.");
+
+  return err;
+}
+
+// pages of every size up to the largest, filled with a count that runs on
+// from page to page, go through the sink into a file that already has
+// something of its own buffered, which has to come out first
+static errno_t check_sink(int background) {
+  errno_t err = 0;
+  FILE* file = 0;
+  oe_page_sink* sink = 0;
+  unsigned char* expected = 0;
+  unsigned char* written = 0;
+  long expected_length = 0;
+  long written_length = 0;
+  unsigned char header[MAX_PAGE_HEADER];
+  unsigned char* body = 0;
+  unsigned int seed = 7;
+  unsigned char next = 0;
+  ogg_page page;
+  char const prefix[] = "buffered before the sink";
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(expected = malloc(SINK_TEST_BYTES + MAX_PAGE_HEADER + MAX_PAGE_BODY + sizeof(prefix)), err);
+    ERR_REGION_NULL_CHECK(body = malloc(MAX_PAGE_BODY), err);
+
+    ERR_REGION_ERROR_CHECK(fopen_s(&file, s_sink_output, "wb"), err);
+    ERR_REGION_CMP_CHECK(fwrite(prefix, 1, sizeof(prefix), file) != sizeof(prefix), err);
+    memcpy(expected, prefix, sizeof(prefix));
+    expected_length = sizeof(prefix);
+
+    // 1 is rounded up to the smallest buffer that holds any page
+    ERR_REGION_NULL_CHECK(sink = oe_sink_open(file, 1, background), err);
+
+    for (long page_index = 0; expected_length < SINK_TEST_BYTES; ++page_index) {
+      memset(&page, 0, sizeof(page));
+      page.header = header;
+      page.body = body;
+
+      // every so often the largest page of all, to fill a buffer in one go
+      seed = seed * 1103515245 + 12345;
+      if (page_index % 16 == 15) {
+        page.header_len = MAX_PAGE_HEADER;
+        page.body_len = MAX_PAGE_BODY;
+      }
+      else {
+        page.header_len = 27 + (long)((seed >> 8) % (MAX_PAGE_HEADER - 27 + 1));
+        page.body_len = (long)((seed >> 4) % (MAX_PAGE_BODY + 1));
+      }
+
+      for (long i = 0; i < page.header_len; ++i) header[i] = next++;
+      for (long i = 0; i < page.body_len; ++i) body[i] = next++;
+
+      ERR_REGION_CMP_CHECK(oe_sink_write_page(sink, &page) != page.header_len + page.body_len, err);
+
+      memcpy(expected + expected_length, header, page.header_len);
+      expected_length += page.header_len;
+      memcpy(expected + expected_length, body, page.body_len);
+      expected_length += page.body_len;
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    ERR_REGION_CMP_CHECK(oe_sink_close(sink), err);
+    sink = 0;
+    ERR_REGION_CMP_CHECK(fclose(file), err);
+    file = 0;
+
+    ERR_REGION_ERROR_CHECK(read_all(s_sink_output, &written, &written_length), err);
+    ERR_REGION_CMP_CHECK(written_length != expected_length, err);
+    ERR_REGION_CMP_CHECK(memcmp(written, expected, expected_length) != 0, err);
+
+  } ERR_REGION_END()
+
+  if (sink) oe_sink_close(sink);
+  if (file) fclose(file);
+  delete_file(s_sink_output);
+  SAFE_FREE(written);
+  SAFE_FREE(body);
+  SAFE_FREE(expected);
+
+  return err;
+}
+
+errno_t test_oggenc_sink(void) {
+  errno_t err = 0;
+
+  printf("Checking oggenc page sink... ");
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_ERROR_CHECK(check_sink(0), err);
+    ERR_REGION_ERROR_CHECK(check_sink(1), err);
+
+  } ERR_REGION_END()
+
+  printf("%s\n", err ? "FAILED!" : "passed.");
+
+  return err;
+}
+
+// reading ahead, however far, mustn't change a byte of what is encoded
+static errno_t check_pipeline(oggenc_input_format_t format, char const* in_path) {
+  errno_t err = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_ERROR_CHECK(encode_file(format, in_path, s_pipeline_expected, 1, 0), err);
+
+    for (size_t i = 0; i < NUM_PIPELINE_DEPTHS; ++i) {
+      ERR_REGION_ERROR_CHECK(encode_file(format, in_path, s_pipeline_output, 1, s_pipeline_depths[i]), err);
+      ERR_REGION_CMP_CHECK(!files_match(s_pipeline_expected, s_pipeline_output), err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+  } ERR_REGION_END()
+
+  delete_file(s_pipeline_expected);
+  delete_file(s_pipeline_output);
+
+  return err;
+}
+
+errno_t test_oggenc_pipeline(void) {
+  errno_t err = 0;
+
+  printf("Checking oggenc read ahead... ");
+
+  ERR_REGION_BEGIN() {
+    // the last block of this one comes up short of a whole block
+    ERR_REGION_ERROR_CHECK(write_raw(s_pipeline_raw, RAW_RATE * 10 + 777), err);
+    ERR_REGION_ERROR_CHECK(check_pipeline(OGGENC_INPUT_RAW, s_pipeline_raw), err);
+
+    // and the only block of this one
+    ERR_REGION_ERROR_CHECK(write_raw(s_pipeline_raw, 500), err);
+    ERR_REGION_ERROR_CHECK(check_pipeline(OGGENC_INPUT_RAW, s_pipeline_raw), err);
+
+    ERR_REGION_ERROR_CHECK(check_pipeline(OGGENC_INPUT_WAV, s_pipeline_wav), err);
+
+  } ERR_REGION_END()
+
+  delete_file(s_pipeline_raw);
+
+  printf("%s\n", err ? "FAILED!" : "passed.");
+
+  return err;
+}
@@ -2,12 +2,17 @@
 
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "err_helpers.h"
 #include "filesystem.h"
-#include "string_vector.h"
+#include "path.h"
+#include "directory_traversal.h"
 #include "char_vector.h"
 #include "string_helpers.h"
+#include "mem_helpers.h"
+#include "thread_helpers.h"
 
 //
 // print visitor
@@ -16,7 +21,7 @@
 static short pv_visit(struct directory_traversal_handler* self, directory_traversal_handler_state_t const* state) {
   file_handle_i const* directory = state->directory;
   directory_entry_i const* entry = state->entry;
-  printf("%s\\%s%s%s%s\n", directory->get_path(directory),
+  printf("%s%s%s%s%s%s\n", directory->get_path(directory), k_path_separator,
     entry->get_name(entry),
     entry->is_directory(entry) ? " [DIR]" : "",
     state->first_entry ? " [FIRST]" : "",
@@ -81,10 +86,14 @@ static short ptv_visit(parallel_visitor_t *self_t, parallel_visitor_state_t cons
   char const* parallel_path = state->parallel_path;
 
   ERR_REGION_BEGIN() {
-    size_t i = self->line;
+    // entries come in directory order, so any unseen result will do
+    size_t i = 0;
+    while (i < self->result_len
+      && (self->seen[i] || strcmp(self->result[i], parallel_path) != 0)) ++i;
+
     ERR_REGION_CMP_CHECK_CODE(i >= self->result_len, keep_traversing, 0);
 
-    ERR_REGION_CMP_CHECK_CODE(strcmp(self->result[i], parallel_path) != 0, keep_traversing, 0);
+    self->seen[i] = 1;
   } ERR_REGION_END()
 
   if (self->passed) self->passed = keep_traversing;
@@ -112,11 +121,122 @@ errno_t parallel_traverse_visitor_init(parallel_traverse_visitor_t* self,
     self->result = result;
     self->result_len = result_len;
 
-  } ERR_REGION_END()
+    ERR_REGION_NULL_CHECK(self->seen = calloc(result_len, sizeof(*self->seen)), err);
 
     return err;
+
+  } ERR_REGION_END()
+
+  parallel_traverse_visitor_uninit(self);
+
+  return err;
 }
 
 void parallel_traverse_visitor_uninit(parallel_traverse_visitor_t* self) {
+  SAFE_FREE(self->seen);
   parallel_visitor_uninit(&self->pv_t);
 }
+
+//
+// unordered visitor
+//
+
+// names may repeat in different directories, so unseen skips any result
+// already visited.  the name runs up to name_end, as the traversal's views
+// of its path aren't terminated
+static short find_result(unordered_visitor_t const* self, char const* name, char const* name_end,
+  short unseen, size_t* index) {
+
+  size_t name_len = (size_t)(name_end - name);
+
+  for (size_t i = 0; i < self->result_len; ++i) {
+    if (unseen && self->seen[i]) continue;
+
+    if (strlen(self->result[i].name) == name_len && memcmp(self->result[i].name, name, name_len) == 0) {
+      *index = i;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+static short uv_visit(struct directory_traversal_handler* self_i, directory_traversal_handler_state_t const* state) {
+  unordered_visitor_t* self = (unordered_visitor_t*)self_i->self;
+  file_handle_i const* directory = state->directory;
+  directory_entry_i const* entry = state->entry;
+  char const* entry_name = entry->get_name(entry);
+  size_t depth = traversal_depth(state);
+  char const* name = 0;
+  char const* name_end = 0;
+  size_t i = 0;
+  size_t parent = 0;
+  char const* path = 0;
+  short passed = 1;
+
+  // the path the traversal kept is the one joined from the directory
+  path = join_dir_file_path(directory->get_path(directory), entry->get_name(entry));
+  passed = path && strcmp(path, state->path) == 0;
+  SAFE_FREE(path);
+
+  // and the last of the names read from it is the entry's
+  passed = passed
+    && traversal_name(state, depth - 1, &name, &name_end)
+    && strlen(entry_name) == (size_t)(name_end - name)
+    && memcmp(entry_name, name, name_end - name) == 0;
+
+  th_mutex_lock(self->lock);
+
+  passed = passed
+    && find_result(self, entry_name, entry_name + strlen(entry_name), 1, &i)
+    && self->result[i].is_dir == entry->is_directory(entry);
+
+  // the names end with the entry, after the directory it is in.  a
+  // filtered traversal may not expect the directory itself
+  if (passed && depth > 1
+    && traversal_name(state, depth - 2, &name, &name_end)
+    && find_result(self, name, name_end, 0, &parent)) {
+    passed = self->seen[parent] != self->post_visit;
+  }
+
+  if (passed) self->seen[i] = 1;
+  if (!passed) self->passed = 0;
+  ++self->line;
+
+  th_mutex_unlock(self->lock);
+
+  return passed;
+}
+
+errno_t unordered_visitor_init(unordered_visitor_t* self,
+  dir_entry_fields_t const* result,
+  size_t result_len,
+  short post_visit) {
+
+  errno_t err = 0;
+
+  ERR_REGION_BEGIN() {
+    memset(self, 0, sizeof(*self));
+    self->handler_i.self = self;
+    self->handler_i.visit = uv_visit;
+    self->passed = 1;
+    self->post_visit = post_visit;
+    self->result = result;
+    self->result_len = result_len;
+
+    ERR_REGION_NULL_CHECK(self->lock = th_mutex_alloc(), err);
+    ERR_REGION_NULL_CHECK(self->seen = calloc(result_len, sizeof(*self->seen)), err);
+
+    return err;
+
+  } ERR_REGION_END()
+
+  unordered_visitor_uninit(self);
+
+  return err;
+}
+
+void unordered_visitor_uninit(unordered_visitor_t* self) {
+  SAFE_FREE(self->seen);
+  SAFE_FREE_HANDLER(self->lock, th_mutex_free);
+}
@@ -6,6 +6,7 @@
 #include "parallel_visitor.h"
 
 struct char_vector;
+struct th_mutex;
 
 typedef struct dir_entry_fields {
   char const* name;
@@ -47,6 +48,7 @@ typedef struct parallel_traverse_visitor {
   short passed;
   size_t line;
   char const** result;
+  short* seen;  // owned, for each result
   size_t result_len;
 } parallel_traverse_visitor_t;
 
@@ -56,3 +58,29 @@ errno_t parallel_traverse_visitor_init(parallel_traverse_visitor_t* self,
   size_t result_len);
 
 void parallel_traverse_visitor_uninit(parallel_traverse_visitor_t* self);
+
+//
+// unordered visitor
+//
+
+// for traversals of several threads, or of file systems that list entries
+// in no set order.  checks that each expected entry is visited once, and
+// that a directory is visited before anything in it, or after when
+// post_visit
+typedef struct unordered_visitor {
+  directory_traversal_handler_i handler_i;
+  struct th_mutex* lock;  // owned
+  short passed;
+  short post_visit;
+  size_t line;
+  dir_entry_fields_t const* result;
+  short* seen;  // owned, for each result
+  size_t result_len;
+} unordered_visitor_t;
+
+errno_t unordered_visitor_init(unordered_visitor_t* self,
+  dir_entry_fields_t const* result,
+  size_t result_len,
+  short post_visit);
+
+void unordered_visitor_uninit(unordered_visitor_t* self);
@@ -24,6 +24,8 @@
 #include "encode.h"
 #include "i18n.h"
 #include "skeleton.h"
+#include "pipeline.h"
+#include "sink.h"
 
 #ifdef HAVE_KATE
 #include "lyrics.h"
@@ -35,6 +37,15 @@
 
 int oe_write_page(ogg_page *page, FILE *fp);
 
+/* Hands the page to the batching sink when there is one */
+static int write_page(oe_page_sink *sink, ogg_page *page, FILE *fp)
+{
+    if(sink)
+        return oe_sink_write_page(sink, page);
+
+    return oe_write_page(page, fp);
+}
+
 #define SETD(toset) \
     do {\
         if(sscanf(opts[i].val, "%lf", &dval) != 1)\
@@ -233,6 +244,8 @@ int oe_encode(oe_enc_opt *opt)
     int ret=0;
     TIMER *timer;
     int result;
+    oe_pipeline *pipeline = NULL;
+    oe_page_sink *sink = NULL;
 
     if(opt->channels > 255) {
         fprintf(stderr, _("255 channels should be enough for anyone. (Sorry, but Vorbis doesn't support more)\n"));
@@ -512,6 +525,14 @@ int oe_encode(oe_enc_opt *opt)
         }
     }
 
+    /* Every header has been written, so from here on pages can be batched
+       up behind the encoder, and input read ahead of it. If either can't be
+       set up, that part just happens inline. */
+    if(opt->pipeline_depth > 0)
+        pipeline = oe_pipeline_start(opt, opt->pipeline_depth, READSIZE);
+    if(opt->write_buffer > 0)
+        sink = oe_sink_open(opt->out, opt->write_buffer, opt->write_behind);
+
     eos = 0;
 
     /* Main encode loop - continue until end of file */
@@ -600,7 +621,7 @@ int oe_encode(oe_enc_opt *opt)
                                     ogg_page ogk;
                                     int result=ogg_stream_flush(&ko,&ogk);
                                     if (!result) break;
-                                    ret = oe_write_page(&ogk, opt->out);
+                                    ret = write_page(sink, &ogk, opt->out);
                                     if(ret != ogk.header_len + ogk.body_len)
                                     {
                                         opt->error(_("Failed writing data to output stream\n"));
@@ -615,7 +636,7 @@ int oe_encode(oe_enc_opt *opt)
                     }
 #endif
 
-                    ret = oe_write_page(&og, opt->out);
+                    ret = write_page(sink, &og, opt->out);
                     if(ret != og.header_len + og.body_len)
                     {
                         opt->error(_("Failed writing data to output stream\n"));
@@ -651,7 +672,7 @@ int oe_encode(oe_enc_opt *opt)
                 int result = ogg_stream_pageout(&ko,&og);
                 if(!result) break;
 
-                ret = oe_write_page(&og, opt->out);
+                ret = write_page(sink, &og, opt->out);
                 if(ret != og.header_len + og.body_len)
                 {
                     opt->error(_("Failed writing data to output stream\n"));
@@ -674,6 +695,16 @@ int oe_encode(oe_enc_opt *opt)
     /* Cleanup time */
 cleanup:
 
+    if(pipeline)
+        oe_pipeline_stop(pipeline);
+
+    /* write out the batched pages before the stream goes away */
+    if(sink && oe_sink_close(sink) && !ret)
+    {
+        opt->error(_("Failed writing data to output stream\n"));
+        ret = 1;
+    }
+
 #ifdef HAVE_KATE
     if (opt->lyrics) {
        ogg_stream_clear(&ko);
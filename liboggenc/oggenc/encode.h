@@ -141,6 +141,16 @@ typedef struct
 
     char *lyrics;
     char *lyrics_language;
+
+    /* Blocks of input read ahead of the encoder on a thread of its own.
+       0 reads inline. */
+    int pipeline_depth;
+
+    /* Pages are gathered into buffers of this many bytes and written in
+       batches, from a thread of their own if write_behind is set. 0 writes
+       each page through out as it is made. */
+    long write_buffer;
+    int write_behind;
 } oe_enc_opt;
 
 
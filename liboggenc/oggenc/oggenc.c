@@ -32,6 +32,9 @@
 #include "audio.h"
 #include "utf8.h"
 #include "i18n.h"
+#include "segment.h"
+#include "oggenc.h"
+#include "thread_helpers.h"
 
 #define CHUNK 4096 /* We do reads, etc. in multiples of this */
 
@@ -184,6 +187,9 @@ errno_t encode_with_arguments(int argc, char const** argv_const)
         enc_opts.copy_comments = opt.copy_comments;
         enc_opts.with_skeleton = opt.with_skeleton;
         enc_opts.ignorelength = opt.ignorelength;
+        enc_opts.pipeline_depth = 0;
+        enc_opts.write_buffer = 0;
+        enc_opts.write_behind = 0;
 
         /* OK, let's build the vorbis_comments structure */
         build_comments(&vc, &opt, i, &artist, &album, &title, &track,
@@ -462,6 +468,160 @@ clear_all:
 
 }
 
+static oggenc_counts_t oe_counts;
+
+void oggenc_counts_get(oggenc_counts_t* counts)
+{
+    counts->segmented = th_atomic_add(&oe_counts.segmented, 0);
+    counts->unspliced = th_atomic_add(&oe_counts.unspliced, 0);
+}
+
+/* Number of samples per channel left in a raw input, without moving it */
+static long raw_total_samples(FILE *in, oe_enc_opt *opt)
+{
+    long framesize = opt->channels * opt->samplesize / 8;
+    long pos = ftell(in);
+    long end;
+
+    if(pos < 0 || fseek(in, 0, SEEK_END))
+        return 0;
+
+    end = ftell(in);
+    fseek(in, pos, SEEK_SET);
+
+    return end > pos ? (end - pos) / framesize : 0;
+}
+
+/* Encode one input described by params.  Unlike encode_with_arguments this
+   does no option parsing and never touches optind, the locale or the random
+   seed, so it may be called from several threads at once. */
+errno_t encode_with_params(oggenc_params_t const* params)
+{
+    oe_enc_opt      enc_opts;
+    vorbis_comment  vc;
+    FILE *in = params->in, *out = params->out;
+    int closein = 0, closeout = 0;
+    input_format raw_format = {NULL, 0, raw_open, wav_close, "raw",
+        N_("RAW file reader")};
+    input_format *format = NULL;
+    char *in_fn = (char *)params->in_path;
+    char *out_fn = (char *)params->out_path;
+    int segmented = -1;
+    int errors = 0;
+
+    memset(&enc_opts, 0, sizeof(enc_opts));
+    vorbis_comment_init(&vc);
+
+    if(in == NULL)
+    {
+        in = oggenc_fopen(in_fn, "rb", 1);
+        if(in == NULL)
+        {
+            fprintf(stderr, _("ERROR: Cannot open input file \"%s\": %s\n"), in_fn, strerror(errno));
+            vorbis_comment_clear(&vc);
+            return 1;
+        }
+        closein = 1;
+    }
+
+    if(params->format == OGGENC_INPUT_RAW)
+    {
+        enc_opts.rate = 44100;
+        enc_opts.channels = 2;
+        enc_opts.samplesize = 16;
+        enc_opts.endianness = 0;
+
+        format = &raw_format;
+        format->open_func(in, &enc_opts, NULL, 0);
+    }
+    else
+        format = open_audio_file(in, &enc_opts);
+
+    if(format == NULL)
+    {
+        fprintf(stderr, _("ERROR: Input file \"%s\" is not a supported format\n"), in_fn?in_fn:"(stream)");
+        errors++;
+        goto clear_in;
+    }
+
+    if(out == NULL)
+    {
+        if(create_directories(out_fn, 1))
+        {
+            fprintf(stderr, _("ERROR: Could not create required subdirectories for output filename \"%s\"\n"), out_fn);
+            errors++;
+            goto clear_format;
+        }
+
+        out = oggenc_fopen(out_fn, "wb", 1);
+        if(out == NULL)
+        {
+            fprintf(stderr, _("ERROR: Cannot open output file \"%s\": %s\n"), out_fn, strerror(errno));
+            errors++;
+            goto clear_format;
+        }
+        closeout = 1;
+    }
+
+    enc_opts.serialno = params->serial;
+    enc_opts.skeleton_serialno = params->serial + 1;
+    enc_opts.kate_serialno = params->serial + 2;
+    enc_opts.start_encode = start_encode_null;
+    enc_opts.progress_update = update_statistics_null;
+    enc_opts.end_encode = final_statistics_null;
+    enc_opts.error = encode_error;
+    enc_opts.comments = &vc;
+    enc_opts.out = out;
+    enc_opts.filename = out_fn;
+    enc_opts.infilename = in_fn;
+    enc_opts.pipeline_depth = params->pipeline;
+    enc_opts.write_buffer = params->write_buffer;
+    enc_opts.write_behind = params->write_behind;
+
+    /* quality mode with no bitrate management, as -q on the command line */
+    enc_opts.managed = 0;
+    enc_opts.bitrate = -1;
+    enc_opts.min_bitrate = -1;
+    enc_opts.max_bitrate = -1;
+    enc_opts.quality = params->quality * 0.1f;
+    if(enc_opts.quality > 1.0f)
+        enc_opts.quality = 1.0f;
+    enc_opts.quality_set = 1;
+
+    /* a long raw file can be split across threads, if it can be reopened */
+    if(params->format == OGGENC_INPUT_RAW && params->threads > 1 && in_fn)
+    {
+        long total_samples = raw_total_samples(in, &enc_opts);
+        long segments = total_samples / (enc_opts.rate * SEGMENT_MIN_SECONDS);
+
+        if(segments > params->threads)
+            segments = params->threads;
+
+        if(segments > 1)
+        {
+            segmented = oe_encode_segmented(&enc_opts, in_fn, total_samples, (int)segments);
+            th_atomic_add(segmented < 0 ? &oe_counts.unspliced : &oe_counts.segmented, 1);
+        }
+    }
+
+    /* no splice point, so encode it in one piece after all */
+    if(segmented < 0 && oe_encode(&enc_opts))
+        errors++;
+    else if(segmented > 0)
+        errors++;
+
+    if(closeout)
+        fclose(out);
+clear_format:
+    format->close_func(enc_opts.readdata);
+clear_in:
+    vorbis_comment_clear(&vc);
+    if(closein)
+        fclose(in);
+
+    return errors?1:0;
+}
+
 #define PACKAGE "vorbis-tools"
 #define VERSION "1.4.0"
 
@@ -1,5 +1,38 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdio.h>
+
+typedef enum oggenc_input_format {
+  OGGENC_INPUT_WAV,
+  OGGENC_INPUT_RAW,  // headerless 16 bit, 44.1kHz, stereo, little endian
+} oggenc_input_format_t;
+
+typedef struct oggenc_params {
+  oggenc_input_format_t format;
+  float quality;  // -1 (poorest) to 10 (best)
+  unsigned int serial;  // ogg stream serial number
+  int threads;  // a long raw input may be split across this many threads
+  int pipeline;  // blocks of input read ahead on a thread of its own, 0 for none
+  long write_buffer;  // bytes of pages gathered per write, 0 writes each page as it is made
+  int write_behind;  // write the gathered pages from a thread of their own
+  char const* in_path;  // weak ref, utf8, opened when in is NULL
+  char const* out_path;  // weak ref, utf8, created when out is NULL
+  FILE* in;  // weak ref, read from the current position
+  FILE* out;  // weak ref, written from the current position
+} oggenc_params_t;
+
+// how the long inputs encoded so far were handled, counted across every
+// thread, so that callers can tell whether they are really being split
+typedef struct oggenc_counts {
+  unsigned long long segmented;  // split across threads, then spliced back together
+  unsigned long long unspliced;  // split, but encoded again on one thread for want of a splice point
+} oggenc_counts_t;
 
 errno_t encode_with_arguments(int argc, char const ** argv);
+
+// encodes a single input quietly, touching no process wide state, so several
+// encodes may run at once on different threads
+errno_t encode_with_params(oggenc_params_t const* params);
+// the encodes made so far by this process
+void oggenc_counts_get(oggenc_counts_t* counts);
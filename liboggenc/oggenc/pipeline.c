@@ -0,0 +1,219 @@
+/* OggEnc
+ **
+ ** This program is distributed under the GNU General Public License, version 2.
+ ** A copy of this license is included with this source.
+ **
+ ** Reads input ahead of the encode loop.
+ **/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "platform.h"
+#include "encode.h"
+#include "pipeline.h"
+#include "thread_helpers.h"
+
+typedef struct
+{
+    float **data; /* one array of block_samples per channel */
+    long samples; /* 0 marks the end of the input */
+} pcm_block;
+
+struct oe_pipeline
+{
+    oe_enc_opt *opt;
+    audio_read_func read_samples; /* the reader the encoder would have used */
+    void *readdata;
+    int channels;
+    int block_samples;
+    int depth;
+
+    th_mutex_t *lock;
+    th_cond_t *changed; /* broadcast whenever the ring moves */
+    int stopping;
+
+    /* filled by the reader, drained by the encoder */
+    pcm_block *blocks;
+    int pcm_head;
+    int pcm_count;
+    long pcm_pos; /* samples of the head block already handed out */
+
+    th_thread_t *reader;
+};
+
+static void read_main(void *arg)
+{
+    oe_pipeline *p = (oe_pipeline *)arg;
+
+    th_mutex_lock(p->lock);
+
+    while(!p->stopping)
+    {
+        pcm_block *block;
+
+        while(p->pcm_count == p->depth && !p->stopping)
+            th_cond_wait(p->changed, p->lock);
+
+        if(p->stopping)
+            break;
+
+        /* the encoder only touches the head block, which this never is */
+        block = p->blocks + (p->pcm_head + p->pcm_count) % p->depth;
+
+        th_mutex_unlock(p->lock);
+        block->samples = p->read_samples(p->readdata, block->data, p->block_samples);
+        th_mutex_lock(p->lock);
+
+        p->pcm_count++;
+        th_cond_broadcast(p->changed);
+
+        if(block->samples == 0)
+            break;
+    }
+
+    th_mutex_unlock(p->lock);
+}
+
+static long pipeline_read(void *src, float **buffer, int samples)
+{
+    oe_pipeline *p = (oe_pipeline *)src;
+    pcm_block *block;
+    long count;
+    int i;
+
+    th_mutex_lock(p->lock);
+    while(!p->pcm_count)
+        th_cond_wait(p->changed, p->lock);
+    block = p->blocks + p->pcm_head;
+    th_mutex_unlock(p->lock);
+
+    /* the end block stays at the head, so later calls see the end too */
+    if(block->samples == 0)
+        return 0;
+
+    count = block->samples - p->pcm_pos;
+    if(count > samples)
+        count = samples;
+
+    for(i = 0; i < p->channels; i++)
+        memcpy(buffer[i], block->data[i] + p->pcm_pos, count * sizeof(float));
+
+    p->pcm_pos += count;
+    if(p->pcm_pos == block->samples)
+    {
+        th_mutex_lock(p->lock);
+        p->pcm_pos = 0;
+        p->pcm_head = (p->pcm_head + 1) % p->depth;
+        p->pcm_count--;
+        th_cond_broadcast(p->changed);
+        th_mutex_unlock(p->lock);
+    }
+
+    return count;
+}
+
+static void free_pipeline(oe_pipeline *p)
+{
+    int i;
+
+    if(p->blocks)
+    {
+        for(i = 0; i < p->depth; i++)
+        {
+            if(p->blocks[i].data)
+                free(p->blocks[i].data[0]);
+            free(p->blocks[i].data);
+        }
+    }
+
+    free(p->blocks);
+
+    if(p->changed)
+        th_cond_free(p->changed);
+    if(p->lock)
+        th_mutex_free(p->lock);
+
+    free(p);
+}
+
+static void join_reader(oe_pipeline *p)
+{
+    th_mutex_lock(p->lock);
+    p->stopping = 1;
+    th_cond_broadcast(p->changed);
+    th_mutex_unlock(p->lock);
+
+    th_thread_join(p->reader);
+    p->reader = NULL;
+}
+
+oe_pipeline *oe_pipeline_start(oe_enc_opt *opt, int depth, int block_samples)
+{
+    oe_pipeline *p;
+    int i, j;
+
+    if(depth < 1 || block_samples < 1)
+        return NULL;
+
+    p = calloc(1, sizeof(*p));
+    if(!p)
+        return NULL;
+
+    p->opt = opt;
+    p->read_samples = opt->read_samples;
+    p->readdata = opt->readdata;
+    p->channels = opt->channels;
+    p->block_samples = block_samples;
+    p->depth = depth;
+
+    p->lock = th_mutex_alloc();
+    p->changed = th_cond_alloc();
+    p->blocks = calloc(depth, sizeof(*p->blocks));
+    if(!p->lock || !p->changed || !p->blocks)
+        goto fail;
+
+    /* memory stays bounded: the ring never grows past depth blocks */
+    for(i = 0; i < depth; i++)
+    {
+        float **data = malloc(p->channels * sizeof(float *));
+        if(!data)
+            goto fail;
+
+        p->blocks[i].data = data;
+        data[0] = malloc(p->channels * block_samples * sizeof(float));
+        if(!data[0])
+            goto fail;
+
+        for(j = 1; j < p->channels; j++)
+            data[j] = data[0] + j * block_samples;
+    }
+
+    p->reader = th_thread_start(read_main, p);
+    if(!p->reader)
+        goto fail;
+
+    opt->read_samples = pipeline_read;
+    opt->readdata = p;
+
+    return p;
+
+fail:
+    free_pipeline(p);
+    return NULL;
+}
+
+void oe_pipeline_stop(oe_pipeline *p)
+{
+    join_reader(p);
+
+    p->opt->read_samples = p->read_samples;
+    p->opt->readdata = p->readdata;
+
+    free_pipeline(p);
+}
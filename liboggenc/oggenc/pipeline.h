@@ -0,0 +1,18 @@
+#ifndef __PIPELINE_H
+#define __PIPELINE_H
+
+#include "encode.h"
+
+typedef struct oe_pipeline oe_pipeline;
+
+/* Starts a reader thread, which keeps up to depth blocks of samples read
+   ahead of the encoder.  opt->read_samples and opt->readdata are redirected
+   to the reader until oe_pipeline_stop.
+
+   Returns NULL if the thread could not be started, leaving opt untouched. */
+oe_pipeline *oe_pipeline_start(oe_enc_opt *opt, int depth, int block_samples);
+
+/* Stops the reader and restores opt */
+void oe_pipeline_stop(oe_pipeline *p);
+
+#endif /* __PIPELINE_H */
@@ -0,0 +1,439 @@
+/* OggEnc
+ **
+ ** This program is distributed under the GNU General Public License, version 2.
+ ** A copy of this license is included with this source.
+ **
+ ** Segment parallel encoding of a single long raw input.
+ **/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "platform.h"
+#include <vorbis/vorbisenc.h>
+#include "encode.h"
+#include "audio.h"
+#include "segment.h"
+#include "sink.h"
+#include "i18n.h"
+#include "thread_helpers.h"
+
+#define READSIZE 1024
+
+/* Boundaries fall on a multiple of the largest Vorbis block, so that
+   neighbouring encoders start out on the same block grid */
+#define SEGMENT_ALIGN 8192
+
+/* Each segment starts this many samples ahead of the span it contributes and
+   runs on this far past it, so that by the splice point its encoder has
+   settled on the same block layout as its neighbour (about 10s at 44.1kHz) */
+#define SEGMENT_LEAD (54 * SEGMENT_ALIGN)
+
+int oe_write_page(ogg_page *page, FILE *fp);
+
+typedef struct
+{
+    unsigned char *data;
+    long bytes;
+    ogg_int64_t granulepos; /* absolute, in samples from the start of the input */
+    long blocksize;
+} seg_packet;
+
+typedef struct
+{
+    oe_enc_opt *opt; /* shared, read only */
+    char *in_fn;
+    long start; /* first sample encoded */
+    long end;   /* one past the last sample encoded */
+    int with_headers;
+
+    seg_packet headers[3];
+    seg_packet *packets;
+    long count;
+    long capacity;
+    long long_blocksize;
+
+    long first; /* packets first..last end up in the stream */
+    long last;
+    int ret;
+} segment;
+
+static int setup_vorbis(vorbis_info *vi, oe_enc_opt *opt)
+{
+    vorbis_info_init(vi);
+
+    if(vorbis_encode_setup_vbr(vi, opt->channels, opt->rate, opt->quality))
+    {
+        vorbis_info_clear(vi);
+        return 1;
+    }
+
+#ifdef OV_ECTL_RATEMANAGE2_SET
+    /* Turn off management entirely, as oe_encode does */
+    vorbis_encode_ctl(vi, OV_ECTL_RATEMANAGE2_SET, NULL);
+#endif
+
+    vorbis_encode_setup_init(vi);
+
+    return 0;
+}
+
+static int save_packet(seg_packet *p, ogg_packet *op)
+{
+    p->data = malloc(op->bytes);
+    if(!p->data)
+        return 1;
+
+    memcpy(p->data, op->packet, op->bytes);
+    p->bytes = op->bytes;
+    p->granulepos = op->granulepos;
+    p->blocksize = 0;
+
+    return 0;
+}
+
+static int add_packet(segment *seg, vorbis_info *vi, ogg_packet *op)
+{
+    seg_packet *p;
+
+    if(seg->count == seg->capacity)
+    {
+        long capacity = seg->capacity ? seg->capacity * 2 : 1024;
+        seg_packet *packets = realloc(seg->packets, capacity * sizeof(*packets));
+        if(!packets)
+            return 1;
+
+        seg->packets = packets;
+        seg->capacity = capacity;
+    }
+
+    p = seg->packets + seg->count;
+    if(save_packet(p, op))
+        return 1;
+
+    p->granulepos += seg->start;
+    p->blocksize = vorbis_packet_blocksize(vi, op);
+    seg->count++;
+
+    return 0;
+}
+
+static void encode_segment(void *arg)
+{
+    segment *seg = (segment *)arg;
+    oe_enc_opt opt = *seg->opt;
+    vorbis_info vi;
+    vorbis_dsp_state vd;
+    vorbis_block vb;
+    ogg_packet op;
+    FILE *in;
+    long framesize = opt.channels * opt.samplesize / 8;
+    int done = 0;
+
+    seg->ret = 1;
+
+    in = oggenc_fopen(seg->in_fn, "rb", 1);
+    if(in == NULL)
+        return;
+
+    if(fseek(in, seg->start * framesize, SEEK_SET) ||
+            setup_vorbis(&vi, &opt))
+    {
+        fclose(in);
+        return;
+    }
+
+    raw_open(in, &opt, NULL, 0);
+    ((wavfile *)opt.readdata)->totalsamples = seg->end - seg->start;
+
+    seg->long_blocksize = vorbis_info_blocksize(&vi, 1);
+    vorbis_analysis_init(&vd, &vi);
+    vorbis_block_init(&vd, &vb);
+
+    if(seg->with_headers)
+    {
+        ogg_packet header_main;
+        ogg_packet header_comments;
+        ogg_packet header_codebooks;
+
+        vorbis_analysis_headerout(&vd, opt.comments,
+                &header_main, &header_comments, &header_codebooks);
+
+        if(save_packet(&seg->headers[0], &header_main) ||
+                save_packet(&seg->headers[1], &header_comments) ||
+                save_packet(&seg->headers[2], &header_codebooks))
+            goto cleanup;
+    }
+
+    /* The same loop as oe_encode, but the packets are kept rather than paged */
+    while(!done)
+    {
+        float **buffer = vorbis_analysis_buffer(&vd, READSIZE);
+        long samples_read = opt.read_samples(opt.readdata, buffer, READSIZE);
+
+        /* Writing 0 samples signals the end */
+        vorbis_analysis_wrote(&vd, samples_read);
+        if(samples_read == 0)
+            done = 1;
+
+        while(vorbis_analysis_blockout(&vd, &vb) == 1)
+        {
+            vorbis_analysis(&vb, NULL);
+            vorbis_bitrate_addblock(&vb);
+
+            while(vorbis_bitrate_flushpacket(&vd, &op))
+            {
+                if(add_packet(seg, &vi, &op))
+                    goto cleanup;
+            }
+        }
+    }
+
+    seg->ret = 0;
+
+cleanup:
+    vorbis_block_clear(&vb);
+    vorbis_dsp_clear(&vd);
+    vorbis_info_clear(&vi);
+    wav_close(opt.readdata);
+    fclose(in);
+}
+
+/* Find a packet in a and one in b which end at the same sample with the same
+   block size, and are each followed by a packet of the same size.  The windows
+   on either side of that point then overlap exactly as a single encoder would
+   have made them, so the stream can switch from a to b there. */
+static int find_splice(segment *a, segment *b, long boundary, long *ia, long *ib)
+{
+    long i = 0, j = 0;
+
+    while(i + 1 < a->count && j + 1 < b->count)
+    {
+        seg_packet *pa = a->packets + i;
+        seg_packet *pb = b->packets + j;
+
+        /* past here a is winding down, and its layout can't be trusted */
+        if(pa[1].granulepos + a->long_blocksize > a->end)
+            break;
+
+        if(pa->granulepos < pb->granulepos)
+            i++;
+        else if(pb->granulepos < pa->granulepos)
+            j++;
+        else
+        {
+            if(pa->granulepos >= boundary &&
+                    pa[0].blocksize == pb[0].blocksize &&
+                    pa[1].blocksize == pb[1].blocksize &&
+                    pa[1].granulepos == pb[1].granulepos)
+            {
+                *ia = i;
+                *ib = j;
+                return 0;
+            }
+
+            i++;
+            j++;
+        }
+    }
+
+    return -1;
+}
+
+static int write_pages(ogg_stream_state *os, oe_page_sink *sink, FILE *out,
+        int flush, long *bytes_written)
+{
+    ogg_page og;
+    int ret;
+
+    while(flush ? ogg_stream_flush(os, &og) : ogg_stream_pageout(os, &og))
+    {
+        ret = sink ? oe_sink_write_page(sink, &og) : oe_write_page(&og, out);
+        if(ret != og.header_len + og.body_len)
+            return 1;
+
+        *bytes_written += ret;
+    }
+
+    return 0;
+}
+
+int oe_encode_segmented(oe_enc_opt *opt, char *in_fn, long total_samples,
+        int segments)
+{
+    segment *segs;
+    th_thread_t **threads;
+    ogg_stream_state os;
+    ogg_packet op;
+    oe_page_sink *sink = NULL;
+    long span, bytes_written = 0;
+    ogg_int64_t packetno = 0;
+    TIMER *timer;
+    int i, ret = 1;
+
+    /* Only plain quality mode is reproduced by the segment encoders */
+    if(opt->managed || opt->advopt_count || opt->with_skeleton || opt->lyrics)
+        return -1;
+
+    if(segments < 2)
+        return -1;
+
+    span = total_samples / segments;
+    if(span < SEGMENT_LEAD * 2)
+        return -1;
+
+    segs = calloc(segments, sizeof(*segs));
+    threads = calloc(segments, sizeof(*threads));
+    if(!segs || !threads)
+    {
+        free(segs);
+        free(threads);
+        return 1;
+    }
+
+    for(i = 0; i < segments; i++)
+    {
+        long boundary = (i * span) / SEGMENT_ALIGN * SEGMENT_ALIGN;
+        long next = ((i + 1) * span) / SEGMENT_ALIGN * SEGMENT_ALIGN;
+
+        segs[i].opt = opt;
+        segs[i].in_fn = in_fn;
+        segs[i].start = i ? boundary - SEGMENT_LEAD : 0;
+        segs[i].end = i < segments - 1 ? next + SEGMENT_LEAD : total_samples;
+        segs[i].with_headers = (i == 0);
+    }
+
+    /* the first segment runs on this thread while the others get their own */
+    for(i = 1; i < segments; i++)
+        threads[i] = th_thread_start(encode_segment, segs + i);
+
+    encode_segment(segs);
+
+    for(i = 1; i < segments; i++)
+    {
+        if(threads[i])
+            th_thread_join(threads[i]);
+        else
+            encode_segment(segs + i);
+    }
+
+    for(i = 0; i < segments; i++)
+    {
+        if(segs[i].ret || !segs[i].count)
+            goto cleanup;
+    }
+
+    /* work out every splice before writing anything, so that the caller can
+       still fall back to a serial encode */
+    segs[0].first = 0;
+    for(i = 0; i + 1 < segments; i++)
+    {
+        long boundary = segs[i + 1].start + SEGMENT_LEAD;
+        long next_first;
+
+        if(find_splice(segs + i, segs + i + 1, boundary, &segs[i].last, &next_first))
+        {
+            fprintf(stderr, _("WARNING: No splice point between segments %d and %d of \"%s\", encoding it on one thread\n"),
+                    i + 1, i + 2, in_fn);
+            ret = -1;
+            goto cleanup;
+        }
+
+        segs[i + 1].first = next_first + 1;
+    }
+    segs[segments - 1].last = segs[segments - 1].count - 1;
+
+    timer = timer_start();
+    opt->start_encode(opt->infilename, opt->filename, opt->bitrate, opt->quality,
+            opt->quality_set, opt->managed, opt->min_bitrate, opt->max_bitrate);
+
+    ogg_stream_init(&os, opt->serialno);
+
+    /* a single set of headers, taken from the first segment */
+    for(i = 0; i < 3; i++)
+    {
+        op.packet = segs[0].headers[i].data;
+        op.bytes = segs[0].headers[i].bytes;
+        op.b_o_s = (i == 0);
+        op.e_o_s = 0;
+        op.granulepos = 0;
+        op.packetno = packetno++;
+        ogg_stream_packetin(&os, &op);
+
+        /* the identification header gets a page of its own */
+        if((i == 0 || i == 2) && write_pages(&os, NULL, opt->out, 1, &bytes_written))
+        {
+            opt->error(_("Failed writing header to output stream\n"));
+            goto cleanup_stream;
+        }
+    }
+
+    /* the headers are out, so the rest can be batched as oe_encode does */
+    if(opt->write_buffer > 0)
+        sink = oe_sink_open(opt->out, opt->write_buffer, opt->write_behind);
+
+    for(i = 0; i < segments; i++)
+    {
+        long k;
+
+        for(k = segs[i].first; k <= segs[i].last; k++)
+        {
+            seg_packet *p = segs[i].packets + k;
+
+            op.packet = p->data;
+            op.bytes = p->bytes;
+            op.b_o_s = 0;
+            op.e_o_s = (i == segments - 1 && k == segs[i].last);
+            op.granulepos = p->granulepos;
+            op.packetno = packetno++;
+            ogg_stream_packetin(&os, &op);
+
+            if(write_pages(&os, sink, opt->out, 0, &bytes_written))
+            {
+                opt->error(_("Failed writing data to output stream\n"));
+                goto cleanup_stream;
+            }
+        }
+    }
+
+    if(write_pages(&os, sink, opt->out, 1, &bytes_written))
+    {
+        opt->error(_("Failed writing data to output stream\n"));
+        goto cleanup_stream;
+    }
+
+    ret = 0;
+
+cleanup_stream:
+    if(sink && oe_sink_close(sink) && !ret)
+    {
+        opt->error(_("Failed writing data to output stream\n"));
+        ret = 1;
+    }
+
+    ogg_stream_clear(&os);
+    opt->end_encode(opt->filename, timer_time(timer), opt->rate, total_samples,
+            bytes_written);
+    timer_clear(timer);
+
+cleanup:
+    for(i = 0; i < segments; i++)
+    {
+        long k;
+
+        for(k = 0; k < 3; k++)
+            free(segs[i].headers[k].data);
+        for(k = 0; k < segs[i].count; k++)
+            free(segs[i].packets[k].data);
+        free(segs[i].packets);
+    }
+    free(segs);
+    free(threads);
+
+    return ret;
+}
@@ -0,0 +1,21 @@
+#ifndef __SEGMENT_H
+#define __SEGMENT_H
+
+#include "encode.h"
+
+/* Shortest span worth handing to its own thread */
+#define SEGMENT_MIN_SECONDS 60
+
+/* Encodes the raw input in_fn as several overlapping time segments, each on
+   its own thread, then splices the packets of neighbouring segments at a
+   point where both encoders chose the same block layout, producing a single
+   logical stream.  opt must describe the raw input and the output as it
+   would for oe_encode.
+
+   Returns 0 on success, 1 on error, or -1 when no splice point could be
+   found, which is reported as a warning.  Nothing has been written to
+   opt->out in that case, so the caller can fall back to oe_encode. */
+int oe_encode_segmented(oe_enc_opt *opt, char *in_fn, long total_samples,
+        int segments);
+
+#endif /* __SEGMENT_H */
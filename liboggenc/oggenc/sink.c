@@ -0,0 +1,359 @@
+/* OggEnc
+ **
+ ** This program is distributed under the GNU General Public License, version 2.
+ ** A copy of this license is included with this source.
+ **
+ ** Batched output of Ogg pages.
+ **/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <malloc.h>
+#else
+#include <unistd.h>
+#include <limits.h>
+#include <sys/uio.h>
+#endif
+
+#include "sink.h"
+#include "thread_helpers.h"
+
+/* Buffers are whole multiples of this, and start on such a boundary */
+#define SINK_ALIGN 4096
+
+/* The largest possible Ogg page is a 282 byte header and 255 segments of
+   255 bytes, so every page fits in a buffer of at least this size */
+#define SINK_MIN_SIZE 65536
+
+/* Enough that the encoder can fill one while the others are written */
+#define SINK_BUFFERS 4
+
+#if !defined(_WIN32) && !defined(IOV_MAX)
+#define IOV_MAX 16
+#endif
+
+typedef struct
+{
+    unsigned char *data;
+    long used;
+} sink_buffer;
+
+struct oe_page_sink
+{
+    int fd;
+    long size; /* bytes per buffer */
+    int background;
+
+    /* buffers head..head+full-1 wait to be written, and the one after
+       them is being filled */
+    sink_buffer buffers[SINK_BUFFERS];
+    int head;
+    int full;
+    int current; /* only touched by the encoder, so read without the lock */
+    int failed;
+    int stopping;
+
+    th_mutex_t *lock;
+    th_cond_t *changed;
+    th_thread_t *flusher;
+};
+
+static void *alloc_aligned(long size)
+{
+#ifdef _WIN32
+    return _aligned_malloc(size, SINK_ALIGN);
+#else
+    void *data;
+    return posix_memalign(&data, SINK_ALIGN, size) ? NULL : data;
+#endif
+}
+
+static void free_aligned(void *data)
+{
+#ifdef _WIN32
+    _aligned_free(data);
+#else
+    free(data);
+#endif
+}
+
+/* Writes n buffers starting at first, retrying after partial writes */
+static int write_buffers(oe_page_sink *sink, int first, int n)
+{
+#ifdef _WIN32
+    /* Windows only gathers into unbuffered handles, so take them in turn */
+    int i;
+
+    for(i = 0; i < n; i++)
+    {
+        sink_buffer *b = sink->buffers + (first + i) % SINK_BUFFERS;
+        long done = 0;
+
+        while(done < b->used)
+        {
+            int ret = _write(sink->fd, b->data + done, (unsigned int)(b->used - done));
+            if(ret <= 0)
+                return 1;
+
+            done += ret;
+        }
+    }
+
+    return 0;
+#else
+    struct iovec iov[SINK_BUFFERS];
+    struct iovec *next = iov;
+    int i, left = n;
+
+    for(i = 0; i < n; i++)
+    {
+        sink_buffer *b = sink->buffers + (first + i) % SINK_BUFFERS;
+        iov[i].iov_base = b->data;
+        iov[i].iov_len = b->used;
+    }
+
+    while(left)
+    {
+        ssize_t ret = writev(sink->fd, next, left < IOV_MAX ? left : IOV_MAX);
+        if(ret < 0 && errno == EINTR)
+            continue;
+        if(ret <= 0)
+            return 1;
+
+        /* step past whatever went out, which may end part way through one */
+        while(left && (size_t)ret >= next->iov_len)
+        {
+            ret -= next->iov_len;
+            next++;
+            left--;
+        }
+
+        if(left)
+        {
+            next->iov_base = (char *)next->iov_base + ret;
+            next->iov_len -= ret;
+        }
+    }
+
+    return 0;
+#endif
+}
+
+static void flush_main(void *arg)
+{
+    oe_page_sink *sink = (oe_page_sink *)arg;
+
+    th_mutex_lock(sink->lock);
+
+    while(1)
+    {
+        int first, n, failed;
+
+        while(!sink->full && !sink->stopping)
+            th_cond_wait(sink->changed, sink->lock);
+
+        /* drain everything that was handed over before stopping */
+        if(!sink->full)
+            break;
+
+        first = sink->head;
+        n = sink->full;
+        failed = sink->failed;
+
+        th_mutex_unlock(sink->lock);
+        if(!failed)
+            failed = write_buffers(sink, first, n);
+        th_mutex_lock(sink->lock);
+
+        sink->failed = failed;
+        sink->head = (first + n) % SINK_BUFFERS;
+        sink->full -= n;
+        th_cond_broadcast(sink->changed);
+    }
+
+    th_mutex_unlock(sink->lock);
+}
+
+/* Hands the buffer being filled over to be written, and waits for room to
+   fill the next one */
+static int submit(oe_page_sink *sink)
+{
+    int failed;
+
+    if(!sink->background)
+    {
+        sink->full++;
+
+        if(sink->full == SINK_BUFFERS)
+        {
+            if(!sink->failed)
+                sink->failed = write_buffers(sink, sink->head, sink->full);
+            sink->full = 0;
+        }
+
+        sink->current = (sink->current + 1) % SINK_BUFFERS;
+        sink->buffers[sink->current].used = 0;
+        return sink->failed;
+    }
+
+    th_mutex_lock(sink->lock);
+
+    sink->full++;
+    th_cond_broadcast(sink->changed);
+
+    while(sink->full == SINK_BUFFERS)
+        th_cond_wait(sink->changed, sink->lock);
+
+    failed = sink->failed;
+
+    th_mutex_unlock(sink->lock);
+
+    sink->current = (sink->current + 1) % SINK_BUFFERS;
+    sink->buffers[sink->current].used = 0;
+
+    return failed;
+}
+
+/* Writes out everything handed over so far, and the buffer being filled */
+static int drain(oe_page_sink *sink)
+{
+    int failed;
+
+    if(sink->buffers[sink->current].used)
+        submit(sink);
+
+    if(!sink->background)
+    {
+        if(sink->full && !sink->failed)
+            sink->failed = write_buffers(sink, sink->head, sink->full);
+        sink->head = (sink->head + sink->full) % SINK_BUFFERS;
+        sink->full = 0;
+        return sink->failed;
+    }
+
+    th_mutex_lock(sink->lock);
+    while(sink->full)
+        th_cond_wait(sink->changed, sink->lock);
+    failed = sink->failed;
+    th_mutex_unlock(sink->lock);
+
+    return failed;
+}
+
+static void free_sink(oe_page_sink *sink)
+{
+    int i;
+
+    for(i = 0; i < SINK_BUFFERS; i++)
+    {
+        if(sink->buffers[i].data)
+            free_aligned(sink->buffers[i].data);
+    }
+
+    if(sink->changed)
+        th_cond_free(sink->changed);
+    if(sink->lock)
+        th_mutex_free(sink->lock);
+
+    free(sink);
+}
+
+oe_page_sink *oe_sink_open(FILE *out, long buffer_size, int background)
+{
+    oe_page_sink *sink;
+    int i;
+
+    if(buffer_size < 1 || fflush(out))
+        return NULL;
+
+    sink = calloc(1, sizeof(*sink));
+    if(!sink)
+        return NULL;
+
+#ifdef _WIN32
+    sink->fd = _fileno(out);
+#else
+    sink->fd = fileno(out);
+#endif
+    if(sink->fd < 0)
+        goto fail;
+
+    if(buffer_size < SINK_MIN_SIZE)
+        buffer_size = SINK_MIN_SIZE;
+    sink->size = (buffer_size + SINK_ALIGN - 1) / SINK_ALIGN * SINK_ALIGN;
+    sink->background = background;
+
+    for(i = 0; i < SINK_BUFFERS; i++)
+    {
+        sink->buffers[i].data = alloc_aligned(sink->size);
+        if(!sink->buffers[i].data)
+            goto fail;
+    }
+
+    if(background)
+    {
+        sink->lock = th_mutex_alloc();
+        sink->changed = th_cond_alloc();
+        if(!sink->lock || !sink->changed)
+            goto fail;
+
+        /* without the thread, writes just happen as buffers fill */
+        sink->flusher = th_thread_start(flush_main, sink);
+        if(!sink->flusher)
+            sink->background = 0;
+    }
+
+    return sink;
+
+fail:
+    free_sink(sink);
+    return NULL;
+}
+
+int oe_sink_write_page(oe_page_sink *sink, ogg_page *page)
+{
+    long bytes = page->header_len + page->body_len;
+    sink_buffer *current = sink->buffers + sink->current;
+
+    if(current->used + bytes > sink->size)
+    {
+        if(submit(sink))
+            return -1;
+
+        current = sink->buffers + sink->current;
+    }
+
+    memcpy(current->data + current->used, page->header, page->header_len);
+    memcpy(current->data + current->used + page->header_len, page->body, page->body_len);
+    current->used += bytes;
+
+    return bytes;
+}
+
+int oe_sink_close(oe_page_sink *sink)
+{
+    int failed = drain(sink);
+
+    if(sink->flusher)
+    {
+        th_mutex_lock(sink->lock);
+        sink->stopping = 1;
+        th_cond_broadcast(sink->changed);
+        th_mutex_unlock(sink->lock);
+
+        th_thread_join(sink->flusher);
+    }
+
+    free_sink(sink);
+
+    return failed;
+}
@@ -0,0 +1,27 @@
+#ifndef __SINK_H
+#define __SINK_H
+
+#include <stdio.h>
+#include <ogg/ogg.h>
+
+typedef struct oe_page_sink oe_page_sink;
+
+/* Gathers pages into a few large buffers of about buffer_size bytes, and
+   writes every full buffer with a single vectored write to the descriptor
+   behind out.  With background set the writes happen on a thread of their
+   own, so the encoder only waits when every buffer is full.
+
+   Anything already buffered in out is flushed first.  Returns NULL if the
+   sink could not be set up, in which case pages should go through out as
+   before. */
+oe_page_sink *oe_sink_open(FILE *out, long buffer_size, int background);
+
+/* Copies page into the sink.  Returns the number of bytes taken, as
+   oe_write_page does, or -1 once a write has failed. */
+int oe_sink_write_page(oe_page_sink *sink, ogg_page *page);
+
+/* Writes whatever is left and releases the sink.  Returns nonzero if any
+   page could not be written. */
+int oe_sink_close(oe_page_sink *sink);
+
+#endif /* __SINK_H */
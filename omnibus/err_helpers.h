@@ -78,7 +78,7 @@
 
 #else
 
-Edefine ERR_IGNORE_WARNING(id, cmd) cmd
+#define ERR_IGNORE_WARNING(id, cmd) cmd
 
 #endif
 
@@ -18,8 +18,14 @@ char* msnprintf(char const* fmt, ...) {
 char* msnprintf_va(char const* fmt, va_list args) {
   char* buf = NULL;
   int buf_req;
+  va_list measure_args;
 
-  buf_req = vsnprintf(NULL, 0, fmt, args);
+  // the first pass uses up its list on platforms that pass it by reference
+  va_copy(measure_args, args);
+  buf_req = vsnprintf(NULL, 0, fmt, measure_args);
+  va_end(measure_args);
+
+  if (buf_req < 0) return NULL;
 
   buf = malloc(buf_req + 1);
   if (!buf) return NULL;
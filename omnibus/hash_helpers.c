@@ -0,0 +1,184 @@
+#include "hash_helpers.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "err_helpers.h"
+#include "mem_helpers.h"
+
+// files are read a block at a time
+#define HASH_BLOCK_SIZE (1024 * 1024)
+
+#define STRIPE_SIZE 32
+
+#define PRIME_1 11400714785074694791ull
+#define PRIME_2 14029467366897019727ull
+#define PRIME_3 1609587929392839161ull
+#define PRIME_4 9650029242287828579ull
+#define PRIME_5 2870177450012600261ull
+
+static unsigned long long rotl(unsigned long long value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+// the format is little endian, whatever the machine
+static unsigned long long read_64(unsigned char const* bytes) {
+  unsigned long long value = 0;
+  for (int i = 7; i >= 0; --i) value = (value << 8) | bytes[i];
+  return value;
+}
+
+static unsigned long long read_32(unsigned char const* bytes) {
+  unsigned long long value = 0;
+  for (int i = 3; i >= 0; --i) value = (value << 8) | bytes[i];
+  return value;
+}
+
+static unsigned long long mix_lane(unsigned long long lane, unsigned long long input) {
+  lane += input * PRIME_2;
+  lane = rotl(lane, 31);
+  return lane * PRIME_1;
+}
+
+static unsigned long long merge_lane(unsigned long long hash, unsigned long long lane) {
+  hash ^= mix_lane(0, lane);
+  return hash * PRIME_1 + PRIME_4;
+}
+
+static void consume_stripe(hash_state_t* self, unsigned char const* stripe) {
+  self->lanes[0] = mix_lane(self->lanes[0], read_64(stripe));
+  self->lanes[1] = mix_lane(self->lanes[1], read_64(stripe + 8));
+  self->lanes[2] = mix_lane(self->lanes[2], read_64(stripe + 16));
+  self->lanes[3] = mix_lane(self->lanes[3], read_64(stripe + 24));
+}
+
+void hash_state_init(hash_state_t* self, unsigned long long seed) {
+  memset(self, 0, sizeof(*self));
+
+  self->seed = seed;
+  self->lanes[0] = seed + PRIME_1 + PRIME_2;
+  self->lanes[1] = seed + PRIME_2;
+  self->lanes[2] = seed;
+  self->lanes[3] = seed - PRIME_1;
+}
+
+void hash_state_update(hash_state_t* self, void const* bytes, size_t length) {
+  unsigned char const* data = (unsigned char const*)bytes;
+  unsigned char const* end = data + length;
+
+  self->total += length;
+
+  // finish a stripe left over from before
+  if (self->num_pending) {
+    size_t needed = STRIPE_SIZE - self->num_pending;
+    if (length < needed) {
+      memcpy(self->pending + self->num_pending, data, length);
+      self->num_pending += length;
+      return;
+    }
+
+    memcpy(self->pending + self->num_pending, data, needed);
+    consume_stripe(self, self->pending);
+    self->num_pending = 0;
+    data += needed;
+  }
+
+  for (; end - data >= STRIPE_SIZE; data += STRIPE_SIZE) {
+    consume_stripe(self, data);
+  }
+
+  if (data < end) {
+    memcpy(self->pending, data, end - data);
+    self->num_pending = end - data;
+  }
+}
+
+unsigned long long hash_state_digest(hash_state_t const* self) {
+  unsigned long long hash = 0;
+  unsigned char const* data = self->pending;
+  unsigned char const* end = data + self->num_pending;
+
+  if (self->total >= STRIPE_SIZE) {
+    hash = rotl(self->lanes[0], 1) + rotl(self->lanes[1], 7)
+      + rotl(self->lanes[2], 12) + rotl(self->lanes[3], 18);
+
+    for (int i = 0; i < 4; ++i) {
+      hash = merge_lane(hash, self->lanes[i]);
+    }
+  }
+  else {
+    hash = self->seed + PRIME_5;
+  }
+
+  hash += self->total;
+
+  for (; end - data >= 8; data += 8) {
+    hash ^= mix_lane(0, read_64(data));
+    hash = rotl(hash, 27) * PRIME_1 + PRIME_4;
+  }
+
+  if (end - data >= 4) {
+    hash ^= read_32(data) * PRIME_1;
+    hash = rotl(hash, 23) * PRIME_2 + PRIME_3;
+    data += 4;
+  }
+
+  for (; data < end; ++data) {
+    hash ^= *data * PRIME_5;
+    hash = rotl(hash, 11) * PRIME_1;
+  }
+
+  // spread every input bit over the whole result
+  hash ^= hash >> 33;
+  hash *= PRIME_2;
+  hash ^= hash >> 29;
+  hash *= PRIME_3;
+  hash ^= hash >> 32;
+
+  return hash;
+}
+
+unsigned long long hash_bytes(unsigned long long seed, void const* bytes, size_t length) {
+  hash_state_t state;
+
+  hash_state_init(&state, seed);
+  hash_state_update(&state, bytes, length);
+
+  return hash_state_digest(&state);
+}
+
+unsigned long long hash_cstr(unsigned long long seed, char const* str) {
+  return hash_bytes(seed, str, strlen(str));
+}
+
+errno_t hash_file(char const* path, unsigned long long* hash) {
+  errno_t err = 0;
+  FILE* file = 0;
+  unsigned char* block = 0;
+  hash_state_t state;
+  size_t read = 0;
+
+  hash_state_init(&state, 0);
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(block = malloc(HASH_BLOCK_SIZE), err);
+
+    fopen_s(&file, path, "rb");
+    ERR_REGION_NULL_CHECK(file, err);
+
+    while ((read = fread(block, 1, HASH_BLOCK_SIZE, file)) != 0) {
+      hash_state_update(&state, block, read);
+    }
+
+    ERR_REGION_CMP_CHECK(ferror(file), err);
+
+    *hash = hash_state_digest(&state);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE_HANDLER(file, fclose);
+  SAFE_FREE(block);
+
+  return err;
+}
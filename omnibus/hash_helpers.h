@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stddef.h>
+
+// a fast 64 bit hash, xxh64, for telling file contents apart.  it isn't
+// cryptographic, so it only guards against accidents, not attacks
+
+// a value fed in pieces hashes the same as when fed all at once
+typedef struct hash_state {
+  unsigned long long lanes[4];
+  unsigned long long seed;
+  unsigned long long total;  // bytes fed so far
+  unsigned char pending[32];  // bytes that don't yet fill a stripe
+  size_t num_pending;
+} hash_state_t;
+
+void hash_state_init(hash_state_t* self, unsigned long long seed);
+void hash_state_update(hash_state_t* self, void const* bytes, size_t length);
+unsigned long long hash_state_digest(hash_state_t const* self);
+
+// one piece values.  chain several by passing each result as the next seed
+unsigned long long hash_bytes(unsigned long long seed, void const* bytes, size_t length);
+unsigned long long hash_cstr(unsigned long long seed, char const* str);
+
+// hashes the whole content of a file
+errno_t hash_file(char const* path, unsigned long long* hash);
@@ -0,0 +1,83 @@
+#pragma once
+
+// the parts of the microsoft c runtime the code uses, for building
+// elsewhere.  the posix makefile includes this ahead of every file, so
+// nothing needs to include it itself
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef int errno_t;
+
+#define _strdup strdup
+
+static inline errno_t fopen_s(FILE** file, char const* path, char const* mode) {
+  if (!file) return EINVAL;
+
+  *file = fopen(path, mode);
+  return *file ? 0 : errno;
+}
+
+// as with the microsoft versions, a copy that doesn't fit leaves an empty
+// string rather than a partial one
+static inline errno_t strcpy_s(char* dst, size_t dst_size, char const* src) {
+  size_t len = 0;
+
+  if (!dst || !dst_size) return EINVAL;
+
+  len = src ? strlen(src) : 0;
+  if (!src || len >= dst_size) {
+    dst[0] = 0;
+    return src ? ERANGE : EINVAL;
+  }
+
+  memcpy(dst, src, len + 1);
+  return 0;
+}
+
+static inline errno_t strncpy_s(char* dst, size_t dst_size, char const* src, size_t count) {
+  size_t len = 0;
+
+  if (!dst || !dst_size) return EINVAL;
+
+  if (!src) {
+    dst[0] = 0;
+    return EINVAL;
+  }
+
+  while (len < count && src[len]) ++len;
+
+  if (len >= dst_size) {
+    dst[0] = 0;
+    return ERANGE;
+  }
+
+  memcpy(dst, src, len);
+  dst[len] = 0;
+  return 0;
+}
+
+static inline errno_t memmove_s(void* dst, size_t dst_size, void const* src, size_t count) {
+  if (!count) return 0;
+  if (!dst || !src) return EINVAL;
+  if (count > dst_size) return ERANGE;
+
+  memmove(dst, src, count);
+  return 0;
+}
+
+static inline size_t fread_s(void* buffer, size_t buffer_size, size_t element_size, size_t count, FILE* stream) {
+  if (!element_size || !count) return 0;
+
+  // never read past the end of the buffer
+  if (count > buffer_size / element_size) count = buffer_size / element_size;
+
+  return fread(buffer, element_size, count, stream);
+}
+
+#endif
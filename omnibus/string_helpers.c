@@ -67,6 +67,35 @@ short cstr_ends_with(char const* cstr, char const* ending) {
   return strncmp(cstr + (cstr_len - ending_len), ending, ending_len) == 0;
 }
 
+short cstr_glob_matches(char const* cstr, char const* pattern) {
+  char const* star = NULL;  // the last * seen, which can take more
+  char const* resume = NULL;  // where the string picks up if it does
+
+  if (!cstr || !pattern) return 0;
+
+  while (*cstr) {
+    if (*pattern == '*') {
+      star = pattern++;
+      resume = cstr;
+    }
+    else if (*pattern == '?' || *pattern == *cstr) {
+      ++pattern;
+      ++cstr;
+    }
+    else if (star) {
+      pattern = star + 1;
+      cstr = ++resume;
+    }
+    else {
+      return 0;
+    }
+  }
+
+  while (*pattern == '*') ++pattern;
+
+  return !*pattern;
+}
+
 char const* find_last_substring(char const* str, char const* substr) {
   char const *curr_head = str;
   char const *last_found = NULL;
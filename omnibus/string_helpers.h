@@ -4,4 +4,7 @@
 
 char *join_cstrs(char const *strings[], size_t num_strings, char const *delim);
 short cstr_ends_with(char const *str, char const *ending);
+// whether the whole of str matches pattern, where * matches any run of
+// characters and ? any one
+short cstr_glob_matches(char const *str, char const *pattern);
 char const *find_last_substring(char const *str, char const *substr);
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+
+struct th_thread;
+struct th_mutex;
+struct th_cond;
+
+typedef struct th_thread th_thread_t;
+typedef struct th_mutex th_mutex_t;
+typedef struct th_cond th_cond_t;
+
+typedef void (*th_thread_func)(void* arg);
+
+// start a thread running func(arg)
+// returns NULL if the thread could not be started
+struct th_thread* th_thread_start(th_thread_func func, void* arg);
+
+// wait for the thread to finish, then release it
+void th_thread_join(struct th_thread* thread);
+
+struct th_mutex* th_mutex_alloc(void);
+void th_mutex_free(struct th_mutex* self);
+void th_mutex_lock(struct th_mutex* self);
+void th_mutex_unlock(struct th_mutex* self);
+
+struct th_cond* th_cond_alloc(void);
+void th_cond_free(struct th_cond* self);
+// mutex must be held by the caller, and will be held again on return
+void th_cond_wait(struct th_cond* self, struct th_mutex* mutex);
+// as th_cond_wait, but gives up after milliseconds, returning 0 if it did
+short th_cond_timed_wait(struct th_cond* self, struct th_mutex* mutex, unsigned long milliseconds);
+void th_cond_signal(struct th_cond* self);
+void th_cond_broadcast(struct th_cond* self);
+
+// number of processors available to the process (at least 1)
+size_t th_cpu_count(void);
+
+// adds amount to value as a single step, however many threads add at once,
+// returning the new value.  adding 0 reads it
+unsigned long long th_atomic_add(unsigned long long volatile* value, unsigned long long amount);
@@ -0,0 +1,127 @@
+#include "thread_helpers.h"
+
+#ifndef _WIN32
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct th_thread {
+  pthread_t handle;
+  th_thread_func func;
+  void* arg;
+} th_thread_t;
+
+typedef struct th_mutex {
+  pthread_mutex_t lock;
+} th_mutex_t;
+
+typedef struct th_cond {
+  pthread_cond_t cond;
+} th_cond_t;
+
+static void* thread_proc(void* param) {
+  th_thread_t* self = (th_thread_t*)param;
+  self->func(self->arg);
+  return NULL;
+}
+
+struct th_thread* th_thread_start(th_thread_func func, void* arg) {
+  th_thread_t* self = malloc(sizeof(*self));
+  if (!self) return NULL;
+
+  self->func = func;
+  self->arg = arg;
+  if (pthread_create(&self->handle, NULL, thread_proc, self)) {
+    free(self);
+    return NULL;
+  }
+
+  return self;
+}
+
+void th_thread_join(struct th_thread* self) {
+  pthread_join(self->handle, NULL);
+  free(self);
+}
+
+struct th_mutex* th_mutex_alloc(void) {
+  th_mutex_t* self = malloc(sizeof(*self));
+  if (!self) return NULL;
+
+  if (pthread_mutex_init(&self->lock, NULL)) {
+    free(self);
+    return NULL;
+  }
+
+  return self;
+}
+
+void th_mutex_free(struct th_mutex* self) {
+  pthread_mutex_destroy(&self->lock);
+  free(self);
+}
+
+void th_mutex_lock(struct th_mutex* self) {
+  pthread_mutex_lock(&self->lock);
+}
+
+void th_mutex_unlock(struct th_mutex* self) {
+  pthread_mutex_unlock(&self->lock);
+}
+
+struct th_cond* th_cond_alloc(void) {
+  th_cond_t* self = malloc(sizeof(*self));
+  if (!self) return NULL;
+
+  if (pthread_cond_init(&self->cond, NULL)) {
+    free(self);
+    return NULL;
+  }
+
+  return self;
+}
+
+void th_cond_free(struct th_cond* self) {
+  pthread_cond_destroy(&self->cond);
+  free(self);
+}
+
+void th_cond_wait(struct th_cond* self, struct th_mutex* mutex) {
+  pthread_cond_wait(&self->cond, &mutex->lock);
+}
+
+short th_cond_timed_wait(struct th_cond* self, struct th_mutex* mutex, unsigned long milliseconds) {
+  struct timespec until;
+
+  // the condition measures against the realtime clock by default
+  clock_gettime(CLOCK_REALTIME, &until);
+  until.tv_sec += milliseconds / 1000;
+  until.tv_nsec += (long)(milliseconds % 1000) * 1000000;
+  if (until.tv_nsec >= 1000000000) {
+    until.tv_sec += 1;
+    until.tv_nsec -= 1000000000;
+  }
+
+  return pthread_cond_timedwait(&self->cond, &mutex->lock, &until) ? 0 : 1;
+}
+
+void th_cond_signal(struct th_cond* self) {
+  pthread_cond_signal(&self->cond);
+}
+
+void th_cond_broadcast(struct th_cond* self) {
+  pthread_cond_broadcast(&self->cond);
+}
+
+size_t th_cpu_count(void) {
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (size_t)count : 1;
+}
+
+unsigned long long th_atomic_add(unsigned long long volatile* value, unsigned long long amount) {
+  return __atomic_add_fetch(value, amount, __ATOMIC_SEQ_CST);
+}
+
+#endif
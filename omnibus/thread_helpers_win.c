@@ -0,0 +1,113 @@
+#include "thread_helpers.h"
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+
+#include <Windows.h>
+#include <stdlib.h>
+
+#include "mem_helpers.h"
+
+typedef struct th_thread {
+  HANDLE handle;
+  th_thread_func func;
+  void* arg;
+} th_thread_t;
+
+typedef struct th_mutex {
+  SRWLOCK lock;
+} th_mutex_t;
+
+typedef struct th_cond {
+  CONDITION_VARIABLE cond;
+} th_cond_t;
+
+static DWORD WINAPI thread_proc(LPVOID param) {
+  th_thread_t* self = (th_thread_t*)param;
+  self->func(self->arg);
+  return 0;
+}
+
+struct th_thread* th_thread_start(th_thread_func func, void* arg) {
+  th_thread_t* self = malloc(sizeof(*self));
+  if (!self) return NULL;
+
+  self->func = func;
+  self->arg = arg;
+  self->handle = CreateThread(NULL, 0, thread_proc, self, 0, NULL);
+  if (!self->handle) {
+    SAFE_FREE(self);
+    return NULL;
+  }
+
+  return self;
+}
+
+void th_thread_join(struct th_thread* self) {
+  WaitForSingleObject(self->handle, INFINITE);
+  CloseHandle(self->handle);
+  free(self);
+}
+
+struct th_mutex* th_mutex_alloc(void) {
+  th_mutex_t* self = malloc(sizeof(*self));
+  if (!self) return NULL;
+
+  InitializeSRWLock(&self->lock);
+  return self;
+}
+
+void th_mutex_free(struct th_mutex* self) {
+  // SRW locks need no cleanup
+  free(self);
+}
+
+void th_mutex_lock(struct th_mutex* self) {
+  AcquireSRWLockExclusive(&self->lock);
+}
+
+void th_mutex_unlock(struct th_mutex* self) {
+  ReleaseSRWLockExclusive(&self->lock);
+}
+
+struct th_cond* th_cond_alloc(void) {
+  th_cond_t* self = malloc(sizeof(*self));
+  if (!self) return NULL;
+
+  InitializeConditionVariable(&self->cond);
+  return self;
+}
+
+void th_cond_free(struct th_cond* self) {
+  // condition variables need no cleanup
+  free(self);
+}
+
+void th_cond_wait(struct th_cond* self, struct th_mutex* mutex) {
+  SleepConditionVariableSRW(&self->cond, &mutex->lock, INFINITE, 0);
+}
+
+short th_cond_timed_wait(struct th_cond* self, struct th_mutex* mutex, unsigned long milliseconds) {
+  return SleepConditionVariableSRW(&self->cond, &mutex->lock, milliseconds, 0) ? 1 : 0;
+}
+
+void th_cond_signal(struct th_cond* self) {
+  WakeConditionVariable(&self->cond);
+}
+
+void th_cond_broadcast(struct th_cond* self) {
+  WakeAllConditionVariable(&self->cond);
+}
+
+size_t th_cpu_count(void) {
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors ? info.dwNumberOfProcessors : 1;
+}
+
+unsigned long long th_atomic_add(unsigned long long volatile* value, unsigned long long amount) {
+  return (unsigned long long)InterlockedExchangeAdd64((LONG64 volatile*)value, (LONG64)amount) + amount;
+}
+
+#endif
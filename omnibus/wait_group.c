@@ -0,0 +1,69 @@
+#include "wait_group.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "err_helpers.h"
+#include "mem_helpers.h"
+#include "thread_helpers.h"
+
+struct wait_group* wait_group_alloc(void) {
+  wait_group_t* self = malloc(sizeof(*self));
+  if (!self) return NULL;
+
+  errno_t err = wait_group_init(self);
+  if (!err) return self;
+
+  SAFE_FREE(self);
+  return NULL;
+}
+
+errno_t wait_group_init(struct wait_group* self) {
+  errno_t err = 0;
+
+  memset(self, 0, sizeof(*self));
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(self->lock = th_mutex_alloc(), err);
+    ERR_REGION_NULL_CHECK(self->is_done = th_cond_alloc(), err);
+
+    return err;
+
+  } ERR_REGION_END()
+
+  wait_group_uninit(self);
+
+  return err;
+}
+
+void wait_group_uninit(struct wait_group* self) {
+  SAFE_FREE_HANDLER(self->is_done, th_cond_free);
+  SAFE_FREE_HANDLER(self->lock, th_mutex_free);
+}
+
+void wait_group_free(struct wait_group* self) {
+  wait_group_uninit(self);
+  SAFE_FREE(self);
+}
+
+void wait_group_add(struct wait_group* self, size_t count) {
+  th_mutex_lock(self->lock);
+  self->remaining += count;
+  th_mutex_unlock(self->lock);
+}
+
+void wait_group_done(struct wait_group* self) {
+  th_mutex_lock(self->lock);
+  if (self->remaining && !--self->remaining) {
+    th_cond_broadcast(self->is_done);
+  }
+  th_mutex_unlock(self->lock);
+}
+
+void wait_group_wait(struct wait_group* self) {
+  th_mutex_lock(self->lock);
+  while (self->remaining) {
+    th_cond_wait(self->is_done, self->lock);
+  }
+  th_mutex_unlock(self->lock);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+
+struct th_mutex;
+struct th_cond;
+
+// counts outstanding pieces of work so that one thread can wait for a
+// batch it handed to other threads
+typedef struct wait_group {
+  struct th_mutex* lock;
+  struct th_cond* is_done;
+  size_t remaining;
+} wait_group_t;
+
+struct wait_group* wait_group_alloc(void);
+errno_t wait_group_init(struct wait_group* self);
+void wait_group_uninit(struct wait_group* self);
+void wait_group_free(struct wait_group* self);
+
+void wait_group_add(struct wait_group* self, size_t count);
+void wait_group_done(struct wait_group* self);
+// block until every added piece of work is done
+void wait_group_wait(struct wait_group* self);
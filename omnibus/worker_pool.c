@@ -0,0 +1,155 @@
+#include "worker_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "err_helpers.h"
+#include "mem_helpers.h"
+#include "thread_helpers.h"
+
+static void worker_main(void* arg);
+
+struct worker_pool* worker_pool_alloc(size_t num_workers, size_t capacity) {
+  worker_pool_t* self = malloc(sizeof(*self));
+  if (!self) return NULL;
+
+  errno_t err = worker_pool_init(self, num_workers, capacity);
+  if (!err) return self;
+
+  SAFE_FREE(self);
+  return NULL;
+}
+
+errno_t worker_pool_init(struct worker_pool* self, size_t num_workers, size_t capacity) {
+  errno_t err = 0;
+
+  memset(self, 0, sizeof(*self));
+
+  if (!num_workers) num_workers = 1;
+  if (!capacity) capacity = num_workers;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(self->lock = th_mutex_alloc(), err);
+    ERR_REGION_NULL_CHECK(self->has_jobs = th_cond_alloc(), err);
+    ERR_REGION_NULL_CHECK(self->has_room = th_cond_alloc(), err);
+    ERR_REGION_NULL_CHECK(self->is_idle = th_cond_alloc(), err);
+
+    self->queue = malloc(capacity * sizeof(*self->queue));
+    ERR_REGION_NULL_CHECK(self->queue, err);
+    self->capacity = capacity;
+
+    self->workers = malloc(num_workers * sizeof(*self->workers));
+    ERR_REGION_NULL_CHECK(self->workers, err);
+
+    for (; self->num_workers < num_workers; ++self->num_workers) {
+      worker_pool_worker_t* worker = self->workers + self->num_workers;
+      worker->pool = self;
+      worker->index = self->num_workers;
+
+      worker->thread = th_thread_start(worker_main, worker);
+      ERR_REGION_NULL_CHECK(worker->thread, err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    return err;
+
+  } ERR_REGION_END()
+
+  // stops any workers that did start, and releases everything else
+  worker_pool_uninit(self);
+
+  return err;
+}
+
+void worker_pool_uninit(struct worker_pool* self) {
+  if (self->lock) {
+    th_mutex_lock(self->lock);
+    self->stopping = 1;
+    th_cond_broadcast(self->has_jobs);
+    th_mutex_unlock(self->lock);
+  }
+
+  for (size_t i = 0; i < self->num_workers; ++i) {
+    th_thread_join(self->workers[i].thread);
+  }
+  self->num_workers = 0;
+
+  SAFE_FREE(self->workers);
+  SAFE_FREE(self->queue);
+  SAFE_FREE_HANDLER(self->is_idle, th_cond_free);
+  SAFE_FREE_HANDLER(self->has_room, th_cond_free);
+  SAFE_FREE_HANDLER(self->has_jobs, th_cond_free);
+  SAFE_FREE_HANDLER(self->lock, th_mutex_free);
+}
+
+void worker_pool_free(struct worker_pool* self) {
+  worker_pool_uninit(self);
+  SAFE_FREE(self);
+}
+
+errno_t worker_pool_submit(struct worker_pool* self, worker_pool_job_func func, void* job) {
+  errno_t err = 0;
+
+  th_mutex_lock(self->lock);
+
+  while (self->queued == self->capacity && !self->stopping) {
+    th_cond_wait(self->has_room, self->lock);
+  }
+
+  if (self->stopping) {
+    err = -1;
+  }
+  else {
+    worker_pool_job_t* slot = self->queue + (self->head + self->queued) % self->capacity;
+    slot->func = func;
+    slot->job = job;
+    ++self->queued;
+    th_cond_signal(self->has_jobs);
+  }
+
+  th_mutex_unlock(self->lock);
+
+  return err;
+}
+
+void worker_pool_wait(struct worker_pool* self) {
+  th_mutex_lock(self->lock);
+
+  while (self->queued || self->running) {
+    th_cond_wait(self->is_idle, self->lock);
+  }
+
+  th_mutex_unlock(self->lock);
+}
+
+static void worker_main(void* arg) {
+  worker_pool_worker_t* worker = (worker_pool_worker_t*)arg;
+  worker_pool_t* self = worker->pool;
+
+  th_mutex_lock(self->lock);
+
+  while (1) {
+    while (!self->queued && !self->stopping) {
+      th_cond_wait(self->has_jobs, self->lock);
+    }
+
+    // drain everything that was queued before stopping
+    if (!self->queued) break;
+
+    worker_pool_job_t job = self->queue[self->head];
+    self->head = (self->head + 1) % self->capacity;
+    --self->queued;
+    ++self->running;
+    th_cond_signal(self->has_room);
+
+    th_mutex_unlock(self->lock);
+    job.func(job.job, worker->index);
+    th_mutex_lock(self->lock);
+
+    --self->running;
+    if (!self->queued && !self->running) {
+      th_cond_broadcast(self->is_idle);
+    }
+  }
+
+  th_mutex_unlock(self->lock);
+}
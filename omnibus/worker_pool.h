@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stddef.h>
+
+struct th_mutex;
+struct th_cond;
+struct th_thread;
+
+// worker is the index of the worker running the job, below num_workers,
+// so jobs can keep per worker state without locking
+typedef void (*worker_pool_job_func)(void* job, size_t worker);
+
+typedef struct worker_pool_job {
+  worker_pool_job_func func;
+  void* job;  // weak ref
+} worker_pool_job_t;
+
+typedef struct worker_pool_worker {
+  struct worker_pool* pool;  // weak ref
+  size_t index;
+  struct th_thread* thread;
+} worker_pool_worker_t;
+
+// a fixed set of worker threads draining a bounded job queue.
+// submitting to a full queue blocks until a worker frees a slot.
+typedef struct worker_pool {
+  struct th_mutex* lock;
+  struct th_cond* has_jobs;
+  struct th_cond* has_room;
+  struct th_cond* is_idle;
+  worker_pool_job_t* queue;  // ring buffer of capacity entries
+  size_t capacity;
+  size_t head;
+  size_t queued;
+  size_t running;
+  short stopping;
+  worker_pool_worker_t* workers;
+  size_t num_workers;
+} worker_pool_t;
+
+struct worker_pool* worker_pool_alloc(size_t num_workers, size_t capacity);
+errno_t worker_pool_init(struct worker_pool* self, size_t num_workers, size_t capacity);
+// waits for all submitted jobs to complete before stopping the workers
+void worker_pool_uninit(struct worker_pool* self);
+void worker_pool_free(struct worker_pool* self);
+
+errno_t worker_pool_submit(struct worker_pool* self, worker_pool_job_func func, void* job);
+// block until the queue is empty and no job is running
+void worker_pool_wait(struct worker_pool* self);
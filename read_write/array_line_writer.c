@@ -39,10 +39,12 @@ static size_t write_line_range(line_writer_i* self, char const* start, char cons
     return 0;
   }
 
+  // the array may have moved, whether or not the line makes it in
+  array_self->lines = lines;
+
   size_t len = end - start;
   char* line_dup = malloc(len + 1);
   if (!line_dup) {
-    free(lines);
     return 0;
   }
 
@@ -56,7 +58,7 @@ static size_t write_line_range(line_writer_i* self, char const* start, char cons
   *dup_i = 0;
 
   array_self->lines = lines;
-  array_self->lines[num_lines] = line_dup;
+  array_self->lines[num_lines - 1] = line_dup;
   array_self->num_lines = num_lines;
 
   return len;
@@ -72,9 +74,11 @@ static size_t write_line(line_writer_i* self, char const* line) {
     return 0;
   }
 
+  // the array may have moved, whether or not the line makes it in
+  array_self->lines = lines;
+
   char *line_dup = _strdup(line);
   if (!line_dup) {
-    free(lines);
     return 0;
   }
 
@@ -0,0 +1,403 @@
+#include "directory_cache.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "filesystem.h"
+#include "path.h"
+#include "err_helpers.h"
+#include "mem_helpers.h"
+#include "hash_helpers.h"
+#include "thread_helpers.h"
+
+struct cache_dir;
+
+// entries are never removed, so an empty slot ends a probe
+typedef struct cache_slot {
+  char const* key;  // owned, folded where paths ignore case
+  unsigned long long hash;
+  struct cache_dir* dir;  // owned, NULL in a table of names
+} cache_slot_t;
+
+typedef struct directory_cache_table {
+  cache_slot_t* slots;  // owned
+  size_t capacity;  // a power of 2, or 0 before the first key
+  size_t count;
+} cache_table_t;
+
+typedef struct cache_dir {
+  short exists;  // known to be there
+  short listed;  // names holds everything in it
+  cache_table_t names;
+} cache_dir_t;
+
+static char* fold_key(char const* path);
+static cache_slot_t* table_find(cache_table_t const* self, char const* key, unsigned long long hash);
+static errno_t table_add(cache_table_t* self, char const* key, unsigned long long hash, cache_dir_t* dir);
+static errno_t table_grow(cache_table_t* self);
+static void table_uninit(cache_table_t* self);
+static cache_dir_t* find_dir(directory_cache_t* self, char const* path);
+static short has_name(cache_dir_t const* dir, char const* name);
+static errno_t add_name(cache_dir_t* dir, char const* name);
+static errno_t list_dir(directory_cache_t* self, cache_dir_t* dir, char const* path);
+static errno_t ensure_dir_locked(directory_cache_t* self, char const* path);
+static short is_path_top(char const* path, char const* name);
+
+// tables start with room for this many keys, and double as they fill
+#define INITIAL_CAPACITY 16
+
+struct directory_cache* directory_cache_alloc(void) {
+  directory_cache_t* self = malloc(sizeof(*self));
+  if (!self) return NULL;
+
+  if (directory_cache_init(self)) {
+    SAFE_FREE(self);
+  }
+
+  return self;
+}
+
+errno_t directory_cache_init(struct directory_cache* self) {
+  errno_t err = 0;
+
+  memset(self, 0, sizeof(*self));
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(self->dirs = calloc(1, sizeof(*self->dirs)), err);
+    ERR_REGION_NULL_CHECK(self->lock = th_mutex_alloc(), err);
+
+  } ERR_REGION_END()
+
+  if (err) directory_cache_uninit(self);
+
+  return err;
+}
+
+void directory_cache_uninit(struct directory_cache* self) {
+  if (self->dirs) table_uninit(self->dirs);
+  SAFE_FREE(self->dirs);
+  SAFE_FREE_HANDLER(self->lock, th_mutex_free);
+}
+
+void directory_cache_free(struct directory_cache* self) {
+  directory_cache_uninit(self);
+  free(self);
+}
+
+short directory_cache_file_exists(struct directory_cache* self, char const* path) {
+  errno_t err = 0;
+  char const* dir_path = 0;
+  char const* name = 0;
+  cache_dir_t* dir = 0;
+  short result = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(dir_path = path_dir_part(path), err);
+    ERR_REGION_NULL_CHECK(name = path_file_part(path), err);
+
+    // a bare name has no directory worth listing
+    ERR_REGION_CMP_CHECK(is_path_top(path, name), err);
+
+    th_mutex_lock(self->lock);
+
+    dir = find_dir(self, dir_path);
+    if (dir && !dir->listed) err = list_dir(self, dir, dir_path);
+    if (dir && !err) result = has_name(dir, name);
+    if (!dir) err = -1;
+
+    th_mutex_unlock(self->lock);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE(dir_path);
+  SAFE_FREE(name);
+
+  // whatever couldn't be cached is asked of the filesystem
+  if (err) result = file_exists(path);
+
+  return result;
+}
+
+errno_t directory_cache_ensure_dir(struct directory_cache* self, char const* path) {
+  errno_t err = 0;
+
+  th_mutex_lock(self->lock);
+  err = ensure_dir_locked(self, path);
+  th_mutex_unlock(self->lock);
+
+  return err;
+}
+
+errno_t directory_cache_add_file(struct directory_cache* self, char const* path) {
+  errno_t err = 0;
+  char const* dir_path = 0;
+  char const* name = 0;
+  cache_dir_t* dir = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(dir_path = path_dir_part(path), err);
+    ERR_REGION_NULL_CHECK(name = path_file_part(path), err);
+
+    // bare names are never cached, so there is nothing to update
+    if (!is_path_top(path, name)) {
+      th_mutex_lock(self->lock);
+
+      dir = find_dir(self, dir_path);
+      if (dir) {
+        dir->exists = 1;
+        if (dir->listed) err = add_name(dir, name);
+      }
+      else {
+        err = -1;
+      }
+
+      th_mutex_unlock(self->lock);
+    }
+
+  } ERR_REGION_END()
+
+  SAFE_FREE(dir_path);
+  SAFE_FREE(name);
+
+  return err;
+}
+
+static errno_t ensure_dir_locked(directory_cache_t* self, char const* path) {
+  errno_t err = 0;
+  char const* parent_path = 0;
+  char const* name = 0;
+  cache_dir_t* dir = 0;
+  cache_dir_t* parent = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(dir = find_dir(self, path), err);
+
+    if (!dir->exists) {
+      ERR_REGION_NULL_CHECK(parent_path = path_dir_part(path), err);
+      ERR_REGION_NULL_CHECK(name = path_file_part(path), err);
+
+      if (is_path_top(path, name)) {
+        // roots and the start of relative paths are left to ensure_dir,
+        // which knows which of them can't be created
+        ERR_REGION_ERROR_CHECK(ensure_dir(path), err);
+      }
+      else {
+        ERR_REGION_ERROR_CHECK(ensure_dir_locked(self, parent_path), err);
+        ERR_REGION_NULL_CHECK(parent = find_dir(self, parent_path), err);
+
+        if (!parent->listed || !has_name(parent, name)) {
+          ERR_REGION_ERROR_CHECK(make_dir(path), err);
+          ++self->creates;
+
+          // missing from a listed parent, so it was just created, and is empty
+          if (parent->listed) {
+            ERR_REGION_ERROR_CHECK(add_name(parent, name), err);
+            dir->listed = 1;
+          }
+        }
+      }
+
+      dir->exists = 1;
+    }
+
+  } ERR_REGION_END()
+
+  SAFE_FREE(parent_path);
+  SAFE_FREE(name);
+
+  return err;
+}
+
+// a path with no directory part to cache, either because it is a single
+// name, or because it names a root
+static short is_path_top(char const* path, char const* name) {
+  return !strchr(path, k_path_separator_char)
+    || !*name
+    || strcmp(name, ".") == 0
+    || strcmp(name, "..") == 0;
+}
+
+static errno_t list_dir(directory_cache_t* self, cache_dir_t* dir, char const* path) {
+  errno_t err = 0;
+  file_handle_i* handle = 0;
+  directory_entry_i* entry = 0;
+
+  ERR_REGION_BEGIN() {
+    handle = open_dir(path);
+
+    // a directory that can't be opened holds nothing, until it is created
+    while (handle && !handle->is_eof(handle)) {
+      ERR_REGION_NULL_CHECK(entry = handle->next_dir_entry(handle), err);
+      ERR_REGION_ERROR_CHECK(add_name(dir, entry->get_name(entry)), err);
+
+      entry->release(entry);
+      entry = 0;
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    if (handle) dir->exists = 1;
+    dir->listed = 1;
+    ++self->listings;
+
+  } ERR_REGION_END()
+
+  if (entry) entry->release(entry);
+  if (handle) handle->close(handle);
+
+  return err;
+}
+
+static cache_dir_t* find_dir(directory_cache_t* self, char const* path) {
+  errno_t err = 0;
+  char* key = 0;
+  unsigned long long hash = 0;
+  cache_slot_t* slot = 0;
+  cache_dir_t* dir = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(key = fold_key(path), err);
+    hash = hash_cstr(0, key);
+
+    slot = table_find(self->dirs, key, hash);
+    if (slot) {
+      dir = slot->dir;
+    }
+    else {
+      ERR_REGION_NULL_CHECK(dir = calloc(1, sizeof(*dir)), err);
+
+      // the table owns both from here on, even if it can't take them
+      err = table_add(self->dirs, key, hash, dir);
+      key = 0;
+      if (err) dir = 0;
+    }
+
+  } ERR_REGION_END()
+
+  SAFE_FREE(key);
+
+  return dir;
+}
+
+static short has_name(cache_dir_t const* dir, char const* name) {
+  char* key = fold_key(name);
+  short result = 0;
+
+  if (key) result = table_find(&dir->names, key, hash_cstr(0, key)) != 0;
+
+  SAFE_FREE(key);
+
+  return result;
+}
+
+static errno_t add_name(cache_dir_t* dir, char const* name) {
+  char* key = fold_key(name);
+  unsigned long long hash = 0;
+
+  if (!key) return -1;
+
+  hash = hash_cstr(0, key);
+  if (table_find(&dir->names, key, hash)) {
+    SAFE_FREE(key);
+    return 0;
+  }
+
+  return table_add(&dir->names, key, hash, NULL);
+}
+
+static char* fold_key(char const* path) {
+  char* key = _strdup(path);
+
+  if (key && k_path_ignores_case) {
+    for (char* c = key; *c; ++c) {
+      *c = (char)tolower((unsigned char)*c);
+    }
+  }
+
+  return key;
+}
+
+static cache_slot_t* table_find(cache_table_t const* self, char const* key, unsigned long long hash) {
+  size_t mask = self->capacity - 1;
+
+  if (!self->capacity) return NULL;
+
+  for (size_t i = (size_t)hash & mask; self->slots[i].key; i = (i + 1) & mask) {
+    cache_slot_t* slot = &self->slots[i];
+    if (slot->hash == hash && strcmp(slot->key, key) == 0) return slot;
+  }
+
+  return NULL;
+}
+
+// takes ownership of key and dir, freeing them if they can't be added
+static errno_t table_add(cache_table_t* self, char const* key, unsigned long long hash, cache_dir_t* dir) {
+  errno_t err = 0;
+  size_t mask = 0;
+  size_t i = 0;
+
+  ERR_REGION_BEGIN() {
+    // kept at most three quarters full, so probes stay short
+    if ((self->count + 1) * 4 > self->capacity * 3) {
+      ERR_REGION_ERROR_CHECK(table_grow(self), err);
+    }
+
+    mask = self->capacity - 1;
+    for (i = (size_t)hash & mask; self->slots[i].key; i = (i + 1) & mask);
+
+    self->slots[i].key = key;
+    self->slots[i].hash = hash;
+    self->slots[i].dir = dir;
+    ++self->count;
+
+  } ERR_REGION_END()
+
+  if (err) {
+    SAFE_FREE(key);
+    if (dir) {
+      table_uninit(&dir->names);
+      free(dir);
+    }
+  }
+
+  return err;
+}
+
+static errno_t table_grow(cache_table_t* self) {
+  size_t capacity = self->capacity ? self->capacity * 2 : INITIAL_CAPACITY;
+  size_t mask = capacity - 1;
+  cache_slot_t* slots = calloc(capacity, sizeof(*slots));
+
+  if (!slots) return -1;
+
+  for (size_t j = 0; j < self->capacity; ++j) {
+    cache_slot_t const* slot = &self->slots[j];
+    size_t i = 0;
+
+    if (!slot->key) continue;
+
+    for (i = (size_t)slot->hash & mask; slots[i].key; i = (i + 1) & mask);
+    slots[i] = *slot;
+  }
+
+  SAFE_FREE(self->slots);
+  self->slots = slots;
+  self->capacity = capacity;
+
+  return 0;
+}
+
+static void table_uninit(cache_table_t* self) {
+  for (size_t i = 0; i < self->capacity; ++i) {
+    cache_slot_t* slot = &self->slots[i];
+
+    SAFE_FREE(slot->key);
+    if (slot->dir) {
+      table_uninit(&slot->dir->names);
+      free(slot->dir);
+    }
+  }
+
+  SAFE_FREE(self->slots);
+  self->capacity = 0;
+  self->count = 0;
+}
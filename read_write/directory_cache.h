@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+
+struct th_mutex;
+struct directory_cache_table;
+
+// what is known of the directories under a target.  each directory is
+// listed at most once, the first time a file in it is asked about, and
+// directories are only created the first time they are needed, so that
+// a traversal writing into a slow target asks the filesystem once per
+// directory rather than once per file.  only sees changes made through it
+typedef struct directory_cache {
+  struct directory_cache_table* dirs;  // owned, what is known of each directory, by path
+  struct th_mutex* lock;  // owned, guards everything
+  size_t listings;  // directories read so far
+  size_t creates;  // directories created, or found to exist, so far
+} directory_cache_t;
+
+struct directory_cache* directory_cache_alloc(void);
+errno_t directory_cache_init(struct directory_cache* self);
+void directory_cache_uninit(struct directory_cache* self);
+void directory_cache_free(struct directory_cache* self);
+
+// as file_exists, but answered from the listing of the directory holding
+// path.  safe to call from several threads at once
+short directory_cache_file_exists(struct directory_cache* self, char const* path);
+
+// as ensure_dir, but only creates the levels of path not already known
+// to exist.  safe to call from several threads at once
+errno_t directory_cache_ensure_dir(struct directory_cache* self, char const* path);
+
+// records a file the caller just wrote, so that it is seen by later
+// checks.  safe to call from several threads at once
+errno_t directory_cache_add_file(struct directory_cache* self, char const* path);
@@ -6,15 +6,26 @@
 
 #include "filesystem.h"
 #include "directory_traversal_handler.h"
-#include "string_vector.h"
 #include "err_helpers.h"
 #include "mem_helpers.h"
+#include "thread_helpers.h"
+#include "string_helpers.h"
 
 static const char s_current_dir[] = ".";
 static const char s_parent_dir[] = "..";
 
+// a path grown and cut back a name at a time as the traversal goes down
+// and back up, so that each entry's is there without being joined
+typedef struct dt_path {
+  char* buffer;  // owned
+  size_t length;
+  size_t capacity;
+} dt_path_t;
+
 typedef struct directory_traversal_state {
-  struct string_vector* history;
+  dt_path_t path;
+  dt_path_t parallel_path;
+  size_t root_length;  // of path, before the names under the directory traversed
 } directory_traversal_state_t;
 
 static short traverse_dir_internal(
@@ -22,6 +33,20 @@ static short traverse_dir_internal(
   struct directory_traversal_options const* opts, 
   struct directory_traversal_state *state,
   struct directory_traversal_handler* handler);
+static short traverse_dir_parallel(
+  file_handle_i* directory,
+  struct directory_traversal_options const* opts,
+  struct directory_traversal_handler* handler);
+static void filter_entries(file_handle_i* directory, struct directory_traversal_options const* opts);
+static short is_handled(directory_entry_i const* entry, struct directory_traversal_options const* opts);
+static errno_t path_init(dt_path_t* self, char const* root);
+static void path_uninit(dt_path_t* self);
+static errno_t path_push(dt_path_t* self, char const* name);
+static void path_pop(dt_path_t* self);
+static errno_t push_entry(directory_traversal_handler_state_t* handler_state,
+  dt_path_t* path, dt_path_t* parallel_path, char const* name);
+static void pop_entry(directory_traversal_handler_state_t* handler_state,
+  dt_path_t* path, dt_path_t* parallel_path);
 
 short traverse_dir_path_opts(char const* path, struct directory_traversal_options const* opts, struct directory_traversal_handler* handler) {
   short result = 0;
@@ -61,18 +86,64 @@ static short should_traverse(directory_entry_i const* entry) {
 
 short traverse_dir_opts(file_handle_i* directory, struct directory_traversal_options const *opts, struct directory_traversal_handler* handler) {
 
+  short keep_traversing = 0;
   directory_traversal_state_t state;
   memset(&state, 0, sizeof(state));
-  state.history = string_vector_alloc();
-  if (! state.history) return 0;
 
-  short keep_traversing = traverse_dir_internal(directory, opts, &state, handler);
+  filter_entries(directory, opts);
+
+  if (opts->threads > 1) {
+    keep_traversing = traverse_dir_parallel(directory, opts, handler);
+  }
+  else if (!path_init(&state.path, directory->get_path(directory))
+    && !path_init(&state.parallel_path, handler->parallel_root)) {
+
+    state.root_length = state.path.length;
+    keep_traversing = traverse_dir_internal(directory, opts, &state, handler);
+  }
+
+  // the caller's directory doesn't keep a filter that refers to opts
+  directory->set_entry_filter(directory, NULL, NULL);
 
-  SAFE_FREE_HANDLER(state.history, string_vector_free);
+  path_uninit(&state.parallel_path);
+  path_uninit(&state.path);
 
   return keep_traversing;
 }
 
+size_t traversal_depth(directory_traversal_handler_state_t const* state) {
+  size_t depth = 0;
+  char const* start = 0;
+  char const* end = 0;
+
+  while (traversal_name(state, depth, &start, &end)) ++depth;
+
+  return depth;
+}
+
+// each name follows a separator, so the names are counted off from the
+// end of the root
+short traversal_name(directory_traversal_handler_state_t const* state, size_t depth,
+  char const** start, char const** end) {
+
+  char const* name = state->path ? state->path + state->root_length : 0;
+
+  for (size_t i = 0; name && *name; ++i) {
+    char const* name_end = strchr(name + 1, k_path_separator_char);
+    if (!name_end) name_end = name + strlen(name);
+
+    if (i == depth) {
+      *start = name + 1;
+      *end = name_end;
+      return 1;
+    }
+
+    name = name_end;
+  }
+
+  return 0;
+}
+
 short traverse_dir(file_handle_i *directory, struct directory_traversal_handler* handler) {
   directory_traversal_options_t opts;
   memset(&opts, 0, sizeof(opts));
@@ -88,6 +159,7 @@ static short traverse_dir_internal(
   struct directory_traversal_handler* handler) {
 
   short keep_traversing = 1;
+  short handled = 0;
   file_handle_i* dir = directory;
   directory_entry_i* entry = 0;
 
@@ -95,7 +167,7 @@ static short traverse_dir_internal(
   memset(&handler_state, 0, sizeof(handler_state));
   handler_state.directory = dir;
   handler_state.first_entry = 1;
-  handler_state.history = state->history;
+  handler_state.root_length = state->root_length;
 
   while (!dir->is_eof(dir) && keep_traversing) {
     ERR_REGION_BEGIN() {
@@ -108,32 +180,39 @@ static short traverse_dir_internal(
 
       handler_state.entry = entry;
       handler_state.last_entry = dir->is_eof(dir);
-      ERR_REGION_NULL_CHECK_CODE(
-        handler_state.history->push(handler_state.history, entry->get_name(entry)),
+      ERR_REGION_ERROR_CHECK_CODE(
+        push_entry(&handler_state, &state->path, &state->parallel_path, entry->get_name(entry)),
         keep_traversing, 0);
 
-      if (!opts->post_visit && handler->visit) {
+      handled = is_handled(entry, opts);
+
+      if (!opts->post_visit && handler->visit && handled) {
         keep_traversing = handler->visit(handler, &handler_state);
       }
 
       if (should_traverse(entry) && keep_traversing && opts->should_descend) {
         file_handle_i* subdir = dir->open_directory(dir, entry->get_name(entry));
         if (subdir) {
+          filter_entries(subdir, opts);
           keep_traversing = traverse_dir_internal(subdir, opts, state, handler);
           subdir->close(subdir);
         }
+
+        // the longer names under it may have moved the paths
+        handler_state.path = state->path.buffer;
+        handler_state.parallel_path = state->parallel_path.buffer;
       }
 
-      if (opts->post_visit && handler->visit && keep_traversing) {
+      if (opts->post_visit && handler->visit && keep_traversing && handled) {
         keep_traversing = handler->visit(handler, &handler_state);
       }
 
-      if (handler->exit && keep_traversing) {
+      if (handler->exit && keep_traversing && handled) {
         keep_traversing = handler->exit(handler, &handler_state);
       }
 
-      handler_state.history->pop(handler_state.history);
-      handler_state.first_entry = 0;
+      pop_entry(&handler_state, &state->path, &state->parallel_path);
+      if (handled) handler_state.first_entry = 0;
 
     } ERR_REGION_END()
 
@@ -142,3 +221,576 @@ static short traverse_dir_internal(
 
   return keep_traversing;
 }
+
+// passes the directories the traversal goes down into, and whatever else
+// the options let reach the handler
+static short dt_filter(void const* context, char const* name, short is_directory) {
+  directory_traversal_options_t const* opts = (directory_traversal_options_t const*)context;
+  size_t name_len = 0;
+
+  if (is_directory) return opts->should_descend || !opts->files_only;
+  if (!opts->num_suffixes && !opts->num_patterns) return 1;
+
+  // the name is measured once, however many suffixes it is held to
+  name_len = strlen(name);
+  for (size_t i = 0; i < opts->num_suffixes; ++i) {
+    size_t suffix_len = strlen(opts->suffixes[i]);
+
+    if (suffix_len <= name_len
+      && memcmp(name + name_len - suffix_len, opts->suffixes[i], suffix_len) == 0) return 1;
+  }
+
+  for (size_t i = 0; i < opts->num_patterns; ++i) {
+    if (cstr_glob_matches(name, opts->patterns[i])) return 1;
+  }
+
+  return 0;
+}
+
+// without anything to filter on, the directory isn't given the filter to
+// call, and hands out everything
+static void filter_entries(file_handle_i* directory, struct directory_traversal_options const* opts) {
+  if (opts->files_only || opts->num_suffixes || opts->num_patterns) {
+    directory->set_entry_filter(directory, dt_filter, opts);
+  }
+}
+
+// a directory only read for what is under it isn't handed to the handler
+static short is_handled(directory_entry_i const* entry, struct directory_traversal_options const* opts) {
+  return !opts->files_only || !entry->is_directory(entry);
+}
+
+// without a root, the path isn't kept at all
+static errno_t path_init(dt_path_t* self, char const* root) {
+  size_t length = root ? strlen(root) : 0;
+
+  memset(self, 0, sizeof(*self));
+  if (!root) return 0;
+
+  self->buffer = malloc(length + 1);
+  if (!self->buffer) return -1;
+
+  memcpy(self->buffer, root, length + 1);
+  self->length = length;
+  self->capacity = length + 1;
+
+  return 0;
+}
+
+static void path_uninit(dt_path_t* self) {
+  SAFE_FREE(self->buffer);
+}
+
+static errno_t path_push(dt_path_t* self, char const* name) {
+  size_t name_len = strlen(name);
+  size_t needed = self->length + 1 + name_len + 1;
+
+  if (needed > self->capacity) {
+    size_t capacity = self->capacity * 2 > needed ? self->capacity * 2 : needed;
+    char* buffer = realloc(self->buffer, capacity);
+
+    if (!buffer) return -1;
+    self->buffer = buffer;
+    self->capacity = capacity;
+  }
+
+  self->buffer[self->length] = k_path_separator_char;
+  memcpy(self->buffer + self->length + 1, name, name_len + 1);
+  self->length += 1 + name_len;
+
+  return 0;
+}
+
+// names hold no separator, so the last one starts the last name
+static void path_pop(dt_path_t* self) {
+  while (self->length && self->buffer[--self->length] != k_path_separator_char);
+  self->buffer[self->length] = 0;
+}
+
+// the entry goes on the paths, which the handler sees.  the parallel path
+// is only kept when the handler has a root for it
+static errno_t push_entry(directory_traversal_handler_state_t* handler_state,
+  dt_path_t* path, dt_path_t* parallel_path, char const* name) {
+
+  if (path_push(path, name)) return -1;
+
+  // nothing stays pushed unless everything is
+  if (parallel_path->buffer && path_push(parallel_path, name)) {
+    path_pop(path);
+    return -1;
+  }
+
+  handler_state->path = path->buffer;
+  handler_state->parallel_path = parallel_path->buffer;
+
+  return 0;
+}
+
+static void pop_entry(directory_traversal_handler_state_t* handler_state,
+  dt_path_t* path, dt_path_t* parallel_path) {
+
+  path_pop(path);
+  if (parallel_path->buffer) path_pop(parallel_path);
+
+  handler_state->path = 0;
+  handler_state->parallel_path = 0;
+}
+
+//
+// parallel traversal
+//
+
+// a directory entry kept past the read of its directory, so that it can be
+// visited once everything under it is done
+typedef struct dt_entry {
+  directory_entry_i entry_i;
+  char const* name;  // owned
+} dt_entry_t;
+
+// a directory to read, taken by whichever thread is free
+typedef struct dt_task {
+  struct dt_task* parent;  // NULL for the root
+  file_handle_i* directory;  // owned but for the root, open until everything under it is done
+  dt_path_t path;  // of the directory, and then of each entry in turn as it is read
+  dt_path_t parallel_path;
+  dt_entry_t entry;  // the directory, as an entry of its parent
+  short first_entry;  // as it was visited in its parent
+  short last_entry;
+  size_t unfinished;  // guarded by the traversal lock.  1 until read, and 1 for each subdirectory not yet done
+} dt_task_t;
+
+// the tasks a thread queued.  it takes the newest itself, so that it works
+// depth first, and other threads steal the oldest, which tend to have the
+// most under them
+typedef struct dt_deque {
+  struct th_mutex* lock;  // owned
+  dt_task_t** tasks;  // owned
+  size_t first;  // the oldest
+  size_t end;  // past the newest
+  size_t capacity;
+} dt_deque_t;
+
+typedef struct dt_parallel {
+  struct directory_traversal_options const* opts;  // weak ref
+  struct directory_traversal_handler* handler;  // weak ref
+  dt_deque_t* deques;  // owned, one for each thread
+  size_t num_threads;
+  struct th_mutex* lock;  // owned, guards what follows, and the unfinished count of each task
+  struct th_cond* wake;  // owned, signalled when a task is queued, and once every one is done
+  size_t queued;  // tasks in the deques
+  size_t active;  // tasks queued or being read
+  short halted;  // a callback asked to stop, or something failed
+  size_t root_length;  // of the path of the directory traversed
+} dt_parallel_t;
+
+typedef struct dt_worker {
+  dt_parallel_t* parallel;  // weak ref
+  size_t index;  // of its deque
+  struct th_thread* thread;  // NULL for the calling thread
+} dt_worker_t;
+
+static short dt_entry_is_directory(directory_entry_i const* self) {
+  (void)self;
+  return 1;
+}
+
+static char const* dt_entry_get_name(directory_entry_i const* self_i) {
+  dt_entry_t const* self = (dt_entry_t const*)self_i->self;
+  return self->name;
+}
+
+static void dt_entry_release(directory_entry_i* self) {
+  // freed with its task
+  (void)self;
+}
+
+static dt_task_t* task_alloc(dt_task_t* parent, char const* name, short first_entry, short last_entry) {
+  errno_t err = 0;
+  dt_task_t* task = calloc(1, sizeof(*task));
+
+  if (!task) return NULL;
+
+  ERR_REGION_BEGIN() {
+    task->parent = parent;
+    task->first_entry = first_entry;
+    task->last_entry = last_entry;
+    task->unfinished = 1;
+
+    task->entry.entry_i.self = &task->entry;
+    task->entry.entry_i.is_directory = dt_entry_is_directory;
+    task->entry.entry_i.get_name = dt_entry_get_name;
+    task->entry.entry_i.release = dt_entry_release;
+    ERR_REGION_NULL_CHECK(task->entry.name = _strdup(name), err);
+
+    // each thread pushes and pops the names under its own directory
+    ERR_REGION_ERROR_CHECK(path_init(&task->path, parent->path.buffer), err);
+    ERR_REGION_ERROR_CHECK(path_push(&task->path, name), err);
+    ERR_REGION_ERROR_CHECK(path_init(&task->parallel_path, parent->parallel_path.buffer), err);
+    if (task->parallel_path.buffer) {
+      ERR_REGION_ERROR_CHECK(path_push(&task->parallel_path, name), err);
+    }
+
+  } ERR_REGION_END()
+
+  if (err) {
+    path_uninit(&task->parallel_path);
+    path_uninit(&task->path);
+    SAFE_FREE(task->entry.name);
+    SAFE_FREE(task);
+  }
+
+  return task;
+}
+
+static void task_free(dt_task_t* task) {
+  if (task->parent && task->directory) task->directory->close(task->directory);
+  path_uninit(&task->parallel_path);
+  path_uninit(&task->path);
+  SAFE_FREE(task->entry.name);
+  SAFE_FREE(task);
+}
+
+static errno_t deque_push(dt_deque_t* self, dt_task_t* task) {
+  errno_t err = 0;
+
+  th_mutex_lock(self->lock);
+
+  ERR_REGION_BEGIN() {
+    if (self->end == self->capacity && self->first) {
+      memmove(self->tasks, self->tasks + self->first, (self->end - self->first) * sizeof(*self->tasks));
+      self->end -= self->first;
+      self->first = 0;
+    }
+
+    if (self->end == self->capacity) {
+      size_t capacity = self->capacity ? self->capacity * 2 : 64;
+      dt_task_t** tasks = realloc(self->tasks, capacity * sizeof(*tasks));
+
+      ERR_REGION_NULL_CHECK(tasks, err);
+      self->tasks = tasks;
+      self->capacity = capacity;
+    }
+
+    self->tasks[self->end++] = task;
+
+  } ERR_REGION_END()
+
+  th_mutex_unlock(self->lock);
+
+  return err;
+}
+
+static dt_task_t* deque_take(dt_deque_t* self, short newest) {
+  dt_task_t* task = 0;
+
+  th_mutex_lock(self->lock);
+
+  if (self->first < self->end) {
+    task = newest ? self->tasks[--self->end] : self->tasks[self->first++];
+    if (self->first == self->end) self->first = self->end = 0;
+  }
+
+  th_mutex_unlock(self->lock);
+
+  return task;
+}
+
+static void halt(dt_parallel_t* self) {
+  th_mutex_lock(self->lock);
+  self->halted = 1;
+  th_mutex_unlock(self->lock);
+}
+
+static short is_halted(dt_parallel_t* self) {
+  short halted = 0;
+
+  th_mutex_lock(self->lock);
+  halted = self->halted;
+  th_mutex_unlock(self->lock);
+
+  return halted;
+}
+
+// counted before it is pushed, as another thread may take it, and even
+// finish it, as soon as it is
+static errno_t queue_task(dt_parallel_t* self, size_t index, dt_task_t* task) {
+  errno_t err = 0;
+
+  th_mutex_lock(self->lock);
+  ++self->queued;
+  ++self->active;
+  th_mutex_unlock(self->lock);
+
+  err = deque_push(self->deques + index, task);
+
+  th_mutex_lock(self->lock);
+  if (err) {
+    --self->queued;
+    if (!--self->active) th_cond_broadcast(self->wake);
+  }
+  else {
+    th_cond_signal(self->wake);
+  }
+  th_mutex_unlock(self->lock);
+
+  return err;
+}
+
+// the next task for the thread, its own newest or else the oldest of
+// another's.  NULL once every task is done
+static dt_task_t* take_task(dt_parallel_t* self, size_t index) {
+  dt_task_t* task = 0;
+
+  for (;;) {
+    for (size_t i = 0; i < self->num_threads && !task; ++i) {
+      size_t victim = (index + i) % self->num_threads;
+      task = deque_take(self->deques + victim, victim == index);
+    }
+
+    th_mutex_lock(self->lock);
+
+    if (task) {
+      --self->queued;
+      th_mutex_unlock(self->lock);
+
+      return task;
+    }
+
+    if (!self->active) {
+      th_mutex_unlock(self->lock);
+
+      return NULL;
+    }
+
+    // nothing to steal yet, though something is being read that may queue more
+    if (!self->queued) th_cond_wait(self->wake, self->lock);
+
+    th_mutex_unlock(self->lock);
+  }
+}
+
+// once everything under a directory is done, it is visited after, as
+// post_visit wants, and exited, from its parent, which is kept open until
+// then.  the parent may be done with it
+static void finish_task(dt_parallel_t* self, dt_task_t* task) {
+  directory_traversal_handler_i* handler = self->handler;
+  short keep_traversing = 1;
+  short done = 0;
+
+  while (task) {
+    dt_task_t* parent = task->parent;
+
+    th_mutex_lock(self->lock);
+    done = !--task->unfinished;
+    keep_traversing = !self->halted;
+    th_mutex_unlock(self->lock);
+
+    if (!done) return;
+
+    // nothing more is read from it, and it may be about to be deleted,
+    // as it is by delete_dir, so it is closed first as it is on one thread
+    if (parent && task->directory) {
+      task->directory->close(task->directory);
+      task->directory = 0;
+    }
+
+    if (parent && keep_traversing && !self->opts->files_only) {
+      directory_traversal_handler_state_t handler_state;
+      memset(&handler_state, 0, sizeof(handler_state));
+      handler_state.directory = parent->directory;
+      handler_state.entry = &task->entry.entry_i;
+      handler_state.first_entry = task->first_entry;
+      handler_state.last_entry = task->last_entry;
+      handler_state.path = task->path.buffer;
+      handler_state.root_length = self->root_length;
+      handler_state.parallel_path = task->parallel_path.buffer;
+
+      if (self->opts->post_visit && handler->visit) {
+        keep_traversing = handler->visit(handler, &handler_state);
+      }
+
+      if (handler->exit && keep_traversing) {
+        keep_traversing = handler->exit(handler, &handler_state);
+      }
+
+      if (!keep_traversing) halt(self);
+    }
+
+    task_free(task);
+    task = parent;
+  }
+}
+
+// reads the directory of a task, visiting its files and queuing its
+// subdirectories, as traverse_dir_internal does on one thread
+static void read_task(dt_parallel_t* self, size_t index, dt_task_t* task) {
+  directory_traversal_options_t const* opts = self->opts;
+  directory_traversal_handler_i* handler = self->handler;
+  short keep_traversing = !is_halted(self);
+  short handled = 0;
+  file_handle_i* dir = 0;
+  directory_entry_i* entry = 0;
+  dt_task_t* child = 0;
+
+  directory_traversal_handler_state_t handler_state;
+  memset(&handler_state, 0, sizeof(handler_state));
+  handler_state.first_entry = 1;
+  handler_state.root_length = self->root_length;
+
+  // the parent is still open, as this is under it
+  if (keep_traversing && task->parent) {
+    dt_task_t* parent = task->parent;
+    task->directory = parent->directory->open_directory(parent->directory, task->entry.name);
+    if (task->directory) filter_entries(task->directory, opts);
+  }
+
+  dir = task->directory;
+  handler_state.directory = dir;
+
+  while (dir && !dir->is_eof(dir) && keep_traversing) {
+    ERR_REGION_BEGIN() {
+      entry = dir->next_dir_entry(dir);
+      ERR_REGION_NULL_CHECK_CODE(entry, keep_traversing, 0);
+
+      if (!should_visit(entry)) {
+        ERR_REGION_EXIT()
+      }
+
+      handler_state.entry = entry;
+      handler_state.last_entry = dir->is_eof(dir);
+      ERR_REGION_ERROR_CHECK_CODE(
+        push_entry(&handler_state, &task->path, &task->parallel_path, entry->get_name(entry)),
+        keep_traversing, 0);
+
+      handled = is_handled(entry, opts);
+
+      if (!opts->post_visit && handler->visit && handled) {
+        keep_traversing = handler->visit(handler, &handler_state);
+      }
+
+      if (should_traverse(entry) && keep_traversing && opts->should_descend) {
+        // the rest of its visit waits on everything under it
+        pop_entry(&handler_state, &task->path, &task->parallel_path);
+
+        child = task_alloc(task, entry->get_name(entry), handler_state.first_entry, handler_state.last_entry);
+        ERR_REGION_NULL_CHECK_CODE(child, keep_traversing, 0);
+
+        th_mutex_lock(self->lock);
+        ++task->unfinished;
+        th_mutex_unlock(self->lock);
+
+        if (queue_task(self, index, child)) {
+          // dropped as though done, once halted so that it isn't visited
+          halt(self);
+          keep_traversing = 0;
+          finish_task(self, child);
+        }
+
+        child = 0;
+        if (handled) handler_state.first_entry = 0;
+        ERR_REGION_EXIT()
+      }
+
+      if (opts->post_visit && handler->visit && keep_traversing && handled) {
+        keep_traversing = handler->visit(handler, &handler_state);
+      }
+
+      if (handler->exit && keep_traversing && handled) {
+        keep_traversing = handler->exit(handler, &handler_state);
+      }
+
+      pop_entry(&handler_state, &task->path, &task->parallel_path);
+      if (handled) handler_state.first_entry = 0;
+
+    } ERR_REGION_END()
+
+    if (entry) entry->release(entry);
+    entry = 0;
+  }
+
+  if (!keep_traversing) halt(self);
+
+  finish_task(self, task);
+
+  th_mutex_lock(self->lock);
+  if (!--self->active) th_cond_broadcast(self->wake);
+  th_mutex_unlock(self->lock);
+}
+
+static void run_worker(void* arg) {
+  dt_worker_t* worker = (dt_worker_t*)arg;
+  dt_parallel_t* self = worker->parallel;
+  dt_task_t* task = 0;
+
+  while ((task = take_task(self, worker->index))) {
+    read_task(self, worker->index, task);
+  }
+}
+
+static short traverse_dir_parallel(
+  file_handle_i* directory,
+  struct directory_traversal_options const* opts,
+  struct directory_traversal_handler* handler) {
+
+  errno_t err = 0;
+  dt_parallel_t self;
+  dt_worker_t* workers = 0;
+  dt_task_t* root = 0;
+  size_t num_threads = (size_t)opts->threads;
+
+  memset(&self, 0, sizeof(self));
+  self.opts = opts;
+  self.handler = handler;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(self.lock = th_mutex_alloc(), err);
+    ERR_REGION_NULL_CHECK(self.wake = th_cond_alloc(), err);
+
+    ERR_REGION_NULL_CHECK(self.deques = calloc(num_threads, sizeof(*self.deques)), err);
+    for (; self.num_threads < num_threads; ++self.num_threads) {
+      ERR_REGION_NULL_CHECK(self.deques[self.num_threads].lock = th_mutex_alloc(), err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    ERR_REGION_NULL_CHECK(workers = calloc(num_threads, sizeof(*workers)), err);
+
+    // the root is the caller's, and has no parent to be visited from
+    ERR_REGION_NULL_CHECK(root = calloc(1, sizeof(*root)), err);
+    ERR_REGION_ERROR_CHECK(path_init(&root->path, directory->get_path(directory)), err);
+    self.root_length = root->path.length;
+    ERR_REGION_ERROR_CHECK(path_init(&root->parallel_path, handler->parallel_root), err);
+    root->directory = directory;
+    root->unfinished = 1;
+
+    ERR_REGION_ERROR_CHECK(queue_task(&self, 0, root), err);
+    root = 0;
+
+    // the calling thread works too, so any thread that can't start is
+    // just one fewer
+    for (size_t i = 0; i < num_threads; ++i) {
+      workers[i].parallel = &self;
+      workers[i].index = i;
+      if (i) workers[i].thread = th_thread_start(run_worker, workers + i);
+    }
+
+    run_worker(workers);
+
+    for (size_t i = 1; i < num_threads; ++i) {
+      if (workers[i].thread) th_thread_join(workers[i].thread);
+    }
+
+  } ERR_REGION_END()
+
+  if (root) task_free(root);
+
+  for (size_t i = 0; i < self.num_threads; ++i) {
+    SAFE_FREE(self.deques[i].tasks);
+    th_mutex_free(self.deques[i].lock);
+  }
+
+  SAFE_FREE(workers);
+  SAFE_FREE(self.deques);
+  SAFE_FREE_HANDLER(self.wake, th_cond_free);
+  SAFE_FREE_HANDLER(self.lock, th_mutex_free);
+
+  return !err && !self.halted;
+}
@@ -5,14 +5,41 @@
 struct directory_traversal_handler;
 struct file_handle;
 struct directory_traversal_options;
-struct string_vector;
+struct directory_traversal_handler_state;
 
 typedef struct directory_traversal_options {
   short should_descend;
   short post_visit;
+  // directories read at once, each subdirectory being queued for whichever
+  // thread is free.  1 or less reads them depth first on the calling thread.
+  // with more, the handler is called from several threads at once, and
+  // entries come in no set order, except that a directory is visited before
+  // anything under it, or after when post_visit, and exited after both
+  int threads;
+  // directories aren't handed to the handler, though they are still
+  // descended into
+  short files_only;
+  // when either is given, only files whose names end with one of the
+  // suffixes, or match one of the patterns as cstr_glob_matches has it,
+  // reach the handler.  directories aren't held to them.  all of this is
+  // checked as each directory is read, so what doesn't pass costs nothing
+  // more than its read
+  char const* const* suffixes;  // weak ref
+  size_t num_suffixes;
+  char const* const* patterns;  // weak ref
+  size_t num_patterns;
 } directory_traversal_options_t;
 
 short traverse_dir(struct file_handle* directory, struct directory_traversal_handler *handler);
 short traverse_dir_opts(struct file_handle* directory, struct directory_traversal_options const *opts, struct directory_traversal_handler* handler);
 short traverse_dir_path(char const *path, struct directory_traversal_handler *handler);
 short traverse_dir_path_opts(char const* path, struct directory_traversal_options const* opts, struct directory_traversal_handler* handler);
+
+// the names from the directory traversed down to the entry of a handler
+// call, the entry's included, are read from its path rather than kept aside
+size_t traversal_depth(struct directory_traversal_handler_state const* state);
+// the name at depth, 0 being directly under the directory traversed, runs
+// from *start up to *end in state->path, and is only good while it is.
+// false past the entry
+short traversal_name(struct directory_traversal_handler_state const* state, size_t depth,
+  char const** start, char const** end);
@@ -1,8 +1,9 @@
 #pragma once
 
+#include <stddef.h>
+
 struct file_handle;
 struct directory_entry;
-struct string_vector;
 struct directory_traversal_handler;
 struct directory_traversal_handler_state;
 
@@ -10,12 +11,21 @@ typedef short (*directory_traversal_callback)(
   struct directory_traversal_handler* self,
   struct directory_traversal_handler_state const* state);
 
+// in a traversal of several threads, the state belongs to the calling
+// thread, but the directory may be read by another, so it may only be
+// asked its path
 typedef struct directory_traversal_handler_state {
   struct file_handle* directory;
   struct directory_entry* entry;
   short first_entry;
   short last_entry;
-  struct string_vector* history;
+  // the entry's path, under the directory traversed, and under the handler's
+  // parallel root when it has one.  both are only good during the call
+  char const* path;
+  char const* parallel_path;
+  // where the names under the directory traversed start in path, which
+  // traversal_name reads them from
+  size_t root_length;
 } directory_traversal_handler_state_t;
 
 typedef struct directory_traversal_handler {
@@ -23,4 +33,6 @@ typedef struct directory_traversal_handler {
   // return true to continue traversal, or false to halt
   directory_traversal_callback visit;
   directory_traversal_callback exit;
+  // weak ref, where parallel paths are rooted, or NULL for none
+  char const* parallel_root;
 } directory_traversal_handler_i;
\ No newline at end of file
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stddef.h>
+
+struct directory_watch;
+struct string_vector;
+
+typedef struct directory_watch directory_watch_t;
+
+// watches a directory and everything under it, including directories made
+// after the watch was opened.  NULL where the platform has no way to watch
+struct directory_watch* directory_watch_open(char const* root);
+void directory_watch_close(struct directory_watch* self);
+
+// waits up to milliseconds for something under the root to change.  adds
+// to files the path of each file made, written to or moved in, and to dirs
+// each directory made or moved in, since its contents may never be seen
+// one by one.  changes the watch missed, such as when too many came at
+// once, add the root to dirs.  paths may repeat.  a wait that times out
+// adds nothing, and isn't an error
+errno_t directory_watch_wait(struct directory_watch* self, unsigned long milliseconds,
+  struct string_vector* files, struct string_vector* dirs);
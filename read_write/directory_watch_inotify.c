@@ -0,0 +1,238 @@
+#include "directory_watch.h"
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "err_helpers.h"
+#include "mem_helpers.h"
+#include "path.h"
+#include "filesystem.h"
+#include "string_vector.h"
+
+// a file is reported once it is closed after writing, or moved in whole.
+// writes are also reported as they happen, so that a file still being
+// copied keeps its directory from settling
+#define WATCH_MASK (IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR)
+
+// enough for a good many changes at once, however long their names
+#define WATCH_BUFFER_SIZE (64 * 1024)
+
+// inotify watches single directories, so one is added for each under the
+// root, and for each made later on
+typedef struct directory_watch {
+  char const* root;  // owned
+  int fd;
+  int* wds;  // owned, the watch of each directory
+  struct string_vector* paths;  // owned, the directory each watch is on
+  size_t capacity;  // of wds
+  char* buffer;  // owned
+} directory_watch_t;
+
+static errno_t add_tree(directory_watch_t* self, char const* path);
+static errno_t add_one(directory_watch_t* self, char const* path);
+static short find_watch(directory_watch_t const* self, int wd, size_t* index);
+static errno_t add_change(directory_watch_t* self, struct inotify_event const* event,
+  struct string_vector* files, struct string_vector* dirs);
+
+struct directory_watch* directory_watch_open(char const* root) {
+  errno_t err = 0;
+  directory_watch_t* self = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(self = calloc(1, sizeof(*self)), err);
+    self->fd = -1;
+
+    ERR_REGION_NULL_CHECK(self->root = _strdup(root), err);
+    ERR_REGION_NULL_CHECK(self->paths = string_vector_alloc(), err);
+    ERR_REGION_NULL_CHECK(self->buffer = malloc(WATCH_BUFFER_SIZE), err);
+
+    self->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    ERR_REGION_CMP_CHECK(self->fd < 0, err);
+
+    ERR_REGION_ERROR_CHECK(add_tree(self, root), err);
+
+  } ERR_REGION_END()
+
+  if (err) SAFE_FREE_HANDLER(self, directory_watch_close);
+
+  return self;
+}
+
+void directory_watch_close(struct directory_watch* self) {
+  // closing the descriptor removes every watch on it
+  if (self->fd >= 0) close(self->fd);
+  SAFE_FREE(self->buffer);
+  SAFE_FREE_HANDLER(self->paths, string_vector_free);
+  SAFE_FREE(self->wds);
+  SAFE_FREE(self->root);
+  SAFE_FREE(self);
+}
+
+errno_t directory_watch_wait(struct directory_watch* self, unsigned long milliseconds,
+  struct string_vector* files, struct string_vector* dirs) {
+
+  errno_t err = 0;
+  struct pollfd poll_fd = { self->fd, POLLIN, 0 };
+  ssize_t bytes = 0;
+  int ready = 0;
+
+  ERR_REGION_BEGIN() {
+    ready = poll(&poll_fd, 1, (int)milliseconds);
+    ERR_REGION_CMP_EXIT(ready < 0 && errno == EINTR);
+    ERR_REGION_CMP_CHECK(ready < 0, err);
+    ERR_REGION_CMP_EXIT(!ready);
+
+    // everything already queued is read, a buffer at a time
+    while ((bytes = read(self->fd, self->buffer, WATCH_BUFFER_SIZE)) > 0) {
+      for (char const* at = self->buffer; at < self->buffer + bytes; ) {
+        struct inotify_event const* event = (struct inotify_event const*)at;
+
+        ERR_REGION_ERROR_CHECK(add_change(self, event, files, dirs), err);
+        at += sizeof(*event) + event->len;
+      } ERR_REGION_ERROR_BUBBLE(err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    ERR_REGION_CMP_CHECK(bytes < 0 && errno != EAGAIN && errno != EINTR, err);
+
+  } ERR_REGION_END()
+
+  return err;
+}
+
+static errno_t add_tree(directory_watch_t* self, char const* path) {
+  errno_t err = 0;
+  file_handle_i* dir = 0;
+  directory_entry_i* entry = 0;
+  char const* sub_path = 0;
+
+  ERR_REGION_BEGIN() {
+    // watched before it is listed, so nothing made in between is missed
+    ERR_REGION_ERROR_CHECK(add_one(self, path), err);
+
+    // gone again already
+    ERR_REGION_NULL_EXIT(dir = open_dir(path));
+
+    while (!dir->is_eof(dir)) {
+      entry = dir->next_dir_entry(dir);
+      if (!entry) continue;
+
+      if (entry->is_directory(entry)) {
+        ERR_REGION_NULL_CHECK(sub_path = join_dir_file_path(path, entry->get_name(entry)), err);
+        ERR_REGION_ERROR_CHECK(add_tree(self, sub_path), err);
+        SAFE_FREE(sub_path);
+      }
+
+      entry->release(entry);
+      entry = 0;
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+  } ERR_REGION_END()
+
+  if (entry) entry->release(entry);
+  if (dir) dir->close(dir);
+  SAFE_FREE(sub_path);
+
+  return err;
+}
+
+static errno_t add_one(directory_watch_t* self, char const* path) {
+  errno_t err = 0;
+  size_t index = 0;
+  int wd = 0;
+
+  ERR_REGION_BEGIN() {
+    wd = inotify_add_watch(self->fd, path, WATCH_MASK);
+
+    // gone again already, or not a directory after all
+    ERR_REGION_CMP_EXIT(wd < 0 && (errno == ENOENT || errno == ENOTDIR));
+    ERR_REGION_CMP_CHECK(wd < 0, err);
+
+    // a directory moved within the tree keeps its watch, under a new name
+    if (find_watch(self, wd, &index)) {
+      ERR_REGION_ERROR_CHECK(self->paths->delete_at(self->paths, index), err);
+      memmove(self->wds + index, self->wds + index + 1,
+        (self->paths->get_length(self->paths) - index) * sizeof(*self->wds));
+    }
+
+    if (self->paths->get_length(self->paths) == self->capacity) {
+      size_t capacity = self->capacity ? self->capacity * 2 : 64;
+      int* wds = realloc(self->wds, capacity * sizeof(*wds));
+
+      ERR_REGION_NULL_CHECK(wds, err);
+      self->wds = wds;
+      self->capacity = capacity;
+    }
+
+    self->wds[self->paths->get_length(self->paths)] = wd;
+    ERR_REGION_NULL_CHECK(self->paths->push(self->paths, path), err);
+
+  } ERR_REGION_END()
+
+  return err;
+}
+
+static short find_watch(directory_watch_t const* self, int wd, size_t* index) {
+  for (size_t i = 0; i < self->paths->get_length(self->paths); ++i) {
+    if (self->wds[i] == wd) {
+      *index = i;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+static errno_t add_change(directory_watch_t* self, struct inotify_event const* event,
+  struct string_vector* files, struct string_vector* dirs) {
+
+  errno_t err = 0;
+  size_t index = 0;
+  char const* path = 0;
+
+  ERR_REGION_BEGIN() {
+    // changes were dropped, so which is unknown
+    if (event->mask & IN_Q_OVERFLOW) {
+      ERR_REGION_NULL_CHECK(dirs->push(dirs, self->root), err);
+      ERR_REGION_EXIT();
+    }
+
+    ERR_REGION_CMP_EXIT(!find_watch(self, event->wd, &index));
+
+    // the directory went away, and its watch with it
+    if (event->mask & IN_IGNORED) {
+      ERR_REGION_ERROR_CHECK(self->paths->delete_at(self->paths, index), err);
+      memmove(self->wds + index, self->wds + index + 1,
+        (self->paths->get_length(self->paths) - index) * sizeof(*self->wds));
+      ERR_REGION_EXIT();
+    }
+
+    ERR_REGION_CMP_EXIT(!event->len);
+
+    ERR_REGION_NULL_CHECK(path = join_dir_file_path(
+      self->paths->get(self->paths, index), event->name), err);
+
+    if (event->mask & IN_ISDIR) {
+      // writes within a directory are reported by its own watch
+      ERR_REGION_CMP_EXIT(!(event->mask & (IN_CREATE | IN_MOVED_TO)));
+
+      ERR_REGION_ERROR_CHECK(add_tree(self, path), err);
+      ERR_REGION_NULL_CHECK(dirs->push(dirs, path), err);
+    }
+    else {
+      ERR_REGION_NULL_CHECK(files->push(files, path), err);
+    }
+
+  } ERR_REGION_END()
+
+  SAFE_FREE(path);
+
+  return err;
+}
+
+#endif
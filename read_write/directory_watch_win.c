@@ -0,0 +1,225 @@
+#include "directory_watch.h"
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+
+#include <Windows.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "err_helpers.h"
+#include "mem_helpers.h"
+#include "path.h"
+#include "string_vector.h"
+
+// changes are read in batches of at most this many bytes, which is as much
+// as a watch over the network can take
+#define WATCH_BUFFER_SIZE (64 * 1024)
+
+#define WATCH_FILTER (FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME \
+  | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE)
+
+typedef struct directory_watch {
+  char const* root;  // owned
+  wchar_t* root_w;  // owned
+  HANDLE dir;
+  OVERLAPPED overlapped;  // its event is owned
+  DWORD* buffer;  // owned, DWORD aligned, as the changes must be
+  short pending;  // a read was issued and hasn't completed
+} directory_watch_t;
+
+static errno_t issue_read(directory_watch_t* self);
+static errno_t add_change(directory_watch_t* self, FILE_NOTIFY_INFORMATION const* info,
+  struct string_vector* files, struct string_vector* dirs);
+static wchar_t* widen(char const* path);
+static char* narrow(wchar_t const* path, size_t length);
+
+struct directory_watch* directory_watch_open(char const* root) {
+  errno_t err = 0;
+  directory_watch_t* self = 0;
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(self = calloc(1, sizeof(*self)), err);
+    self->dir = INVALID_HANDLE_VALUE;
+
+    ERR_REGION_NULL_CHECK(self->root = _strdup(root), err);
+    ERR_REGION_NULL_CHECK(self->root_w = widen(root), err);
+    ERR_REGION_NULL_CHECK(self->buffer = malloc(WATCH_BUFFER_SIZE), err);
+    ERR_REGION_NULL_CHECK(self->overlapped.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL), err);
+
+    self->dir = CreateFileW(self->root_w, FILE_LIST_DIRECTORY,
+      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+      FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+    ERR_REGION_CMP_CHECK(self->dir == INVALID_HANDLE_VALUE, err);
+
+    // changes made from here on are kept by the system until read
+    ERR_REGION_ERROR_CHECK(issue_read(self), err);
+
+    return self;
+
+  } ERR_REGION_END()
+
+  if (self) directory_watch_close(self);
+
+  return NULL;
+}
+
+void directory_watch_close(struct directory_watch* self) {
+  if (self->pending) {
+    DWORD bytes = 0;
+
+    CancelIoEx(self->dir, &self->overlapped);
+    GetOverlappedResult(self->dir, &self->overlapped, &bytes, TRUE);
+  }
+
+  if (self->dir != INVALID_HANDLE_VALUE) CloseHandle(self->dir);
+  if (self->overlapped.hEvent) CloseHandle(self->overlapped.hEvent);
+  SAFE_FREE(self->buffer);
+  SAFE_FREE(self->root_w);
+  SAFE_FREE(self->root);
+  SAFE_FREE(self);
+}
+
+errno_t directory_watch_wait(struct directory_watch* self, unsigned long milliseconds,
+  struct string_vector* files, struct string_vector* dirs) {
+
+  errno_t err = 0;
+  DWORD bytes = 0;
+  unsigned char const* change = 0;
+
+  ERR_REGION_BEGIN() {
+    if (!self->pending) {
+      ERR_REGION_ERROR_CHECK(issue_read(self), err);
+    }
+
+    ERR_REGION_CMP_EXIT(WaitForSingleObject(self->overlapped.hEvent, milliseconds) == WAIT_TIMEOUT);
+
+    self->pending = 0;
+    ERR_REGION_CMP_CHECK(!GetOverlappedResult(self->dir, &self->overlapped, &bytes, FALSE)
+      && GetLastError() != ERROR_NOTIFY_ENUM_DIR, err);
+
+    // more changed than the buffer could hold, so which is unknown
+    if (!bytes) {
+      ERR_REGION_NULL_CHECK(dirs->push(dirs, self->root), err);
+      ERR_REGION_EXIT();
+    }
+
+    change = (unsigned char const*)self->buffer;
+    for (;;) {
+      FILE_NOTIFY_INFORMATION const* info = (FILE_NOTIFY_INFORMATION const*)change;
+
+      ERR_REGION_ERROR_CHECK(add_change(self, info, files, dirs), err);
+
+      if (!info->NextEntryOffset) break;
+      change += info->NextEntryOffset;
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    // the next batch is gathered while this one is handled
+    ERR_REGION_ERROR_CHECK(issue_read(self), err);
+
+  } ERR_REGION_END()
+
+  return err;
+}
+
+static errno_t issue_read(directory_watch_t* self) {
+  ResetEvent(self->overlapped.hEvent);
+
+  if (!ReadDirectoryChangesW(self->dir, self->buffer, WATCH_BUFFER_SIZE, TRUE,
+    WATCH_FILTER, NULL, &self->overlapped, NULL)) {
+    return -1;
+  }
+
+  self->pending = 1;
+
+  return 0;
+}
+
+static errno_t add_change(directory_watch_t* self, FILE_NOTIFY_INFORMATION const* info,
+  struct string_vector* files, struct string_vector* dirs) {
+
+  errno_t err = 0;
+  char const* name = 0;
+  char const* path = 0;
+  wchar_t* path_w = 0;
+  size_t root_len = wcslen(self->root_w);
+  size_t name_len = info->FileNameLength / sizeof(wchar_t);
+  DWORD attributes = 0;
+
+  // a name that went away leaves nothing to convert
+  if (info->Action == FILE_ACTION_REMOVED || info->Action == FILE_ACTION_RENAMED_OLD_NAME) {
+    return err;
+  }
+
+  ERR_REGION_BEGIN() {
+    ERR_REGION_NULL_CHECK(name = narrow(info->FileName, name_len), err);
+    ERR_REGION_NULL_CHECK(path = join_dir_file_path(self->root, name), err);
+
+    ERR_REGION_NULL_CHECK(path_w = malloc((root_len + 1 + name_len + 1) * sizeof(wchar_t)), err);
+    wmemcpy(path_w, self->root_w, root_len);
+    path_w[root_len] = L'\\';
+    wmemcpy(path_w + root_len + 1, info->FileName, name_len);
+    path_w[root_len + 1 + name_len] = 0;
+
+    // gone again already, as with a part file moved into place
+    attributes = GetFileAttributesW(path_w);
+    ERR_REGION_CMP_EXIT(attributes == INVALID_FILE_ATTRIBUTES);
+
+    if (attributes & FILE_ATTRIBUTE_DIRECTORY) {
+      // a directory is modified by whatever happens in it, which is
+      // reported on its own
+      if (info->Action != FILE_ACTION_MODIFIED) {
+        ERR_REGION_NULL_CHECK(dirs->push(dirs, path), err);
+      }
+    }
+    else {
+      ERR_REGION_NULL_CHECK(files->push(files, path), err);
+    }
+
+  } ERR_REGION_END()
+
+  SAFE_FREE(path_w);
+  SAFE_FREE(path);
+  SAFE_FREE(name);
+
+  return err;
+}
+
+static wchar_t* widen(char const* path) {
+  wchar_t* path_w = NULL;
+  int length = MultiByteToWideChar(CP_UTF8, 0, path, -1, NULL, 0);
+
+  if (!length) return NULL;
+
+  path_w = malloc(length * sizeof(wchar_t));
+  if (!path_w) return NULL;
+
+  if (!MultiByteToWideChar(CP_UTF8, 0, path, -1, path_w, length)) {
+    SAFE_FREE(path_w);
+  }
+
+  return path_w;
+}
+
+// the names of changes aren't terminated
+static char* narrow(wchar_t const* path, size_t length) {
+  char* path_n = NULL;
+  int size = WideCharToMultiByte(CP_UTF8, 0, path, (int)length, NULL, 0, NULL, NULL);
+
+  if (!size && length) return NULL;
+
+  path_n = malloc(size + 1);
+  if (!path_n) return NULL;
+
+  if (length && !WideCharToMultiByte(CP_UTF8, 0, path, (int)length, path_n, size, NULL, NULL)) {
+    SAFE_FREE(path_n);
+    return NULL;
+  }
+
+  path_n[size] = 0;
+
+  return path_n;
+}
+
+#endif
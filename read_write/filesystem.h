@@ -5,6 +5,27 @@
 struct file_handle;
 struct directory_entry;
 
+// how copy_file_as makes its copy
+typedef enum copy_strategy {
+  EWC_CS_AUTO = 0,  // the cheapest copy the filesystem offers, sharing src's blocks where it can
+  EWC_CS_COPY,  // every byte written again, into blocks of dst's own
+  EWC_CS_LINK,  // another name for src, or a copy where the filesystem can't link
+  EWC_CS_LAST,
+} copy_strategy_t;
+
+// how the copies made so far were made, counted across every thread, so
+// that callers can tell whether the cheap ways are being taken
+typedef struct copy_counts {
+  unsigned long long linked;  // another name for src
+  unsigned long long shared;  // dst shares src's blocks
+  unsigned long long by_system;  // the system moved the bytes, never passing them through here
+  unsigned long long buffered;  // read in and written out again here
+} copy_counts_t;
+
+// whether an entry is handed out, decided from its name and type as the
+// directory is read, before anything is made of it
+typedef short (*directory_entry_filter)(void const* context, char const* name, short is_directory);
+
 typedef struct file_handle {
   void *self;
   short (*is_eof)(struct file_handle const* self);
@@ -12,6 +33,10 @@ typedef struct file_handle {
   struct directory_entry *(*next_dir_entry)(struct file_handle* self);
   struct file_handle *(*open_directory)(struct file_handle const *self, char const *path);
   char const* (*get_path)(struct file_handle const* self);
+  // entries from here on are only handed out if filter passes them, and
+  // the directory ends after the last that does.  NULL passes everything.
+  // directories opened from this one don't inherit it
+  void (*set_entry_filter)(struct file_handle* self, directory_entry_filter filter, void const* context);
 } file_handle_i;
 
 typedef struct directory_entry {
@@ -25,12 +50,63 @@ file_handle_i* open_dir(char const* path);
 errno_t delete_file(char const* path);
 errno_t delete_dir(char const* path);
 errno_t ensure_dir(char const* path);
+// creates a single directory, whose parent must already exist.  succeeds
+// if the directory is already there
+errno_t make_dir(char const* path);
 short file_exists(char const* path);
+errno_t file_size(char const* path, unsigned long long* size);
+// last write time, in units that only mean something compared to each other
+errno_t file_mtime(char const* path, unsigned long long* mtime);
+// copies src over any dst, keeping src's time.  the copy only replaces dst
+// once whole, so one that fails leaves any dst as it was
 errno_t copy_file(char const* src, char const* dst);
+// copies as copy_file does, and hashes the content, giving the same value
+// hash_file would.  bytes that pass through here are hashed on the way,
+// and where the system copies them, src is hashed after from the cache
+errno_t copy_file_hashed(char const* src, char const* dst, unsigned long long* hash);
+// copies as strategy says, keeping src's time as copy_file does.  hashes
+// the content as copy_file_hashed does, unless hash is NULL.  a link only
+// replaces no existing dst, so copies over one instead
+errno_t copy_file_as(char const* src, char const* dst, copy_strategy_t strategy, unsigned long long* hash);
+// makes dst another name for src.  fails where the filesystem can't, such
+// as across volumes, so callers fall back to copying
+errno_t link_file(char const* src, char const* dst);
+// fails rather than replace an existing dst
+errno_t rename_file(char const* src, char const* dst);
+// moves src over dst, replacing any file already there.  dst is never
+// seen part written, it is either the old file or all of the new one
+errno_t replace_file(char const* src, char const* dst);
+// returns once everything written to the file has reached the disk
+errno_t sync_file(char const* path);
+// creates path holding bytes, unless anything is already there.  of any
+// number of processes racing to create it, only one is told it created it
+errno_t create_file_exclusive(char const* path, void const* bytes, size_t length, short* created);
+// sets the last write time of the file to now
+errno_t touch_file(char const* path);
 errno_t copy_dir(char const* src, char const* dst);
+// maps the whole of a file into memory, read only.  the view stays valid,
+// even with the file closed, until it is unmapped.  an empty file can't
+// be mapped
+errno_t map_file(char const* path, void const** view, size_t* size);
+void unmap_file(void const* view, size_t size);
+// the copies made so far by this process
+void copy_counts_get(copy_counts_t* counts);
 
 extern const char k_path_separator[];
 extern const char k_path_separator_char;
 
+// k_path_separator as a literal, for paths spelled out in the code
+#ifdef _WIN32
+#define PATH_SEPARATOR "\\"
+#else
+#define PATH_SEPARATOR "/"
+#endif
+
 extern const char k_ext_separator[];
 extern const char k_ext_separator_char;
+
+// whether names differing only in case name the same file
+extern const short k_path_ignores_case;
+
+// file_mtime units in a second
+extern const unsigned long long k_file_mtime_ticks_per_second;
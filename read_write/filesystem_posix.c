@@ -0,0 +1,649 @@
+#include "filesystem_shared.h"
+
+#ifndef _WIN32
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "mem_helpers.h"
+#include "string_helpers.h"
+#include "path.h"
+#include "err_helpers.h"
+#include "hash_helpers.h"
+#include "format_helpers.h"
+#include "thread_helpers.h"
+
+#define PATH_SEPARATOR_CHAR '/'
+const char k_path_separator_char = PATH_SEPARATOR_CHAR;
+const char k_path_separator[] = { PATH_SEPARATOR_CHAR, 0 };
+
+#define EXT_SEPARATOR_CHAR '.'
+const char k_ext_separator_char = EXT_SEPARATOR_CHAR;
+const char k_ext_separator[] = { EXT_SEPARATOR_CHAR, 0 };
+
+const short k_path_ignores_case = 0;
+
+// last write times count nanoseconds
+const unsigned long long k_file_mtime_ticks_per_second = 1000000000;
+
+// from linux/fs.h, which glibc only offers with _GNU_SOURCE, and that
+// brings a struct file_handle of its own
+#ifndef RENAME_NOREPLACE
+#define RENAME_NOREPLACE (1 << 0)
+#endif
+
+// also from linux/fs.h, makes a file share all of another's blocks
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+
+// entries are read from the kernel a block at a time, so even a large
+// directory takes few calls
+#define DIR_BLOCK_SIZE (32 * 1024)
+
+// as getdents64 fills the block
+typedef struct fs_dirent {
+  unsigned long long d_ino;
+  long long d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+} fs_dirent_t;
+
+typedef struct fs_directory_entry {
+  directory_entry_i entry_i;
+  char name[NAME_MAX + 1];  // copied out of the block, which the next read reuses
+  short is_directory;
+} fs_directory_entry_t;
+
+// a directory is read straight into the handle, and each entry handed out
+// is the one the handle holds, so reading an entry allocates nothing.  an
+// entry stays valid until the next is read or the handle is closed
+typedef struct fs_file_handle {
+  file_handle_i handle_i;
+  int fd;
+  char const* path;  // owned
+  fs_directory_entry_t entry;
+  size_t block_length;
+  size_t block_offset;
+  fs_dirent_t const* next;  // read ahead, so the end is known before it's reached, NULL there
+  short next_is_directory;
+  directory_entry_filter filter;  // NULL for none
+  void const* filter_context;  // weak ref
+  unsigned long long block[DIR_BLOCK_SIZE / sizeof(unsigned long long)];  // aligned as entries need
+} fs_file_handle_t;
+
+static file_handle_i* fs_open_fd(int fd, char const* path);
+static void fs_read_ahead(fs_file_handle_t* self);
+static short fs_dirent_is_directory(fs_file_handle_t const* self, fs_dirent_t const* dirent);
+static short fs_is_eof(file_handle_i const* self);
+static void fs_close_dir(file_handle_i* handle);
+static directory_entry_i* fs_next_dir_entry(file_handle_i* handle);
+static file_handle_i* fs_open_directory(file_handle_i const* handle, char const *path);
+static char const* fs_get_path(file_handle_i const* handle);
+static void fs_set_entry_filter(file_handle_i* handle, directory_entry_filter filter, void const* context);
+
+static short fs_is_directory(struct directory_entry const* self);
+static char const* fs_get_name(struct directory_entry const* self);
+static void fs_release(struct directory_entry* self);
+
+static char* copy_temp_path(char const* dst);
+static errno_t copy_contents(char const* src, char const* dst, copy_strategy_t strategy, hash_state_t* state);
+static errno_t copy_in_kernel(int src_fd, int dst_fd, short* copied);
+static errno_t hash_contents(int fd, hash_state_t* state);
+static errno_t write_all(int fd, void const* bytes, size_t length);
+
+file_handle_i* open_dir(char const* path) {
+  int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) return NULL;
+
+  return fs_open_fd(fd, path);
+}
+
+// takes ownership of fd
+static file_handle_i* fs_open_fd(int fd, char const* path) {
+  errno_t err = 0;
+  fs_file_handle_t* result = NULL;
+  char* path_duplicate = 0;
+
+  ERR_REGION_BEGIN() {
+    path_duplicate = strdup(path);
+    ERR_REGION_NULL_CHECK(path_duplicate, err);
+
+    result = calloc(1, sizeof(fs_file_handle_t));
+    ERR_REGION_NULL_CHECK(result, err);
+
+    result->handle_i.self = result;
+    result->handle_i.is_eof = fs_is_eof;
+    result->handle_i.close = fs_close_dir;
+    result->handle_i.next_dir_entry = fs_next_dir_entry;
+    result->handle_i.open_directory = fs_open_directory;
+    result->handle_i.get_path = fs_get_path;
+    result->handle_i.set_entry_filter = fs_set_entry_filter;
+
+    result->entry.entry_i.self = &result->entry;
+    result->entry.entry_i.is_directory = fs_is_directory;
+    result->entry.entry_i.get_name = fs_get_name;
+    result->entry.entry_i.release = fs_release;
+
+    result->fd = fd;
+    result->path = path_duplicate;
+
+    // unset state values that shouldn't be cleaned up
+    fd = -1;
+    path_duplicate = NULL;
+
+    fs_read_ahead(result);
+
+  } ERR_REGION_END()
+
+  if (fd >= 0) close(fd);
+  SAFE_FREE(path_duplicate);
+
+  return err ? NULL : &result->handle_i;
+}
+
+// . and .. are never handed out, as nothing wants them, nor is anything
+// the filter doesn't pass
+static void fs_read_ahead(fs_file_handle_t* self) {
+  char const* block = (char const*)self->block;
+
+  for (;;) {
+    if (self->block_offset >= self->block_length) {
+      long read = syscall(SYS_getdents64, self->fd, self->block, sizeof(self->block));
+
+      // a directory that can't be read any further ends there
+      if (read <= 0) {
+        self->next = NULL;
+        return;
+      }
+
+      self->block_length = (size_t)read;
+      self->block_offset = 0;
+    }
+
+    self->next = (fs_dirent_t const*)(block + self->block_offset);
+    self->block_offset += self->next->d_reclen;
+
+    if (strcmp(self->next->d_name, ".") == 0 || strcmp(self->next->d_name, "..") == 0) continue;
+
+    self->next_is_directory = fs_dirent_is_directory(self, self->next);
+
+    if (!self->filter || self->filter(self->filter_context, self->next->d_name, self->next_is_directory)) return;
+  }
+}
+
+// the type comes with the name, except on filesystems that don't keep
+// it.  a link is never a directory, so a traversal can't be led round in
+// circles, nor a delete out of the tree
+static short fs_dirent_is_directory(fs_file_handle_t const* self, fs_dirent_t const* dirent) {
+  struct stat st;
+
+  switch (dirent->d_type) {
+    case DT_DIR:
+      return 1;
+
+    case DT_UNKNOWN:
+      return !fstatat(self->fd, dirent->d_name, &st, AT_SYMLINK_NOFOLLOW) && S_ISDIR(st.st_mode);
+
+    default:
+      return 0;
+  }
+}
+
+static void fs_close_dir(file_handle_i* handle) {
+  fs_file_handle_t *self = (fs_file_handle_t*)handle->self;
+  close(self->fd);
+  free((void*)self->path);
+  free(self);
+}
+
+static short fs_is_eof(file_handle_i const* handle) {
+  fs_file_handle_t const* self = (fs_file_handle_t const*)handle->self;
+  return !self->next;
+}
+
+static directory_entry_i* fs_next_dir_entry(file_handle_i* handle) {
+  fs_file_handle_t* self = (fs_file_handle_t*)handle->self;
+  fs_dirent_t const* next = self->next;
+
+  if (!next) return NULL;
+
+  strcpy(self->entry.name, next->d_name);
+  self->entry.is_directory = self->next_is_directory;
+
+  fs_read_ahead(self);
+
+  return &self->entry.entry_i;
+}
+
+// opened relative to the directory already open, so the path isn't
+// looked up again from the root for every level
+static file_handle_i* fs_open_directory(file_handle_i const* handle, char const* path) {
+  fs_file_handle_t const *self = (fs_file_handle_t const*)handle->self;
+  file_handle_i* new_handle = NULL;
+  int fd = -1;
+
+  char const *new_path = join_dir_file_path(self->path, path);
+  if (! new_path) return NULL;
+
+  fd = openat(self->fd, path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd >= 0) new_handle = fs_open_fd(fd, new_path);
+
+  SAFE_FREE(new_path);
+
+  return new_handle;
+}
+
+static char const* fs_get_path(file_handle_i const* handle) {
+  fs_file_handle_t const* self = (fs_file_handle_t const*)handle->self;
+  return self->path;
+}
+
+// the entry already read ahead is held to the filter too
+static void fs_set_entry_filter(file_handle_i* handle, directory_entry_filter filter, void const* context) {
+  fs_file_handle_t* self = (fs_file_handle_t*)handle->self;
+
+  self->filter = filter;
+  self->filter_context = context;
+
+  if (self->next && filter && !filter(context, self->next->d_name, self->next_is_directory)) {
+    fs_read_ahead(self);
+  }
+}
+
+static short fs_is_directory(directory_entry_i const* entry) {
+  fs_directory_entry_t const* self = (fs_directory_entry_t const*)entry->self;
+  return self->is_directory;
+}
+
+static char const* fs_get_name(directory_entry_i const* entry) {
+  fs_directory_entry_t const* self = (fs_directory_entry_t const*)entry->self;
+  return self->name;
+}
+
+// the entry belongs to its handle
+static void fs_release(directory_entry_i* entry) {
+  (void)entry;
+}
+
+errno_t delete_file(char const* path) {
+  return unlink(path) ? -1 : 0;
+}
+
+errno_t fs_remove_directory(char const* path) {
+  return rmdir(path) ? -1 : 0;
+}
+
+errno_t fs_create_directory(char const* path) {
+  if (mkdir(path, 0777) && errno != EEXIST) return -1;
+
+  return 0;
+}
+
+errno_t make_dir(char const* path) {
+  return fs_create_directory(path);
+}
+
+short file_exists(char const* path) {
+  return access(path, F_OK) == 0;
+}
+
+errno_t file_size(char const* path, unsigned long long* size) {
+  struct stat st;
+
+  if (stat(path, &st)) return -1;
+
+  *size = (unsigned long long)st.st_size;
+
+  return 0;
+}
+
+errno_t file_mtime(char const* path, unsigned long long* mtime) {
+  struct stat st;
+
+  if (stat(path, &st)) return -1;
+
+  *mtime = (unsigned long long)st.st_mtim.tv_sec * k_file_mtime_ticks_per_second + st.st_mtim.tv_nsec;
+
+  return 0;
+}
+
+errno_t copy_file(char const* src, char const* dst) {
+  return copy_contents(src, dst, EWC_CS_AUTO, NULL);
+}
+
+errno_t copy_file_hashed(char const* src, char const* dst, unsigned long long* hash) {
+  return fs_copy_file(src, dst, EWC_CS_AUTO, hash);
+}
+
+errno_t fs_copy_file(char const* src, char const* dst, copy_strategy_t strategy, unsigned long long* hash) {
+  errno_t err = 0;
+  hash_state_t state;
+
+  if (!hash) return copy_contents(src, dst, strategy, NULL);
+
+  hash_state_init(&state, 0);
+
+  err = copy_contents(src, dst, strategy, &state);
+  if (!err) *hash = hash_state_digest(&state);
+
+  return err;
+}
+
+errno_t link_file(char const* src, char const* dst) {
+  return link(src, dst) ? -1 : 0;
+}
+
+errno_t rename_file(char const* src, char const* dst) {
+#ifdef SYS_renameat2
+  if (!syscall(SYS_renameat2, AT_FDCWD, src, AT_FDCWD, dst, RENAME_NOREPLACE)) return 0;
+  if (errno != EINVAL && errno != ENOSYS) return -1;
+#endif
+
+  // a filesystem that can't refuse to rename over a file can still refuse
+  // to link over one
+  if (link(src, dst)) return -1;
+
+  unlink(src);
+
+  return 0;
+}
+
+errno_t replace_file(char const* src, char const* dst) {
+  struct stat st;
+
+  if (rename(src, dst)) return -1;
+
+  // renaming one link of a file over another does nothing at all, so src
+  // is still there when both were linked to the same source
+  if (!lstat(src, &st) && unlink(src)) return -1;
+
+  return 0;
+}
+
+errno_t sync_file(char const* path) {
+  errno_t err = 0;
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+  if (fd < 0) return -1;
+
+  // any descriptor flushes what every descriptor wrote
+  if (fsync(fd)) err = -1;
+  close(fd);
+
+  return err;
+}
+
+errno_t create_file_exclusive(char const* path, void const* bytes, size_t length, short* created) {
+  errno_t err = 0;
+  int fd = -1;
+
+  ERR_REGION_BEGIN() {
+    *created = 0;
+
+    // O_EXCL is decided by the filesystem, even one shared over a network
+    fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+    ERR_REGION_CMP_EXIT(fd < 0 && errno == EEXIST);
+    ERR_REGION_CMP_CHECK(fd < 0, err);
+    *created = 1;
+
+    ERR_REGION_ERROR_CHECK(write_all(fd, bytes, length), err);
+
+  } ERR_REGION_END()
+
+  if (fd >= 0) close(fd);
+
+  return err;
+}
+
+errno_t touch_file(char const* path) {
+  return utimensat(AT_FDCWD, path, NULL, 0) ? -1 : 0;
+}
+
+errno_t map_file(char const* path, void const** view, size_t* size) {
+  errno_t err = 0;
+  int fd = -1;
+  struct stat st;
+  void* mapped = MAP_FAILED;
+
+  ERR_REGION_BEGIN() {
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    ERR_REGION_CMP_CHECK(fd < 0, err);
+
+    ERR_REGION_CMP_CHECK(fstat(fd, &st), err);
+    ERR_REGION_CMP_CHECK(st.st_size <= 0, err);
+    ERR_REGION_CMP_CHECK((unsigned long long)st.st_size > (size_t)-1, err);
+
+    // the mapping keeps the file open by itself
+    mapped = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ERR_REGION_CMP_CHECK(mapped == MAP_FAILED, err);
+
+    *view = mapped;
+    *size = (size_t)st.st_size;
+
+  } ERR_REGION_END()
+
+  if (fd >= 0) close(fd);
+
+  return err;
+}
+
+void unmap_file(void const* view, size_t size) {
+  if (view) munmap((void*)view, size);
+}
+
+// large enough that the disk, not the calls, sets the pace
+#define COPY_BLOCK_SIZE (1024 * 1024)
+
+// asked of the kernel per call, so that even a disc image takes few
+#define KERNEL_COPY_SIZE (16 * 1024 * 1024)
+
+// numbers the temp names copies are made under
+static unsigned long long volatile s_next_copy_temp;
+
+// a fresh name beside dst, for a copy to be made under and then renamed
+// over it.  the process id keeps other processes copying to the same dst
+// from choosing it too, and one left by a process that stopped is skipped
+// when it is found taken
+static char* copy_temp_path(char const* dst) {
+  return msnprintf("%s.%lu.%llu.tmp", dst, (unsigned long)getpid(), th_atomic_add(&s_next_copy_temp, 1));
+}
+
+// copies src over any dst, keeping its time as CopyFile does, since callers
+// compare against it.  the copy is made under another name and renamed over
+// dst once whole, so a copy that fails leaves any dst as it was.  left to
+// itself, a copy on the same btrfs or XFS volume shares the source's blocks
+// and costs nothing.  failing that the kernel moves the bytes, and only
+// where it can't do they pass through here.  a hash, when asked for, is
+// taken on the way through, or else read after from src, which the kernel
+// copy left in the cache
+static errno_t copy_contents(char const* src, char const* dst, copy_strategy_t strategy, hash_state_t* state) {
+  errno_t err = 0;
+  int src_fd = -1;
+  int dst_fd = -1;
+  char* temp = 0;
+  unsigned char* block = 0;
+  struct stat st;
+  struct stat dst_st;
+  struct timespec times[2];
+  ssize_t read_length = 0;
+  short copied = 0;
+
+  ERR_REGION_BEGIN() {
+    src_fd = open(src, O_RDONLY | O_CLOEXEC);
+    ERR_REGION_CMP_CHECK(src_fd < 0, err);
+    ERR_REGION_CMP_CHECK(fstat(src_fd, &st), err);
+    posix_fadvise(src_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    // dst may be a link to src already, as linked copies are, so has its
+    // content already
+    if (!stat(dst, &dst_st) && dst_st.st_dev == st.st_dev && dst_st.st_ino == st.st_ino) {
+      if (state) ERR_REGION_ERROR_CHECK(hash_contents(src_fd, state), err);
+      ERR_REGION_EXIT();
+    }
+
+    while (dst_fd < 0) {
+      SAFE_FREE(temp);
+      ERR_REGION_NULL_CHECK(temp = copy_temp_path(dst), err);
+
+      dst_fd = open(temp, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, st.st_mode & 0777);
+      if (dst_fd < 0 && errno == EEXIST) continue;
+      ERR_REGION_CMP_CHECK(dst_fd < 0, err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    if (strategy != EWC_CS_COPY) {
+      copied = !ioctl(dst_fd, FICLONE, src_fd);
+      if (copied) {
+        th_atomic_add(&fs_copy_counts.shared, 1);
+      }
+      else {
+        ERR_REGION_ERROR_CHECK(copy_in_kernel(src_fd, dst_fd, &copied), err);
+        if (copied) th_atomic_add(&fs_copy_counts.by_system, 1);
+      }
+
+      if (copied && state) {
+        ERR_REGION_CMP_CHECK(lseek(src_fd, 0, SEEK_SET), err);
+        ERR_REGION_ERROR_CHECK(hash_contents(src_fd, state), err);
+      }
+    }
+
+    if (!copied) {
+      th_atomic_add(&fs_copy_counts.buffered, 1);
+
+      block = malloc(COPY_BLOCK_SIZE);
+      ERR_REGION_NULL_CHECK(block, err);
+
+      while (1) {
+        read_length = read(src_fd, block, COPY_BLOCK_SIZE);
+        if (read_length < 0 && errno == EINTR) continue;
+        ERR_REGION_CMP_CHECK(read_length < 0, err);
+        if (!read_length) break;
+
+        // hash what was read while it's still in cache
+        if (state) hash_state_update(state, block, (size_t)read_length);
+
+        ERR_REGION_ERROR_CHECK(write_all(dst_fd, block, (size_t)read_length), err);
+      } ERR_REGION_ERROR_BUBBLE(err);
+    }
+
+    times[0] = st.st_atim;
+    times[1] = st.st_mtim;
+    ERR_REGION_CMP_CHECK(futimens(dst_fd, times), err);
+
+    // a network filesystem may only report a failed write as it closes
+    ERR_REGION_CMP_CHECK(close(dst_fd), err);
+    dst_fd = -1;
+
+    ERR_REGION_CMP_CHECK(rename(temp, dst), err);
+    SAFE_FREE(temp);
+
+  } ERR_REGION_END()
+
+  if (dst_fd >= 0) close(dst_fd);
+
+  // the temp file is only left when the copy failed
+  if (temp) unlink(temp);
+
+  if (src_fd >= 0) close(src_fd);
+
+  SAFE_FREE(temp);
+  SAFE_FREE(block);
+
+  return err;
+}
+
+// the errors of a kernel or filesystem that can't copy this way, rather
+// than of a copy that went wrong
+static short is_unsupported(int error) {
+  return error == ENOSYS || error == EXDEV || error == EINVAL
+    || error == EOPNOTSUPP || error == ENOTSUP;
+}
+
+// copies from the offset of each descriptor to the end of src, without the
+// bytes leaving the kernel.  copy_file_range lets the filesystem copy as it
+// likes, even server side over nfs, and sendfile at least spares the copies
+// into and out of this process.  copied is left 0 where neither can start,
+// for the caller to copy itself
+static errno_t copy_in_kernel(int src_fd, int dst_fd, short* copied) {
+  ssize_t length = 0;
+  short started = 0;
+
+#ifdef SYS_copy_file_range
+  while ((length = syscall(SYS_copy_file_range, src_fd, NULL, dst_fd, NULL, KERNEL_COPY_SIZE, 0)) != 0) {
+    if (length < 0 && errno == EINTR) continue;
+    if (length < 0 && !started && is_unsupported(errno)) break;
+    if (length < 0) return -1;
+
+    started = 1;
+  }
+
+  if (!length) {
+    *copied = 1;
+    return 0;
+  }
+#endif
+
+  while ((length = sendfile(dst_fd, src_fd, NULL, KERNEL_COPY_SIZE)) != 0) {
+    if (length < 0 && errno == EINTR) continue;
+    if (length < 0 && !started && is_unsupported(errno)) return 0;
+    if (length < 0) return -1;
+
+    started = 1;
+  }
+
+  *copied = 1;
+
+  return 0;
+}
+
+static errno_t hash_contents(int fd, hash_state_t* state) {
+  errno_t err = 0;
+  unsigned char* block = malloc(COPY_BLOCK_SIZE);
+  ssize_t read_length = 0;
+
+  if (!block) return -1;
+
+  while ((read_length = read(fd, block, COPY_BLOCK_SIZE)) != 0) {
+    if (read_length < 0 && errno == EINTR) continue;
+    if (read_length < 0) {
+      err = -1;
+      break;
+    }
+
+    hash_state_update(state, block, (size_t)read_length);
+  }
+
+  SAFE_FREE(block);
+
+  return err;
+}
+
+static errno_t write_all(int fd, void const* bytes, size_t length) {
+  unsigned char const* at = (unsigned char const*)bytes;
+
+  while (length) {
+    ssize_t written = write(fd, at, length);
+
+    if (written < 0 && errno == EINTR) continue;
+    if (written <= 0) return -1;
+
+    at += written;
+    length -= (size_t)written;
+  }
+
+  return 0;
+}
+
+#endif
@@ -0,0 +1,177 @@
+#include "filesystem_shared.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem_helpers.h"
+#include "err_helpers.h"
+#include "path.h"
+#include "hash_helpers.h"
+#include "directory_traversal.h"
+#include "directory_traversal_handler.h"
+#include "parallel_visitor.h"
+#include "thread_helpers.h"
+
+// directories of a tree read at once while deleting or copying it.  over a
+// share each read is a round trip, which the others overlap
+#define TREE_THREADS 4
+
+copy_counts_t fs_copy_counts;
+
+typedef struct delete_visitor {
+  directory_traversal_handler_i handler_i;
+} delete_visitor_t;
+
+static short dv_visit(struct directory_traversal_handler* self, directory_traversal_handler_state_t const* state) {
+  directory_entry_i const* entry = state->entry;
+  char const *full_path = state->path;
+
+  (void)self;
+
+  errno_t result;
+  if (! entry->is_directory(entry)) {
+    result = delete_file(full_path);
+  }
+  else {
+    result = fs_remove_directory(full_path);
+  }
+
+  return ! result;
+}
+
+static void dv_init_visitor(delete_visitor_t* self) {
+  memset(self, 0, sizeof(*self));
+  self->handler_i.self = self;
+  self->handler_i.visit = dv_visit;
+}
+
+errno_t delete_dir(char const* path) {
+  delete_visitor_t visitor;
+  dv_init_visitor(&visitor);
+
+  directory_traversal_options_t opts;
+  memset(&opts, 0, sizeof(opts));
+  opts.should_descend = 1;
+  opts.post_visit = 1;
+  opts.threads = TREE_THREADS;
+
+  errno_t result = 0;
+  short keep_traversing = traverse_dir_path_opts(path, &opts, &visitor.handler_i);
+  if (keep_traversing) {
+    result = fs_remove_directory(path);
+  }
+
+  return result;
+}
+
+errno_t ensure_dir(char const* path) {
+  errno_t err = 0;
+  char *buf = 0;
+  path_enumerator_i* i = 0;
+
+  ERR_REGION_BEGIN() {
+    size_t path_len = strlen(path);
+    buf = malloc(path_len + 1);
+    ERR_REGION_NULL_CHECK(buf, err);
+    memset(buf, 0, path_len + 1);
+
+    // enumerate the path
+    i = enumerate_path(path);
+    ERR_REGION_NULL_CHECK(i, err);
+
+    // check that each point has a directory created
+    while (i->has_next(i) && !err) {
+      path_enumerate_status_t status = i->next(i);
+      size_t full_path_len = status.path_end - status.full_path_start;
+      memcpy(buf, status.full_path_start, full_path_len);
+      *(buf + full_path_len) = 0;
+
+      err = fs_create_directory(buf);
+    }
+
+  } ERR_REGION_END()
+
+  if (i) i->dispose(i);
+  SAFE_FREE(buf);
+
+  return err;
+}
+
+typedef struct {
+  parallel_visitor_t pv_t;
+} copy_dir_visitor_t;
+
+static short cdv_visit(parallel_visitor_t* self_t, parallel_visitor_state_t const* state) {
+
+  directory_entry_i const* entry = state->base_state->entry;
+
+  char const* src_path = state->base_state->path;
+  char const *dst_path = state->parallel_path;
+  char const *dir = 0;
+  short keep_traversing = 1;
+
+  (void)self_t;
+
+  ERR_REGION_BEGIN() {
+    // make sure the target directory exists
+    dir = path_dir_part(dst_path);
+    ERR_REGION_NULL_CHECK_CODE(dir, keep_traversing, 0);
+    ERR_REGION_ERROR_CHECK_CODE(ensure_dir(dir), keep_traversing, 0);
+
+    // if directory, ensure it
+    // if file, copy it
+    if (entry->is_directory(entry)) {
+      ERR_REGION_ERROR_CHECK_CODE(ensure_dir(dst_path), keep_traversing, 0);
+    }
+    else {
+      ERR_REGION_ERROR_CHECK_CODE(copy_file(src_path, dst_path), keep_traversing, 0);
+    }
+  } ERR_REGION_END()
+
+  SAFE_FREE(dir);
+
+  return keep_traversing;
+}
+
+
+errno_t copy_dir(char const* src, char const* dst) {
+  errno_t err = 0;
+  copy_dir_visitor_t visitor = {0};
+  directory_traversal_options_t opts = { 0 };
+
+  opts.should_descend = 1;
+  opts.threads = TREE_THREADS;
+
+  // run a parallel traverse of the src dir, using that to build up the target
+  ERR_REGION_BEGIN() {
+    ERR_REGION_ERROR_CHECK(parallel_visitor_init(&visitor.pv_t, dst), err);
+    visitor.pv_t.self = &visitor;
+    visitor.pv_t.visit = cdv_visit;
+
+    // each directory is visited before anything in it, so is there for it
+    ERR_REGION_CMP_CHECK(! traverse_dir_path_opts(src, &opts, &visitor.pv_t.handler_i), err);
+
+  } ERR_REGION_END()
+
+  parallel_visitor_uninit(&visitor.pv_t);
+
+  return err;
+}
+
+errno_t copy_file_as(char const* src, char const* dst, copy_strategy_t strategy, unsigned long long* hash) {
+  if (strategy == EWC_CS_LINK && !link_file(src, dst)) {
+    th_atomic_add(&fs_copy_counts.linked, 1);
+
+    // nothing was read, so the hash takes a read of its own
+    return hash ? hash_file(dst, hash) : 0;
+  }
+
+  return fs_copy_file(src, dst, strategy, hash);
+}
+
+void copy_counts_get(copy_counts_t* counts) {
+  counts->linked = th_atomic_add(&fs_copy_counts.linked, 0);
+  counts->shared = th_atomic_add(&fs_copy_counts.shared, 0);
+  counts->by_system = th_atomic_add(&fs_copy_counts.by_system, 0);
+  counts->buffered = th_atomic_add(&fs_copy_counts.buffered, 0);
+}
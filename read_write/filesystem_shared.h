@@ -0,0 +1,17 @@
+#pragma once
+
+#include "filesystem.h"
+
+// what each platform provides for the parts of filesystem.h written once,
+// in filesystem_shared.c, in terms of them
+
+// removes a single directory, which must be empty
+errno_t fs_remove_directory(char const* path);
+// creates a single directory, succeeding if it is already there
+errno_t fs_create_directory(char const* path);
+// copies src over any dst, by strategy where the platform tells copies
+// apart, hashing the content when hash isn't NULL
+errno_t fs_copy_file(char const* src, char const* dst, copy_strategy_t strategy, unsigned long long* hash);
+
+// what copy_counts_get reports, kept up with th_atomic_add by each copy
+extern copy_counts_t fs_copy_counts;
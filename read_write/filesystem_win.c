@@ -1,4 +1,4 @@
-#include "filesystem.h"
+#include "filesystem_shared.h"
 
 #ifdef _WIN32
 
@@ -13,11 +13,11 @@
 
 #include "mem_helpers.h"
 #include "string_helpers.h"
-#include "directory_traversal.h"
-#include "directory_traversal_handler.h"
 #include "path.h"
 #include "err_helpers.h"
-#include "parallel_visitor.h"
+#include "hash_helpers.h"
+#include "format_helpers.h"
+#include "thread_helpers.h"
 
 //#define PRINT_ONLY
 
@@ -29,6 +29,11 @@ const char k_path_separator[] = { PATH_SEPARATOR_CHAR, 0 };
 const char k_ext_separator_char = EXT_SEPARATOR_CHAR;
 const char k_ext_separator[] = { EXT_SEPARATOR_CHAR, 0 };
 
+const short k_path_ignores_case = 1;
+
+// last write times count 100ns ticks
+const unsigned long long k_file_mtime_ticks_per_second = 10000000;
+
 static char const s_path_wildcard[] = "\\*";
 static const size_t s_path_wildcard_len = sizeof(s_path_wildcard) - 1;
 
@@ -38,14 +43,19 @@ typedef struct fs_file_handle {
   WIN32_FIND_DATA ffd;
   char const *path;
   short eof;
+  directory_entry_filter filter;  // NULL for none
+  void const* filter_context;  // weak ref
+  char filter_name[MAX_PATH * 3];  // the name found, narrowed for the filter, as long as it can get
 } fs_file_handle_t;
 
 static void fs_file_handle_init(fs_file_handle_t* self);
+static void fs_skip_filtered(fs_file_handle_t* self);
 static short fs_is_eof(file_handle_i const* self);
 static void fs_close_dir(file_handle_i* handle);
 static directory_entry_i* fs_next_dir_entry(file_handle_i* handle);
 static file_handle_i* fs_open_directory(file_handle_i const* handle, char const *path);
 static char const* fs_get_path(file_handle_i const* handle);
+static void fs_set_entry_filter(file_handle_i* handle, directory_entry_filter filter, void const* context);
 
 typedef struct fs_directory_entry {
   directory_entry_i entry_i;
@@ -102,6 +112,9 @@ static void fs_file_handle_init(fs_file_handle_t* self) {
   self->handle_i.next_dir_entry = fs_next_dir_entry;
   self->handle_i.open_directory = fs_open_directory;
   self->handle_i.get_path = fs_get_path;
+  self->handle_i.set_entry_filter = fs_set_entry_filter;
+  self->filter = NULL;
+  self->filter_context = NULL;
 }
 
 file_handle_i* open_dir(char const* path) {
@@ -186,10 +199,36 @@ directory_entry_i* fs_next_dir_entry(file_handle_i* handle) {
   result->is_directory = !!(self->ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY);
 
   self->eof = !FindNextFile(self->handle, &self->ffd);
+  fs_skip_filtered(self);
 
   return &result->entry_i;
 }
 
+// what the filter doesn't pass is skipped as it is found, so the end is
+// known before it's reached.  a name that can't be narrowed is handed
+// out, to fail as it would without a filter
+static void fs_skip_filtered(fs_file_handle_t* self) {
+  while (self->filter && !self->eof) {
+    short is_directory = !!(self->ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY);
+
+    if (!WideCharToMultiByte(CP_UTF8, 0, self->ffd.cFileName, -1,
+      self->filter_name, sizeof(self->filter_name), NULL, NULL)) return;
+
+    if (self->filter(self->filter_context, self->filter_name, is_directory)) return;
+
+    self->eof = !FindNextFile(self->handle, &self->ffd);
+  }
+}
+
+static void fs_set_entry_filter(file_handle_i* handle, directory_entry_filter filter, void const* context) {
+  fs_file_handle_t* self = (fs_file_handle_t*)handle->self;
+
+  self->filter = filter;
+  self->filter_context = context;
+
+  fs_skip_filtered(self);
+}
+
 static char const* join_path(char const* base, char const* path) {
   char const *strings[] = { base, path };
   return join_cstrs(strings, 2, k_path_separator);
@@ -253,7 +292,7 @@ errno_t delete_file(char const* path) {
   return ! result;
 }
 
-static errno_t remove_directory(char const* path) {
+errno_t fs_remove_directory(char const* path) {
   BOOL result = 1;
   wchar_t* path_w = widen_path(path);
   if (!path_w) return -1;
@@ -270,55 +309,7 @@ static errno_t remove_directory(char const* path) {
   return !result;
 }
 
-typedef struct delete_visitor {
-  directory_traversal_handler_i handler_i;
-} delete_visitor_t;
-
-static short dv_visit(struct directory_traversal_handler* self, directory_traversal_handler_state_t const* state) {
-  file_handle_i const* directory = state->directory;
-  directory_entry_i const* entry = state->entry;
-
-  char const *full_path = join_path(directory->get_path(directory), entry->get_name(entry));
-  if (! full_path) return 0;
-
-  errno_t result;
-  if (! entry->is_directory(entry)) {
-    result = delete_file(full_path);
-  }
-  else {
-    result = remove_directory(full_path);
-  }
-
-  SAFE_FREE(full_path);
-
-  return ! result;
-}
-
-static void dv_init_visitor(delete_visitor_t* self) {
-  memset(self, 0, sizeof(*self));
-  self->handler_i.self = self;
-  self->handler_i.visit = dv_visit;
-}
-
-errno_t delete_dir(char const* path) {
-  delete_visitor_t visitor;
-  dv_init_visitor(&visitor);
-
-  directory_traversal_options_t opts;
-  memset(&opts, 0, sizeof(opts));
-  opts.should_descend = 1;
-  opts.post_visit = 1;
-
-  errno_t result = 0;
-  short keep_traversing = traverse_dir_path_opts(path, &opts, &visitor.handler_i);
-  if (keep_traversing) {
-    result = remove_directory(path);
-  }
-
-  return result;
-}
-
-static errno_t create_directory(char const* path) {
+errno_t fs_create_directory(char const* path) {
   BOOL result = 1;
   wchar_t* path_w = widen_path(path);
   if (!path_w) return -1;
@@ -341,37 +332,8 @@ static errno_t create_directory(char const* path) {
   return !result;
 }
 
-errno_t ensure_dir(char const* path) {
-  errno_t err = 0;
-  char *buf = 0;
-  path_enumerator_i* i = 0;
-
-  ERR_REGION_BEGIN() {
-    size_t path_len = strlen(path);
-    buf = malloc(path_len + 1);
-    ERR_REGION_NULL_CHECK(buf, err);
-    memset(buf, 0, path_len + 1);
-
-    // enumerate the path
-    i = enumerate_path(path);
-    ERR_REGION_NULL_CHECK(i, err);
-
-    // check that each point has a directory created
-    while (i->has_next(i) && !err) {
-      path_enumerate_status_t status = i->next(i);
-      size_t full_path_len = status.path_end - status.full_path_start;
-      memmove_s(buf, path_len + 1, status.full_path_start, full_path_len);
-      *(buf + full_path_len) = 0;
-
-      err = create_directory(buf);
-    }
-
-  } ERR_REGION_END()
-
-  if (i) i->dispose(i);
-  SAFE_FREE(buf);
-
-  return err;
+errno_t make_dir(char const* path) {
+  return fs_create_directory(path);
 }
 
 short file_exists(char const* path) {
@@ -392,11 +354,61 @@ short file_exists(char const* path) {
   return result;
 }
 
+errno_t file_size(char const* path, unsigned long long* size) {
+  errno_t err = 0;
+  WIN32_FILE_ATTRIBUTE_DATA data;
+  wchar_t* path_w = 0;
+
+  ERR_REGION_BEGIN() {
+    path_w = widen_path(path);
+    ERR_REGION_NULL_CHECK(path_w, err);
+
+    ERR_REGION_CMP_CHECK(!GetFileAttributesEx(path_w, GetFileExInfoStandard, &data), err);
+
+    *size = ((unsigned long long)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+
+  } ERR_REGION_END()
+
+  SAFE_FREE(path_w);
+
+  return err;
+}
+
+errno_t file_mtime(char const* path, unsigned long long* mtime) {
+  errno_t err = 0;
+  WIN32_FILE_ATTRIBUTE_DATA data;
+  wchar_t* path_w = 0;
+
+  ERR_REGION_BEGIN() {
+    path_w = widen_path(path);
+    ERR_REGION_NULL_CHECK(path_w, err);
+
+    ERR_REGION_CMP_CHECK(!GetFileAttributesEx(path_w, GetFileExInfoStandard, &data), err);
+
+    // 100ns ticks since 1601
+    *mtime = ((unsigned long long)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+
+  } ERR_REGION_END()
+
+  SAFE_FREE(path_w);
+
+  return err;
+}
+
+// numbers the temp names copies are made under
+static unsigned long long volatile s_next_copy_temp;
+
+// copies src over any dst.  the copy is made under another name and moved
+// over dst once whole, so a copy that fails leaves any dst as it was.  the
+// process id keeps other processes copying to the same dst from choosing
+// the same name, and one left by a process that stopped is skipped
 errno_t copy_file(char const* src, char const* dst) {
   errno_t err = 0;
-  BOOL win_success = 1;
+  BOOL win_success = 0;
   wchar_t* src_w = 0;
+  wchar_t* temp_w = 0;
   wchar_t* dst_w = 0;
+  char* temp = 0;
 
   ERR_REGION_BEGIN() {
     src_w = widen_path(src);
@@ -405,79 +417,240 @@ errno_t copy_file(char const* src, char const* dst) {
     dst_w = widen_path(dst);
     ERR_REGION_NULL_CHECK(dst_w, err);
 
-    win_success = CopyFile(src_w, dst_w, FALSE);  // allow overwrite
-    ERR_REGION_CMP_CHECK(! win_success, err);
+    while (!win_success) {
+      SAFE_FREE(temp_w);
+      SAFE_FREE(temp);
+      ERR_REGION_NULL_CHECK(temp = msnprintf("%s.%lu.%llu.tmp", dst,
+        (unsigned long)GetCurrentProcessId(), th_atomic_add(&s_next_copy_temp, 1)), err);
+      ERR_REGION_NULL_CHECK(temp_w = widen_path(temp), err);
+
+      win_success = CopyFile(src_w, temp_w, TRUE);  // claims the name
+      if (!win_success && GetLastError() == ERROR_FILE_EXISTS) continue;
+      ERR_REGION_CMP_CHECK(!win_success, err);
+    } ERR_REGION_ERROR_BUBBLE(err);
+
+    th_atomic_add(&fs_copy_counts.by_system, 1);
+
+    ERR_REGION_CMP_CHECK(!MoveFileEx(temp_w, dst_w, MOVEFILE_REPLACE_EXISTING), err);
+    SAFE_FREE(temp_w);
 
   } ERR_REGION_END()
 
+  // the temp file is only left when the copy failed
+  if (temp_w) DeleteFile(temp_w);
+
+  SAFE_FREE(temp);
+  SAFE_FREE(temp_w);
   SAFE_FREE(dst_w);
   SAFE_FREE(src_w);
 
   return err;
 }
 
-typedef struct {
-  parallel_visitor_t pv_t;
-} copy_dir_visitor_t;
+// CopyFile decides for itself how the blocks are copied, with no way to
+// ask for them all to be written again, so every strategy copies alike.
+// it may copy server side, or share blocks on ReFS, so a hash is read
+// after from src, which a local copy left in the cache
+errno_t fs_copy_file(char const* src, char const* dst, copy_strategy_t strategy, unsigned long long* hash) {
+  errno_t err = copy_file(src, dst);
+
+  (void)strategy;
 
-static short cdv_visit(parallel_visitor_t* self_t, parallel_visitor_state_t const* state) {
+  if (!err && hash) err = hash_file(src, hash);
+
+  return err;
+}
 
-  copy_dir_visitor_t* self = (copy_dir_visitor_t*)self_t->self;
-  file_handle_i const* directory = state->base_state->directory;
-  directory_entry_i const* entry = state->base_state->entry;
+errno_t copy_file_hashed(char const* src, char const* dst, unsigned long long* hash) {
+  return fs_copy_file(src, dst, EWC_CS_AUTO, hash);
+}
 
-  char const* src_path = 0;
-  char const *dst_path = state->parallel_path;
-  char const *dir = 0;
-  short keep_traversing = 1;
-  char const* parallel_path = state->parallel_path;
+errno_t link_file(char const* src, char const* dst) {
+  errno_t err = 0;
+  wchar_t* src_w = 0;
+  wchar_t* dst_w = 0;
 
   ERR_REGION_BEGIN() {
-    src_path = join_dir_file_path(
-      directory->get_path(directory),
-      entry->get_name(entry)
-    );
-    ERR_REGION_NULL_CHECK_CODE(src_path, keep_traversing, 0);
-
-    // make sure the target directory exists
-    dir = path_dir_part(dst_path);
-    ERR_REGION_NULL_CHECK_CODE(dir, keep_traversing, 0);
-    ERR_REGION_ERROR_CHECK_CODE(ensure_dir(dir), keep_traversing, 0);
-
-    // if directory, ensure it
-    // if file, copy it
-    if (entry->is_directory(entry)) {
-      ERR_REGION_ERROR_CHECK_CODE(ensure_dir(dst_path), keep_traversing, 0);
-    }
-    else {
-      ERR_REGION_ERROR_CHECK_CODE(copy_file(src_path, dst_path), keep_traversing, 0);
-    }
+    src_w = widen_path(src);
+    ERR_REGION_NULL_CHECK(src_w, err);
+
+    dst_w = widen_path(dst);
+    ERR_REGION_NULL_CHECK(dst_w, err);
+
+    ERR_REGION_CMP_CHECK(!CreateHardLink(dst_w, src_w, NULL), err);
+
   } ERR_REGION_END()
 
-  SAFE_FREE(dir);
-  SAFE_FREE(src_path);
+  SAFE_FREE(dst_w);
+  SAFE_FREE(src_w);
 
-  return keep_traversing;
+  return err;
 }
 
+errno_t rename_file(char const* src, char const* dst) {
+  errno_t err = 0;
+  wchar_t* src_w = 0;
+  wchar_t* dst_w = 0;
+
+  ERR_REGION_BEGIN() {
+    src_w = widen_path(src);
+    ERR_REGION_NULL_CHECK(src_w, err);
+
+    dst_w = widen_path(dst);
+    ERR_REGION_NULL_CHECK(dst_w, err);
+
+    ERR_REGION_CMP_CHECK(!MoveFileEx(src_w, dst_w, 0), err);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE(dst_w);
+  SAFE_FREE(src_w);
+
+  return err;
+}
+
+errno_t replace_file(char const* src, char const* dst) {
+  errno_t err = 0;
+  wchar_t* src_w = 0;
+  wchar_t* dst_w = 0;
+
+  ERR_REGION_BEGIN() {
+    src_w = widen_path(src);
+    ERR_REGION_NULL_CHECK(src_w, err);
+
+    dst_w = widen_path(dst);
+    ERR_REGION_NULL_CHECK(dst_w, err);
+
+    ERR_REGION_CMP_CHECK(!MoveFileEx(src_w, dst_w, MOVEFILE_REPLACE_EXISTING), err);
+
+  } ERR_REGION_END()
+
+  SAFE_FREE(dst_w);
+  SAFE_FREE(src_w);
+
+  return err;
+}
+
+errno_t sync_file(char const* path) {
+  errno_t err = 0;
+  wchar_t* path_w = 0;
+  HANDLE h = INVALID_HANDLE_VALUE;
+
+  ERR_REGION_BEGIN() {
+    path_w = widen_path(path);
+    ERR_REGION_NULL_CHECK(path_w, err);
+
+    // any handle able to write flushes what every handle wrote
+    h = CreateFile(path_w, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    ERR_REGION_INVALID_CHECK(h, err);
+
+    ERR_REGION_CMP_CHECK(!FlushFileBuffers(h), err);
+
+  } ERR_REGION_END()
 
-errno_t copy_dir(char const* src, char const* dst) {
+  if (h != INVALID_HANDLE_VALUE) CloseHandle(h);
+  SAFE_FREE(path_w);
+
+  return err;
+}
+
+errno_t create_file_exclusive(char const* path, void const* bytes, size_t length, short* created) {
   errno_t err = 0;
-  copy_dir_visitor_t visitor = {0};
+  wchar_t* path_w = 0;
+  HANDLE h = INVALID_HANDLE_VALUE;
+  DWORD written = 0;
 
-  // run a parallel traverse of the src dir, using that to build up the target
   ERR_REGION_BEGIN() {
-    ERR_REGION_ERROR_CHECK(parallel_visitor_init(&visitor.pv_t, dst), err);
-    visitor.pv_t.self = &visitor;
-    visitor.pv_t.visit = cdv_visit;
+    path_w = widen_path(path);
+    ERR_REGION_NULL_CHECK(path_w, err);
+
+    *created = 0;
+
+    // CREATE_NEW is decided by the filesystem, even one shared over a network
+    h = CreateFile(path_w, GENERIC_WRITE, FILE_SHARE_READ, NULL,
+      CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+    ERR_REGION_CMP_EXIT(h == INVALID_HANDLE_VALUE && GetLastError() == ERROR_FILE_EXISTS);
+    ERR_REGION_INVALID_CHECK(h, err);
+    *created = 1;
 
-    ERR_REGION_CMP_CHECK(! traverse_dir_path(src, &visitor.pv_t.handler_i), err);
+    ERR_REGION_CMP_CHECK(!WriteFile(h, bytes, (DWORD)length, &written, NULL), err);
+    ERR_REGION_CMP_CHECK(written != length, err);
 
   } ERR_REGION_END()
 
-  parallel_visitor_uninit(&visitor.pv_t);
+  if (h != INVALID_HANDLE_VALUE) CloseHandle(h);
+  SAFE_FREE(path_w);
 
   return err;
 }
 
+errno_t touch_file(char const* path) {
+  errno_t err = 0;
+  wchar_t* path_w = 0;
+  HANDLE h = INVALID_HANDLE_VALUE;
+  FILETIME now;
+
+  ERR_REGION_BEGIN() {
+    path_w = widen_path(path);
+    ERR_REGION_NULL_CHECK(path_w, err);
+
+    h = CreateFile(path_w, FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+      NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    ERR_REGION_INVALID_CHECK(h, err);
+
+    GetSystemTimeAsFileTime(&now);
+    ERR_REGION_CMP_CHECK(!SetFileTime(h, NULL, NULL, &now), err);
+
+  } ERR_REGION_END()
+
+  if (h != INVALID_HANDLE_VALUE) CloseHandle(h);
+  SAFE_FREE(path_w);
+
+  return err;
+}
+
+errno_t map_file(char const* path, void const** view, size_t* size) {
+  errno_t err = 0;
+  wchar_t* path_w = 0;
+  HANDLE file_h = INVALID_HANDLE_VALUE;
+  HANDLE mapping_h = NULL;
+  LARGE_INTEGER file_size;
+  void const* mapped = 0;
+
+  ERR_REGION_BEGIN() {
+    path_w = widen_path(path);
+    ERR_REGION_NULL_CHECK(path_w, err);
+
+    file_h = CreateFile(path_w, GENERIC_READ, FILE_SHARE_READ, NULL,
+      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    ERR_REGION_CMP_CHECK(file_h == INVALID_HANDLE_VALUE, err);
+
+    ERR_REGION_CMP_CHECK(!GetFileSizeEx(file_h, &file_size), err);
+    ERR_REGION_CMP_CHECK(file_size.QuadPart <= 0, err);
+    ERR_REGION_CMP_CHECK((unsigned long long)file_size.QuadPart > (size_t)-1, err);
+
+    mapping_h = CreateFileMapping(file_h, NULL, PAGE_READONLY, 0, 0, NULL);
+    ERR_REGION_NULL_CHECK(mapping_h, err);
+
+    // the view keeps the mapping open by itself
+    mapped = MapViewOfFile(mapping_h, FILE_MAP_READ, 0, 0, 0);
+    ERR_REGION_NULL_CHECK(mapped, err);
+
+    *view = mapped;
+    *size = (size_t)file_size.QuadPart;
+
+  } ERR_REGION_END()
+
+  if (mapping_h) CloseHandle(mapping_h);
+  if (file_h != INVALID_HANDLE_VALUE) CloseHandle(file_h);
+  SAFE_FREE(path_w);
+
+  return err;
+}
+
+void unmap_file(void const* view, size_t size) {
+  if (view) UnmapViewOfFile(view);
+}
+
 #endif
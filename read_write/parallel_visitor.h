@@ -14,6 +14,8 @@ typedef struct parallel_visitor_state {
   char const *parallel_path;  // weak ref
 } parallel_visitor_state_t;
 
+// may be called from several threads at once, as long as visit and exit
+// may be
 typedef struct parallel_visitor {
   directory_traversal_handler_i handler_i;
   void *self;
@@ -26,6 +26,10 @@ char const* path_dir_part(char const* path);
 char const* path_file_part(char const* path);
 char const* join_dir_file_path(char const* dir, char const* file);
 char const* join_path_parts(char const** parts);
+// the part of path under root, pointing into path.  all of path if it isn't under root
+char const* path_relative_part(char const* root, char const* path);
+// the name a file is written under until it is complete, beside the file
+char const* path_part_file(char const* path);
 
 char const* file_name_part(char const* filename);
 char const* file_ext_part(char const* filename);
@@ -13,6 +13,7 @@ static char const s_current_dir[] = ".";
 static const size_t s_current_dir_len = sizeof(s_current_dir) / sizeof(*s_current_dir) - 1;
 static char const s_parent_dir[] = "..";
 static const size_t s_parent_dir_len = sizeof(s_parent_dir) / sizeof(*s_parent_dir) - 1;
+static char const s_part_suffix[] = ".part";
 
 struct ps_path_enumerator;
 
@@ -214,6 +215,28 @@ char const* join_path_parts(char const** parts) {
   return join_cstrs(parts, num_parts, k_path_separator);
 }
 
+char const* path_relative_part(char const* root, char const* path) {
+  size_t root_len = strlen(root);
+
+  if (strncmp(path, root, root_len) != 0) return path;
+
+  // a root of c:\a doesn't contain c:\ab
+  char const* relative = path + root_len;
+  if (*relative && *relative != '\\' && *relative != '/' && root_len
+    && root[root_len - 1] != '\\' && root[root_len - 1] != '/') {
+    return path;
+  }
+
+  while (*relative == '\\' || *relative == '/') ++relative;
+
+  return relative;
+}
+
+char const* path_part_file(char const* path) {
+  char const* strings[] = { path, s_part_suffix };
+  return join_cstrs(strings, 2, "");
+}
+
 char const* file_name_part(char const* filename) {
   return string_find_first_part(filename, k_ext_separator);
 }
@@ -221,4 +244,3 @@ char const* file_name_part(char const* filename) {
 char const* file_ext_part(char const* filename) {
   return string_find_second_part(filename, k_ext_separator);
 }
-